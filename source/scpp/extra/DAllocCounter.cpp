@@ -0,0 +1,100 @@
+/*******************************************************************************
+
+    Counts the allocations made by the C++ side, for the SCP simulation
+    (`dub -c scp-sim`). Replacing the global operator new affects the whole
+    binary, hence this file is only linked by the configurations which
+    report it.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<std::size_t> gAllocCount{0};
+std::atomic<std::size_t> gAllocBytes{0};
+}
+
+void*
+operator new(std::size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void*
+operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void*
+operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return ::operator new(size);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
+void*
+operator new[](std::size_t size, std::nothrow_t const& tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// number of calls to operator new since the start of the program
+std::size_t
+getCppAllocationCount()
+{
+    return gAllocCount.load(std::memory_order_relaxed);
+}
+
+// bytes requested from operator new since the start of the program
+std::size_t
+getCppAllocatedBytes()
+{
+    return gAllocBytes.load(std::memory_order_relaxed);
+}
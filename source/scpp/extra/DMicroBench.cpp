@@ -0,0 +1,666 @@
+/*******************************************************************************
+
+    Contains microbenchmarks of the federated voting primitives, of the
+    quorum intersection checker and of the structures under them, run by
+    `dub -c scp-bench`. The results are written to stdout as JSON.
+    It also replays the recordings of `SCP::startRecording` (see SCPReplay).
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "crypto/Hash.h"
+#include "lib/json/json.h"
+#include "lib/util/cbitset.h"
+#include "quorum/QuorumIntersectionChecker.h"
+#include "scp/LocalNode.h"
+#include "scp/SCP.h"
+#include "scp/SCPDriver.h"
+#include "scp/SCPRecorder.h"
+#include "scp/SCPReplay.h"
+#include "scp/Slot.h"
+#include "util/BitSet.h"
+#include "util/JsonWriter.h"
+#include "xdrpp/marshal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace stellar;
+
+namespace
+{
+typedef std::chrono::steady_clock BenchClock;
+
+// receives the results of the benchmarked calls, so that they aren't
+// optimized out
+size_t volatile gSink;
+
+class Runner
+{
+    JsonWriter& mOut;
+    std::string mFilter;
+    std::chrono::nanoseconds mMinTime;
+
+  public:
+    Runner(JsonWriter& out, std::string const& filter,
+           std::chrono::milliseconds minTime)
+        : mOut(out), mFilter(filter), mMinTime(minTime)
+    {
+    }
+
+    // calls `op` until it took at least the minimum time, and writes the
+    // time per call; `op` must return `expected`, which checks the setup
+    template <typename Op, typename Result>
+    void
+    run(std::string const& name, Result expected, Op const& op)
+    {
+        if (name.find(mFilter) == std::string::npos)
+        {
+            return;
+        }
+        if (!(op() == expected))
+        {
+            throw std::runtime_error(name + ": unexpected result");
+        }
+
+        uint64_t iterations = 1;
+        std::chrono::nanoseconds elapsed;
+        for (;;)
+        {
+            size_t sink = 0;
+            auto start = BenchClock::now();
+            for (uint64_t i = 0; i < iterations; ++i)
+            {
+                sink += static_cast<size_t>(op());
+            }
+            elapsed = BenchClock::now() - start;
+            gSink = gSink + sink;
+            if (elapsed >= mMinTime)
+            {
+                break;
+            }
+            // aim a bit past the minimum time, growing 10x at most
+            auto target = iterations * 11 * mMinTime.count() /
+                          std::max<int64_t>(10 * elapsed.count(), 1);
+            iterations = std::min(iterations * 10,
+                                  std::max<uint64_t>(target, iterations + 1));
+        }
+
+        mOut.beginObject();
+        mOut.key("name");
+        mOut.value(name);
+        mOut.key("iterations");
+        mOut.value(iterations);
+        mOut.key("ns_per_op");
+        mOut.value(Json::Value(static_cast<double>(elapsed.count()) /
+                               static_cast<double>(iterations)));
+        mOut.endObject();
+    }
+};
+
+NodeID
+makeNodeID(size_t i)
+{
+    NodeID id;
+    auto& key = id.ed25519();
+    std::fill(key.begin(), key.end(), 0);
+    for (size_t b = 0; b < sizeof(i); ++b)
+    {
+        key[b] = static_cast<uint8_t>(i >> (8 * b));
+    }
+    return id;
+}
+
+// `count` validators from `first`, as generated by Quorum.d
+SCPQuorumSet
+flatQSet(size_t first, size_t count, uint32 threshold)
+{
+    SCPQuorumSet qSet;
+    qSet.threshold = threshold;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        qSet.validators.emplace_back(makeNodeID(i));
+    }
+    return qSet;
+}
+
+// `orgs` organizations of 3 nodes, of which 2 must agree
+SCPQuorumSet
+orgQSet(size_t orgs, uint32 threshold)
+{
+    SCPQuorumSet qSet;
+    qSet.threshold = threshold;
+    for (size_t o = 0; o < orgs; ++o)
+    {
+        qSet.innerSets.emplace_back(flatQSet(3 * o, 3, 2));
+    }
+    return qSet;
+}
+
+struct Shape
+{
+    std::string mName;
+    SCPQuorumSet mQSet;
+};
+
+std::vector<Shape>
+getShapes()
+{
+    return {{"flat7", flatQSet(0, 7, 6)},
+            {"flat100", flatQSet(0, 100, 80)},
+            {"orgs10", orgQSet(10, 7)}};
+}
+
+std::vector<NodeID>
+getNodes(SCPQuorumSet const& qSet)
+{
+    std::vector<NodeID> nodes;
+    LocalNode::forAllNodes(qSet,
+                           [&](NodeID const& id) { nodes.emplace_back(id); });
+    return nodes;
+}
+
+SCPEnvelope
+makePrepare(NodeID const& id, Hash const& qSetHash, Value const& value,
+            uint32 counter, bool prepared)
+{
+    SCPEnvelope env;
+    env.statement.nodeID = id;
+    env.statement.slotIndex = 1;
+    env.statement.pledges.type(SCP_ST_PREPARE);
+    auto& prep = env.statement.pledges.prepare();
+    prep.quorumSetHash = qSetHash;
+    prep.ballot.counter = counter;
+    prep.ballot.value = value;
+    if (prepared)
+    {
+        prep.prepared.activate() = prep.ballot;
+    }
+    return env;
+}
+
+// envelopes of all the nodes of `qSet`, the first `prepared` ones having
+// prepared their ballot
+std::map<NodeID, SCPEnvelope>
+makeEnvelopes(SCPQuorumSet const& qSet, size_t prepared)
+{
+    Value value(64, 1);
+    auto qSetHash = getHashOf(qSet);
+    std::map<NodeID, SCPEnvelope> envs;
+    auto nodes = getNodes(qSet);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        envs.emplace(nodes[i],
+                     makePrepare(nodes[i], qSetHash, value, 1, i < prepared));
+    }
+    return envs;
+}
+
+class BenchDriver : public SCPDriver
+{
+  public:
+    std::map<Hash, SCPQuorumSetPtr> mQSets;
+
+    void
+    signEnvelope(SCPEnvelope&) override
+    {
+    }
+
+    SCPQuorumSetPtr
+    getQSet(Hash const& qSetHash) override
+    {
+        auto it = mQSets.find(qSetHash);
+        return it == mQSets.end() ? nullptr : it->second;
+    }
+
+    void
+    emitEnvelope(SCPEnvelope const&) override
+    {
+    }
+
+    Value
+    combineCandidates(uint64, std::set<Value> const& candidates) override
+    {
+        return *candidates.rbegin();
+    }
+
+    void
+    setupTimer(uint64, int, std::chrono::milliseconds,
+               std::function<void()>* cb) override
+    {
+        delete cb;
+    }
+};
+
+void
+benchLocalNode(Runner& runner)
+{
+    for (auto const& shape : getShapes())
+    {
+        auto const& qSet = shape.mQSet;
+        auto nodes = getNodes(qSet);
+        auto qSetPtr = std::make_shared<SCPQuorumSet>(qSet);
+
+        // just enough nodes, so that every level is looked at
+        std::vector<NodeID> slice, blocking;
+        if (qSet.innerSets.empty())
+        {
+            slice.assign(nodes.begin(), nodes.begin() + qSet.threshold);
+            blocking.assign(nodes.begin(),
+                            nodes.end() - qSet.threshold + 1);
+        }
+        else
+        {
+            for (size_t o = 0; o < qSet.innerSets.size(); ++o)
+            {
+                if (o < qSet.threshold)
+                {
+                    slice.emplace_back(nodes[3 * o]);
+                    slice.emplace_back(nodes[3 * o + 1]);
+                }
+                if (o < qSet.innerSets.size() - qSet.threshold + 1)
+                {
+                    blocking.emplace_back(nodes[3 * o]);
+                    blocking.emplace_back(nodes[3 * o + 1]);
+                }
+            }
+        }
+        runner.run("LocalNode/isQuorumSlice/" + shape.mName, true, [&]() {
+            return LocalNode::isQuorumSlice(qSet, slice);
+        });
+        runner.run("LocalNode/isVBlocking/" + shape.mName, true, [&]() {
+            return LocalNode::isVBlocking(qSet, blocking);
+        });
+
+        auto envs = makeEnvelopes(qSet, 0);
+        runner.run("LocalNode/isQuorum/" + shape.mName, true, [&]() {
+            return LocalNode::isQuorum(
+                qSet, envs, [&](SCPStatement const&) { return qSetPtr; });
+        });
+    }
+}
+
+void
+benchFederatedVoting(Runner& runner)
+{
+    StatementPredicate voted = [](SCPStatement const& st) {
+        return st.pledges.prepare().ballot.counter != 0;
+    };
+    StatementPredicate accepted = [](SCPStatement const& st) {
+        return !!st.pledges.prepare().prepared;
+    };
+
+    for (auto const& shape : getShapes())
+    {
+        auto const& qSet = shape.mQSet;
+        auto nodes = getNodes(qSet);
+        BenchDriver driver;
+        driver.mQSets[getHashOf(qSet)] = std::make_shared<SCPQuorumSet>(qSet);
+        SCP scp(driver, nodes.front(), true, qSet);
+        auto slot = std::make_shared<Slot>(1, scp);
+
+        // accepted by a v-blocking set, or only voted for by a quorum
+        auto blocking = makeEnvelopes(qSet, nodes.size());
+        auto quorum = makeEnvelopes(qSet, 0);
+        runner.run("Slot/federatedAccept/vblocking/" + shape.mName, true,
+                   [&]() {
+                       return slot->federatedAccept(voted, accepted, blocking);
+                   });
+        runner.run("Slot/federatedAccept/quorum/" + shape.mName, true, [&]() {
+            return slot->federatedAccept(voted, accepted, quorum);
+        });
+        runner.run("Slot/federatedRatify/" + shape.mName, true,
+                   [&]() { return slot->federatedRatify(voted, quorum); });
+    }
+}
+
+// quorum map where every node of [0, n) has a quorum set from `qSetOf`
+template <typename QSetOf>
+QuorumTracker::QuorumMap
+makeQuorumMap(size_t n, QSetOf const& qSetOf)
+{
+    QuorumTracker::QuorumMap qmap;
+    for (size_t i = 0; i < n; ++i)
+    {
+        qmap[makeNodeID(i)] = std::make_shared<SCPQuorumSet>(qSetOf(i));
+    }
+    return qmap;
+}
+
+void
+benchQuorumIntersection(Runner& runner)
+{
+    // 7 random nodes at 80%, as generated by Quorum.d
+    std::mt19937_64 rng(1);
+    auto flat = makeQuorumMap(20, [&](size_t i) {
+        std::vector<size_t> others;
+        for (size_t j = 0; j < 20; ++j)
+        {
+            if (j != i)
+            {
+                others.emplace_back(j);
+            }
+        }
+        std::shuffle(others.begin(), others.end(), rng);
+        others.resize(6);
+        others.emplace_back(i);
+        std::sort(others.begin(), others.end());
+        SCPQuorumSet qSet;
+        qSet.threshold = 6;
+        for (auto j : others)
+        {
+            qSet.validators.emplace_back(makeNodeID(j));
+        }
+        return qSet;
+    });
+    // 6 organizations of 3 nodes, requiring 2/3 of each org and 5 orgs
+    auto orgs = makeQuorumMap(15, [](size_t) { return orgQSet(5, 4); });
+    // everyone at barely more than half: the quorums intersect, but in a
+    // single node, and there are many of them to enumerate
+    auto majority =
+        makeQuorumMap(14, [](size_t) { return flatQSet(0, 14, 8); });
+    // everyone at half: two disjoint quorums
+    auto split = makeQuorumMap(14, [](size_t) { return flatQSet(0, 14, 7); });
+
+    struct Topology
+    {
+        std::string mName;
+        QuorumTracker::QuorumMap* mQMap;
+        bool mEnjoys;
+    };
+    for (auto const& topology :
+         std::vector<Topology>{{"flat20", &flat, true},
+                               {"orgs15", &orgs, true},
+                               {"majority14", &majority, true},
+                               {"split14", &split, false}})
+    {
+        // results are cached by quorum map, so that every check gets a
+        // different map by adding a node that no one depends on, which
+        // doesn't change the search. The cache keeps fewer maps than this.
+        std::vector<QuorumTracker::QuorumMap> qmaps(32, *topology.mQMap);
+        auto observed = topology.mQMap->begin()->second;
+        for (size_t i = 0; i < qmaps.size(); ++i)
+        {
+            qmaps[i][makeNodeID(1000 + i)] = observed;
+        }
+        size_t next = 0;
+        // `create` takes the map the way D passes it, as a pointer (see the
+        // unordered_map binding of Cpp.d)
+        auto create = [&]() {
+            auto qmap = &qmaps[next++ % qmaps.size()];
+            return QuorumIntersectionChecker::create(
+                *reinterpret_cast<QuorumTracker::QuorumMap const*>(&qmap));
+        };
+        runner.run(
+            "QuorumIntersectionChecker/" + topology.mName, topology.mEnjoys,
+            [&]() { return create()->networkEnjoysQuorumIntersection(); });
+
+        // same, starting from the hints of a previous check
+        auto first = create();
+        first->networkEnjoysQuorumIntersection();
+        auto hints = first->getHints();
+        runner.run("QuorumIntersectionChecker/" + topology.mName + "/warm",
+                   topology.mEnjoys, [&]() {
+                       auto qic = create();
+                       qic->setHints(hints);
+                       return qic->networkEnjoysQuorumIntersection();
+                   });
+    }
+}
+
+void
+benchXDR(Runner& runner)
+{
+    auto qSet = flatQSet(0, 7, 6);
+    auto qSetHash = getHashOf(qSet);
+    auto prepare = makePrepare(makeNodeID(0), qSetHash, Value(64, 1), 1, true);
+
+    SCPEnvelope nominate;
+    nominate.statement.nodeID = makeNodeID(0);
+    nominate.statement.slotIndex = 1;
+    nominate.statement.pledges.type(SCP_ST_NOMINATE);
+    auto& nom = nominate.statement.pledges.nominate();
+    nom.quorumSetHash = qSetHash;
+    for (uint8_t i = 0; i < 10; ++i)
+    {
+        nom.votes.emplace_back(64, i);
+        nom.accepted.emplace_back(64, i);
+    }
+
+    for (auto const& env : {std::make_pair("PREPARE", &prepare),
+                            std::make_pair("NOMINATE", &nominate)})
+    {
+        auto const& envelope = *env.second;
+        auto bytes = xdr::xdr_to_opaque(envelope);
+        runner.run(std::string("xdr_to_opaque/") + env.first, bytes.size(),
+                   [&]() { return xdr::xdr_to_opaque(envelope).size(); });
+        runner.run(std::string("xdr_from_opaque/") + env.first,
+                   envelope.statement.slotIndex, [&]() {
+                       SCPEnvelope decoded;
+                       xdr::xdr_from_opaque(bytes, decoded);
+                       return decoded.statement.slotIndex;
+                   });
+    }
+}
+
+void
+benchBitSet(Runner& runner)
+{
+    // two sets of 1024 bits overlapping by half
+    size_t const n = 1024;
+    BitSet a(n), b(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            a.set(i);
+        }
+        if (i % 4 < 2)
+        {
+            b.set(i);
+        }
+    }
+    runner.run("BitSet/union", size_t(768), [&]() { return (a | b).count(); });
+    runner.run("BitSet/inplaceUnion", true, [&]() {
+        BitSet c(a);
+        c.inplaceUnion(b);
+        return !c.empty();
+    });
+    runner.run("BitSet/intersectionCount", size_t(256),
+               [&]() { return a.intersectionCount(b); });
+    runner.run("BitSet/isSubsetEq", false,
+               [&]() { return a.isSubsetEq(b); });
+    runner.run("BitSet/nextSet", size_t(512), [&]() {
+        size_t count = 0;
+        for (size_t i = 0; a.nextSet(i); ++i)
+        {
+            ++count;
+        }
+        return count;
+    });
+
+    std::unique_ptr<bitset_t, decltype(&bitset_free)> ca(
+        bitset_create_with_capacity(n), &bitset_free);
+    std::unique_ptr<bitset_t, decltype(&bitset_free)> cb(
+        bitset_create_with_capacity(n), &bitset_free);
+    for (size_t i = 0; a.nextSet(i); ++i)
+    {
+        bitset_set(ca.get(), i);
+    }
+    for (size_t i = 0; b.nextSet(i); ++i)
+    {
+        bitset_set(cb.get(), i);
+    }
+    runner.run("cbitset/count", size_t(512),
+               [&]() { return bitset_count(ca.get()); });
+    runner.run("cbitset/inplace_union", true, [&]() {
+        return bitset_inplace_union(ca.get(), cb.get());
+    });
+    runner.run("cbitset/intersection_count", size_t(512),
+               [&]() { return bitset_intersection_count(ca.get(), cb.get()); });
+}
+}
+
+namespace
+{
+char const*
+getInputName(uint32 type)
+{
+    switch (type)
+    {
+    case SCPRecorder::RECEIVE_ENVELOPE:
+        return "receiveEnvelope";
+    case SCPRecorder::RECEIVE_ENVELOPES:
+        return "receiveEnvelopes";
+    case SCPRecorder::VALUE_VALIDATED:
+        return "valueValidated";
+    case SCPRecorder::CANDIDATES_COMBINED:
+        return "candidatesCombined";
+    case SCPRecorder::EXTERNALIZE_COMPLETED:
+        return "externalizeCompleted";
+    case SCPRecorder::NOMINATE:
+        return "nominate";
+    case SCPRecorder::NOMINATE_AHEAD:
+        return "nominateAhead";
+    case SCPRecorder::STOP_NOMINATION:
+        return "stopNomination";
+    case SCPRecorder::UPDATE_LOCAL_QUORUM_SET:
+        return "updateLocalQuorumSet";
+    case SCPRecorder::INVALIDATE_QSET:
+        return "invalidateQSet";
+    case SCPRecorder::INVALIDATE_QSETS:
+        return "invalidateQSets";
+    case SCPRecorder::PURGE_SLOTS:
+        return "purgeSlots";
+    case SCPRecorder::SET_STATE_FROM_ENVELOPE:
+        return "setStateFromEnvelope";
+    case SCPRecorder::RESTORE_STATE:
+        return "restoreState";
+    case SCPRecorder::SET_QSET_CACHE_ENABLED:
+        return "setQSetCacheEnabled";
+    case SCPRecorder::SET_CATCH_UP_ENABLED:
+        return "setCatchUpEnabled";
+    case SCPRecorder::SET_QUORUM_FILTER_ENABLED:
+        return "setQuorumFilterEnabled";
+    case SCPRecorder::SET_STATEMENT_HISTORY:
+        return "setStatementHistory";
+    case SCPRecorder::TIMER:
+        return "timer";
+    default:
+        return "unknown";
+    }
+}
+}
+
+// runs the benchmarks whose name contains `filter` for `minTimeMs` each,
+// and writes their results to stdout; returns 0 on success
+int
+runMicroBenchmarks(char const* filter, uint32_t minTimeMs, char const* version)
+{
+    JsonWriter out(std::cout);
+    out.beginObject();
+    out.key("version");
+    out.value(version);
+    out.key("min_time_ms");
+    out.value(static_cast<uint64_t>(minTimeMs));
+    out.key("benchmarks");
+    out.beginArray();
+
+    Runner runner(out, filter, std::chrono::milliseconds(minTimeMs));
+    int res = 0;
+    try
+    {
+        benchLocalNode(runner);
+        benchFederatedVoting(runner);
+        benchQuorumIntersection(runner);
+        benchXDR(runner);
+        benchBitSet(runner);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        res = 1;
+    }
+
+    out.endArray();
+    out.endObject();
+    std::cout << std::endl;
+    return res;
+}
+
+// replays the recording at `path` in fresh SCP instances until it took at
+// least `minTimeMs`, and writes the time per input type of the last replay
+// to stdout; returns 0 on success
+int
+runReplay(char const* path, uint32_t minTimeMs, char const* version)
+{
+    std::unique_ptr<SCPReplay> replay;
+    uint64_t passes = 0;
+    std::chrono::nanoseconds elapsed(0);
+    do
+    {
+        replay = std::make_unique<SCPReplay>();
+        if (!replay->load(path))
+        {
+            std::cerr << "Error: can't load " << path << std::endl;
+            return 1;
+        }
+        auto start = BenchClock::now();
+        if (!replay->run())
+        {
+            std::cerr << "Error: invalid recording " << path << std::endl;
+            return 1;
+        }
+        elapsed += BenchClock::now() - start;
+        passes++;
+    } while (elapsed < std::chrono::milliseconds(minTimeMs));
+
+    JsonWriter out(std::cout);
+    out.beginObject();
+    out.key("version");
+    out.value(version);
+    out.key("recording");
+    out.value(path);
+    out.key("passes");
+    out.value(passes);
+    out.key("ns_per_pass");
+    out.value(Json::Value(static_cast<double>(elapsed.count()) /
+                          static_cast<double>(passes)));
+    out.key("recorded_ns");
+    out.value(static_cast<uint64_t>(replay->getRecordedTime().count()));
+    out.key("divergences");
+    out.value(replay->getDivergences());
+    out.key("externalized");
+    out.value(replay->getExternalizedCount());
+    out.key("inputs");
+    out.beginArray();
+    for (auto const& s : replay->getStats())
+    {
+        out.beginObject();
+        out.key("name");
+        out.value(getInputName(s.first));
+        out.key("count");
+        out.value(s.second.mCount);
+        out.key("total_ns");
+        out.value(static_cast<uint64_t>(s.second.mTotal.count()));
+        out.key("max_ns");
+        out.value(static_cast<uint64_t>(s.second.mMax.count()));
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    std::cout << std::endl;
+    return replay->getDivergences() == 0 ? 0 : 2;
+}
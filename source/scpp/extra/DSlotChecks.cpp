@@ -0,0 +1,706 @@
+/*******************************************************************************
+
+    Contains unittest functions checking the asynchronous callbacks of Slot
+    (`SCP::valueValidated`, `SCP::candidatesCombined`, `SCP::nominateAhead`
+    and `SCP::externalizeCompleted`), the coalescing of the statements it
+    emits, the publication of the read snapshot and the count of the
+    statements recorded, on a network of SCP instances within the process.
+
+    Every check returns nullptr when it passes, or the reason it failed.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "crypto/Hash.h"
+#include "scp/SCP.h"
+#include "scp/SCPDriver.h"
+#include "scp/SCPReadSnapshot.h"
+#include "util/XDROperators.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace stellar;
+
+namespace
+{
+class TestNetwork;
+
+NodeID
+makeNodeID(size_t i)
+{
+    NodeID id;
+    auto& key = id.ed25519();
+    std::fill(key.begin(), key.end(), 0);
+    key[0] = static_cast<uint8_t>(i + 1);
+    return id;
+}
+
+Value
+makeValue(std::string const& str)
+{
+    return Value(str.begin(), str.end());
+}
+
+// Driver of a node of `TestNetwork`: the asynchronous callbacks are only
+// recorded when enabled, and answered by the checks
+class TestDriver : public SCPDriver
+{
+  public:
+    TestNetwork& mNetwork;
+    size_t mIndex;
+    SCPQuorumSetPtr mQSet;
+    std::unique_ptr<SCP> mSCP;
+
+    // `validateValue` returns kPendingValue, and keeps the values here
+    bool mPendingValidations = false;
+    std::vector<std::pair<uint64, Hash>> mPendingValues;
+    // values asked for while their validation was pending
+    size_t mAskedAgain = 0;
+
+    // `combineCandidates` returns an empty value, and keeps the candidates
+    bool mAsyncCombine = false;
+    std::vector<std::pair<uint64, std::set<Value>>> mCombinations;
+
+    // the slots externalized, and those whose value isn't applied yet
+    // (`externalizeCompleted` not called)
+    bool mAsyncApply = false;
+    std::map<uint64, Value> mExternalized;
+    std::vector<uint64> mApplying;
+    std::set<uint64> mApplied;
+
+    // the value of the first ballot of the slots, once started
+    std::map<uint64, Value> mBallotValues;
+
+    // number of nominations signed, and of ballot statements emitted
+    size_t mSignedNominations = 0;
+    size_t mEmittedBallots = 0;
+
+    // when disconnected, the envelopes of the other nodes are kept here
+    bool mConnected = true;
+    std::vector<SCPEnvelope> mInbox;
+
+    std::function<void()>* mTimer = nullptr;
+
+    TestDriver(TestNetwork& network, size_t index, SCPQuorumSet const& qSet)
+        : mNetwork(network)
+        , mIndex(index)
+        , mQSet(std::make_shared<SCPQuorumSet>(qSet))
+        , mSCP(std::make_unique<SCP>(*this, makeNodeID(index), true, qSet))
+    {
+        mApplied.insert(0);
+    }
+
+    ~TestDriver()
+    {
+        delete mTimer;
+    }
+
+    void
+    signEnvelope(SCPEnvelope& envelope) override
+    {
+        if (envelope.statement.pledges.type() == SCP_ST_NOMINATE)
+        {
+            mSignedNominations++;
+        }
+    }
+
+    SCPQuorumSetPtr
+    getQSet(Hash const& qSetHash) override
+    {
+        return qSetHash == getHashOf(*mQSet) ? mQSet : nullptr;
+    }
+
+    void emitEnvelope(SCPEnvelope const& envelope) override;
+
+    ValidationLevel
+    validateValue(uint64 slotIndex, Value const& value, bool) override
+    {
+        if (!mPendingValidations)
+        {
+            return kFullyValidatedValue;
+        }
+        auto hash = getHashOf(value);
+        for (auto const& pending : mPendingValues)
+        {
+            if (pending.first == slotIndex && pending.second == hash)
+            {
+                mAskedAgain++;
+            }
+        }
+        mPendingValues.emplace_back(slotIndex, hash);
+        return kPendingValue;
+    }
+
+    Value
+    combineCandidates(uint64 slotIndex,
+                      std::set<Value> const& candidates) override
+    {
+        if (mAsyncCombine)
+        {
+            mCombinations.emplace_back(slotIndex, candidates);
+            return Value();
+        }
+        return *candidates.rbegin();
+    }
+
+    // every node is a neighbor, and the leader of the rounds changes in
+    // turn, whatever the hash functions used by SCP
+    uint64
+    computeHashNode(uint64, Value const&, bool isPriority, int32_t roundNumber,
+                    NodeID const& nodeID) override
+    {
+        if (!isPriority)
+        {
+            return 0;
+        }
+        return (nodeID.ed25519()[0] + roundNumber) % 16 + 1;
+    }
+
+    uint64
+    computeValueHash(uint64, Value const&, int32_t,
+                     Value const& value) override
+    {
+        uint64 hash = 0;
+        for (auto c : value)
+        {
+            hash = hash * 131 + c;
+        }
+        return hash;
+    }
+
+    void
+    setupTimer(uint64, int, std::chrono::milliseconds,
+               std::function<void()>* cb) override
+    {
+        delete mTimer;
+        mTimer = cb;
+    }
+
+    void
+    valueExternalized(uint64 slotIndex, Value const& value) override
+    {
+        mExternalized[slotIndex] = value;
+        if (mAsyncApply)
+        {
+            mApplying.emplace_back(slotIndex);
+        }
+        else
+        {
+            mApplied.insert(slotIndex);
+        }
+    }
+
+    void
+    startedBallotProtocol(uint64 slotIndex, SCPBallot const& ballot) override
+    {
+        mBallotValues.emplace(slotIndex, ballot.value);
+    }
+
+    // gives the verdicts of the pending validations, returns false if
+    // there were none
+    bool
+    validatePending()
+    {
+        auto pending = std::move(mPendingValues);
+        mPendingValues.clear();
+        for (auto const& value : pending)
+        {
+            mSCP->valueValidated(value.first, value.second,
+                                 kFullyValidatedValue);
+        }
+        return !pending.empty();
+    }
+
+    // gives the composite values of the pending combinations, combining
+    // the candidates as `combineCandidates` does synchronously
+    bool
+    combinePending()
+    {
+        auto combinations = std::move(mCombinations);
+        mCombinations.clear();
+        for (auto const& combination : combinations)
+        {
+            mSCP->candidatesCombined(combination.first,
+                                     *combination.second.rbegin());
+        }
+        return !combinations.empty();
+    }
+
+    // completes the application of the values externalized
+    bool
+    applyPending()
+    {
+        auto applying = std::move(mApplying);
+        mApplying.clear();
+        for (auto slotIndex : applying)
+        {
+            mApplied.insert(slotIndex);
+            mSCP->externalizeCompleted(slotIndex);
+        }
+        return !applying.empty();
+    }
+
+    void
+    nominate(uint64 slotIndex)
+    {
+        auto value = makeValue("value " + std::to_string(slotIndex) + "/" +
+                               std::to_string(mIndex));
+        auto prev = makeValue("value " + std::to_string(slotIndex - 1));
+        if (mApplied.count(slotIndex - 1))
+        {
+            mSCP->nominate(slotIndex, value, prev);
+        }
+        else
+        {
+            mSCP->nominateAhead(slotIndex, value, prev);
+        }
+    }
+};
+
+// `size` nodes sharing a flat quorum set, whose envelopes are delivered in
+// the order they are emitted
+class TestNetwork
+{
+  public:
+    std::vector<std::unique_ptr<TestDriver>> mNodes;
+    std::deque<std::pair<size_t, SCPEnvelope>> mQueue;
+
+    TestNetwork(size_t size, uint32 threshold)
+    {
+        SCPQuorumSet qSet;
+        qSet.threshold = threshold;
+        for (size_t i = 0; i < size; ++i)
+        {
+            qSet.validators.emplace_back(makeNodeID(i));
+        }
+        for (size_t i = 0; i < size; ++i)
+        {
+            mNodes.emplace_back(std::make_unique<TestDriver>(*this, i, qSet));
+        }
+    }
+
+    void
+    broadcast(size_t from, SCPEnvelope const& envelope)
+    {
+        mQueue.emplace_back(from, envelope);
+    }
+
+    // delivers the envelopes until no node emits any
+    void
+    deliver()
+    {
+        while (!mQueue.empty())
+        {
+            auto message = std::move(mQueue.front());
+            mQueue.pop_front();
+            for (auto& node : mNodes)
+            {
+                if (node->mIndex == message.first)
+                {
+                    continue;
+                }
+                if (node->mConnected)
+                {
+                    node->mSCP->receiveEnvelope(message.second);
+                }
+                else
+                {
+                    node->mInbox.emplace_back(message.second);
+                }
+            }
+        }
+    }
+
+    // fires the timers armed, which start the next rounds
+    void
+    fireTimers()
+    {
+        for (auto& node : mNodes)
+        {
+            if (auto timer = node->mTimer)
+            {
+                node->mTimer = nullptr;
+                (*timer)();
+                delete timer;
+            }
+        }
+    }
+
+    // runs `rounds` rounds of `deliver` then `fireTimers`, or until every
+    // node externalized `slotIndex`
+    void
+    run(uint64 slotIndex, size_t rounds)
+    {
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            deliver();
+            if (countExternalized(slotIndex) == mNodes.size())
+            {
+                return;
+            }
+            fireTimers();
+        }
+        deliver();
+    }
+
+    size_t
+    countExternalized(uint64 slotIndex) const
+    {
+        size_t count = 0;
+        for (auto const& node : mNodes)
+        {
+            count += node->mExternalized.count(slotIndex);
+        }
+        return count;
+    }
+
+    // true if all the nodes externalized the same value for `slotIndex`
+    bool
+    agreed(uint64 slotIndex) const
+    {
+        if (countExternalized(slotIndex) != mNodes.size())
+        {
+            return false;
+        }
+        for (auto const& node : mNodes)
+        {
+            if (node->mExternalized.at(slotIndex) !=
+                mNodes.front()->mExternalized.at(slotIndex))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+void
+TestDriver::emitEnvelope(SCPEnvelope const& envelope)
+{
+    if (envelope.statement.pledges.type() != SCP_ST_NOMINATE)
+    {
+        mEmittedBallots++;
+    }
+    mNetwork.broadcast(mIndex, envelope);
+}
+
+size_t const Rounds = 10;
+}
+
+// statements wait for the values left pending by validateValue, which is
+// asked once per value, and proceed once SCP::valueValidated is called
+char const*
+checkPendingValidation()
+{
+    TestNetwork network(4, 3);
+    for (auto& node : network.mNodes)
+    {
+        node->mPendingValidations = true;
+        node->nominate(1);
+    }
+    network.run(1, Rounds);
+    if (network.countExternalized(1) != 0)
+    {
+        return "A slot externalized before its values were validated";
+    }
+
+    size_t pending = 0;
+    for (size_t round = 0; round < Rounds && !network.agreed(1); ++round)
+    {
+        for (auto& node : network.mNodes)
+        {
+            pending += node->mPendingValues.size();
+            node->validatePending();
+        }
+        network.run(1, 1);
+    }
+    if (pending == 0)
+    {
+        return "No validation was left pending";
+    }
+    for (auto const& node : network.mNodes)
+    {
+        if (node->mAskedAgain)
+        {
+            return "A value was validated again while pending";
+        }
+    }
+    if (!network.agreed(1))
+    {
+        return "The slot didn't externalize once its values were validated";
+    }
+    return nullptr;
+}
+
+// the composite value given by SCP::candidatesCombined for candidates that
+// changed meanwhile is dropped, and the new candidates are combined again
+char const*
+checkCandidatesCombined()
+{
+    TestNetwork network(4, 3);
+    for (auto& node : network.mNodes)
+    {
+        node->mAsyncCombine = true;
+        node->nominate(1);
+    }
+    network.run(1, Rounds);
+    auto& node = *network.mNodes.front();
+    if (node.mCombinations.size() != 1)
+    {
+        return "The candidates were not combined once";
+    }
+    auto outdated = node.mCombinations.front();
+
+    // the other nodes now also accepted a value that isn't a candidate yet
+    auto extra = makeValue("value 1/9");
+    for (size_t i = 1; i < network.mNodes.size(); ++i)
+    {
+        auto envelope = *node.mSCP->getLatestMessage(makeNodeID(i));
+        auto& nomination = envelope.statement.pledges.nominate();
+        for (auto values : {&nomination.votes, &nomination.accepted})
+        {
+            values->emplace_back(extra);
+            std::sort(values->begin(), values->end());
+        }
+        node.mSCP->receiveEnvelope(envelope);
+    }
+    if (node.mCombinations.size() != 1)
+    {
+        return "The candidates were combined again while in flight";
+    }
+
+    node.mCombinations.clear();
+    node.mSCP->candidatesCombined(1, *outdated.second.rbegin());
+    if (node.mBallotValues.count(1))
+    {
+        return "The ballot started with the outdated composite value";
+    }
+    if (node.mCombinations.size() != 1 ||
+        node.mCombinations.front().second.size() !=
+            outdated.second.size() + 1)
+    {
+        return "The new candidates were not combined";
+    }
+
+    node.combinePending();
+    if (!node.mBallotValues.count(1) || node.mBallotValues.at(1) != extra)
+    {
+        return "The ballot didn't start with the new composite value";
+    }
+    return nullptr;
+}
+
+// the ballot protocol of a slot nominated ahead waits until the value of
+// the previous slot is applied, while its nomination runs
+char const*
+checkNominateAhead()
+{
+    TestNetwork network(4, 3);
+    auto& ahead = *network.mNodes.back();
+    for (auto& node : network.mNodes)
+    {
+        node->mAsyncApply = node.get() != &ahead;
+        node->nominate(1);
+    }
+    network.run(1, Rounds);
+    if (!network.agreed(1))
+    {
+        return "The first slot didn't externalize";
+    }
+
+    for (auto& node : network.mNodes)
+    {
+        node->nominate(2);
+    }
+    network.run(2, Rounds);
+    if (!ahead.mBallotValues.count(2))
+    {
+        return "The nomination of the slots nominated ahead didn't run";
+    }
+    if (network.countExternalized(2) != 0)
+    {
+        return "A slot externalized before the previous one was applied";
+    }
+    for (auto const& node : network.mNodes)
+    {
+        if (node.get() != &ahead && node->mBallotValues.count(2))
+        {
+            return "A ballot started before the previous slot was applied";
+        }
+    }
+
+    for (auto& node : network.mNodes)
+    {
+        node->applyPending();
+    }
+    network.run(2, Rounds);
+    if (!network.agreed(2))
+    {
+        return "The slot didn't externalize once the previous one was applied";
+    }
+    return nullptr;
+}
+
+// a batch of envelopes changing the local nomination several times signs
+// and emits it once
+char const*
+checkCoalescedNominations()
+{
+    TestNetwork network(4, 3);
+    auto& node = *network.mNodes.front();
+    node.mConnected = false;
+    for (auto& n : network.mNodes)
+    {
+        n->nominate(1);
+    }
+    network.deliver();
+
+    auto signedNominations = node.mSignedNominations;
+    auto emittedBallots = node.mEmittedBallots;
+    node.mConnected = true;
+    node.mSCP->receiveEnvelopes(node.mInbox);
+    // one by one, these envelopes sign 2 nominations and emit 5 ballot
+    // statements
+    if (node.mSignedNominations != signedNominations + 1)
+    {
+        return "A batch didn't sign exactly one nomination";
+    }
+    if (node.mEmittedBallots != emittedBallots + 1)
+    {
+        return "A batch didn't emit exactly one ballot statement";
+    }
+
+    network.run(1, Rounds);
+    if (!network.agreed(1))
+    {
+        return "The slot didn't externalize";
+    }
+    return nullptr;
+}
+
+namespace
+{
+// true if the read snapshot of `node` holds the latest messages of its SCP,
+// its own included as the values are fully validated
+bool
+snapshotIsCurrent(TestNetwork const& network, TestDriver const& node)
+{
+    auto snapshot = node.mSCP->getReadSnapshot();
+    if (!snapshot)
+    {
+        return false;
+    }
+    for (auto const& other : network.mNodes)
+    {
+        auto id = makeNodeID(other->mIndex);
+        auto live = node.mSCP->getLatestMessage(id);
+        auto published = snapshot->getLatestMessage(id);
+        if (!live != !published || (live && !(*live == *published)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+// with SCP::setReadSnapshotEnabled, the envelopes, the timers and the
+// purges leave the read snapshot current without the driver publishing it
+char const*
+checkReadSnapshot()
+{
+    TestNetwork network(4, 3);
+    auto& node = *network.mNodes.front();
+    node.mSCP->setReadSnapshotEnabled(true);
+    if (!node.mSCP->getReadSnapshot())
+    {
+        return "Enabling the read snapshot didn't publish it";
+    }
+    for (auto& n : network.mNodes)
+    {
+        n->nominate(1);
+    }
+    for (size_t round = 0; round < Rounds && !network.agreed(1); ++round)
+    {
+        network.deliver();
+        if (!snapshotIsCurrent(network, node))
+        {
+            return "The read snapshot lags behind the envelopes received";
+        }
+        // the snapshot is published again, even if the timer didn't
+        // change what is compared
+        auto previous = node.mSCP->getReadSnapshot();
+        bool armed = node.mTimer != nullptr;
+        network.fireTimers();
+        if ((armed && node.mSCP->getReadSnapshot() == previous) ||
+            !snapshotIsCurrent(network, node))
+        {
+            return "The read snapshot lags behind the timers fired";
+        }
+    }
+    network.deliver();
+    if (!network.agreed(1))
+    {
+        return "The slot didn't externalize";
+    }
+    if (!node.mSCP->getReadSnapshot()->isSlotFullyValidated(1))
+    {
+        return "The read snapshot lags behind the slot";
+    }
+    if (network.mNodes.back()->mSCP->getReadSnapshot())
+    {
+        return "The read snapshot was published while disabled";
+    }
+
+    node.mSCP->purgeSlots(2);
+    if (node.mSCP->getReadSnapshot()->getSlot(1))
+    {
+        return "The read snapshot still holds a purged slot";
+    }
+    return nullptr;
+}
+
+// SCP::getCumulativeStatemtCount counts the statements recorded, whatever
+// the statement history keeps of them
+char const*
+checkStatementCount()
+{
+    TestNetwork network(4, 3);
+    auto& off = *network.mNodes[0]->mSCP;
+    auto& limited = *network.mNodes[1]->mSCP;
+    off.setStatementHistory(SCP::HISTORY_OFF);
+    size_t const limit = 2;
+    limited.setStatementHistory(SCP::HISTORY_COMPACT, limit);
+    for (auto& node : network.mNodes)
+    {
+        node->nominate(1);
+    }
+    network.run(1, Rounds);
+    if (!network.agreed(1))
+    {
+        return "The slot didn't externalize";
+    }
+    if (off.getCumulativeStatemtCount() == 0)
+    {
+        return "The statements were not counted without a history";
+    }
+    if (limited.getCumulativeStatemtCount() <= limit)
+    {
+        return "The statements were only counted up to the history limit";
+    }
+    return nullptr;
+}
@@ -4,6 +4,10 @@
 #include "DUtils.h"
 #include "xdrpp/marshal.h"
 #include "xdr/Stellar-SCP.h"
+#include "scp/SCP.h"
+#include "quorum/QuorumIntersectionChecker.h"
+#include <atomic>
+#include <chrono>
 #include <functional>
 
 using namespace xdr;
@@ -17,17 +21,28 @@ std::set<unsigned int>* makeTestSet()
 
 opaque_vec<> XDRToOpaque(const xdr::xvector<unsigned char>& param)
 {
+    ZoneScoped;
     return xdr::xdr_to_opaque(param);
 }
 opaque_vec<> XDRToOpaque(const stellar::SCPQuorumSet& param)
 {
+    ZoneScoped;
     return xdr::xdr_to_opaque(param);
 }
 opaque_vec<> XDRToOpaque(const stellar::SCPStatement& param)
 {
+    ZoneScoped;
     return xdr::xdr_to_opaque(param);
 }
 
+#define XDRINST(T) \
+    template std::size_t XDRSize<T>(const T&); \
+    template std::size_t XDRToBuffer<T>(const T&, unsigned char*, std::size_t);
+XDRINST(xvector<unsigned char>)
+XDRINST(SCPQuorumSet)
+XDRINST(SCPStatement)
+XDRINST(SCPEnvelope)
+
 #define PUSHBACKINST1(T) template void push_back<T, xvector<T>>(xvector<T>&, T&);
 #define PUSHBACKINST2(T, VT) template void push_back<T, VT>(VT&, T&);
 #define PUSHBACKINST3(T, V) template void push_back<T, V<T>>(V<T>&, T&);
@@ -57,18 +72,32 @@ opaque_vec<> duplicate_value (void const *value_)
     return dup;
 }
 
+// the copy owns its storage, and outlives the SCP state of the
+// envelope it was made from
+SCPEnvelope duplicate_envelope (void const *envelope_)
+{
+    auto envelope = (SCPEnvelope const*)envelope_;
+    return *envelope;
+}
+
 PUSHBACKINST1(PublicKey)
 PUSHBACKINST1(SCPQuorumSet)
 PUSHBACKINST3(PublicKey, std::vector)
 PUSHBACKINST3(SCPEnvelope, std::vector)
 PUSHBACKINST3(SCPQuorumSet, std::vector)
 
+#define APPENDINST(VT) template void append<VT>(VT&, const void*, std::size_t);
+APPENDINST(xvector<PublicKey>)
+APPENDINST(std::vector<SCPEnvelope>)
+
+
+#define CPPSETELEMENTSINST(T) template std::size_t cpp_set_elements<T>(const void*, void*, std::size_t);
+CPPSETELEMENTSINST(Value)
+CPPSETELEMENTSINST(SCPBallot)
+CPPSETELEMENTSINST(PublicKey)
+CPPSETELEMENTSINST(unsigned int)
 
-#define CPPSETFOREACHINST(T) template int cpp_set_foreach<T>(void*, void*, void*);
-CPPSETFOREACHINST(Value)
-CPPSETFOREACHINST(SCPBallot)
-CPPSETFOREACHINST(PublicKey)
-CPPSETFOREACHINST(unsigned int)
+template std::size_t cpp_set_spans<Value>(const void*, void*, std::size_t);
 
 #define CPPSETEMPTYINST(T) template bool cpp_set_empty<T>(const void*);
 CPPSETEMPTYINST(Value)
@@ -98,6 +127,58 @@ void callCPPDelegate (void* cb)
     delete callback;
 }
 
+// walks through the envelopes of a slot without copying them, see the
+// `forEach` methods of SCP: `func` is called with `ctx` until it returns
+// non-zero, which is returned
+// note: can't use proper callback types, see DUtils.h
+using DEnvelopeVisitor = int (*)(void* ctx, const SCPEnvelope& value);
+
+template<typename ForEach>
+static int cpp_scp_foreach (ForEach forEach, void* ctx, void* func)
+{
+    auto wrapper = (DEnvelopeVisitor)func;
+    int res = 0;
+    forEach([&](SCPEnvelope const& envelope) {
+        res = wrapper(ctx, envelope);
+        return res == 0;
+    });
+    return res;
+}
+
+int cpp_scp_foreach_latest_message_send (const void* scp,
+    std::uint64_t slotIndex, void* ctx, void* func)
+{
+    return cpp_scp_foreach([&](SCP::EnvelopeVisitor const& f) {
+        ((const SCP*)scp)->forEachLatestMessageSend(slotIndex, f);
+    }, ctx, func);
+}
+
+int cpp_scp_foreach_current_envelope (const void* scp,
+    std::uint64_t slotIndex, void* ctx, void* func)
+{
+    return cpp_scp_foreach([&](SCP::EnvelopeVisitor const& f) {
+        ((const SCP*)scp)->forEachCurrentEnvelope(slotIndex, f);
+    }, ctx, func);
+}
+
+int cpp_scp_foreach_externalizing_envelope (const void* scp,
+    std::uint64_t slotIndex, void* ctx, void* func)
+{
+    return cpp_scp_foreach([&](SCP::EnvelopeVisitor const& f) {
+        ((const SCP*)scp)->forEachExternalizingEnvelope(slotIndex, f);
+    }, ctx, func);
+}
+
+// checkQuorumIntersection without deadline nor progress callback, aborted
+// once `*interruptFlag` (a `shared(bool)` in D) is set
+// note: can't use proper types, std::atomic isn't bound
+int cpp_check_quorum_intersection (const void* qic, const void* interruptFlag)
+{
+    return ((const QuorumIntersectionChecker*)qic)->checkQuorumIntersection(
+        (const std::atomic<bool>*)interruptFlag,
+        std::chrono::steady_clock::time_point::max(), nullptr);
+}
+
 std::shared_ptr<SCPQuorumSet> makeSharedSCPQuorumSet (
     const SCPQuorumSet& quorum)
 {
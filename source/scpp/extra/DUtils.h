@@ -8,23 +8,45 @@
 #include <vector>
 
 #include "crypto/SecretKey.h"  // for operator() (hashing support)
+#include "quorum/QuorumTracker.h"
+#include "util/Tracy.h"
+#include "xdrpp/marshal.h"
 
-// rudimentary support for walking through an std::set
-// note: can't use proper callback type due to
+// the layout of a D array, e.g. `const(ubyte)[]`
+struct DArray
+{
+    std::size_t length;
+    const void* ptr;
+};
+
+// reads an std::set in a single call (instead of calling back into D for
+// every element): fills `out` (a `const(T)*[max]`) with pointers to the
+// first `max` elements of the set, in order, and returns the size of the
+// set, so D can call again with a larger buffer
+// note: can't use proper types due to
 // https://issues.dlang.org/show_bug.cgi?id=20223
 template<typename T>
-int cpp_set_foreach(void* setptr, void* ctx, void* func)
+std::size_t cpp_set_elements(const void* setptr, void* out, std::size_t max)
 {
-    auto wrapper = (int (*)(void* ctx, const T& value))func;
-
-    for (auto const &elem : *(std::set<T>*)setptr)
-    {
-        int res = wrapper(ctx, elem);
-        if (res != 0)
-            return res;
-    }
+    auto set = (const std::set<T>*)setptr;
+    auto res = (const T**)out;
+    std::size_t i = 0;
+    for (auto it = set->begin(); it != set->end() && i < max; ++it)
+        res[i++] = &*it;
+    return set->size();
+}
 
-    return 0;
+// same for sets of byte vectors (e.g. Value), with the contents of the
+// elements as D arrays in `out` (a `const(ubyte)[][max]`)
+template<typename T>
+std::size_t cpp_set_spans(const void* setptr, void* out, std::size_t max)
+{
+    auto set = (const std::set<T>*)setptr;
+    auto res = (DArray*)out;
+    std::size_t i = 0;
+    for (auto it = set->begin(); it != set->end() && i < max; ++it)
+        res[i++] = DArray{it->size(), it->data()};
+    return set->size();
 }
 
 template<typename T>
@@ -33,24 +55,38 @@ bool cpp_set_empty(const void* setptr)
     return ((const std::set<T>*)setptr)->empty();
 }
 
+// the type of the unordered maps of K to V that D refers to,
+// as some of them don't use the default hasher
+template<typename K, typename V>
+struct DUnorderedMap
+{
+    using type = std::unordered_map<K, V>;
+};
+
+template<>
+struct DUnorderedMap<stellar::NodeID, stellar::SCPQuorumSetPtr>
+{
+    using type = stellar::QuorumTracker::QuorumMap;
+};
+
 template<typename K, typename V>
 void cpp_unordered_map_assign (void* map, const K& key, const V& value)
 {
-    auto m = (std::unordered_map<K, V>*)map;
+    auto m = (typename DUnorderedMap<K, V>::type*)map;
     (*m)[key] = value;
 }
 
 template<typename K, typename V>
 std::size_t cpp_unordered_map_length (const void* map)
 {
-    auto m = (const std::unordered_map<K, V>*)map;
+    auto m = (const typename DUnorderedMap<K, V>::type*)map;
     return m->size();
 }
 
 template<typename K, typename V>
 void* cpp_unordered_map_create ()
 {
-    return new std::unordered_map<K, V>();
+    return new typename DUnorderedMap<K, V>::type();
 }
 
 // @bug with substitution
@@ -61,12 +97,49 @@ void* cpp_unordered_map_create ()
 //     return new std::unordered_map<K, V>();
 // }
 
+// size of the XDR encoding of value, see XDRToBuffer
+template<typename T>
+std::size_t XDRSize (const T& value)
+{
+    return xdr::xdr_size(value);
+}
+
+// encodes value in the 4-byte aligned buffer [buf, buf + size) without
+// allocating, and returns the number of bytes written (XDRSize(value)),
+// or 0 if the buffer is too small.
+// Encodings are multiples of 4 bytes, so values can be appended to the
+// same buffer by encoding them at the offsets returned so far.
+template<typename T>
+std::size_t XDRToBuffer (const T& value, unsigned char* buf, std::size_t size)
+{
+    ZoneScoped;
+    std::size_t needed = xdr::xdr_size(value);
+    if (needed > size)
+        return 0;
+    xdr::xdr_put p(buf, buf + needed);
+    xdr::xdr_argpack_archive(p, value);
+    assert(p.p_ == p.e_);
+    return needed;
+}
+
 template<typename T, typename VectorT>
 void push_back(VectorT& this_, T& value)
 {
     this_.push_back(value);
 }
 
+// appends copies of the `count` elements pointed to by `items` (a
+// `const(T)*[count]`) to the vector, growing it once
+template<typename VectorT>
+void append(VectorT& this_, const void* items, std::size_t count)
+{
+    using T = typename VectorT::value_type;
+    auto ptrs = (const T* const*)items;
+    this_.reserve(this_.size() + count);
+    for (std::size_t i = 0; i < count; i++)
+        this_.push_back(*ptrs[i]);
+}
+
 // todo: use this once dlang #20805 is fixed
 template<typename VectorT>
 VectorT duplicate(const VectorT& this_)
@@ -164,17 +164,67 @@ size_t bitset_union_count(const bitset_t* b1, const bitset_t* b2);
  * call bitset_copy */
 void bitset_inplace_intersection(bitset_t* b1, const bitset_t* b2);
 
+/* number of bits set in x: on baseline x86-64 __builtin_popcountll is a libgcc
+ * call, which is slower than counting inline */
+static inline size_t
+bitset_popcount64(uint64_t x)
+{
+#if defined(__POPCNT__) || defined(__aarch64__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/* same as below, with a POPCNT, AVX2 or NEON version picked at runtime */
+size_t bitset_popcount_words_large(const uint64_t* words, size_t n);
+size_t bitset_popcount_and_words_large(const uint64_t* a, const uint64_t* b,
+                                       size_t n);
+
+/* below this many words, counting inline is faster than the call */
+#define BITSET_POPCOUNT_INLINE_WORDS 4
+
+/* number of bits set in words[0, n) */
+static inline size_t
+bitset_popcount_words(const uint64_t* words, size_t n)
+{
+    if (n > BITSET_POPCOUNT_INLINE_WORDS)
+    {
+        return bitset_popcount_words_large(words, n);
+    }
+    size_t card = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        card += bitset_popcount64(words[k]);
+    }
+    return card;
+}
+
+/* number of bits set in (a[k] & b[k]) for k in [0, n) */
+static inline size_t
+bitset_popcount_and_words(const uint64_t* a, const uint64_t* b, size_t n)
+{
+    if (n > BITSET_POPCOUNT_INLINE_WORDS)
+    {
+        return bitset_popcount_and_words_large(a, b, n);
+    }
+    size_t card = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        card += bitset_popcount64(a[k] & b[k]);
+    }
+    return card;
+}
+
 /* report the size of the intersection (without materializing it) */
 static inline size_t
 bitset_intersection_count(const bitset_t* b1, const bitset_t* b2)
 {
-    size_t answer = 0;
     size_t minlength = b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    for (size_t k = 0; k < minlength; ++k)
-    {
-        answer += __builtin_popcountll(b1->array[k] & b2->array[k]);
-    }
-    return answer;
+    return bitset_popcount_and_words(b1->array, b2->array, minlength);
 }
 
 /* compute the difference in-place (to b1), to generate a new bitset first call
@@ -58,6 +58,25 @@ struct marshal_noswap : marshal_base {
     u.u32[1] = *p++;
     return u.u64;
   }
+
+  //! Bulk versions of put32/put64 and get32/get64 for \c n contiguous
+  //! values, which are a plain copy without byteswapping.
+  static void put32s(std::uint32_t *&p, const void *v, std::size_t n) {
+    std::memcpy(p, v, n * 4);
+    p += n;
+  }
+  static void put64s(std::uint32_t *&p, const void *v, std::size_t n) {
+    std::memcpy(p, v, n * 8);
+    p += 2 * n;
+  }
+  static void get32s(const std::uint32_t *&p, void *v, std::size_t n) {
+    std::memcpy(v, p, n * 4);
+    p += n;
+  }
+  static void get64s(const std::uint32_t *&p, void *v, std::size_t n) {
+    std::memcpy(v, p, n * 8);
+    p += 2 * n;
+  }
 };
 
 //! Numeric marshaling mixin that byteswaps all numeric values (thus
@@ -77,8 +96,63 @@ struct marshal_swap : marshal_base {
     u.u32[0] = swap32(*p++);
     return u.u64;
   }
+
+  //! Bulk versions of put32/put64 and get32/get64 for \c n contiguous
+  //! values.  The loops are simple enough for the compiler to turn them
+  //! into vector shuffles.
+  static void put32s(std::uint32_t *&p, const void *v, std::size_t n) {
+    bswap_words<std::uint32_t>(p, v, n);
+    p += n;
+  }
+  static void put64s(std::uint32_t *&p, const void *v, std::size_t n) {
+    bswap_words<std::uint64_t>(p, v, n);
+    p += 2 * n;
+  }
+  static void get32s(const std::uint32_t *&p, void *v, std::size_t n) {
+    bswap_words<std::uint32_t>(v, p, n);
+    p += n;
+  }
+  static void get64s(const std::uint32_t *&p, void *v, std::size_t n) {
+    bswap_words<std::uint64_t>(v, p, n);
+    p += 2 * n;
+  }
+
+private:
+  static std::uint32_t bswap(std::uint32_t v) { return swap32(v); }
+  static std::uint64_t bswap(std::uint64_t v) { return swap64(v); }
+
+  // memcpy keeps the accesses valid whatever the alignment of the values
+  template<typename W> static void
+  bswap_words(void *to, const void *from, std::size_t n) {
+    char *d = static_cast<char *>(to);
+    const char *s = static_cast<const char *>(from);
+    for (std::size_t i = 0; i < n; ++i) {
+      W w;
+      std::memcpy(&w, s + i * sizeof(W), sizeof(W));
+      w = bswap(w);
+      std::memcpy(d + i * sizeof(W), &w, sizeof(W));
+    }
+  }
 };
 
+namespace detail {
+//! Integers whose XDR encoding has the same size as their representation.
+template<typename T, bool = std::is_integral<T>::value
+			    && (sizeof(T) == 4 || sizeof(T) == 8)>
+struct is_bulk_scalar : std::false_type {};
+template<typename T> struct is_bulk_scalar<T, true>
+  : std::integral_constant<bool, xdr_traits<T>::is_numeric
+			   && sizeof(T) == sizeof(typename xdr_traits<T>::uint_type)> {};
+
+//! Containers of such integers, which the marshaling archives read and
+//! write in bulk instead of element by element.
+template<typename T> struct is_bulk_container : std::false_type {};
+template<typename T, uint32_t N> struct is_bulk_container<xvector<T, N>>
+  : is_bulk_scalar<T> {};
+template<typename T, uint32_t N> struct is_bulk_container<xarray<T, N>>
+  : is_bulk_scalar<T> {};
+}
+
 //! Archive type for marshaling to a buffer.  Depending on the `Base`
 //! type, will marshal in either big- or little-endian order.
 template<typename Base> struct xdr_generic_put : Base {
@@ -127,7 +201,24 @@ template<typename Base> struct xdr_generic_put : Base {
   }
 
   template<typename T> typename std::enable_if<
-    xdr_traits<T>::is_class || xdr_traits<T>::is_container>::type
+    detail::is_bulk_container<T>::value>::type
+  operator()(const T &t) {
+    using value_type = typename T::value_type;
+    if (xdr_traits<T>::variable_nelem) {
+      check(4 + t.size() * sizeof(value_type));
+      put32(p_, size32(t.size()));
+    }
+    else
+      check(t.size() * sizeof(value_type));
+    if (sizeof(value_type) == 4)
+      Base::put32s(p_, t.data(), t.size());
+    else
+      Base::put64s(p_, t.data(), t.size());
+  }
+
+  template<typename T> typename std::enable_if<
+    (xdr_traits<T>::is_class || xdr_traits<T>::is_container)
+    && !detail::is_bulk_container<T>::value>::type
   operator()(const T &t) {
     if (!marshal_base::stack_limit--)
       throw xdr_stack_overflow("stack overflow in xdr_generic_put");
@@ -191,7 +282,31 @@ template<typename Base> struct xdr_generic_get : Base {
   }
 
   template<typename T> typename std::enable_if<
-    xdr_traits<T>::is_class || xdr_traits<T>::is_container>::type
+    detail::is_bulk_container<T>::value>::type
+  operator()(T &t) {
+    using value_type = typename T::value_type;
+    std::uint32_t n;
+    if (xdr_traits<T>::variable_nelem) {
+      check(4);
+      n = get32(p_);
+      t.check_size(n);
+      // checked before resizing, so a bogus count doesn't allocate
+      check(std::size_t(n) * sizeof(value_type));
+      t.resize(n);
+    }
+    else {
+      n = size32(t.size());
+      check(std::size_t(n) * sizeof(value_type));
+    }
+    if (sizeof(value_type) == 4)
+      Base::get32s(p_, t.data(), n);
+    else
+      Base::get64s(p_, t.data(), n);
+  }
+
+  template<typename T> typename std::enable_if<
+    (xdr_traits<T>::is_class || xdr_traits<T>::is_container)
+    && !detail::is_bulk_container<T>::value>::type
   operator()(T &t) {
     if (!marshal_base::stack_limit--)
       throw xdr_stack_overflow("stack overflow in xdr_generic_get");
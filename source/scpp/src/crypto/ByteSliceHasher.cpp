@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ByteSliceHasher.h"
+#include <mutex>
 #include <sodium.h>
 
 namespace stellar
@@ -10,10 +11,12 @@ namespace stellar
 namespace shortHash
 {
 static unsigned char sKey[crypto_shorthash_KEYBYTES];
+static std::once_flag sKeyOnce;
 void
 initialize_byteslice_hasher()
 {
-    crypto_shorthash_keygen(sKey);
+    // a new key would break every hash table built with the current one
+    std::call_once(sKeyOnce, []() { crypto_shorthash_keygen(sKey); });
 }
 uint64_t
 computeHash(stellar::ByteSlice const& b)
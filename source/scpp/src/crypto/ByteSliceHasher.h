@@ -14,6 +14,8 @@ namespace stellar
 // or cryptographic use
 namespace shortHash
 {
+// draws the key of the process on the first call, the next calls do
+// nothing: the key is then only read, by any thread
 void initialize_byteslice_hasher();
 uint64_t computeHash(stellar::ByteSlice const& b);
 }
@@ -11,6 +11,34 @@ namespace stellar
 {
 namespace strKey
 {
+namespace
+{
+// base 32 encoding of data made of whole 5 bytes groups, 8 characters at a
+// time: the StrKeys of keys and hashes are 35 bytes long, so they don't
+// need the padding bn::encode_b32 handles bit by bit
+std::string
+encodeB32Groups(std::vector<uint8_t> const& data)
+{
+    static char const dictionary[33] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    std::string res(data.size() / 5 * 8, '\0');
+    auto out = &res[0];
+    for (size_t i = 0; i < data.size(); i += 5, out += 8)
+    {
+        uint64_t v = 0;
+        for (size_t j = 0; j < 5; j++)
+        {
+            v = (v << 8) | data[i + j];
+        }
+        for (int j = 7; j >= 0; j--)
+        {
+            out[j] = dictionary[v & 31];
+            v >>= 5;
+        }
+    }
+    return res;
+}
+}
+
 // Encode a version byte and ByteSlice into StrKey
 SecretValue
 toStrKey(uint8_t ver, ByteSlice const& bin)
@@ -27,7 +55,14 @@ toStrKey(uint8_t ver, ByteSlice const& bin)
     toEncode.emplace_back(static_cast<uint8_t>(crc & 0xFF));
 
     std::string res;
-    res = decoder::encode_b32(toEncode);
+    if (toEncode.size() % 5 == 0)
+    {
+        res = encodeB32Groups(toEncode);
+    }
+    else
+    {
+        res = decoder::encode_b32(toEncode);
+    }
     return SecretValue{res};
 }
 
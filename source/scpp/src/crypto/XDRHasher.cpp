@@ -0,0 +1,57 @@
+/*******************************************************************************
+
+    Implementation of an xdrpp archive hashing XDR values in a single pass, see
+    XDRHasher.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "crypto/XDRHasher.h"
+
+namespace stellar
+{
+XDRHasher::XDRHasher()
+{
+    crypto_generichash_init(&mState, nullptr, 0, uint512().size());
+}
+
+void
+XDRHasher::add(void const* data, size_t size)
+{
+    crypto_generichash_update(
+        &mState, static_cast<unsigned char const*>(data), size);
+}
+
+void
+XDRHasher::addUint32(uint32_t v)
+{
+    unsigned char buf[4] = {
+        static_cast<unsigned char>(v >> 24), static_cast<unsigned char>(v >> 16),
+        static_cast<unsigned char>(v >> 8), static_cast<unsigned char>(v)};
+    add(buf, sizeof(buf));
+}
+
+void
+XDRHasher::addBytes(void const* data, size_t size)
+{
+    static unsigned char const zeroes[3] = {0, 0, 0};
+    add(data, size);
+    add(zeroes, (4 - (size & 3)) & 3);
+}
+
+uint512
+XDRHasher::finish()
+{
+    uint512 res;
+    crypto_generichash_final(&mState, res.data(), res.size());
+    return res;
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains an xdrpp archive hashing XDR values in a single pass.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "crypto/ByteSlice.h"
+#include "xdr/Stellar-types.h"
+#include <sodium.h>
+#include <xdrpp/marshal.h>
+
+namespace stellar
+{
+/**
+ * xdrpp archive feeding the XDR encoding of the values it is applied to
+ * into an incremental BLAKE2b-512 state, next to xdr::xdr_generic_put:
+ * any XDR type is hashed in a single pass, without encoding it into a
+ * buffer first. The result is the hash of the encoding, that is
+ * crypto_generichash of xdr::xdr_to_opaque of the same values.
+ *
+ * These hashes don't go through the getHashOf routines of the client
+ * (crypto/Hash.h), so they are only suitable for values SCP identifies
+ * locally, not for the hashes exchanged with other nodes.
+ */
+class XDRHasher
+{
+    crypto_generichash_state mState;
+
+    void add(void const* data, size_t size);
+    void addUint32(uint32_t v);
+
+  public:
+    XDRHasher();
+
+    template <typename T>
+    typename std::enable_if<std::is_same<
+        std::uint32_t, typename xdr::xdr_traits<T>::uint_type>::value>::type
+    operator()(T t)
+    {
+        addUint32(xdr::xdr_traits<T>::to_uint(t));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_same<
+        std::uint64_t, typename xdr::xdr_traits<T>::uint_type>::value>::type
+    operator()(T t)
+    {
+        uint64_t v = xdr::xdr_traits<T>::to_uint(t);
+        addUint32(static_cast<uint32_t>(v >> 32));
+        addUint32(static_cast<uint32_t>(v));
+    }
+
+    template <typename T>
+    typename std::enable_if<xdr::xdr_traits<T>::is_bytes>::type
+    operator()(T const& t)
+    {
+        if (xdr::xdr_traits<T>::variable_nelem)
+        {
+            addUint32(xdr::size32(t.size()));
+        }
+        addBytes(t.data(), t.size());
+    }
+
+    template <typename T>
+    typename std::enable_if<xdr::xdr_traits<T>::is_class ||
+                            xdr::xdr_traits<T>::is_container>::type
+    operator()(T const& t)
+    {
+        xdr::xdr_traits<T>::save(*this, t);
+    }
+
+    // adds `size` opaque bytes followed by their padding
+    void addBytes(void const* data, size_t size);
+
+    // adds data that is already XDR encoded
+    void
+    addEncoded(ByteSlice const& data)
+    {
+        add(data.data(), data.size());
+    }
+
+    uint512 finish();
+};
+
+// hash of the XDR encoding of args
+template <typename... Args>
+uint512
+getXDRHashOf(Args const&... args)
+{
+    XDRHasher hasher;
+    xdr::xdr_argpack_archive(hasher, args...);
+    return hasher.finish();
+}
+}
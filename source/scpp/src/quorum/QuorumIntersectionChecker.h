@@ -5,6 +5,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "quorum/QuorumTracker.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 
 namespace stellar
@@ -12,13 +15,71 @@ namespace stellar
 class QuorumIntersectionChecker
 {
   public:
+    // numThreads: threads used to scan the powerset of the main SCC, 0 for
+    // one per hardware thread
+    // splitDepth: recursion depth up to which a parallel scan is split into
+    // tasks, which yields up to 2^splitDepth tasks
+    // The results of the last complete checks are cached by quorum map, so
+    // checking a new checker created for the same map doesn't search again.
     static std::shared_ptr<QuorumIntersectionChecker>
-    create(stellar::QuorumTracker::QuorumMap const& qmap);
+    create(stellar::QuorumTracker::QuorumMap const& qmap,
+           size_t numThreads = 1, size_t splitDepth = 8);
+
+    enum IntersectionResult
+    {
+        INTERSECTION_ENJOYED,
+        INTERSECTION_SPLIT, // see getPotentialSplit
+        INTERSECTION_ABORTED
+    };
+
+    // counters of a running check, see checkQuorumIntersection
+    struct Progress
+    {
+        size_t mCallsStarted;
+        size_t mMaxQuorumsSeen;
+        size_t mMinQuorumsSeen;
+    };
+    typedef std::function<void(Progress const&)> ProgressCallback;
 
     virtual ~QuorumIntersectionChecker(){};
     virtual bool networkEnjoysQuorumIntersection() const = 0;
     virtual size_t getMaxQuorumsFound() const = 0;
     virtual std::pair<std::vector<PublicKey>, std::vector<PublicKey>>
     getPotentialSplit() const = 0;
+
+    // Replaces the quorum map of the checker, only rebuilding the parts of
+    // the graph of the nodes whose quorum set changed. The next check
+    // returns the previous result without searching when the changes can't
+    // break quorum intersection, e.g. nodes raising their threshold.
+    virtual void update(stellar::QuorumTracker::QuorumMap const& qmap) = 0;
+
+    // Same as networkEnjoysQuorumIntersection, but the check is aborted as
+    // soon as *interruptFlag is set (if not null) or the deadline passes.
+    // progress (if set) is called periodically on the calling thread.
+    virtual IntersectionResult checkQuorumIntersection(
+        std::atomic<bool> const* interruptFlag,
+        std::chrono::steady_clock::time_point deadline,
+        ProgressCallback const& progress) const = 0;
+
+    // What a search found that is likely to hold after small changes of the
+    // network: the potential split, if any, and some of the minimal quorums
+    // that had no disjoint quorum.
+    struct Hints
+    {
+        std::pair<std::vector<PublicKey>, std::vector<PublicKey>>
+            mPotentialSplit;
+        std::vector<std::vector<PublicKey>> mMinQuorums;
+    };
+
+    // The hints of the last search, which the checker also keeps for its
+    // next search when its map is updated.
+    virtual Hints getHints() const = 0;
+
+    // Makes the next search start from the hints of another checker, e.g.
+    // one for a previous version of the network: the split is tested again
+    // before anything else, and the quorums that still have no disjoint
+    // quorum prune the search. The hints only make the search faster, they
+    // don't change its result even if they are unrelated to the network.
+    virtual void setHints(Hints const& hints) = 0;
 };
 }
@@ -5,8 +5,13 @@
 #include "QuorumIntersectionCheckerImpl.h"
 #include "QuorumIntersectionChecker.h"
 
+#include "crypto/XDRHasher.h"
 #include "util/Logging.h"
 #include "util/Math.h"
+#include "xdrpp/marshal.h"
+
+#include <algorithm>
+#include <thread>
 
 namespace
 {
@@ -19,15 +24,25 @@ using namespace stellar;
 struct QBitSet;
 using QGraph = std::vector<QBitSet>;
 
-QBitSet::QBitSet(uint32_t threshold, BitSet const& nodes,
+QBitSet::QBitSet(uint32_t threshold, NodeBitSet const& nodes,
                  QGraph const& innerSets)
     : mThreshold(threshold)
     , mNodes(nodes)
     , mInnerSets(innerSets)
     , mAllSuccessors(getSuccessors(nodes, innerSets))
+    , mFlat(innerSets.empty())
+    , mTwoLevel(std::all_of(innerSets.begin(), innerSets.end(),
+                            [](QBitSet const& i) { return i.mFlat; }))
 {
 }
 
+bool
+QBitSet::operator==(QBitSet const& other) const
+{
+    return mThreshold == other.mThreshold && mNodes == other.mNodes &&
+           mInnerSets == other.mInnerSets;
+}
+
 void
 QBitSet::log(size_t indent) const
 {
@@ -41,10 +56,10 @@ QBitSet::log(size_t indent) const
     }
 }
 
-BitSet
-QBitSet::getSuccessors(BitSet const& nodes, QGraph const& inner)
+NodeBitSet
+QBitSet::getSuccessors(NodeBitSet const& nodes, QGraph const& inner)
 {
-    BitSet out(nodes);
+    NodeBitSet out(nodes);
     for (auto const& i : inner)
     {
         out |= i.mAllSuccessors;
@@ -69,25 +84,72 @@ TarjanSCCCalculator::TarjanSCCCalculator(QGraph const& graph) : mGraph(graph)
 void
 TarjanSCCCalculator::calculateSCCs()
 {
-    mNodes.clear();
+    mNodes.assign(mGraph.size(), SCCNode{});
     mStack.clear();
+    mCallStack.clear();
     mIndex = 0;
-    mSCCs.clear();
+    mComponents.assign(mGraph.size(), 0);
+    mNumComponents = 0;
     for (size_t i = 0; i < mGraph.size(); ++i)
     {
-        mNodes.emplace_back(SCCNode{});
+        if (mNodes.at(i).mIndex == -1)
+        {
+            scc(i);
+        }
     }
+    collectSCCs();
+}
+
+bool
+TarjanSCCCalculator::addEdge(size_t from, size_t to)
+{
+    size_t lo = mComponents.at(from);
+    size_t hi = mComponents.at(to);
+    if (lo >= hi)
+    {
+        // Already in the same SCC, or in an order consistent with the edge.
+        return false;
+    }
+
+    // Only the SCCs numbered in [lo, hi] can be merged or reordered by the
+    // edge: SCCs below lo can't reach `from`, and SCCs above hi can't be
+    // reached from `to`. Recalculate them, with the other nodes visited.
+    mStack.clear();
+    mCallStack.clear();
+    mIndex = 0;
     for (size_t i = 0; i < mGraph.size(); ++i)
     {
-        if (mNodes.at(i).mIndex == -1)
+        size_t c = mComponents[i];
+        mNodes[i] = SCCNode{};
+        if (c < lo || c > hi)
+        {
+            mNodes[i].mIndex = 0;
+        }
+    }
+    size_t total = mNumComponents;
+    mNumComponents = lo;
+    for (size_t i = 0; i < mGraph.size(); ++i)
+    {
+        if (mNodes[i].mIndex == -1)
         {
             scc(i);
         }
     }
+    size_t merged = (hi + 1) - mNumComponents;
+    for (auto& c : mComponents)
+    {
+        if (c > hi)
+        {
+            c -= merged;
+        }
+    }
+    mNumComponents = total - merged;
+    collectSCCs();
+    return merged != 0;
 }
 
 void
-TarjanSCCCalculator::scc(size_t i)
+TarjanSCCCalculator::visit(size_t i)
 {
     auto& v = mNodes.at(i);
     v.mIndex = mIndex;
@@ -95,36 +157,68 @@ TarjanSCCCalculator::scc(size_t i)
     mIndex++;
     mStack.push_back(i);
     v.mOnStack = true;
+    mCallStack.push_back(Frame{i, 0});
+}
 
-    BitSet const& succ = mGraph.at(i).mAllSuccessors;
-    for (size_t j = 0; succ.nextSet(j); ++j)
+void
+TarjanSCCCalculator::scc(size_t root)
+{
+    visit(root);
+    while (!mCallStack.empty())
     {
-        CLOG(TRACE, "SCP") << "edge: " << i << " -> " << j;
-        SCCNode& w = mNodes.at(j);
-        if (w.mIndex == -1)
+        size_t i = mCallStack.back().mNode;
+        size_t j = mCallStack.back().mNextSuccessor;
+        SCCNode& v = mNodes.at(i);
+        NodeBitSet const& succ = mGraph.at(i).mAllSuccessors;
+        if (succ.nextSet(j))
+        {
+            mCallStack.back().mNextSuccessor = j + 1;
+            CLOG(TRACE, "SCP") << "edge: " << i << " -> " << j;
+            SCCNode& w = mNodes.at(j);
+            if (w.mIndex == -1)
+            {
+                // "recursive" call, the low link of v is updated on return
+                visit(j);
+            }
+            else if (w.mOnStack)
+            {
+                v.mLowLink = std::min(v.mLowLink, w.mIndex);
+            }
+            continue;
+        }
+
+        mCallStack.pop_back();
+        if (!mCallStack.empty())
         {
-            scc(j);
-            v.mLowLink = std::min(v.mLowLink, w.mLowLink);
+            SCCNode& parent = mNodes.at(mCallStack.back().mNode);
+            parent.mLowLink = std::min(parent.mLowLink, v.mLowLink);
         }
-        else if (w.mOnStack)
+        if (v.mLowLink == v.mIndex)
         {
-            v.mLowLink = std::min(v.mLowLink, w.mIndex);
+            size_t k = 0;
+            do
+            {
+                k = mStack.back();
+                mComponents.at(k) = mNumComponents;
+                mStack.pop_back();
+                mNodes.at(k).mOnStack = false;
+            } while (k != i);
+            mNumComponents++;
         }
     }
+}
 
-    if (v.mLowLink == v.mIndex)
+void
+TarjanSCCCalculator::collectSCCs()
+{
+    mSCCs.resize(mNumComponents);
+    for (auto& scc : mSCCs)
     {
-        BitSet newScc;
-        newScc.set(i);
-        size_t j = 0;
-        do
-        {
-            j = mStack.back();
-            newScc.set(j);
-            mStack.pop_back();
-            mNodes.at(j).mOnStack = false;
-        } while (j != i);
-        mSCCs.push_back(newScc);
+        scc.clear();
+    }
+    for (size_t i = 0; i < mComponents.size(); ++i)
+    {
+        mSCCs.at(mComponents[i]).set(i);
     }
 }
 
@@ -132,6 +226,9 @@ TarjanSCCCalculator::scc(size_t i)
 // Implementation of MinQuorumEnumerator
 ////////////////////////////////////////////////////////////////////////////////
 
+// Number of minimal quorums a search keeps for the hints, see "Coda 5".
+size_t const HINT_QUORUMS = 64;
+
 // Slightly tweaked variant of Lachowski's next-node function.
 size_t
 MinQuorumEnumerator::pickSplitNode() const
@@ -147,7 +244,7 @@ MinQuorumEnumerator::pickSplitNode() const
         // Heuristic opportunity: biasing towards cross-org edges and
         // away from intra-org edges seems to help; work out some way
         // to make this a robust bias.
-        BitSet avail = mQic.mGraph.at(i).mAllSuccessors & mRemaining;
+        NodeBitSet avail = mQic.mGraph.at(i).mAllSuccessors & mRemaining;
         for (size_t j = 0; avail.nextSet(j); ++j)
         {
             size_t currDegree = ++inDegrees.at(j);
@@ -158,7 +255,8 @@ MinQuorumEnumerator::pickSplitNode() const
                     // currDegree same as existing max: replace it
                     // only probabilistically.
                     maxCount++;
-                    if (rand_uniform<size_t>(0, maxCount) == 0)
+                    if (std::uniform_int_distribution<size_t>(0, maxCount)(
+                            mCtx.mRandom) == 0)
                     {
                         // Not switching max element with max degree.
                         continue;
@@ -185,24 +283,41 @@ MinQuorumEnumerator::maxCommit() const
 }
 
 MinQuorumEnumerator::MinQuorumEnumerator(
-    BitSet const& committed, BitSet const& remaining,
-    QuorumIntersectionCheckerImpl const& qic)
+    NodeBitSet const& committed, NodeBitSet const& remaining,
+    QuorumIntersectionCheckerImpl const& qic, SearchContext& ctx,
+    ParallelMinQuorumSearch* search, size_t depth)
     : mCommitted(committed)
     , mRemaining(remaining)
     , mPerimeter(committed | remaining)
     , mQic(qic)
+    , mCtx(ctx)
+    , mSearch(search)
+    , mDepth(depth)
 {
 }
 
 bool
 MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
 {
-    mQic.mStats.mCallsStarted++;
+    // Interrupted, or another worker found a counterexample: the result of
+    // the search is already known.
+    if (mCtx.mControl.stopped())
+    {
+        return false;
+    }
+
+    auto& stats = mCtx.mStats;
+    stats.mCallsStarted++;
+
+    if ((stats.mCallsStarted & 0xfff) == 0)
+    {
+        mCtx.poll();
+    }
 
     // Emit a progress meter every million calls.
-    if ((mQic.mStats.mCallsStarted & 0xfffff) == 0)
+    if (mCtx.mLogProgress && (stats.mCallsStarted & 0xfffff) == 0)
     {
-        mQic.mStats.log();
+        stats.log();
     }
     if (mQic.mLogTrace)
     {
@@ -216,7 +331,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     // min-quorum they find (if they find any).
     if (mCommitted.count() > maxCommit())
     {
-        mQic.mStats.mEarlyExit1s++;
+        stats.mEarlyExit1s++;
         if (mQic.mLogTrace)
         {
             CLOG(TRACE, "SCP") << "early exit 1, with committed=" << mCommitted;
@@ -233,9 +348,21 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         CLOG(TRACE, "SCP") << "checking for quorum in committed=" << mCommitted;
     }
-    if (auto committedQuorum = mQic.contractToMaximalQuorum(mCommitted))
+    if (auto committedQuorum =
+            mQic.contractToMaximalQuorum(mCommitted, stats))
     {
-        if (mQic.isMinimalQuorum(committedQuorum))
+        // The only min-quorum left would be a known quorum, see "Coda 5".
+        if (mQic.extendsKnownQuorum(committedQuorum))
+        {
+            if (mQic.mLogTrace)
+            {
+                CLOG(TRACE, "SCP")
+                    << "early exit 3.3: known quorum in=" << committedQuorum;
+            }
+            stats.mEarlyExit33s++;
+            return false;
+        }
+        if (mQic.isMinimalQuorum(committedQuorum, stats))
         {
             // Found a min-quorum. Examine it to see if
             // there's a disjoint quorum.
@@ -244,15 +371,23 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 CLOG(TRACE, "SCP")
                     << "early exit 3.1: minimal quorum=" << committedQuorum;
             }
-            mQic.mStats.mEarlyExit31s++;
-            return mQic.hasDisjointQuorum(committedQuorum);
+            stats.mEarlyExit31s++;
+            if (mQic.hasDisjointQuorum(committedQuorum, mCtx))
+            {
+                return true;
+            }
+            if (mCtx.mMinQuorums.size() < HINT_QUORUMS)
+            {
+                mCtx.mMinQuorums.emplace_back(committedQuorum);
+            }
+            return false;
         }
         if (mQic.mLogTrace)
         {
             CLOG(TRACE, "SCP")
                 << "early exit 3.2: non-minimal quorum=" << committedQuorum;
         }
-        mQic.mStats.mEarlyExit32s++;
+        stats.mEarlyExit32s++;
         return false;
     }
 
@@ -263,7 +398,8 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         CLOG(TRACE, "SCP") << "checking for quorum in perimeter=" << mPerimeter;
     }
-    if (auto extensionQuorum = mQic.contractToMaximalQuorum(mPerimeter))
+    if (auto extensionQuorum =
+            mQic.contractToMaximalQuorum(mPerimeter, stats))
     {
         if (!(mCommitted <= extensionQuorum))
         {
@@ -274,7 +410,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                     << " in perimeter=" << mPerimeter
                     << " does not extend committed=" << mCommitted;
             }
-            mQic.mStats.mEarlyExit22s++;
+            stats.mEarlyExit22s++;
             return false;
         }
     }
@@ -286,14 +422,14 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 << "early exit 2.1: no extension quorum in perimeter="
                 << mPerimeter;
         }
-        mQic.mStats.mEarlyExit21s++;
+        stats.mEarlyExit21s++;
         return false;
     }
 
     // Principal termination condition: stop when remainder is empty.
     if (!mRemaining)
     {
-        mQic.mStats.mTerminations++;
+        stats.mTerminations++;
         if (mQic.mLogTrace)
         {
             CLOG(TRACE, "SCP") << "remainder exhausted";
@@ -308,8 +444,21 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         CLOG(TRACE, "SCP") << "recursing into subproblems, split=" << split;
     }
     mRemaining.unset(split);
-    MinQuorumEnumerator childExcludingSplit(mCommitted, mRemaining, mQic);
-    mQic.mStats.mFirstRecursionsTaken++;
+
+    // Near the top of a parallel search, the subproblems are left to the
+    // workers instead.
+    if (mSearch && mSearch->shouldSplit(mDepth))
+    {
+        mSearch->push(mCtx, mCommitted, mRemaining, mDepth + 1);
+        NodeBitSet committedWithSplit(mCommitted);
+        committedWithSplit.set(split);
+        mSearch->push(mCtx, committedWithSplit, mRemaining, mDepth + 1);
+        return false;
+    }
+
+    MinQuorumEnumerator childExcludingSplit(mCommitted, mRemaining, mQic, mCtx,
+                                            mSearch, mDepth + 1);
+    stats.mFirstRecursionsTaken++;
     if (childExcludingSplit.anyMinQuorumHasDisjointQuorum())
     {
         if (mQic.mLogTrace)
@@ -320,21 +469,205 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         return true;
     }
     mCommitted.set(split);
-    MinQuorumEnumerator childIncludingSplit(mCommitted, mRemaining, mQic);
-    mQic.mStats.mSecondRecursionsTaken++;
+    MinQuorumEnumerator childIncludingSplit(mCommitted, mRemaining, mQic, mCtx,
+                                            mSearch, mDepth + 1);
+    stats.mSecondRecursionsTaken++;
     return childIncludingSplit.anyMinQuorumHasDisjointQuorum();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of ParallelMinQuorumSearch
+////////////////////////////////////////////////////////////////////////////////
+
+SearchControl::SearchControl(
+    std::atomic<bool> const* interruptFlag,
+    std::chrono::steady_clock::time_point deadline,
+    QuorumIntersectionChecker::ProgressCallback const& progress)
+    : mInterruptFlag(interruptFlag), mDeadline(deadline), mProgress(progress)
+{
+}
+
+SearchContext::SearchContext(SearchControl& control,
+                             std::default_random_engine::result_type seed,
+                             bool logProgress)
+    : mControl(control), mRandom(seed), mLogProgress(logProgress)
+{
+}
+
+void
+SearchContext::poll()
+{
+    mControl.mCallsStarted += mStats.mCallsStarted - mPublishedCalls;
+    mControl.mMaxQuorumsSeen += mStats.mMaxQuorumsSeen - mPublishedMaxQuorums;
+    mControl.mMinQuorumsSeen += mStats.mMinQuorumsSeen - mPublishedMinQuorums;
+    mPublishedCalls = mStats.mCallsStarted;
+    mPublishedMaxQuorums = mStats.mMaxQuorumsSeen;
+    mPublishedMinQuorums = mStats.mMinQuorumsSeen;
+
+    if ((mControl.mInterruptFlag && mControl.mInterruptFlag->load()) ||
+        std::chrono::steady_clock::now() >= mControl.mDeadline)
+    {
+        mControl.mAborted.store(true);
+        mControl.mStop.store(true);
+        return;
+    }
+
+    if (mLogProgress && mControl.mProgress &&
+        (mStats.mCallsStarted & 0xffff) == 0)
+    {
+        mControl.mProgress(QuorumIntersectionChecker::Progress{
+            mControl.mCallsStarted.load(), mControl.mMaxQuorumsSeen.load(),
+            mControl.mMinQuorumsSeen.load()});
+    }
+}
+
+ParallelMinQuorumSearch::ParallelMinQuorumSearch(
+    QuorumIntersectionCheckerImpl const& qic, SearchControl& control,
+    size_t numThreads, size_t splitDepth)
+    : mQic(qic)
+    , mSplitDepth(splitDepth)
+    , mQueues(numThreads)
+    , mControl(control)
+{
+    assert(numThreads > 0);
+    mContexts.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        // The calling thread runs the first worker
+        mContexts.emplace_back(control, gRandomEngine(), i == 0);
+    }
+}
+
+void
+ParallelMinQuorumSearch::push(SearchContext const& ctx,
+                              NodeBitSet const& committed, NodeBitSet const& remaining,
+                              size_t depth)
+{
+    size_t worker = &ctx - mContexts.data();
+    assert(worker < mContexts.size());
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueues[worker].emplace_back(Task{committed, remaining, depth});
+    }
+    mWakeUp.notify_one();
+}
+
+bool
+ParallelMinQuorumSearch::popTask(size_t worker, Task& task)
+{
+    // Own queue first, most recent task: it's the deepest, so the smallest
+    // and the closest to what this worker just looked at.
+    auto& own = mQueues[worker];
+    if (!own.empty())
+    {
+        task = std::move(own.back());
+        own.pop_back();
+        return true;
+    }
+    // Then steal the oldest task of the next worker that has any.
+    for (size_t i = 1; i < mQueues.size(); ++i)
+    {
+        auto& other = mQueues[(worker + i) % mQueues.size()];
+        if (!other.empty())
+        {
+            task = std::move(other.front());
+            other.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+ParallelMinQuorumSearch::work(size_t worker)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mControl.stopped())
+    {
+        Task task;
+        if (!popTask(worker, task))
+        {
+            if (mActive == 0)
+            {
+                // Nothing queued and nothing running that could queue more:
+                // the search is over.
+                break;
+            }
+            mWakeUp.wait(lock);
+            continue;
+        }
+
+        ++mActive;
+        lock.unlock();
+        MinQuorumEnumerator mqe(task.mCommitted, task.mRemaining, mQic,
+                                mContexts[worker], this, task.mDepth);
+        bool found = mqe.anyMinQuorumHasDisjointQuorum();
+        lock.lock();
+        --mActive;
+
+        if (found)
+        {
+            mFound.store(true);
+            mControl.mStop.store(true);
+        }
+        if (found || mActive == 0)
+        {
+            mWakeUp.notify_all();
+        }
+    }
+}
+
+bool
+ParallelMinQuorumSearch::run(NodeBitSet const& committed, NodeBitSet const& remaining)
+{
+    mQueues[0].emplace_back(Task{committed, remaining, 0});
+
+    std::vector<std::thread> threads;
+    threads.reserve(mContexts.size() - 1);
+    for (size_t i = 1; i < mContexts.size(); ++i)
+    {
+        threads.emplace_back([this, i]() { work(i); });
+    }
+    work(0);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    return mFound.load();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation of QuorumIntersectionChecker
 ////////////////////////////////////////////////////////////////////////////////
 
+// Results of the last complete checks, by quorum map digest (oldest first),
+// see "Coda 3". This is the only state shared by the checkers: it's keyed
+// by the content of the map, so the checkers of SCP instances running on
+// separate threads share the results under the lock.
+struct CachedResult
+{
+    std::vector<uint8_t> mDigest;
+    QuorumIntersectionChecker::IntersectionResult mResult;
+    std::pair<std::vector<PublicKey>, std::vector<PublicKey>> mPotentialSplit;
+    size_t mMaxQuorumsFound;
+};
+size_t const RESULT_CACHE_SIZE = 16;
+std::mutex gResultCacheMutex;
+std::deque<CachedResult> gResultCache;
+
 QuorumIntersectionCheckerImpl::QuorumIntersectionCheckerImpl(
-    QuorumTracker::QuorumMap const& qmap)
-    : mLogTrace(Logging::logTrace("SCP")), mTSC(mGraph)
+    QuorumTracker::QuorumMap const& qmap, size_t numThreads, size_t splitDepth)
+    : mLogTrace(Logging::logTrace("SCP"))
+    , mNumThreads(numThreads != 0
+                      ? numThreads
+                      : std::max<size_t>(1, std::thread::hardware_concurrency()))
+    , mSplitDepth(splitDepth)
+    , mTSC(mGraph)
 {
     buildGraph(qmap);
+    buildQSetClasses();
     buildSCCs();
+    buildDigest(qmap);
 }
 
 std::pair<std::vector<PublicKey>, std::vector<PublicKey>>
@@ -349,12 +682,29 @@ QuorumIntersectionCheckerImpl::getMaxQuorumsFound() const
     return mStats.mMaxQuorumsSeen;
 }
 
+void
+QuorumIntersectionCheckerImpl::Stats::merge(Stats const& other)
+{
+    mCallsStarted += other.mCallsStarted;
+    mFirstRecursionsTaken += other.mFirstRecursionsTaken;
+    mSecondRecursionsTaken += other.mSecondRecursionsTaken;
+    mMaxQuorumsSeen += other.mMaxQuorumsSeen;
+    mMinQuorumsSeen += other.mMinQuorumsSeen;
+    mTerminations += other.mTerminations;
+    mEarlyExit1s += other.mEarlyExit1s;
+    mEarlyExit21s += other.mEarlyExit21s;
+    mEarlyExit22s += other.mEarlyExit22s;
+    mEarlyExit31s += other.mEarlyExit31s;
+    mEarlyExit32s += other.mEarlyExit32s;
+    mEarlyExit33s += other.mEarlyExit33s;
+}
+
 void
 QuorumIntersectionCheckerImpl::Stats::log() const
 {
     CLOG(DEBUG, "SCP") << "Quorum intersection checker stats:";
     size_t exits = (mEarlyExit1s + mEarlyExit21s + mEarlyExit22s +
-                    mEarlyExit31s + mEarlyExit32s);
+                    mEarlyExit31s + mEarlyExit32s + mEarlyExit33s);
     CLOG(DEBUG, "SCP") << "[Nodes: " << mTotalNodes << ", SCCs: " << mNumSCCs
                        << ", MaxSCC: " << mMaxSCC
                        << ", MaxQs:" << mMaxQuorumsSeen
@@ -366,13 +716,14 @@ QuorumIntersectionCheckerImpl::Stats::log() const
     CLOG(DEBUG, "SCP") << "[X1:" << mEarlyExit1s << ", X2.1:" << mEarlyExit21s
                        << ", X2.2:" << mEarlyExit22s
                        << ", X3.1:" << mEarlyExit31s
-                       << ", X3.2:" << mEarlyExit32s << "]";
+                       << ", X3.2:" << mEarlyExit32s
+                       << ", X3.3:" << mEarlyExit33s << "]";
 }
 
 // This function is the innermost call in the checker and must be as fast
 // as possible. We spend almost all of our time in here.
 bool
-QuorumIntersectionCheckerImpl::containsQuorumSlice(BitSet const& bs,
+QuorumIntersectionCheckerImpl::containsQuorumSlice(NodeBitSet const& bs,
                                                    QBitSet const& qbs) const
 {
     // First we do a very quick check: do we have enough bits in 'bs'
@@ -383,6 +734,10 @@ QuorumIntersectionCheckerImpl::containsQuorumSlice(BitSet const& bs,
     {
         return true;
     }
+    if (qbs.mFlat)
+    {
+        return false;
+    }
 
     // If not, the residual "inner threshold" is the number of additional hits
     // (in the innerSets) we need to satisfy this qset. If there aren't enough
@@ -413,10 +768,16 @@ QuorumIntersectionCheckerImpl::containsQuorumSlice(BitSet const& bs,
     // If we had a threshold of (say) 5 of 7, the fail-limit would be 3: once
     // we've failed 3 innerSets we can stop looking at the others since there's
     // no way to get to 5 successes.
+    //
+    // When all the innerSets are flat (the usual organization-based qset),
+    // each of them is a single population count, done here without
+    // recursing.
     size_t innerFailLimit = qbs.mInnerSets.size() - innerThreshold + 1;
     for (auto const& inner : qbs.mInnerSets)
     {
-        if (containsQuorumSlice(bs, inner))
+        if (qbs.mTwoLevel
+                ? bs.intersectionCount(inner.mNodes) >= inner.mThreshold
+                : containsQuorumSlice(bs, inner))
         {
             innerThreshold--;
             if (innerThreshold == 0)
@@ -437,37 +798,39 @@ QuorumIntersectionCheckerImpl::containsQuorumSlice(BitSet const& bs,
 }
 
 bool
-QuorumIntersectionCheckerImpl::containsQuorumSliceForNode(BitSet const& bs,
-                                                          size_t node) const
-{
-    if (!bs.get(node))
-    {
-        return false;
-    }
-    return containsQuorumSlice(bs, mGraph.at(node));
-}
-
-bool
-QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isAQuorum(NodeBitSet const& nodes,
+                                         Stats& stats) const
 {
-    return (bool)contractToMaximalQuorum(nodes);
+    return (bool)contractToMaximalQuorum(nodes, stats);
 }
 
-BitSet
-QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
+NodeBitSet
+QuorumIntersectionCheckerImpl::contractToMaximalQuorum(NodeBitSet nodes,
+                                                       Stats& stats) const
 {
-    // Find greatest fixpoint of f(X) = {n ∈ X | containsQuorumSliceForNode(X,
-    // n)}
+    // Find greatest fixpoint of f(X) = {n ∈ X | containsQuorumSlice(X,
+    // mGraph[n])}
     if (mLogTrace)
     {
         CLOG(TRACE, "SCP") << "Contracting to max quorum of " << nodes;
     }
     while (true)
     {
-        BitSet filtered(nodes.count());
+        NodeBitSet filtered(nodes.count());
+        // results of this round, by qset class (see mQSetClasses)
+        NodeBitSet evaluated, satisfied;
         for (size_t i = 0; nodes.nextSet(i); ++i)
         {
-            if (containsQuorumSliceForNode(nodes, i))
+            size_t cls = mQSetClasses[i];
+            if (!evaluated.get(cls))
+            {
+                evaluated.set(cls);
+                if (containsQuorumSlice(nodes, mGraph.at(i)))
+                {
+                    satisfied.set(cls);
+                }
+            }
+            if (satisfied.get(cls))
             {
                 if (mLogTrace)
                 {
@@ -491,7 +854,7 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
             }
             if (filtered)
             {
-                ++mStats.mMaxQuorumsSeen;
+                ++stats.mMaxQuorumsSeen;
             }
             return filtered;
         }
@@ -500,15 +863,16 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
 }
 
 bool
-QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isMinimalQuorum(NodeBitSet const& nodes,
+                                               Stats& stats) const
 {
 #ifndef NDEBUG
     // We should only be called with a quorum, such that contracting to its
     // maximum doesn't do anything. This is a slightly expensive check.
-    assert(contractToMaximalQuorum(nodes) == nodes);
+    assert(contractToMaximalQuorum(nodes, stats) == nodes);
 #endif
 
-    BitSet minQ = nodes;
+    NodeBitSet minQ = nodes;
     if (!nodes)
     {
         // nodes isn't a quorum at all: certainly not a minq.
@@ -517,7 +881,7 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     for (size_t i = 0; nodes.nextSet(i); ++i)
     {
         minQ.unset(i);
-        if (isAQuorum(minQ))
+        if (isAQuorum(minQ, stats))
         {
             // There's a subquorum with i removed: nodes isn't a minq.
             return false;
@@ -527,13 +891,13 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     }
     // Tried every possible one-node-less subset, found no subquorums: this one
     // is minimal.
-    mStats.mMinQuorumsSeen++;
+    stats.mMinQuorumsSeen++;
     return true;
 }
 
 void
 QuorumIntersectionCheckerImpl::noteFoundDisjointQuorums(
-    BitSet const& nodes, BitSet const& disj) const
+    NodeBitSet const& nodes, NodeBitSet const& disj) const
 {
     mPotentialSplit.first.clear();
     mPotentialSplit.second.clear();
@@ -546,23 +910,28 @@ QuorumIntersectionCheckerImpl::noteFoundDisjointQuorums(
     err << "Found potential disjoint quorums: ";
     nodes.streamWith(err, [this](std::ostream& out, size_t i) {
         out << this->nodeName(i);
-        this->mPotentialSplit.first.emplace_back(this->mBitNumPubKeys.at(i));
+        this->mPotentialSplit.first.emplace_back(
+            this->mNodeIndex.getNodeID(i));
     });
     err << " vs. ";
     disj.streamWith(err, [this](std::ostream& out, size_t i) {
         out << this->nodeName(i);
-        this->mPotentialSplit.second.emplace_back(this->mBitNumPubKeys.at(i));
+        this->mPotentialSplit.second.emplace_back(
+            this->mNodeIndex.getNodeID(i));
     });
     CLOG(ERROR, "SCP") << err.str();
 }
 
 bool
-QuorumIntersectionCheckerImpl::hasDisjointQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::hasDisjointQuorum(NodeBitSet const& nodes,
+                                                 SearchContext& ctx) const
 {
-    BitSet disj = contractToMaximalQuorum(mMaxSCC - nodes);
+    NodeBitSet disj = contractToMaximalQuorum(mMaxSCC - nodes, ctx.mStats);
     if (disj)
     {
-        noteFoundDisjointQuorums(nodes, disj);
+        // Reported by networkEnjoysQuorumIntersection, on its own thread.
+        ctx.mFoundQuorum = nodes;
+        ctx.mFoundDisjoint = disj;
     }
     else
     {
@@ -579,11 +948,11 @@ QBitSet
 QuorumIntersectionCheckerImpl::convertSCPQuorumSet(SCPQuorumSet const& sqs)
 {
     uint32_t threshold = sqs.threshold;
-    BitSet nodeBits(mPubKeyBitNums.size());
+    NodeBitSet nodeBits(mNodeIndex.size());
     for (auto const& v : sqs.validators)
     {
-        auto i = mPubKeyBitNums.find(v);
-        if (i == mPubKeyBitNums.end())
+        size_t i = mNodeIndex.find(v);
+        if (i == NodeIndex::npos)
         {
             // This node 'v' is one we do not have a qset for. We treat this as
             // meaning 'v' is dead: people depend on it but it's not voting, so
@@ -614,7 +983,7 @@ QuorumIntersectionCheckerImpl::convertSCPQuorumSet(SCPQuorumSet const& sqs)
         }
         else
         {
-            nodeBits.set(i->second);
+            nodeBits.set(i);
         }
     }
     QGraph inner;
@@ -629,17 +998,15 @@ QuorumIntersectionCheckerImpl::convertSCPQuorumSet(SCPQuorumSet const& sqs)
 void
 QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
 {
-    mPubKeyBitNums.clear();
-    mBitNumPubKeys.clear();
+    mNodeIndex.clear();
     mGraph.clear();
+    mQSets.clear();
 
     for (auto const& pair : qmap)
     {
         if (pair.second)
         {
-            size_t n = mBitNumPubKeys.size();
-            mPubKeyBitNums.insert(std::make_pair(pair.first, n));
-            mBitNumPubKeys.emplace_back(pair.first);
+            mNodeIndex.intern(pair.first);
         }
         else
         {
@@ -652,22 +1019,259 @@ QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
     {
         if (pair.second)
         {
-            auto i = mPubKeyBitNums.find(pair.first);
-            assert(i != mPubKeyBitNums.end());
-            auto nodeNum = i->second;
+            auto nodeNum = mNodeIndex.find(pair.first);
             assert(nodeNum == mGraph.size());
             auto qb = convertSCPQuorumSet(*pair.second);
             qb.log();
             mGraph.emplace_back(qb);
+            mQSets.emplace_back(pair.second);
+        }
+    }
+    mStats.mTotalNodes = mNodeIndex.size();
+}
+
+QBitSet
+QuorumIntersectionCheckerImpl::convertNode(SCPQuorumSetPtr const& qset)
+{
+    if (qset)
+    {
+        return convertSCPQuorumSet(*qset);
+    }
+    // A node that lost its qset: one slice is needed out of none, so it's
+    // never part of a quorum, like nodes without a bit number.
+    return QBitSet(1, NodeBitSet(), QGraph());
+}
+
+// true if every quorum under `strict` is also a quorum under `qset`, only
+// checking the case of the same members with thresholds at least as high
+bool
+isAtLeastAsStrict(SCPQuorumSet const& strict, SCPQuorumSet const& qset)
+{
+    using xdr::operator==;
+    if (strict.threshold < qset.threshold ||
+        strict.validators != qset.validators ||
+        strict.innerSets.size() != qset.innerSets.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < strict.innerSets.size(); ++i)
+    {
+        if (!isAtLeastAsStrict(strict.innerSets[i], qset.innerSets[i]))
+        {
+            return false;
         }
     }
-    mStats.mTotalNodes = mPubKeyBitNums.size();
+    return true;
+}
+
+void
+QuorumIntersectionCheckerImpl::update(QuorumTracker::QuorumMap const& dqmap)
+{
+    // note: cast due to current unordered_set binding in Cpp.d, see create
+    auto const& qmap = **(QuorumTracker::QuorumMap**)&dqmap;
+
+    using xdr::operator==;
+
+    // New qset of every node, new nodes getting the next bit numbers.
+    std::vector<SCPQuorumSetPtr> qsets(mQSets.size());
+    bool newNodes = false;
+    for (auto const& pair : qmap)
+    {
+        if (!pair.second)
+        {
+            continue;
+        }
+        auto i = mNodeIndex.find(pair.first);
+        if (i == NodeIndex::npos)
+        {
+            mNodeIndex.intern(pair.first);
+            mQSets.emplace_back(nullptr);
+            qsets.emplace_back(pair.second);
+            newNodes = true;
+        }
+        else
+        {
+            qsets[i] = pair.second;
+        }
+    }
+
+    // Whether every change only makes quorums scarcer, see "Coda 1".
+    bool stricter = !newNodes;
+    std::vector<bool> changed(qsets.size(), false);
+    bool anyChange = newNodes;
+    for (size_t i = 0; i < qsets.size(); ++i)
+    {
+        auto const& from = mQSets[i];
+        auto const& to = qsets[i];
+        if (from == to || (from && to && *from == *to))
+        {
+            continue;
+        }
+        changed[i] = anyChange = true;
+        if (to && !(from && isAtLeastAsStrict(*to, *from)))
+        {
+            stricter = false;
+        }
+    }
+    if (!anyChange)
+    {
+        return;
+    }
+
+    // Dependents of the new nodes were converted without them: in this case
+    // rebuild everything, but keep the bit numbers.
+    QGraph graph;
+    graph.reserve(qsets.size());
+    bool successorsChanged = newNodes;
+    // whether the SCCs can be updated edge by edge, see
+    // TarjanSCCCalculator::addEdge
+    bool onlyNewEdges = !newNodes;
+    for (size_t i = 0; i < qsets.size(); ++i)
+    {
+        if (newNodes || changed[i])
+        {
+            graph.emplace_back(convertNode(qsets[i]));
+            successorsChanged =
+                successorsChanged ||
+                !(graph.back().mAllSuccessors == mGraph.at(i).mAllSuccessors);
+            onlyNewEdges =
+                onlyNewEdges &&
+                mGraph.at(i).mAllSuccessors <= graph.back().mAllSuccessors;
+        }
+        else
+        {
+            graph.emplace_back(mGraph.at(i));
+        }
+    }
+    CLOG(DEBUG, "SCP") << "Updated quorum intersection checker: "
+                       << std::count(changed.begin(), changed.end(), true)
+                       << " changed nodes, " << (newNodes ? "" : "no ")
+                       << "new nodes";
+    // mTSC refers to mGraph
+    mGraph.swap(graph);
+    mQSets.swap(qsets);
+    buildQSetClasses();
+    buildDigest(qmap);
+    mStats.mTotalNodes = mNodeIndex.size();
+    if (successorsChanged && onlyNewEdges)
+    {
+        // `graph` is now the previous graph
+        for (size_t i = 0; i < mGraph.size(); ++i)
+        {
+            auto added =
+                mGraph.at(i).mAllSuccessors - graph.at(i).mAllSuccessors;
+            for (size_t j = 0; added.nextSet(j); ++j)
+            {
+                mTSC.addEdge(i, j);
+            }
+        }
+        findMaxSCC();
+    }
+    else if (successorsChanged)
+    {
+        buildSCCs();
+    }
+
+    if (!(mResultValid && mLastResult == INTERSECTION_ENJOYED && stricter))
+    {
+        mResultValid = false;
+    }
+}
+
+void
+QuorumIntersectionCheckerImpl::buildQSetClasses()
+{
+    // representatives of the classes found so far
+    std::vector<size_t> reps;
+    mQSetClasses.assign(mGraph.size(), 0);
+    for (size_t i = 0; i < mGraph.size(); ++i)
+    {
+        auto r = std::find_if(reps.begin(), reps.end(), [&](size_t j) {
+            return mGraph.at(j) == mGraph.at(i);
+        });
+        if (r == reps.end())
+        {
+            reps.emplace_back(i);
+            mQSetClasses[i] = i;
+        }
+        else
+        {
+            mQSetClasses[i] = *r;
+        }
+    }
+}
+
+void
+QuorumIntersectionCheckerImpl::buildDigest(
+    QuorumTracker::QuorumMap const& qmap)
+{
+    std::vector<std::vector<uint8_t>> entries;
+    entries.reserve(qmap.size());
+    for (auto const& pair : qmap)
+    {
+        if (pair.second)
+        {
+            auto entry = xdr::xdr_to_opaque(pair.first);
+            auto hash = getXDRHashOf(*pair.second);
+            entry.insert(entry.end(), hash.begin(), hash.end());
+            entries.emplace_back(std::move(entry));
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    mDigest.clear();
+    for (auto const& entry : entries)
+    {
+        mDigest.insert(mDigest.end(), entry.begin(), entry.end());
+    }
+}
+
+bool
+QuorumIntersectionCheckerImpl::loadCachedResult() const
+{
+    std::lock_guard<std::mutex> lock(gResultCacheMutex);
+    auto i = std::find_if(
+        gResultCache.begin(), gResultCache.end(),
+        [&](CachedResult const& c) { return c.mDigest == mDigest; });
+    if (i == gResultCache.end())
+    {
+        return false;
+    }
+    mLastResult = i->mResult;
+    mResultValid = true;
+    mPotentialSplit = i->mPotentialSplit;
+    mStats.mMaxQuorumsSeen = i->mMaxQuorumsFound;
+    return true;
+}
+
+void
+QuorumIntersectionCheckerImpl::storeCachedResult() const
+{
+    std::lock_guard<std::mutex> lock(gResultCacheMutex);
+    auto i = std::find_if(
+        gResultCache.begin(), gResultCache.end(),
+        [&](CachedResult const& c) { return c.mDigest == mDigest; });
+    if (i != gResultCache.end())
+    {
+        gResultCache.erase(i);
+    }
+    else if (gResultCache.size() == RESULT_CACHE_SIZE)
+    {
+        gResultCache.pop_front();
+    }
+    gResultCache.push_back({mDigest, mLastResult, mPotentialSplit,
+                            mStats.mMaxQuorumsSeen});
 }
 
 void
 QuorumIntersectionCheckerImpl::buildSCCs()
 {
     mTSC.calculateSCCs();
+    findMaxSCC();
+}
+
+void
+QuorumIntersectionCheckerImpl::findMaxSCC()
+{
     mMaxSCC.clear();
     for (auto const& scc : mTSC.mSCCs)
     {
@@ -685,16 +1289,58 @@ QuorumIntersectionCheckerImpl::buildSCCs()
 std::string
 QuorumIntersectionCheckerImpl::nodeName(size_t node) const
 {
-    return toShortString(mBitNumPubKeys.at(node));
+    return mNodeIndex.getName(node, false);
 }
 
 bool
 QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
 {
+    return checkQuorumIntersection(nullptr,
+                                   std::chrono::steady_clock::time_point::max(),
+                                   nullptr) != INTERSECTION_SPLIT;
+}
+
+QuorumIntersectionChecker::IntersectionResult
+QuorumIntersectionCheckerImpl::checkQuorumIntersection(
+    std::atomic<bool> const* interruptFlag,
+    std::chrono::steady_clock::time_point deadline,
+    ProgressCallback const& progress) const
+{
+    if (mResultValid)
+    {
+        CLOG(DEBUG, "SCP") << "Quorum intersection unaffected by the changes "
+                           << "since the last check";
+        return mLastResult;
+    }
+    if (loadCachedResult())
+    {
+        CLOG(DEBUG, "SCP") << "Quorum intersection already checked for this "
+                           << "quorum map";
+        return mLastResult;
+    }
+    auto res = searchQuorumIntersection(interruptFlag, deadline, progress);
+    if (res != INTERSECTION_ABORTED)
+    {
+        mLastResult = res;
+        mResultValid = true;
+        storeCachedResult();
+    }
+    return res;
+}
+
+QuorumIntersectionChecker::IntersectionResult
+QuorumIntersectionCheckerImpl::searchQuorumIntersection(
+    std::atomic<bool> const* interruptFlag,
+    std::chrono::steady_clock::time_point deadline,
+    ProgressCallback const& progress) const
+{
+    mPotentialSplit.first.clear();
+    mPotentialSplit.second.clear();
+
     // First stage: check the graph-level SCCs for disjoint quorums,
     // and filter out nodes that aren't in the main SCC.
     bool foundDisjoint = false;
-    size_t nNodes = mPubKeyBitNums.size();
+    size_t nNodes = mNodeIndex.size();
     CLOG(INFO, "SCP") << "Calculating " << nNodes
                       << "-node network quorum intersection";
 
@@ -704,12 +1350,12 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
         {
             continue;
         }
-        if (auto other = contractToMaximalQuorum(scc))
+        if (auto other = contractToMaximalQuorum(scc, mStats))
         {
             CLOG(DEBUG, "SCP") << "found SCC-disjoint quorum = " << other;
             CLOG(DEBUG, "SCP") << "disjoint from quorum = "
-                               << contractToMaximalQuorum(mMaxSCC);
-            noteFoundDisjointQuorums(contractToMaximalQuorum(mMaxSCC), other);
+                               << contractToMaximalQuorum(mMaxSCC, mStats);
+            noteFoundDisjointQuorums(contractToMaximalQuorum(mMaxSCC, mStats), other);
             foundDisjoint = true;
             break;
         }
@@ -727,7 +1373,7 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
         CLOG(DEBUG, "SCP") << "Main SCC node: " << nodeName(i);
     }
 
-    auto q = contractToMaximalQuorum(mMaxSCC);
+    auto q = contractToMaximalQuorum(mMaxSCC, mStats);
     if (q)
     {
         CLOG(DEBUG, "SCP") << "Maximal main SCC quorum: " << q;
@@ -739,28 +1385,248 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
         // it's worth warning about.
         CLOG(WARN, "SCP")
             << "No quorum found in transitive closure (possible network halt)";
-        return true;
+        return INTERSECTION_ENJOYED;
     }
 
-    // Second stage: scan the main SCC powerset, potentially expensive.
+    if (!foundDisjoint && flatQuorumsIntersect(q))
+    {
+        CLOG(INFO, "SCP") << "Quorum intersection proven by the counting "
+                          << "bound on flat qsets, skipping the search";
+        return INTERSECTION_ENJOYED;
+    }
+
+    // Second stage: scan the main SCC powerset, potentially expensive,
+    // unless the hints of the previous search still hold a split.
+    if (!foundDisjoint && applyHints())
+    {
+        CLOG(INFO, "SCP") << "Quorum intersection still broken by the hints "
+                          << "of a previous search";
+        foundDisjoint = true;
+    }
     if (!foundDisjoint)
     {
-        BitSet committed;
-        BitSet remaining = mMaxSCC;
-        MinQuorumEnumerator mqe(committed, remaining, *this);
-        foundDisjoint = mqe.anyMinQuorumHasDisjointQuorum();
+        SearchControl control(interruptFlag, deadline, progress);
+        foundDisjoint = anyMinQuorumHasDisjointQuorum(control);
         mStats.log();
+        if (!foundDisjoint && control.mAborted)
+        {
+            CLOG(INFO, "SCP") << "Quorum intersection check aborted after "
+                              << mStats.mCallsStarted << " calls";
+            return INTERSECTION_ABORTED;
+        }
+    }
+    if (foundDisjoint)
+    {
+        mHints.mPotentialSplit = mPotentialSplit;
+    }
+    return foundDisjoint ? INTERSECTION_SPLIT : INTERSECTION_ENJOYED;
+}
+
+NodeBitSet
+QuorumIntersectionCheckerImpl::toNodeBitSet(
+    std::vector<PublicKey> const& nodes) const
+{
+    // nodes that are not numbered don't have a qset: they can't be part of
+    // a quorum anyway
+    NodeBitSet res;
+    for (auto const& n : nodes)
+    {
+        size_t i = mNodeIndex.find(n);
+        if (i != NodeIndex::npos)
+        {
+            res.set(i);
+        }
+    }
+    return res;
+}
+
+std::vector<PublicKey>
+QuorumIntersectionCheckerImpl::toNodes(NodeBitSet const& nodes) const
+{
+    std::vector<PublicKey> res;
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        res.emplace_back(mNodeIndex.getNodeID(i));
+    }
+    return res;
+}
+
+bool
+QuorumIntersectionCheckerImpl::applyHints() const
+{
+    mKnownQuorums.clear();
+
+    auto const& split = mHints.mPotentialSplit;
+    if (!split.first.empty())
+    {
+        auto first = contractToMaximalQuorum(toNodeBitSet(split.first), mStats);
+        if (first)
+        {
+            auto second =
+                contractToMaximalQuorum(toNodeBitSet(split.second), mStats);
+            // hints given by setHints may not even be disjoint
+            if (second && !(first & second))
+            {
+                noteFoundDisjointQuorums(first, second);
+                return true;
+            }
+        }
+    }
+
+    for (auto const& nodes : mHints.mMinQuorums)
+    {
+        auto quorum =
+            contractToMaximalQuorum(toNodeBitSet(nodes) & mMaxSCC, mStats);
+        if (!quorum)
+        {
+            continue;
+        }
+        if (auto disj = contractToMaximalQuorum(mMaxSCC - quorum, mStats))
+        {
+            noteFoundDisjointQuorums(quorum, disj);
+            return true;
+        }
+        mKnownQuorums.emplace_back(quorum);
+    }
+    CLOG(DEBUG, "SCP") << mKnownQuorums.size() << " of the "
+                       << mHints.mMinQuorums.size()
+                       << " quorums of the hints prune the search";
+    return false;
+}
+
+bool
+QuorumIntersectionCheckerImpl::extendsKnownQuorum(
+    NodeBitSet const& quorum) const
+{
+    for (auto const& known : mKnownQuorums)
+    {
+        if (known <= quorum)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+QuorumIntersectionCheckerImpl::storeHints(
+    std::vector<NodeBitSet> const& minQuorums) const
+{
+    mHints.mPotentialSplit = mPotentialSplit;
+    mHints.mMinQuorums.clear();
+    std::vector<NodeBitSet> quorums;
+    auto add = [&](std::vector<NodeBitSet> const& from) {
+        for (auto const& q : from)
+        {
+            if (quorums.size() < HINT_QUORUMS &&
+                std::find(quorums.begin(), quorums.end(), q) == quorums.end())
+            {
+                quorums.emplace_back(q);
+                mHints.mMinQuorums.emplace_back(toNodes(q));
+            }
+        }
+    };
+    add(mKnownQuorums);
+    add(minQuorums);
+}
+
+QuorumIntersectionChecker::Hints
+QuorumIntersectionCheckerImpl::getHints() const
+{
+    return mHints;
+}
+
+void
+QuorumIntersectionCheckerImpl::setHints(Hints const& hints)
+{
+    mHints = hints;
+}
+
+bool
+QuorumIntersectionCheckerImpl::flatQuorumsIntersect(NodeBitSet const& q) const
+{
+    std::vector<size_t> nodes;
+    std::vector<NodeBitSet> inQ;
+    std::vector<uint32_t> thresholds;
+    for (size_t i = 0; q.nextSet(i); ++i)
+    {
+        if (!mGraph[i].mFlat)
+        {
+            return false;
+        }
+        nodes.emplace_back(i);
+        inQ.emplace_back(mGraph[i].mNodes & q);
+        thresholds.emplace_back(mGraph[i].mThreshold);
+    }
+    for (size_t a = 0; a < nodes.size(); ++a)
+    {
+        for (size_t b = a; b < nodes.size(); ++b)
+        {
+            if (uint64_t(thresholds[a]) + thresholds[b] <=
+                inQ[a].unionCount(inQ[b]))
+            {
+                CLOG(DEBUG, "SCP")
+                    << "Counting bound fails for " << nodeName(nodes[a])
+                    << " and " << nodeName(nodes[b]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool
+QuorumIntersectionCheckerImpl::anyMinQuorumHasDisjointQuorum(
+    SearchControl& control) const
+{
+    NodeBitSet committed;
+    NodeBitSet remaining = mMaxSCC;
+
+    if (mNumThreads == 1)
+    {
+        SearchContext ctx(control, gRandomEngine(), true);
+        MinQuorumEnumerator mqe(committed, remaining, *this, ctx);
+        bool found = mqe.anyMinQuorumHasDisjointQuorum();
+        mStats.merge(ctx.mStats);
+        if (found)
+        {
+            noteFoundDisjointQuorums(ctx.mFoundQuorum, ctx.mFoundDisjoint);
+        }
+        storeHints(ctx.mMinQuorums);
+        return found;
+    }
+
+    CLOG(DEBUG, "SCP") << "Scanning main SCC powerset with " << mNumThreads
+                       << " threads, split depth " << mSplitDepth;
+    ParallelMinQuorumSearch search(*this, control, mNumThreads, mSplitDepth);
+    bool found = search.run(committed, remaining);
+    bool noted = false;
+    std::vector<NodeBitSet> minQuorums;
+    for (auto const& ctx : search.getContexts())
+    {
+        mStats.merge(ctx.mStats);
+        minQuorums.insert(minQuorums.end(), ctx.mMinQuorums.begin(),
+                          ctx.mMinQuorums.end());
+        // Several workers may have found one before being cancelled
+        if (found && !noted && ctx.mFoundQuorum)
+        {
+            noteFoundDisjointQuorums(ctx.mFoundQuorum, ctx.mFoundDisjoint);
+            noted = true;
+        }
     }
-    return !foundDisjoint;
+    storeHints(minQuorums);
+    return found;
 }
 }
 
 namespace stellar
 {
 std::shared_ptr<QuorumIntersectionChecker>
-QuorumIntersectionChecker::create(QuorumTracker::QuorumMap const& qmap)
+QuorumIntersectionChecker::create(QuorumTracker::QuorumMap const& qmap,
+                                  size_t numThreads, size_t splitDepth)
 {
     // note: cast due to current unordered_set binding in Cpp.d
-    return std::make_shared<QuorumIntersectionCheckerImpl>(**(QuorumTracker::QuorumMap**)&qmap);
+    return std::make_shared<QuorumIntersectionCheckerImpl>(
+        **(QuorumTracker::QuorumMap**)&qmap, numThreads, splitDepth);
 }
 }
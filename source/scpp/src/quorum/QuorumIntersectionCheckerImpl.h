@@ -349,12 +349,119 @@
 //
 // Remaining details of the implementation are noted as we go, but the above
 // explanation ought to give you a good idea what you're looking at.
+//
+//
+// Coda 1: incremental updates
+// ===========================
+//
+// A checker can be given a new QuorumMap (see QuorumIntersectionChecker::
+// update). Nodes keep their bit numbers: new nodes get the next ones, and
+// nodes that lost their qset are kept as "dead" nodes that can't be satisfied,
+// which is equivalent to not having a bit. Only the QBitSets of the nodes
+// whose qset changed are rebuilt, unless a new node appeared, as the QBitSets
+// depending on it were built without it. The SCCs are only recalculated when
+// the successors of a node changed, and edge by edge when successors were
+// only added (see TarjanSCCCalculator::addEdge).
+//
+// Finally, if the network enjoyed quorum intersection and every change only
+// makes quorums scarcer -- nodes losing their qset, or qsets that are at
+// least as strict as before (same members, higher or equal thresholds) --
+// every quorum after the change was already a quorum before it, so the
+// network still enjoys quorum intersection and the search is skipped.
+//
+//
+// Coda 2: parallel search
+// =======================
+//
+// The two recursive calls of the enumerator explore disjoint parts of the
+// powerset and only share read-only state (the graph and the max SCC), so they
+// can run concurrently. When the checker is created with more than one thread,
+// the top `splitDepth` levels of the recursion don't recurse: they push their
+// two subproblems as tasks to a ParallelMinQuorumSearch, whose workers each
+// pop tasks from their own queue (most recent first, to stay depth-first) and
+// steal the oldest -- and so largest -- task of another worker when theirs is
+// empty. Below the split depth the search is the sequential one above.
+//
+// Everything a search mutates lives in a SearchContext, one per worker: the
+// Stats (merged once the search is done), the random engine used by
+// pickSplitNode and the counterexample found, if any. The first worker to find
+// a counterexample cancels the others, which check for it on every call.
+//
+// The contexts of a check share a SearchControl, which makes it possible to
+// interrupt it (see QuorumIntersectionChecker::checkQuorumIntersection): each
+// context polls it every few thousand calls, publishing its counters and
+// checking the interrupt flag and the deadline.
+//
+//
+// Coda 3: result cache
+// ====================
+//
+// Checkers are usually created for a quorum map identical to the one of the
+// previous check. The results of the last few complete checks are kept in a
+// process-wide cache, keyed by a canonical digest of the quorum map: the node
+// ID and the qset hash of every node with a qset, sorted. Digests are compared
+// in full, so there are no false hits, and a repeated check only costs hashing
+// the qsets.
+//
+//
+// Coda 4: counting pre-check
+// ==========================
+//
+// Every quorum of the main SCC is a subset of its maximal quorum Q. When all
+// the nodes of Q have flat qsets (threshold t over validators V), a quorum
+// containing node a holds at least t_a nodes of V_a ∩ Q. So if for every pair
+// of nodes a, b of Q (a = b included):
+//
+//      t_a + t_b > |(V_a ∪ V_b) ∩ Q|
+//
+// then the nodes that any quorum containing a and any quorum containing b
+// hold in (V_a ∪ V_b) ∩ Q can't be disjoint, and every pair of quorums
+// intersects. This is a sufficient condition checked in O(|Q|^2) bitset
+// operations before the powerset scan, which it skips when it holds: it
+// does for the usual qsets with high thresholds (e.g. 2/3 of a common set
+// of validators), not necessarily for nested or overlapping-but-skewed ones.
+//
+//
+// Coda 5: hints
+// =============
+//
+// A search can start from the Hints of a previous one (see
+// QuorumIntersectionChecker::setHints), which a checker also keeps for
+// itself across updates. The hints name nodes by ID, so they can come from
+// a checker of another quorum map. They are used in two ways:
+//
+//     1. Falsification: the potential split is contracted again, half by
+//        half, and if both halves still contain quorums -- which are
+//        disjoint, as the halves are -- the network is split. Same for the
+//        minimal quorums of the hints, with the complement in the main SCC
+//        for the other half.
+//
+//     2. Pruning: a quorum Q of the main SCC whose complement contains no
+//        quorum is "known". The minimal quorums a branch of the enumerator
+//        is responsible for contain its committed set: once that contains
+//        Q, the only one left is Q itself (if Q is minimal), which has no
+//        disjoint quorum. The branch is terminal (early exit 3.3), and
+//        neither the minimality of the committed quorum nor its complement
+//        are checked. Q doesn't need to be minimal for this.
+//
+// Neither can change the result: a split found is made of actual quorums,
+// and the branches pruned contain no minimal quorum with a disjoint quorum.
+// The minimal quorums found without a disjoint quorum by the search become
+// the hints of the next one, with the known quorums still valid.
 
 #include "QuorumIntersectionChecker.h"
 #include "crypto/StrKey.h"
-#include "util/BitSet.h"
+#include "scp/NodeIndex.h"
+#include "util/HashOfHash.h"
+#include "util/SmallBitSet.h"
 #include "xdr/Stellar-SCP.h"
 #include "xdr/Stellar-types.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
 
 namespace
 {
@@ -366,25 +473,39 @@ toShortString(T const& key)
     return stellar::KeyUtils::toStrKey(key).substr(0, 5);
 }
 
+// Sets of up to 512 nodes are stored inline (see util/SmallBitSet.h), so
+// the copies done at every step of the search don't allocate.
+using NodeBitSet = SmallBitSet<8>;
+
 struct QBitSet;
 using QGraph = std::vector<QBitSet>;
 class QuorumIntersectionCheckerImpl;
+struct SearchControl;
+struct SearchContext;
+class ParallelMinQuorumSearch;
 
 // A QBitSet is the "fast" representation of a SCPQuorumSet. It includes both a
-// BitSet of its own nodes and a set of innerSets, along with a "successors"
-// BitSet that contains the union of all the bits set in the own nodes or
+// NodeBitSet of its own nodes and a set of innerSets, along with a "successors"
+// NodeBitSet that contains the union of all the bits set in the own nodes or
 // innerSets, for fast successor-testing.
 struct QBitSet
 {
     const uint32_t mThreshold;
-    const BitSet mNodes;
+    const NodeBitSet mNodes;
     const QGraph mInnerSets;
 
     // Union of mNodes and i.mAllSuccessors for i in mInnerSets: summarizes
     // every node that this QBitSet directly depends on.
-    const BitSet mAllSuccessors;
+    const NodeBitSet mAllSuccessors;
+
+    // Shape of the qset, for the fast paths of containsQuorumSlice: flat
+    // if it has no innerSets, two-level if all its innerSets are flat.
+    const bool mFlat;
+    const bool mTwoLevel;
 
-    QBitSet(uint32_t threshold, BitSet const& nodes, QGraph const& innerSets);
+    QBitSet(uint32_t threshold, NodeBitSet const& nodes, QGraph const& innerSets);
+
+    bool operator==(QBitSet const& other) const;
 
     bool
     empty() const
@@ -394,10 +515,11 @@ struct QBitSet
 
     void log(size_t indent = 0) const;
 
-    static BitSet getSuccessors(BitSet const& nodes, QGraph const& inner);
+    static NodeBitSet getSuccessors(NodeBitSet const& nodes, QGraph const& inner);
 };
 
-// Implementation of Tarjan's algorithm for SCC calculation.
+// Implementation of Tarjan's algorithm for SCC calculation, with an explicit
+// stack and buffers reused across calculations.
 struct TarjanSCCCalculator
 {
     struct SCCNode
@@ -407,15 +529,41 @@ struct TarjanSCCCalculator
         bool mOnStack = {false};
     };
 
+    // A call of the recursive formulation: the node visited and the next of
+    // its successors to look at.
+    struct Frame
+    {
+        size_t mNode;
+        size_t mNextSuccessor;
+    };
+
     std::vector<SCCNode> mNodes;
     std::vector<size_t> mStack;
+    std::vector<Frame> mCallStack;
     int mIndex = {0};
-    std::vector<BitSet> mSCCs;
+
+    // The SCC of every node. SCCs are numbered in reverse topological order:
+    // if there is a path from SCC x to SCC y != x, then x > y.
+    std::vector<size_t> mComponents;
+    size_t mNumComponents = {0};
+    // Nodes of every SCC, by SCC number.
+    std::vector<NodeBitSet> mSCCs;
     QGraph const& mGraph;
 
     TarjanSCCCalculator(QGraph const& graph);
     void calculateSCCs();
+
+    // Updates the SCCs after the edge from -> to was added to mGraph, only
+    // recalculating the SCCs numbered between the ones of `from` and `to`.
+    // Returns true if SCCs were merged.
+    bool addEdge(size_t from, size_t to);
+
+  private:
+    // Visits every node reachable from i that isn't visited yet, numbering
+    // the SCCs found from mNumComponents.
     void scc(size_t i);
+    void visit(size_t i);
+    void collectSCCs();
 };
 
 // A MinQuorumEnumerator is responsible to scanning the powerset of the SCC
@@ -431,21 +579,31 @@ class MinQuorumEnumerator
     // include in every subset S of the powerset that they examine. This set
     // will remain the same (omitting the split node) in one child, and expand
     // (including the split node) in the other child.
-    BitSet mCommitted;
+    NodeBitSet mCommitted;
 
     // Set of nodes that remain to be powerset-expanded in the recurrence. In
     // other words: the part of the powerset that this enumerator and its
     // children are responsible for is { committed ∪ r | r ∈ P(remaining) }.
     // This set will strictly decrease (by the split node) in both children.
-    BitSet mRemaining;
+    NodeBitSet mRemaining;
 
     // The set (committed ∪ remaining) which is a bound on the set of nodes in
     // any set enumerated by this enumerator and its children.
-    BitSet mPerimeter;
+    NodeBitSet mPerimeter;
 
-    // Checker that owns us, contains state of stats, graph, etc.
+    // Checker that owns us, contains state of graph, etc.
     QuorumIntersectionCheckerImpl const& mQic;
 
+    // State of the (possibly per-thread) search we're part of: stats, etc.
+    SearchContext& mCtx;
+
+    // Parallel search to hand our subproblems to while above its split
+    // depth, or nullptr for a sequential search.
+    ParallelMinQuorumSearch* mSearch;
+
+    // Depth of this call in the recursion.
+    size_t mDepth;
+
     // Select the next node in mRemaining to split recursive cases between.
     size_t pickSplitNode() const;
 
@@ -453,8 +611,11 @@ class MinQuorumEnumerator
     size_t maxCommit() const;
 
   public:
-    MinQuorumEnumerator(BitSet const& committed, BitSet const& remaining,
-                        QuorumIntersectionCheckerImpl const& qic);
+    MinQuorumEnumerator(NodeBitSet const& committed, NodeBitSet const& remaining,
+                        QuorumIntersectionCheckerImpl const& qic,
+                        SearchContext& ctx,
+                        ParallelMinQuorumSearch* search = nullptr,
+                        size_t depth = 0);
 
     bool anyMinQuorumHasDisjointQuorum();
 };
@@ -481,7 +642,10 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
         size_t mEarlyExit22s = {0};
         size_t mEarlyExit31s = {0};
         size_t mEarlyExit32s = {0};
+        size_t mEarlyExit33s = {0};
         void log() const;
+        // adds the counters of a search (but not the graph sizes)
+        void merge(Stats const& other);
     };
 
     // We use our own stats and a local cached flag to control tracing because
@@ -490,6 +654,11 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
     mutable Stats mStats;
     bool mLogTrace;
 
+    // Number of threads scanning the main SCC powerset, and the recursion
+    // depth up to which the parallel search splits it into tasks.
+    size_t const mNumThreads;
+    size_t const mSplitDepth;
+
     // State to capture a counterexample found during search, for later
     // reporting.
     mutable std::pair<std::vector<stellar::PublicKey>,
@@ -498,37 +667,236 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
 
     // These are the key state of the checker: the mapping from node public keys
     // to graph node numbers, and the graph of QBitSets itself.
-    std::vector<stellar::PublicKey> mBitNumPubKeys;
-    std::unordered_map<stellar::PublicKey, size_t> mPubKeyBitNums;
+    // Only nodes with a qset are numbered, so the checker has its own index
+    // rather than the one of SCP.
+    stellar::NodeIndex mNodeIndex;
     QGraph mGraph;
 
+    // the qset each node of mGraph was built from, nullptr for dead nodes
+    // (see "Coda 1" above)
+    std::vector<stellar::SCPQuorumSetPtr> mQSets;
+
+    // For every node of mGraph, the lowest node with an identical QBitSet:
+    // nodes sharing a qset (commonly all of them) only need it to be
+    // evaluated once per round of contractToMaximalQuorum.
+    std::vector<size_t> mQSetClasses;
+
+    // Result of the last complete check, valid until an update that may
+    // change it.
+    mutable bool mResultValid{false};
+    mutable IntersectionResult mLastResult{INTERSECTION_ENJOYED};
+
+    // Canonical digest of the current quorum map, see "Coda 3".
+    std::vector<uint8_t> mDigest;
+
+    // Hints for the next search, and the quorums of the hints that prune
+    // the current one, see "Coda 5".
+    mutable Hints mHints;
+    mutable std::vector<NodeBitSet> mKnownQuorums;
+
     // This just calculates SCCs and stores the maximal one, which we use for
     // the remainder of the search.
     TarjanSCCCalculator mTSC;
-    BitSet mMaxSCC;
+    NodeBitSet mMaxSCC;
 
     QBitSet convertSCPQuorumSet(stellar::SCPQuorumSet const& sqs);
+    // the QBitSet of a node given its qset, nullptr for a dead node
+    QBitSet convertNode(stellar::SCPQuorumSetPtr const& qset);
     void buildGraph(stellar::QuorumTracker::QuorumMap const& qmap);
     void buildSCCs();
-
-    bool containsQuorumSlice(BitSet const& bs, QBitSet const& qbs) const;
-    bool containsQuorumSliceForNode(BitSet const& bs, size_t node) const;
-    BitSet contractToMaximalQuorum(BitSet nodes) const;
-    bool isAQuorum(BitSet const& nodes) const;
-    bool isMinimalQuorum(BitSet const& nodes) const;
-    bool hasDisjointQuorum(BitSet const& nodes) const;
-    void noteFoundDisjointQuorums(BitSet const& nodes,
-                                  BitSet const& disj) const;
+    // sets mMaxSCC and the stats from the SCCs of mTSC
+    void findMaxSCC();
+    void buildQSetClasses();
+    void buildDigest(stellar::QuorumTracker::QuorumMap const& qmap);
+
+    // looks up / records mDigest in the result cache; a hit restores the
+    // result, the potential split and the number of quorums found
+    bool loadCachedResult() const;
+    void storeCachedResult() const;
+
+    // The functions below only touch the Stats they are passed, so that they
+    // can be called by concurrent searches.
+    bool containsQuorumSlice(NodeBitSet const& bs, QBitSet const& qbs) const;
+    NodeBitSet contractToMaximalQuorum(NodeBitSet nodes, Stats& stats) const;
+    bool isAQuorum(NodeBitSet const& nodes, Stats& stats) const;
+    bool isMinimalQuorum(NodeBitSet const& nodes, Stats& stats) const;
+    // records the disjoint quorum found (if any) in ctx
+    bool hasDisjointQuorum(NodeBitSet const& nodes, SearchContext& ctx) const;
+    void noteFoundDisjointQuorums(NodeBitSet const& nodes,
+                                  NodeBitSet const& disj) const;
     std::string nodeName(size_t node) const;
 
+    // checkQuorumIntersection, without looking at the last result
+    IntersectionResult
+    searchQuorumIntersection(std::atomic<bool> const* interruptFlag,
+                             std::chrono::steady_clock::time_point deadline,
+                             ProgressCallback const& progress) const;
+
+    // Scans the main SCC powerset, either sequentially or with a
+    // ParallelMinQuorumSearch depending on mNumThreads.
+    bool anyMinQuorumHasDisjointQuorum(SearchControl& control) const;
+
+    // true if the counting bound proves that all the quorums contained in
+    // the maximal quorum `q` intersect, see "Coda 4" above
+    bool flatQuorumsIntersect(NodeBitSet const& q) const;
+
+    // Tests the hints and sets mKnownQuorums, returns true (after noting
+    // it) if they still hold a potential split, see "Coda 5".
+    bool applyHints() const;
+    // true if `quorum` contains one of mKnownQuorums
+    bool extendsKnownQuorum(NodeBitSet const& quorum) const;
+    // Replaces mHints by the result of the search: the potential split, the
+    // known quorums and the minimal quorums found.
+    void storeHints(std::vector<NodeBitSet> const& minQuorums) const;
+    NodeBitSet toNodeBitSet(std::vector<stellar::PublicKey> const& nodes) const;
+    std::vector<stellar::PublicKey> toNodes(NodeBitSet const& nodes) const;
+
     friend class MinQuorumEnumerator;
+    friend struct SearchContext;
+    friend class ParallelMinQuorumSearch;
 
   public:
-    QuorumIntersectionCheckerImpl(stellar::QuorumTracker::QuorumMap const& qmap);
+    // numThreads: 0 uses one thread per hardware thread
+    QuorumIntersectionCheckerImpl(stellar::QuorumTracker::QuorumMap const& qmap,
+                                  size_t numThreads = 1,
+                                  size_t splitDepth = 8);
     bool networkEnjoysQuorumIntersection() const override;
+    IntersectionResult checkQuorumIntersection(
+        std::atomic<bool> const* interruptFlag,
+        std::chrono::steady_clock::time_point deadline,
+        ProgressCallback const& progress) const override;
 
     std::pair<std::vector<stellar::PublicKey>, std::vector<stellar::PublicKey>>
     getPotentialSplit() const override;
     size_t getMaxQuorumsFound() const override;
+    void update(stellar::QuorumTracker::QuorumMap const& qmap) override;
+    Hints getHints() const override;
+    void setHints(Hints const& hints) override;
+};
+
+// State shared by all the contexts of a check, see "Coda 2" above.
+struct SearchControl
+{
+    // When to abort the check
+    std::atomic<bool> const* const mInterruptFlag;
+    std::chrono::steady_clock::time_point const mDeadline;
+    stellar::QuorumIntersectionChecker::ProgressCallback const& mProgress;
+
+    // Set when the check is interrupted or, in a parallel search, when a
+    // counterexample is found: every call returns immediately.
+    std::atomic<bool> mStop{false};
+    std::atomic<bool> mAborted{false};
+
+    // Sums of the counters published by the contexts.
+    std::atomic<size_t> mCallsStarted{0};
+    std::atomic<size_t> mMaxQuorumsSeen{0};
+    std::atomic<size_t> mMinQuorumsSeen{0};
+
+    SearchControl(
+        std::atomic<bool> const* interruptFlag,
+        std::chrono::steady_clock::time_point deadline,
+        stellar::QuorumIntersectionChecker::ProgressCallback const& progress);
+
+    bool
+    stopped() const
+    {
+        return mStop.load(std::memory_order_relaxed);
+    }
+};
+
+// Everything mutated by one (sequential or per-thread) powerset search.
+struct SearchContext
+{
+    QuorumIntersectionCheckerImpl::Stats mStats;
+
+    SearchControl& mControl;
+    // counters last published to mControl
+    size_t mPublishedCalls{0};
+    size_t mPublishedMaxQuorums{0};
+    size_t mPublishedMinQuorums{0};
+
+    // Used by pickSplitNode, seeded from the gRandomEngine of the thread that
+    // creates the context rather than of the one that runs the search.
+    std::default_random_engine mRandom;
+
+    // Whether the progress meter and callback are emitted, which only the
+    // thread that started the check does.
+    bool mLogProgress;
+
+    // Set by hasDisjointQuorum when it finds a counterexample: the
+    // min-quorum and the quorum in its complement.
+    NodeBitSet mFoundQuorum;
+    NodeBitSet mFoundDisjoint;
+
+    // Some of the minimal quorums found without a disjoint quorum, for the
+    // hints of the next search.
+    std::vector<NodeBitSet> mMinQuorums;
+
+    SearchContext(SearchControl& control,
+                  std::default_random_engine::result_type seed,
+                  bool logProgress);
+
+    // Called every few thousand calls: publishes the counters, reports
+    // progress and stops the search if it was interrupted.
+    void poll();
+};
+
+// Runs the top MinQuorumEnumerator on a few threads, see "Coda 2" above.
+// Tasks are (committed, remaining) pairs: workers push the subproblems of the
+// calls above the split depth to their own queue, run their most recent task,
+// and steal the oldest task of another worker when their own queue is empty.
+class ParallelMinQuorumSearch
+{
+    struct Task
+    {
+        NodeBitSet mCommitted;
+        NodeBitSet mRemaining;
+        size_t mDepth;
+    };
+
+    QuorumIntersectionCheckerImpl const& mQic;
+    size_t const mSplitDepth;
+
+    // One context and one queue per worker, the queues (and mActive) being
+    // guarded by mMutex.
+    std::vector<SearchContext> mContexts;
+    std::vector<std::deque<Task>> mQueues;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    // number of tasks being run, which may push more tasks
+    size_t mActive{0};
+
+    SearchControl& mControl;
+
+    // Set once a counterexample is found, which also stops mControl.
+    std::atomic<bool> mFound{false};
+
+    bool popTask(size_t worker, Task& task);
+    void work(size_t worker);
+
+  public:
+    ParallelMinQuorumSearch(QuorumIntersectionCheckerImpl const& qic,
+                            SearchControl& control, size_t numThreads,
+                            size_t splitDepth);
+
+    // true if a call at this depth should push its subproblems as tasks
+    bool
+    shouldSplit(size_t depth) const
+    {
+        return depth < mSplitDepth;
+    }
+
+    void push(SearchContext const& ctx, NodeBitSet const& committed,
+              NodeBitSet const& remaining, size_t depth);
+
+    // Runs the search, returning true if one of the workers found a
+    // counterexample.
+    bool run(NodeBitSet const& committed, NodeBitSet const& remaining);
+
+    std::vector<SearchContext> const&
+    getContexts() const
+    {
+        return mContexts;
+    }
 };
 }
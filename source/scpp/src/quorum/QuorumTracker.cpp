@@ -4,6 +4,7 @@
 
 #include "quorum/QuorumTracker.h"
 #include "scp/LocalNode.h"
+#include <algorithm>
 
 namespace stellar
 {
@@ -74,4 +75,135 @@ QuorumTracker::getQuorum() const
 {
     return mQuorum;
 }
+
+InternedQuorumTracker::InternedQuorumTracker(SCP& scp,
+                                             std::shared_ptr<NodeIndex> index)
+    : mSCP(scp), mIndex(index ? index : scp.getNodeIndex())
+{
+    if (!mIndex)
+    {
+        mIndex = std::make_shared<NodeIndex>();
+    }
+}
+
+InternedQuorumTracker::Entry&
+InternedQuorumTracker::getEntry(size_t index)
+{
+    if (index >= mEntries.size())
+    {
+        mEntries.resize(std::max(index + 1, mIndex->size()));
+    }
+    return mEntries[index];
+}
+
+void
+InternedQuorumTracker::insert(size_t index)
+{
+    auto& entry = getEntry(index);
+    if (entry.mGeneration != mGeneration)
+    {
+        entry.mGeneration = mGeneration;
+        entry.mQSet = nullptr;
+    }
+}
+
+void
+InternedQuorumTracker::setQuorumSet(size_t index, SCPQuorumSetPtr qSet)
+{
+    auto& entry = getEntry(index);
+    entry.mQSet = qSet;
+    if (entry.mDependenciesQSet != qSet)
+    {
+        entry.mDependencies.clear();
+        LocalNode::forAllNodes(*qSet, [&](NodeID const& id) {
+            entry.mDependencies.emplace_back(mIndex->intern(id));
+        });
+        entry.mDependenciesQSet = qSet;
+    }
+    // entries of the dependencies, so that inserting them doesn't
+    // invalidate `entry`
+    if (mEntries.size() < mIndex->size())
+    {
+        mEntries.resize(mIndex->size());
+    }
+}
+
+bool
+InternedQuorumTracker::isNodeDefinitelyInQuorum(NodeID const& id) const
+{
+    size_t index = mIndex->find(id);
+    return index != NodeIndex::npos && isNodeDefinitelyInQuorum(index);
+}
+
+bool
+InternedQuorumTracker::expand(size_t index, SCPQuorumSetPtr qSet)
+{
+    bool res = false;
+    if (isNodeDefinitelyInQuorum(index))
+    {
+        auto const& current = mEntries[index].mQSet;
+        if (current == nullptr)
+        {
+            setQuorumSet(index, qSet);
+            for (auto dep : mEntries[index].mDependencies)
+            {
+                // inserts an edge node if needed
+                insert(dep);
+            }
+            res = true;
+        }
+        else if (current == qSet)
+        {
+            // nop
+            res = true;
+        }
+    }
+    return res;
+}
+
+bool
+InternedQuorumTracker::expand(NodeID const& id, SCPQuorumSetPtr qSet)
+{
+    size_t index = mIndex->find(id);
+    return index != NodeIndex::npos && expand(index, qSet);
+}
+
+SCPQuorumSetPtr const&
+InternedQuorumTracker::getQuorumSet(size_t index) const
+{
+    static SCPQuorumSetPtr const none;
+    return isNodeDefinitelyInQuorum(index) ? mEntries[index].mQSet : none;
+}
+
+std::vector<size_t> const&
+InternedQuorumTracker::getDependencies(size_t index) const
+{
+    static std::vector<size_t> const none;
+    return isNodeDefinitelyInQuorum(index) && mEntries[index].mQSet
+               ? mEntries[index].mDependencies
+               : none;
+}
+
+size_t
+InternedQuorumTracker::size() const
+{
+    return std::count_if(mEntries.begin(), mEntries.end(),
+                         [&](Entry const& entry) {
+                             return entry.mGeneration == mGeneration;
+                         });
+}
+
+QuorumTracker::QuorumMap
+InternedQuorumTracker::getQuorum() const
+{
+    QuorumTracker::QuorumMap res;
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        if (isNodeDefinitelyInQuorum(i))
+        {
+            res.emplace(mIndex->getNodeID(i), mEntries[i].mQSet);
+        }
+    }
+    return res;
+}
 }
@@ -4,9 +4,12 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "scp/CompiledQuorumSet.h"
 #include "scp/SCP.h"
+#include "util/HashOfHash.h"
 #include "util/NonCopyable.h"
 #include <unordered_map>
+#include <vector>
 
 namespace stellar
 {
@@ -21,7 +24,10 @@ namespace stellar
 class QuorumTracker : public NonMovableOrCopyable
 {
   public:
-    using QuorumMap = std::unordered_map<NodeID, SCPQuorumSetPtr>;
+    // the nodes are the ones of the transitive quorum of the local node,
+    // which are known validators
+    using QuorumMap =
+        std::unordered_map<NodeID, SCPQuorumSetPtr, UniformHash<NodeID>>;
 
   private:
     SCP& mSCP;
@@ -49,4 +55,107 @@ class QuorumTracker : public NonMovableOrCopyable
     // returns the current known quorum
     QuorumMap const& getQuorum() const;
 };
+
+// Same as QuorumTracker, but nodes are tracked by their index in a NodeIndex
+// (by default the one of the SCP instance, shared with the compiled quorum
+// sets) instead of a map keyed by NodeID.
+// Every node keeps a flat list of the nodes its quorum set depends on, which
+// is reused as long as the quorum set doesn't change, and entries are stamped
+// with the generation of the last `rebuild` that reached them: a rebuild
+// doesn't clear (nor reallocate) anything, and membership tests by index
+// don't hash node IDs.
+class InternedQuorumTracker : public NonMovableOrCopyable
+{
+    struct Entry
+    {
+        // entry is part of the quorum if mGeneration is the tracker's
+        uint64 mGeneration{0};
+        SCPQuorumSetPtr mQSet;
+        // the quorum set mDependencies were computed for
+        SCPQuorumSetPtr mDependenciesQSet;
+        std::vector<size_t> mDependencies;
+    };
+
+    SCP& mSCP;
+    std::shared_ptr<NodeIndex> mIndex;
+    std::vector<Entry> mEntries;
+    uint64 mGeneration{1};
+    // scratch space of rebuild
+    std::vector<size_t> mBacklog;
+
+    // the entry of a node, created if needed
+    Entry& getEntry(size_t index);
+    // makes a node part of the quorum, without a quorum set if it wasn't
+    void insert(size_t index);
+    // sets the quorum set of a node of the quorum, updating its dependencies
+    // (but not inserting them)
+    void setQuorumSet(size_t index, SCPQuorumSetPtr qSet);
+
+  public:
+    InternedQuorumTracker(SCP& scp, std::shared_ptr<NodeIndex> index = nullptr);
+
+    NodeIndex const&
+    getNodeIndex() const
+    {
+        return *mIndex;
+    }
+
+    // returns true if the node is in transitive quorum for sure
+    bool
+    isNodeDefinitelyInQuorum(size_t index) const
+    {
+        return index < mEntries.size() &&
+               mEntries[index].mGeneration == mGeneration;
+    }
+    bool isNodeDefinitelyInQuorum(NodeID const& id) const;
+
+    // see QuorumTracker::expand
+    bool expand(size_t index, SCPQuorumSetPtr qSet);
+    bool expand(NodeID const& id, SCPQuorumSetPtr qSet);
+
+    // rebuild the transitive quorum given a lookup function, any callable
+    // taking a NodeID const& and returning a SCPQuorumSetPtr
+    template <typename Lookup>
+    void
+    rebuild(Lookup const& lookup)
+    {
+        ++mGeneration;
+        mBacklog.clear();
+        size_t local = mIndex->intern(mSCP.getLocalNodeID());
+        insert(local);
+        mBacklog.emplace_back(local);
+        while (!mBacklog.empty())
+        {
+            size_t n = mBacklog.back();
+            mBacklog.pop_back();
+            auto qSet = lookup(mIndex->getNodeID(n));
+            if (qSet == nullptr)
+            {
+                continue;
+            }
+            setQuorumSet(n, qSet);
+            for (auto dep : mEntries[n].mDependencies)
+            {
+                if (!isNodeDefinitelyInQuorum(dep))
+                {
+                    insert(dep);
+                    mBacklog.emplace_back(dep);
+                }
+            }
+        }
+    }
+
+    // quorum set of a node of the quorum, nullptr if it isn't known
+    SCPQuorumSetPtr const& getQuorumSet(size_t index) const;
+
+    // nodes the quorum set of a node of the quorum depends on
+    std::vector<size_t> const& getDependencies(size_t index) const;
+
+    // number of nodes in the quorum
+    size_t size() const;
+
+    // returns the current known quorum, in the form used by
+    // QuorumIntersectionChecker
+    QuorumTracker::QuorumMap getQuorum() const;
+};
 }
@@ -8,13 +8,16 @@
 #include "crypto/Hex.h"
 #include "crypto/Hash.h"
 #include "lib/json/json.h"
+#include "scp/CompiledQuorumSet.h"
 #include "scp/LocalNode.h"
-#include "scp/QuorumSetUtils.h"
 #include "util/GlobalChecks.h"
 #include "util/Logging.h"
+#include "util/Tracy.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 
 namespace stellar
 {
@@ -26,11 +29,30 @@ static const int MAX_ADVANCE_SLOT_RECURSION = 50;
 BallotProtocol::BallotProtocol(Slot& slot)
     : mSlot(slot)
     , mHeardFromQuorum(false)
+    , mHeardTracked(false)
+    , mHeardChanged(false)
+    , mHeardQuorum(false)
+    , mHeardCounter(0)
+    , mLatestEnvelopes(slot.getSCP().getNodeIndex())
     , mPhase(SCP_PHASE_PREPARE)
     , mCurrentMessageLevel(0)
 {
 }
 
+template <typename Voted, typename Accepted>
+bool
+BallotProtocol::federatedAccept(Voted const& voted, Accepted const& accepted)
+{
+    return mSlot.federatedAccept(voted, accepted, mLatestEnvelopes);
+}
+
+template <typename Voted>
+bool
+BallotProtocol::federatedRatify(Voted const& voted)
+{
+    return mSlot.federatedRatify(voted, mLatestEnvelopes);
+}
+
 bool
 BallotProtocol::isNewerStatement(NodeID const& nodeID, SCPStatement const& st)
 {
@@ -133,21 +155,179 @@ BallotProtocol::isNewerStatement(SCPStatement const& oldst,
 void
 BallotProtocol::recordEnvelope(SCPEnvelope const& env)
 {
-    auto const& st = env.statement;
-    auto oldp = mLatestEnvelopes.find(st.nodeID);
-    if (oldp == mLatestEnvelopes.end())
+    auto oldp = mLatestEnvelopes.find(env.statement.nodeID);
+    bool qSetChanged = false;
+    if (oldp != mLatestEnvelopes.end())
+    {
+        auto const& oldst = oldp->second.statement;
+        indexStatement(oldst, -1);
+        // EXTERNALIZE statements use a singleton quorum set
+        qSetChanged =
+            oldst.pledges.type() != env.statement.pledges.type() ||
+            getCompanionQuorumSetHashFromStatement(oldst) !=
+                getCompanionQuorumSetHashFromStatement(env.statement);
+    }
+    size_t i = mLatestEnvelopes.assign(env.statement.nodeID, env);
+    mClosestVBlocking.clear();
+    mSummaries.assign(i, env.statement, mSlot.getValueTable());
+    mSlot.getSCP().recordLatestMessage(i, mSlot.getSlotIndex());
+    indexStatement(env.statement, 1);
+    mSlot.recordStatement(env.statement);
+
+    if (mHeardTracked && mSummaries.isAtCounter(i, mHeardCounter))
     {
-        mLatestEnvelopes.insert(std::make_pair(st.nodeID, env));
+        if (!mHeardNodes.get(i))
+        {
+            mHeardNodes.set(i);
+            mHeardChanged = true;
+        }
+        else if (qSetChanged)
+        {
+            // the node may not be in the quorum anymore
+            mHeardTracked = false;
+        }
     }
-    else
+}
+
+BallotProtocol::ValueStatements::ValueStatements(Arena& arena)
+    : mPrepareCounters(ArenaAllocator<CounterMap::value_type>(arena))
+    , mConfirmPrepared(ArenaAllocator<CounterMap::value_type>(arena))
+    , mBoundaries(ArenaAllocator<CounterMap::value_type>(arena))
+{
+    // growing mLatestByValue must not copy the maps, which would leave the
+    // nodes of the old ones in the arena
+    static_assert(std::is_nothrow_move_constructible<ValueStatements>::value,
+                  "ValueStatements must be nothrow movable");
+}
+
+// adds delta to the reference count of key, dropping it when it reaches 0
+template <typename Counts>
+static void
+updateCount(Counts& counts, uint32 key, int delta)
+{
+    auto it = counts.emplace(key, 0).first;
+    it->second += delta;
+    if (it->second == 0)
     {
-        oldp->second = env;
+        counts.erase(it);
     }
-    mSlot.recordStatement(env.statement);
+}
+
+void
+BallotProtocol::indexStatement(SCPStatement const& st, int delta)
+{
+    // note: the reference returned is invalidated by the next call
+    auto entry = [&](Value const& v) -> ValueStatements& {
+        auto h = mSlot.getValueTable().intern(v);
+        while (h >= mLatestByValue.size())
+        {
+            mLatestByValue.emplace_back(mSlot.getArena());
+        }
+        return mLatestByValue[h];
+    };
+
+    auto const& pl = st.pledges;
+    switch (pl.type())
+    {
+    case SCP_ST_PREPARE:
+    {
+        auto const& p = pl.prepare();
+        auto& vs = entry(p.ballot.value);
+        updateCount(vs.mPrepareCounters, p.ballot.counter, delta);
+        if (p.nC)
+        {
+            updateCount(vs.mBoundaries, p.nC, delta);
+            updateCount(vs.mBoundaries, p.nH, delta);
+        }
+        if (p.prepared)
+        {
+            updateCount(entry(p.prepared->value).mPrepareCounters,
+                        p.prepared->counter, delta);
+        }
+        if (p.preparedPrime)
+        {
+            updateCount(entry(p.preparedPrime->value).mPrepareCounters,
+                        p.preparedPrime->counter, delta);
+        }
+    }
+    break;
+    case SCP_ST_CONFIRM:
+    {
+        auto const& c = pl.confirm();
+        auto& vs = entry(c.ballot.value);
+        updateCount(vs.mConfirmPrepared, c.nPrepared, delta);
+        vs.mCommitStatements += delta;
+        updateCount(vs.mBoundaries, c.nCommit, delta);
+        updateCount(vs.mBoundaries, c.nH, delta);
+    }
+    break;
+    case SCP_ST_EXTERNALIZE:
+    {
+        auto const& e = pl.externalize();
+        auto& vs = entry(e.commit.value);
+        vs.mCommitStatements += delta;
+        updateCount(vs.mBoundaries, e.commit.counter, delta);
+        updateCount(vs.mBoundaries, e.nH, delta);
+        updateCount(vs.mBoundaries, UINT32_MAX, delta);
+    }
+    break;
+    default:
+        dbgAbort();
+    }
+}
+
+BallotProtocol::ValueStatements const*
+BallotProtocol::findValueStatements(Value const& v) const
+{
+    auto h = mSlot.getValueTable().find(v);
+    if (h == ValueTable::npos || h >= mLatestByValue.size())
+    {
+        return nullptr;
+    }
+    return &mLatestByValue[h];
 }
 
 SCP::EnvelopeState
 BallotProtocol::processEnvelope(SCPEnvelope const& envelope, bool self)
+{
+    bool advance = false;
+    auto res = checkAndRecordEnvelope(envelope, self, advance);
+    if (advance)
+    {
+        advanceSlot(envelope.statement);
+    }
+    return res;
+}
+
+size_t
+BallotProtocol::processEnvelopes(
+    std::vector<SCPEnvelope const*> const& envelopes)
+{
+    size_t res = 0;
+    std::vector<SCPStatement const*> hints;
+    for (auto e : envelopes)
+    {
+        bool advance = false;
+        if (checkAndRecordEnvelope(*e, false, advance) ==
+            SCP::EnvelopeState::VALID)
+        {
+            res++;
+        }
+        if (advance)
+        {
+            hints.emplace_back(&e->statement);
+        }
+    }
+    if (!hints.empty())
+    {
+        advanceSlot(hints);
+    }
+    return res;
+}
+
+SCP::EnvelopeState
+BallotProtocol::checkAndRecordEnvelope(SCPEnvelope const& envelope, bool self,
+                                       bool& advance)
 {
     SCP::EnvelopeState res = SCP::EnvelopeState::INVALID;
     dbgAssert(envelope.statement.slotIndex == mSlot.getSlotIndex());
@@ -182,7 +362,26 @@ BallotProtocol::processEnvelope(SCPEnvelope const& envelope, bool self)
         return SCP::EnvelopeState::INVALID;
     }
 
+    if (!self && mSlot.isBallotProtocolHeld())
+    {
+        // processed again once the previous slot is applied
+        mSlot.deferEnvelope(envelope);
+        return SCP::EnvelopeState::VALID;
+    }
+
     auto validationRes = validateValues(statement);
+    if (validationRes == SCPDriver::kPendingValue)
+    {
+        if (!self)
+        {
+            // processed again once its values are validated
+            mSlot.deferEnvelope(envelope);
+            return SCP::EnvelopeState::VALID;
+        }
+        // the statements of the local node can't wait
+        validationRes = SCPDriver::kMaybeValidValue;
+    }
+
     if (validationRes != SCPDriver::kInvalidValue)
     {
         bool processed = false;
@@ -196,7 +395,7 @@ BallotProtocol::processEnvelope(SCPEnvelope const& envelope, bool self)
 
             recordEnvelope(envelope);
             processed = true;
-            advanceSlot(statement);
+            advance = true;
             res = SCP::EnvelopeState::VALID;
         }
 
@@ -246,9 +445,8 @@ BallotProtocol::processEnvelope(SCPEnvelope const& envelope, bool self)
 bool
 BallotProtocol::isStatementSane(SCPStatement const& st, bool self)
 {
-    auto qSet = mSlot.getQuorumSetFromStatement(st);
     const char* reason = nullptr;
-    bool res = qSet != nullptr && isQuorumSetSane(*qSet, false, &reason);
+    bool res = mSlot.isQuorumSetFromStatementSane(st, &reason);
     if (!res)
     {
         CLOG(DEBUG, "SCP") << "Invalid quorum set received";
@@ -482,6 +680,8 @@ BallotProtocol::bumpToBallot(SCPBallot const& ballot, bool check)
 
     if (!mCurrentBallot)
     {
+        mSlot.recordLatency(SCPLatency::BALLOT_STARTED);
+        ZoneScopedN("SCPDriver::startedBallotProtocol");
         mSlot.getSCPDriver().startedBallotProtocol(mSlot.getSlotIndex(),
                                                    ballot);
     }
@@ -503,30 +703,33 @@ BallotProtocol::bumpToBallot(SCPBallot const& ballot, bool check)
 void
 BallotProtocol::startBallotProtocolTimer()
 {
-    std::chrono::milliseconds timeout =
-        mSlot.getSCPDriver().computeTimeout(mCurrentBallot->counter);
+    std::chrono::milliseconds timeout;
+    {
+        ZoneScopedN("SCPDriver::computeTimeout");
+        timeout = mSlot.getSCPDriver().computeTimeout(mCurrentBallot->counter);
+    }
 
     std::shared_ptr<Slot> slot = mSlot.shared_from_this();
 
-    std::function<void()>* func = new std::function<void()>;
-    *func = [slot]() { slot->getBallotProtocol().ballotProtocolTimerExpired(); };
-
-    mSlot.getSCPDriver().setupTimer(
-        mSlot.getSlotIndex(), Slot::BALLOT_PROTOCOL_TIMER, timeout, func);
+    mSlot.trace(SCPTraceEvent::TIMER_ARMED, Slot::BALLOT_PROTOCOL_TIMER,
+                static_cast<uint32>(timeout.count()));
+    mSlot.getSCP().getTimers().arm(
+        mSlot.getSlotIndex(), Slot::BALLOT_PROTOCOL_TIMER, timeout,
+        [slot]() { slot->getBallotProtocol().ballotProtocolTimerExpired(); });
 }
 
 void
 BallotProtocol::stopBallotProtocolTimer()
 {
-    std::shared_ptr<Slot> slot = mSlot.shared_from_this();
-    mSlot.getSCPDriver().setupTimer(mSlot.getSlotIndex(),
-                                    Slot::BALLOT_PROTOCOL_TIMER,
-                                    std::chrono::seconds::zero(), nullptr);
+    mSlot.trace(SCPTraceEvent::TIMER_STOPPED, Slot::BALLOT_PROTOCOL_TIMER);
+    mSlot.getSCP().getTimers().cancel(mSlot.getSlotIndex(),
+                                      Slot::BALLOT_PROTOCOL_TIMER);
 }
 
 void
 BallotProtocol::ballotProtocolTimerExpired()
 {
+    mSlot.trace(SCPTraceEvent::TIMER_FIRED, Slot::BALLOT_PROTOCOL_TIMER);
     abandonBallot(0);
 }
 
@@ -626,10 +829,11 @@ BallotProtocol::emitCurrentStateStatement()
         if (mSlot.processEnvelope(envelope, true) == SCP::EnvelopeState::VALID)
         {
             if (canEmit &&
-                (!mLastEnvelope || isNewerStatement(mLastEnvelope->statement,
-                                                    envelope.statement)))
+                (!mLastEnvelope ||
+                 isNewerStatement(mLastEnvelope->getEnvelope().statement,
+                                  envelope.statement)))
             {
-                mLastEnvelope = std::make_shared<SCPEnvelope>(envelope);
+                mLastEnvelope = std::make_shared<EncodedEnvelope>(envelope);
                 // this will no-op if invoked from advanceSlot
                 // as advanceSlot consolidates all messages sent
                 sendLatestEnvelope();
@@ -730,57 +934,31 @@ BallotProtocol::getPrepareCandidates(SCPStatement const& hint)
         hintBallots.erase(last);
 
         auto const& val = topVote.value;
+        auto pvs = findValueStatements(val);
+        if (!pvs)
+        {
+            continue;
+        }
+        auto const& vs = *pvs;
 
-        // find candidates that may have been prepared
-        for (auto const& e : mLatestEnvelopes)
+        // find candidates that may have been prepared:
+        // ballots prepared with the same value and a lower counter
+        for (auto pit = vs.mPrepareCounters.begin();
+             pit != vs.mPrepareCounters.end() && pit->first <= topVote.counter;
+             ++pit)
         {
-            SCPStatement const& st = e.second.statement;
-            switch (st.pledges.type())
-            {
-            case SCP_ST_PREPARE:
-            {
-                auto const& prep = st.pledges.prepare();
-                if (areBallotsLessAndCompatible(prep.ballot, topVote))
-                {
-                    candidates.insert(prep.ballot);
-                }
-                if (prep.prepared &&
-                    areBallotsLessAndCompatible(*prep.prepared, topVote))
-                {
-                    candidates.insert(*prep.prepared);
-                }
-                if (prep.preparedPrime &&
-                    areBallotsLessAndCompatible(*prep.preparedPrime, topVote))
-                {
-                    candidates.insert(*prep.preparedPrime);
-                }
-            }
-            break;
-            case SCP_ST_CONFIRM:
-            {
-                auto const& con = st.pledges.confirm();
-                if (areBallotsCompatible(topVote, con.ballot))
-                {
-                    candidates.insert(topVote);
-                    if (con.nPrepared < topVote.counter)
-                    {
-                        candidates.insert(SCPBallot(con.nPrepared, val));
-                    }
-                }
-            }
-            break;
-            case SCP_ST_EXTERNALIZE:
-            {
-                auto const& ext = st.pledges.externalize();
-                if (areBallotsCompatible(topVote, ext.commit))
-                {
-                    candidates.insert(topVote);
-                }
-            }
-            break;
-            default:
-                abort();
-            }
+            candidates.insert(SCPBallot(pit->first, val));
+        }
+        // commits (confirmed or externalized) for the value
+        if (vs.mCommitStatements != 0)
+        {
+            candidates.insert(topVote);
+        }
+        for (auto cit = vs.mConfirmPrepared.begin();
+             cit != vs.mConfirmPrepared.end() && cit->first < topVote.counter;
+             ++cit)
+        {
+            candidates.insert(SCPBallot(cit->first, val));
         }
     }
 
@@ -802,6 +980,7 @@ BallotProtocol::updateCurrentIfNeeded(SCPBallot const& h)
 bool
 BallotProtocol::attemptPreparedAccept(SCPStatement const& hint)
 {
+    ZoneScoped;
     if (mPhase != SCP_PHASE_PREPARE && mPhase != SCP_PHASE_CONFIRM)
     {
         return false;
@@ -843,39 +1022,13 @@ BallotProtocol::attemptPreparedAccept(SCPStatement const& hint)
             // otherwise, there is a chance it increases p'
         }
 
+        // checks if any node is voting for this ballot
+        auto value = mSlot.getValueTable().intern(ballot.value);
         bool accepted = federatedAccept(
-            // checks if any node is voting for this ballot
-            [&ballot](SCPStatement const& st) {
-                bool res;
-
-                switch (st.pledges.type())
-                {
-                case SCP_ST_PREPARE:
-                {
-                    auto const& p = st.pledges.prepare();
-                    res = areBallotsLessAndCompatible(ballot, p.ballot);
-                }
-                break;
-                case SCP_ST_CONFIRM:
-                {
-                    auto const& c = st.pledges.confirm();
-                    res = areBallotsCompatible(ballot, c.ballot);
-                }
-                break;
-                case SCP_ST_EXTERNALIZE:
-                {
-                    auto const& e = st.pledges.externalize();
-                    res = areBallotsCompatible(ballot, e.commit);
-                }
-                break;
-                default:
-                    res = false;
-                    dbgAbort();
-                }
-
-                return res;
-            },
-            std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+            filterNodes([&](size_t i) {
+                return mSummaries.votesPrepared(i, value, ballot.counter);
+            }),
+            getPreparedNodes(ballot));
         if (accepted)
         {
             return setPreparedAccept(ballot);
@@ -912,8 +1065,13 @@ BallotProtocol::setPreparedAccept(SCPBallot const& ballot)
 
     if (didWork)
     {
-        mSlot.getSCPDriver().acceptedBallotPrepared(mSlot.getSlotIndex(),
-                                                    ballot);
+        mSlot.trace(SCPTraceEvent::PREPARED_ACCEPTED, ballot.counter);
+        mSlot.recordLatency(SCPLatency::PREPARED_ACCEPTED);
+        {
+            ZoneScopedN("SCPDriver::acceptedBallotPrepared");
+            mSlot.getSCPDriver().acceptedBallotPrepared(mSlot.getSlotIndex(),
+                                                        ballot);
+        }
         emitCurrentStateStatement();
     }
 
@@ -923,6 +1081,7 @@ BallotProtocol::setPreparedAccept(SCPBallot const& ballot)
 bool
 BallotProtocol::attemptPreparedConfirmed(SCPStatement const& hint)
 {
+    ZoneScoped;
     if (mPhase != SCP_PHASE_PREPARE)
     {
         return false;
@@ -950,8 +1109,7 @@ BallotProtocol::attemptPreparedConfirmed(SCPStatement const& hint)
             break;
         }
 
-        bool ratified = federatedRatify(
-            std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+        bool ratified = federatedRatify(getPreparedNodes(ballot));
         if (ratified)
         {
             newH = ballot;
@@ -986,8 +1144,7 @@ BallotProtocol::attemptPreparedConfirmed(SCPStatement const& hint)
                 {
                     continue;
                 }
-                bool ratified = federatedRatify(
-                    std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+                bool ratified = federatedRatify(getPreparedNodes(ballot));
                 if (ratified)
                 {
                     newC = ballot;
@@ -1069,6 +1226,10 @@ BallotProtocol::setPreparedConfirmed(SCPBallot const& newC,
 
         if (didWork)
         {
+            mSlot.trace(SCPTraceEvent::PREPARED_CONFIRMED, newH.counter,
+                        newC.counter);
+            mSlot.recordLatency(SCPLatency::PREPARED_CONFIRMED);
+            ZoneScopedN("SCPDriver::confirmedBallotPrepared");
             mSlot.getSCPDriver().confirmedBallotPrepared(mSlot.getSlotIndex(),
                                                          newH);
         }
@@ -1127,47 +1288,12 @@ std::set<uint32>
 BallotProtocol::getCommitBoundariesFromStatements(SCPBallot const& ballot)
 {
     std::set<uint32> res;
-    for (auto const& env : mLatestEnvelopes)
+    auto vs = findValueStatements(ballot.value);
+    if (vs)
     {
-        auto const& pl = env.second.statement.pledges;
-        switch (pl.type())
-        {
-        case SCP_ST_PREPARE:
-        {
-            auto const& p = pl.prepare();
-            if (areBallotsCompatible(ballot, p.ballot))
-            {
-                if (p.nC)
-                {
-                    res.emplace(p.nC);
-                    res.emplace(p.nH);
-                }
-            }
-        }
-        break;
-        case SCP_ST_CONFIRM:
+        for (auto const& b : vs->mBoundaries)
         {
-            auto const& c = pl.confirm();
-            if (areBallotsCompatible(ballot, c.ballot))
-            {
-                res.emplace(c.nCommit);
-                res.emplace(c.nH);
-            }
-        }
-        break;
-        case SCP_ST_EXTERNALIZE:
-        {
-            auto const& e = pl.externalize();
-            if (areBallotsCompatible(ballot, e.commit))
-            {
-                res.emplace(e.commit.counter);
-                res.emplace(e.nH);
-                res.emplace(UINT32_MAX);
-            }
-        }
-        break;
-        default:
-            dbgAbort();
+            res.emplace_hint(res.end(), b.first);
         }
     }
     return res;
@@ -1176,6 +1302,7 @@ BallotProtocol::getCommitBoundariesFromStatements(SCPBallot const& ballot)
 bool
 BallotProtocol::attemptAcceptCommit(SCPStatement const& hint)
 {
+    ZoneScoped;
     if (mPhase != SCP_PHASE_PREPARE && mPhase != SCP_PHASE_CONFIRM)
     {
         return false;
@@ -1224,49 +1351,16 @@ BallotProtocol::attemptAcceptCommit(SCPStatement const& hint)
         }
     }
 
-    auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedAccept(
-            [&](SCPStatement const& st) -> bool {
-                bool res = false;
-                auto const& pl = st.pledges;
-                switch (pl.type())
-                {
-                case SCP_ST_PREPARE:
-                {
-                    auto const& p = pl.prepare();
-                    if (areBallotsCompatible(ballot, p.ballot))
-                    {
-                        if (p.nC != 0)
-                        {
-                            res = p.nC <= cur.first && cur.second <= p.nH;
-                        }
-                    }
-                }
-                break;
-                case SCP_ST_CONFIRM:
-                {
-                    auto const& c = pl.confirm();
-                    if (areBallotsCompatible(ballot, c.ballot))
-                    {
-                        res = c.nCommit <= cur.first;
-                    }
-                }
-                break;
-                case SCP_ST_EXTERNALIZE:
-                {
-                    auto const& e = pl.externalize();
-                    if (areBallotsCompatible(ballot, e.commit))
-                    {
-                        res = e.commit.counter <= cur.first;
-                    }
-                }
-                break;
-                default:
-                    dbgAbort();
-                }
-                return res;
-            },
-            std::bind(&BallotProtocol::commitPredicate, ballot, cur, _1));
+    auto value = mSlot.getValueTable().intern(ballot.value);
+    auto pred = [value, this](Interval const& cur) -> bool {
+        return federatedAccept(filterNodes([&](size_t i) {
+                                   return mSummaries.votesCommit(
+                                       i, value, cur.first, cur.second);
+                               }),
+                               filterNodes([&](size_t i) {
+                                   return mSummaries.acceptsCommit(
+                                       i, value, cur.first, cur.second);
+                               }));
     };
 
     // build the boundaries to scan
@@ -1337,7 +1431,12 @@ BallotProtocol::setAcceptCommit(SCPBallot const& c, SCPBallot const& h)
     {
         updateCurrentIfNeeded(*mHighBallot);
 
-        mSlot.getSCPDriver().acceptedCommit(mSlot.getSlotIndex(), h);
+        mSlot.trace(SCPTraceEvent::COMMIT_ACCEPTED, h.counter, c.counter);
+        mSlot.recordLatency(SCPLatency::COMMIT_ACCEPTED);
+        {
+            ZoneScopedN("SCPDriver::acceptedCommit");
+            mSlot.getSCPDriver().acceptedCommit(mSlot.getSlotIndex(), h);
+        }
         emitCurrentStateStatement();
     }
 
@@ -1363,11 +1462,10 @@ statementBallotCounter(SCPStatement const& st)
 
 static bool
 hasVBlockingSubsetStrictlyAheadOf(std::shared_ptr<LocalNode> localNode,
-                                  std::map<NodeID, SCPEnvelope> const& map,
-                                  uint32_t n)
+                                  NodeEnvelopeTable const& map, uint32_t n)
 {
     return LocalNode::isVBlocking(
-        localNode->getQuorumSet(), map,
+        localNode->getCompiledQuorumSet(), map,
         [&](SCPStatement const& st) { return statementBallotCounter(st) > n; });
 }
 
@@ -1391,6 +1489,7 @@ hasVBlockingSubsetStrictlyAheadOf(std::shared_ptr<LocalNode> localNode,
 bool
 BallotProtocol::attemptBump()
 {
+    ZoneScoped;
     if (mPhase == SCP_PHASE_PREPARE || mPhase == SCP_PHASE_CONFIRM)
     {
 
@@ -1434,6 +1533,7 @@ BallotProtocol::attemptBump()
 bool
 BallotProtocol::attemptConfirmCommit(SCPStatement const& hint)
 {
+    ZoneScoped;
     if (mPhase != SCP_PHASE_CONFIRM)
     {
         return false;
@@ -1478,9 +1578,11 @@ BallotProtocol::attemptConfirmCommit(SCPStatement const& hint)
     std::set<uint32> boundaries = getCommitBoundariesFromStatements(ballot);
     Interval candidate;
 
-    auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedRatify(
-            std::bind(&BallotProtocol::commitPredicate, ballot, cur, _1));
+    auto value = mSlot.getValueTable().intern(ballot.value);
+    auto pred = [value, this](Interval const& cur) -> bool {
+        return federatedRatify(filterNodes([&](size_t i) {
+            return mSummaries.acceptsCommit(i, value, cur.first, cur.second);
+        }));
     };
 
     findExtendedInterval(candidate, boundaries, pred);
@@ -1509,17 +1611,88 @@ BallotProtocol::setConfirmCommit(SCPBallot const& c, SCPBallot const& h)
     updateCurrentIfNeeded(*mHighBallot);
 
     mPhase = SCP_PHASE_EXTERNALIZE;
+    mSlot.trace(SCPTraceEvent::COMMIT_CONFIRMED, h.counter, c.counter);
+    mSlot.recordLatency(SCPLatency::EXTERNALIZED);
 
     emitCurrentStateStatement();
 
     mSlot.stopNomination();
 
+    ZoneScopedN("SCPDriver::valueExternalized");
     mSlot.getSCPDriver().valueExternalized(mSlot.getSlotIndex(),
                                            mCommit->value);
 
     return true;
 }
 
+bool
+BallotProtocol::attemptCatchUp(SCPStatement const& hint)
+{
+    ZoneScoped;
+    // past PREPARE, attemptConfirmCommit applies
+    if (mPhase != SCP_PHASE_PREPARE || !mSlot.getSCP().isCatchUpEnabled())
+    {
+        return false;
+    }
+
+    SCPBallot ballot;
+    switch (hint.pledges.type())
+    {
+    case SCP_ST_CONFIRM:
+    {
+        auto const& con = hint.pledges.confirm();
+        ballot = SCPBallot(con.nH, con.ballot.value);
+    }
+    break;
+    case SCP_ST_EXTERNALIZE:
+    {
+        auto const& ext = hint.pledges.externalize();
+        ballot = SCPBallot(ext.nH, ext.commit.value);
+    }
+    break;
+    default:
+        return false;
+    };
+
+    // the nodes that accepted to commit must form a quorum, for the commit
+    // to be confirmed, and be v-blocking, for the local node to accept it
+    // whatever it voted for: the steps in between follow from these
+    auto const& qSet = mSlot.getLocalNode()->getCompiledQuorumSet();
+    auto value = mSlot.getValueTable().intern(ballot.value);
+    auto pred = [&](Interval const& cur) -> bool {
+        auto accepted = filterNodes([&](size_t i) {
+            return mSummaries.acceptsCommit(i, value, cur.first, cur.second);
+        });
+        return LocalNode::isVBlocking(qSet, mLatestEnvelopes, accepted) &&
+               federatedRatify(accepted);
+    };
+
+    std::set<uint32> boundaries = getCommitBoundariesFromStatements(ballot);
+    Interval candidate;
+    findExtendedInterval(candidate, boundaries, pred);
+    if (candidate.first == 0)
+    {
+        return false;
+    }
+
+    SCPBallot c = SCPBallot(candidate.first, ballot.value);
+    SCPBallot h = SCPBallot(candidate.second, ballot.value);
+    if (Logging::logTrace("SCP"))
+        CLOG(TRACE, "SCP") << "BallotProtocol::attemptCatchUp"
+                           << " i: " << mSlot.getSlotIndex()
+                           << " c: " << mSlot.getSCP().ballotToStr(c)
+                           << " h: " << mSlot.getSCP().ballotToStr(h);
+
+    // as setAcceptCommit does when leaving PREPARE
+    mValueOverride = std::make_unique<Value>(h.value);
+    if (mCurrentBallot && !areBallotsLessAndCompatible(h, *mCurrentBallot))
+    {
+        bumpToBallot(h, false);
+    }
+    mPreparedPrime.reset();
+    return setConfirmCommit(c, h);
+}
+
 bool
 BallotProtocol::hasPreparedBallot(SCPBallot const& ballot,
                                   SCPStatement const& st)
@@ -1558,6 +1731,15 @@ BallotProtocol::hasPreparedBallot(SCPBallot const& ballot,
     return res;
 }
 
+BitSet
+BallotProtocol::getPreparedNodes(SCPBallot const& ballot)
+{
+    auto value = mSlot.getValueTable().intern(ballot.value);
+    return filterNodes([&](size_t i) {
+        return mSummaries.hasPrepared(i, value, ballot.counter);
+    });
+}
+
 Hash
 BallotProtocol::getCompanionQuorumSetHashFromStatement(SCPStatement const& st)
 {
@@ -1729,7 +1911,7 @@ BallotProtocol::setStateFromEnvelope(SCPEnvelope const& e)
 
     recordEnvelope(e);
 
-    mLastEnvelope = std::make_shared<SCPEnvelope>(e);
+    mLastEnvelope = std::make_shared<EncodedEnvelope>(e);
     mLastEnvelopeEmit = mLastEnvelope;
 
     auto const& pl = e.statement.pledges;
@@ -1787,20 +1969,29 @@ BallotProtocol::setStateFromEnvelope(SCPEnvelope const& e)
     }
 }
 
+bool
+BallotProtocol::forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const
+{
+    auto const& localID = mSlot.getSCP().getLocalNodeID();
+    // only return messages for self if the slot is fully validated
+    bool self = mSlot.isFullyValidated();
+    // report envelopes by node, independently of the order they were seen in
+    return mLatestEnvelopes.forEachByNodeID(
+        [&](NodeEnvelopeTable::value_type const& n) {
+            return self || !(n.first == localID);
+        },
+        f);
+}
+
 std::vector<SCPEnvelope>
 BallotProtocol::getCurrentState() const
 {
     std::vector<SCPEnvelope> res;
     res.reserve(mLatestEnvelopes.size());
-    for (auto const& n : mLatestEnvelopes)
-    {
-        // only return messages for self if the slot is fully validated
-        if (!(n.first == mSlot.getSCP().getLocalNodeID()) ||
-            mSlot.isFullyValidated())
-        {
-            res.emplace_back(n.second);
-        }
-    }
+    forEachCurrentEnvelope([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
     return res;
 }
 
@@ -1815,39 +2006,61 @@ BallotProtocol::getLatestMessage(NodeID const& id) const
     return nullptr;
 }
 
-std::vector<SCPEnvelope>
-BallotProtocol::getExternalizingState() const
+size_t
+BallotProtocol::getMemoryUsage() const
 {
-    std::vector<SCPEnvelope> res;
-    if (mPhase == SCP_PHASE_EXTERNALIZE)
+    return mLatestEnvelopes.getMemoryUsage() + mSummaries.getMemoryUsage() +
+           mLatestByValue.capacity() * sizeof(ValueStatements);
+}
+
+bool
+BallotProtocol::forEachExternalizingEnvelope(
+    SCP::EnvelopeVisitor const& f) const
+{
+    if (mPhase != SCP_PHASE_EXTERNALIZE)
     {
-        res.reserve(mLatestEnvelopes.size());
-        for (auto const& n : mLatestEnvelopes)
-        {
-            if (!(n.first == mSlot.getSCP().getLocalNodeID()))
+        return true;
+    }
+    auto const& localID = mSlot.getSCP().getLocalNodeID();
+    bool self = mSlot.isFullyValidated();
+    // report envelopes by node, independently of the order they were seen in
+    return mLatestEnvelopes.forEachByNodeID(
+        [&](NodeEnvelopeTable::value_type const& n) {
+            if (!(n.first == localID))
             {
                 // good approximation: statements with the value that
                 // externalized
                 // we could filter more using mConfirmedPrepared as well
-                if (areBallotsCompatible(getWorkingBallot(n.second.statement),
-                                         *mCommit))
-                {
-                    res.emplace_back(n.second);
-                }
-            }
-            else if (mSlot.isFullyValidated())
-            {
-                // only return messages for self if the slot is fully validated
-                res.emplace_back(n.second);
+                return areBallotsCompatible(
+                    getWorkingBallot(n.second.statement), *mCommit);
             }
-        }
-    }
+            // only return messages for self if the slot is fully validated
+            return self;
+        },
+        f);
+}
+
+std::vector<SCPEnvelope>
+BallotProtocol::getExternalizingState() const
+{
+    std::vector<SCPEnvelope> res;
+    forEachExternalizingEnvelope([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
     return res;
 }
 
 void
 BallotProtocol::advanceSlot(SCPStatement const& hint)
 {
+    advanceSlot(std::vector<SCPStatement const*>{&hint});
+}
+
+void
+BallotProtocol::advanceSlot(std::vector<SCPStatement const*> const& hints)
+{
+    ZoneScoped;
     mCurrentMessageLevel++;
     if (Logging::logTrace("SCP"))
         CLOG(TRACE, "SCP") << "BallotProtocol::advanceSlot "
@@ -1868,13 +2081,18 @@ BallotProtocol::advanceSlot(SCPStatement const& hint)
 
     bool didWork = false;
 
-    didWork = attemptPreparedAccept(hint) || didWork;
+    for (auto hint : hints)
+    {
+        didWork = attemptCatchUp(*hint) || didWork;
 
-    didWork = attemptPreparedConfirmed(hint) || didWork;
+        didWork = attemptPreparedAccept(*hint) || didWork;
 
-    didWork = attemptAcceptCommit(hint) || didWork;
+        didWork = attemptPreparedConfirmed(*hint) || didWork;
 
-    didWork = attemptConfirmCommit(hint) || didWork;
+        didWork = attemptAcceptCommit(*hint) || didWork;
+
+        didWork = attemptConfirmCommit(*hint) || didWork;
+    }
 
     // only bump after we're done with everything else
     if (mCurrentMessageLevel == 1)
@@ -1936,33 +2154,43 @@ BallotProtocol::validateValues(SCPStatement const& st)
     SCPDriver::ValidationLevel res = SCPDriver::kFullyValidatedValue;
     for (auto const& v : values)
     {
-        auto tr =
-            mSlot.getSCPDriver().validateValue(mSlot.getSlotIndex(), v, false);
-        if (tr != SCPDriver::kFullyValidatedValue)
+        auto tr = mSlot.validateValue(v, false);
+        if (tr == SCPDriver::kInvalidValue)
         {
-            if (tr == SCPDriver::kInvalidValue)
-            {
-                res = SCPDriver::kInvalidValue;
-            }
-            else
-            {
-                res = SCPDriver::kMaybeValidValue;
-            }
+            return SCPDriver::kInvalidValue;
+        }
+        if (tr == SCPDriver::kPendingValue)
+        {
+            res = SCPDriver::kPendingValue;
+        }
+        else if (tr == SCPDriver::kMaybeValidValue &&
+                 res != SCPDriver::kPendingValue)
+        {
+            res = SCPDriver::kMaybeValidValue;
         }
     }
     return res;
 }
 
+void
+BallotProtocol::emitDeferredEnvelope()
+{
+    sendLatestEnvelope();
+}
+
 void
 BallotProtocol::sendLatestEnvelope()
 {
     // emit current envelope if needed
-    if (mCurrentMessageLevel == 0 && mLastEnvelope && mSlot.isFullyValidated())
+    if (mCurrentMessageLevel == 0 && mLastEnvelope &&
+        mSlot.isFullyValidated() && !mSlot.isEmissionDeferred())
     {
         if (!mLastEnvelopeEmit || mLastEnvelope != mLastEnvelopeEmit)
         {
             mLastEnvelopeEmit = mLastEnvelope;
-            mSlot.getSCPDriver().emitEnvelope(*mLastEnvelopeEmit);
+            ZoneScopedN("SCPDriver::emitEnvelope");
+            mSlot.getSCPDriver().emitEnvelope(
+                mLastEnvelopeEmit->getEnvelope());
         }
     }
 }
@@ -2034,7 +2262,11 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
     int n_missing = 0, n_disagree = 0, n_delayed = 0;
 
     int agree = 0;
-    auto qSet = mSlot.getSCPDriver().getQSet(qSetHash);
+    SCPQuorumSetPtr qSet;
+    {
+        ZoneScopedN("SCPDriver::getQSet");
+        qSet = mSlot.getSCPDriver().getQSet(qSetHash);
+    }
     if (!qSet)
     {
         phase = "expired";
@@ -2046,7 +2278,7 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
         {
             if (!summary)
             {
-                missing.append(mSlot.getSCPDriver().toStrKey(n, fullKeys));
+                missing.append(mSlot.getSCP().toStrKey(n, fullKeys));
             }
             n_missing++;
         }
@@ -2064,7 +2296,7 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
                     if (!summary)
                     {
                         delayed.append(
-                            mSlot.getSCPDriver().toStrKey(n, fullKeys));
+                            mSlot.getSCP().toStrKey(n, fullKeys));
                     }
                     n_delayed++;
                 }
@@ -2073,7 +2305,7 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
             {
                 if (!summary)
                 {
-                    disagree.append(mSlot.getSCPDriver().toStrKey(n, fullKeys));
+                    disagree.append(mSlot.getSCP().toStrKey(n, fullKeys));
                 }
                 n_disagree++;
             }
@@ -2086,12 +2318,28 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
         delayed = n_delayed;
     }
 
-    auto f = LocalNode::findClosestVBlocking(*qSet, mLatestEnvelopes,
-                                             [&](SCPStatement const& st) {
-                                                 return areBallotsCompatible(
-                                                     getWorkingBallot(st), b);
-                                             },
-                                             &id);
+    // monitoring asks for every node, usually several times between two
+    // changes of M
+    auto agreeing = mLatestEnvelopes.filter([&](SCPStatement const& st) {
+        return areBallotsCompatible(getWorkingBallot(st), b);
+    });
+    auto cached = std::find_if(
+        mClosestVBlocking.begin(), mClosestVBlocking.end(),
+        [&](ClosestVBlocking const& r) {
+            // the sets have the size of M, which is the same for all
+            return r.mQSetHash == qSetHash && r.mExcluded == id &&
+                   r.mAgreeing == agreeing;
+        });
+    if (cached == mClosestVBlocking.end())
+    {
+        CompiledQuorumSet compiled(*qSet,
+                                   mLatestEnvelopes.getSharedNodeIndex());
+        auto nodes = LocalNode::findClosestVBlocking(compiled, agreeing, &id);
+        mClosestVBlocking.push_back(
+            {qSetHash, id, std::move(agreeing), std::move(nodes)});
+        cached = mClosestVBlocking.end() - 1;
+    }
+    auto const& f = cached->mNodes;
     ret["fail_at"] = static_cast<int>(f.size());
 
     if (!summary)
@@ -2099,7 +2347,7 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
         auto& f_ex = ret["fail_with"];
         for (auto const& n : f)
         {
-            f_ex.append(mSlot.getSCPDriver().toStrKey(n, fullKeys));
+            f_ex.append(mSlot.getSCP().toStrKey(n, fullKeys));
         }
         ret["value"] = getLocalNode()->toJson(*qSet, fullKeys);
     }
@@ -2135,13 +2383,14 @@ bool
 BallotProtocol::federatedAccept(StatementPredicate voted,
                                 StatementPredicate accepted)
 {
-    return mSlot.federatedAccept(voted, accepted, mLatestEnvelopes);
+    return federatedAccept<StatementPredicate, StatementPredicate>(voted,
+                                                                   accepted);
 }
 
 bool
 BallotProtocol::federatedRatify(StatementPredicate voted)
 {
-    return mSlot.federatedRatify(voted, mLatestEnvelopes);
+    return federatedRatify<StatementPredicate>(voted);
 }
 
 void
@@ -2155,30 +2404,18 @@ BallotProtocol::checkHeardFromQuorum()
     // for a given counter on the local node
     if (mCurrentBallot)
     {
-        if (LocalNode::isQuorum(
-                getLocalNode()->getQuorumSet(), mLatestEnvelopes,
-                std::bind(&Slot::getQuorumSetFromStatement, &mSlot, _1),
-                [&](SCPStatement const& st) {
-                    bool res;
-                    if (st.pledges.type() == SCP_ST_PREPARE)
-                    {
-                        res = mCurrentBallot->counter <=
-                              st.pledges.prepare().ballot.counter;
-                    }
-                    else
-                    {
-                        res = true;
-                    }
-                    return res;
-                }))
+        if (isHeardFromQuorum())
         {
             bool oldHQ = mHeardFromQuorum;
             mHeardFromQuorum = true;
             if (!oldHQ)
             {
                 // if we transition from not heard -> heard, we start the timer
-                mSlot.getSCPDriver().ballotDidHearFromQuorum(
-                    mSlot.getSlotIndex(), *mCurrentBallot);
+                {
+                    ZoneScopedN("SCPDriver::ballotDidHearFromQuorum");
+                    mSlot.getSCPDriver().ballotDidHearFromQuorum(
+                        mSlot.getSlotIndex(), *mCurrentBallot);
+                }
                 if (mPhase != SCP_PHASE_EXTERNALIZE)
                 {
                     startBallotProtocolTimer();
@@ -2196,4 +2433,33 @@ BallotProtocol::checkHeardFromQuorum()
         }
     }
 }
+
+bool
+BallotProtocol::isHeardFromQuorum()
+{
+    uint32 counter = mCurrentBallot->counter;
+    if (!mHeardTracked || mHeardCounter != counter)
+    {
+        mHeardNodes = filterNodes(
+            [&](size_t i) { return mSummaries.isAtCounter(i, counter); });
+        mHeardCounter = counter;
+        mHeardTracked = true;
+        mHeardChanged = true;
+        mHeardQuorum = false;
+    }
+
+    // nodes are only added to the set: a quorum stays one
+    if (mHeardChanged && !mHeardQuorum)
+    {
+        auto const& qSet = getLocalNode()->getCompiledQuorumSet();
+        // the transitive check only removes nodes, so the set must first
+        // contain a slice of the local node
+        mHeardQuorum =
+            qSet.isQuorumSlice(
+                qSet.translate(mHeardNodes, mLatestEnvelopes.getNodeIndex())) &&
+            mSlot.isQuorum(qSet, mLatestEnvelopes, mHeardNodes);
+    }
+    mHeardChanged = false;
+    return mHeardQuorum;
+}
 }
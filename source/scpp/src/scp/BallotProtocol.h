@@ -5,8 +5,13 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "lib/json/json-forwards.h"
+#include "scp/BallotSummaries.h"
+#include "scp/EncodedEnvelope.h"
+#include "scp/NodeEnvelopeTable.h"
 #include "scp/SCP.h"
+#include "util/Arena.h"
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -30,6 +35,15 @@ class BallotProtocol
 
     bool mHeardFromQuorum;
 
+    // state of isHeardFromQuorum: the nodes of M at mHeardCounter, a set
+    // that only grows as counters only move upward, and whether they
+    // formed a quorum when last evaluated
+    bool mHeardTracked;
+    bool mHeardChanged;
+    bool mHeardQuorum;
+    uint32 mHeardCounter;
+    BitSet mHeardNodes;
+
     // state tracking members
     enum SCPPhase
     {
@@ -46,18 +60,55 @@ class BallotProtocol
     std::unique_ptr<SCPBallot> mPreparedPrime;      // p'
     std::unique_ptr<SCPBallot> mHighBallot;         // h
     std::unique_ptr<SCPBallot> mCommit;             // c
-    std::map<NodeID, SCPEnvelope> mLatestEnvelopes; // M
+    NodeEnvelopeTable mLatestEnvelopes;             // M
+    // the statements of M decoded for the predicates, same positions
+    BallotSummaries mSummaries;
+
+    // ballot counters referenced by the statements in M, grouped by value
+    // and indexed by the value's handle in the slot's ValueTable;
+    // maintained by recordEnvelope so that candidate / boundary lookups
+    // don't need to scan M
+    // the nodes of the maps come from the arena of the slot
+    using CounterMap =
+        std::map<uint32, uint32, std::less<uint32>,
+                 ArenaAllocator<std::pair<const uint32, uint32>>>;
+    struct ValueStatements
+    {
+        explicit ValueStatements(Arena& arena);
+
+        // counters of the ballots (b, p, p') of PREPARE statements
+        CounterMap mPrepareCounters;
+        // nPrepared of CONFIRM statements
+        CounterMap mConfirmPrepared;
+        // number of CONFIRM and EXTERNALIZE statements
+        uint32 mCommitStatements{0};
+        // commit boundaries, see getCommitBoundariesFromStatements
+        CounterMap mBoundaries;
+    };
+    std::vector<ValueStatements> mLatestByValue;
+
     SCPPhase mPhase;                                // Phi
     std::unique_ptr<Value> mValueOverride;          // z
 
     int mCurrentMessageLevel; // number of messages triggered in one run
 
-    std::shared_ptr<SCPEnvelope>
+    std::shared_ptr<EncodedEnvelope const>
         mLastEnvelope; // last envelope generated by this node
 
-    std::shared_ptr<SCPEnvelope>
+    std::shared_ptr<EncodedEnvelope const>
         mLastEnvelopeEmit; // last envelope emitted by this node
 
+    // results of findClosestVBlocking for getJsonQuorumInfo, by quorum set,
+    // excluded node and agreeing nodes of M; cleared when M changes
+    struct ClosestVBlocking
+    {
+        Hash mQSetHash;
+        NodeID mExcluded;
+        BitSet mAgreeing;
+        std::vector<NodeID> mNodes;
+    };
+    std::vector<ClosestVBlocking> mClosestVBlocking;
+
   public:
     BallotProtocol(Slot& slot);
 
@@ -67,6 +118,15 @@ class BallotProtocol
     // trigger more potential state changes
     SCP::EnvelopeState processEnvelope(SCPEnvelope const& envelope, bool self);
 
+    // Process a batch of envelopes received for this slot: all envelopes are
+    // recorded first, then the state machine runs once using all of them
+    // as hints, emitting at most one envelope.
+    // returns the number of envelopes that were VALID
+    size_t processEnvelopes(std::vector<SCPEnvelope const*> const& envelopes);
+
+    // emits the latest envelope, once Slot stops deferring the emissions
+    void emitDeferredEnvelope();
+
     void ballotProtocolTimerExpired();
     // abandon's current ballot, move to a new ballot
     // at counter `n` (or, if n == 0, increment current counter)
@@ -101,27 +161,66 @@ class BallotProtocol
     // c for EXTERNALIZE messages
     static SCPBallot getWorkingBallot(SCPStatement const& st);
 
-    SCPEnvelope*
+    // returns true if st is newer than oldst
+    static bool isNewerStatement(SCPStatement const& oldst,
+                                 SCPStatement const& st);
+
+    SCPEnvelope const*
     getLastMessageSend() const
+    {
+        return mLastEnvelopeEmit ? &mLastEnvelopeEmit->getEnvelope() : nullptr;
+    }
+
+    EncodedEnvelope const*
+    getLastEncodedMessageSend() const
     {
         return mLastEnvelopeEmit.get();
     }
 
     void setStateFromEnvelope(SCPEnvelope const& e);
 
+    // true once the local node has a current ballot, the state cannot be set
+    // from an envelope anymore
+    bool
+    hasCurrentBallot() const
+    {
+        return mCurrentBallot != nullptr;
+    }
+
     std::vector<SCPEnvelope> getCurrentState() const;
+    // same as `getCurrentState`, without copying the envelopes
+    bool forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const;
 
     // returns the latest message from a node
     // or nullptr if not found
     SCPEnvelope const* getLatestMessage(NodeID const& id) const;
 
+    // bytes held by M and the indexes derived from it, besides the arena
+    // of the slot, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
+
     std::vector<SCPEnvelope> getExternalizingState() const;
+    // same as `getExternalizingState`, without copying the envelopes
+    bool forEachExternalizingEnvelope(SCP::EnvelopeVisitor const& f) const;
+
+    // the quorum sets used by checkHeardFromQuorum changed
+    void
+    resetHeardFromQuorum()
+    {
+        mHeardTracked = false;
+    }
 
   private:
     // attempts to make progress using the latest statement as a hint
     // calls into the various attempt* methods, emits message
     // to make progress
     void advanceSlot(SCPStatement const& hint);
+    void advanceSlot(std::vector<SCPStatement const*> const& hints);
+
+    // validates the envelope and records it if it should be processed,
+    // `advance` is set when the state machine should then run
+    SCP::EnvelopeState checkAndRecordEnvelope(SCPEnvelope const& envelope,
+                                              bool self, bool& advance);
 
     // returns true if all values in statement are valid
     SCPDriver::ValidationLevel validateValues(SCPStatement const& st);
@@ -163,6 +262,9 @@ class BallotProtocol
     bool setConfirmCommit(SCPBallot const& acceptCommitLow,
                           SCPBallot const& acceptCommitHigh);
 
+    // steps 4 to 8 at once in PREPARE phase, see SCP::setCatchUpEnabled
+    bool attemptCatchUp(SCPStatement const& hint);
+
     // step 9 from the SCP paper
     bool attemptBump();
 
@@ -197,6 +299,16 @@ class BallotProtocol
     static bool commitPredicate(SCPBallot const& ballot, Interval const& check,
                                 SCPStatement const& st);
 
+    // nodes of M for which `pred(i)` holds, i being a row of mSummaries
+    template <typename Pred>
+    BitSet
+    filterNodes(Pred const& pred) const
+    {
+        return BallotSummaries::filter(mLatestEnvelopes.getNodes(), pred);
+    }
+    // nodes of M that have prepared ballot (see hasPreparedBallot)
+    BitSet getPreparedNodes(SCPBallot const& ballot);
+
     // attempts to update p to ballot (updating p' if needed)
     bool setPrepared(SCPBallot const& ballot);
 
@@ -223,16 +335,17 @@ class BallotProtocol
     // for a given node.
     bool isNewerStatement(NodeID const& nodeID, SCPStatement const& st);
 
-    // returns true if st is newer than oldst
-    static bool isNewerStatement(SCPStatement const& oldst,
-                                 SCPStatement const& st);
-
     // basic sanity check on statement
     bool isStatementSane(SCPStatement const& st, bool self);
 
     // records the statement in the state machine
     void recordEnvelope(SCPEnvelope const& env);
 
+    // adds (delta = 1) or removes (delta = -1) st from mLatestByValue
+    void indexStatement(SCPStatement const& st, int delta);
+    // the entry of mLatestByValue for v, nullptr if v is not referenced
+    ValueStatements const* findValueStatements(Value const& v) const;
+
     // ** State related methods
 
     // helper function that updates the current ballot
@@ -264,9 +377,16 @@ class BallotProtocol
 
     bool federatedAccept(StatementPredicate voted, StatementPredicate accepted);
     bool federatedRatify(StatementPredicate voted);
+    // overloads for any callable predicate, defined in BallotProtocol.cpp
+    template <typename Voted, typename Accepted>
+    bool federatedAccept(Voted const& voted, Accepted const& accepted);
+    template <typename Voted> bool federatedRatify(Voted const& voted);
 
     void startBallotProtocolTimer();
     void stopBallotProtocolTimer();
     void checkHeardFromQuorum();
+    // true if a quorum is at the counter of b, re-evaluated only when the
+    // nodes at that counter changed
+    bool isHeardFromQuorum();
 };
 }
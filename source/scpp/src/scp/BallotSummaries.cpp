@@ -0,0 +1,106 @@
+/*******************************************************************************
+
+    Implementation of the ballot statements of a slot decoded into columns, see
+    BallotSummaries.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/BallotSummaries.h"
+#include "util/GlobalChecks.h"
+
+namespace stellar
+{
+void
+BallotSummaries::assign(size_t i, SCPStatement const& st, ValueTable& values)
+{
+    if (i >= mType.size())
+    {
+        size_t n = i + 1;
+        mType.resize(n);
+        mValue.resize(n, ValueTable::npos);
+        mCounter.resize(n);
+        mPreparedValue.resize(n, ValueTable::npos);
+        mPreparedCounter.resize(n);
+        mPreparedPrimeValue.resize(n, ValueTable::npos);
+        mPreparedPrimeCounter.resize(n);
+        mLow.resize(n);
+        mHigh.resize(n);
+    }
+
+    // released once the new ones are acquired, as they are often the same
+    ValueTable::Handle old[] = {mValue[i], mPreparedValue[i],
+                                mPreparedPrimeValue[i]};
+
+    auto const& pl = st.pledges;
+    mType[i] = static_cast<uint8_t>(pl.type());
+    mPreparedPrimeValue[i] = ValueTable::npos;
+    mPreparedPrimeCounter[i] = 0;
+    switch (pl.type())
+    {
+    case SCP_ST_PREPARE:
+    {
+        auto const& p = pl.prepare();
+        mValue[i] = values.acquire(p.ballot.value);
+        mCounter[i] = p.ballot.counter;
+        mPreparedValue[i] =
+            p.prepared ? values.acquire(p.prepared->value) : ValueTable::npos;
+        mPreparedCounter[i] = p.prepared ? p.prepared->counter : 0;
+        if (p.preparedPrime)
+        {
+            mPreparedPrimeValue[i] = values.acquire(p.preparedPrime->value);
+            mPreparedPrimeCounter[i] = p.preparedPrime->counter;
+        }
+        mLow[i] = p.nC;
+        mHigh[i] = p.nH;
+    }
+    break;
+    case SCP_ST_CONFIRM:
+    {
+        auto const& c = pl.confirm();
+        mValue[i] = values.acquire(c.ballot.value);
+        mCounter[i] = c.ballot.counter;
+        mPreparedValue[i] = values.acquire(c.ballot.value);
+        mPreparedCounter[i] = c.nPrepared;
+        mLow[i] = c.nCommit;
+        mHigh[i] = c.nH;
+    }
+    break;
+    case SCP_ST_EXTERNALIZE:
+    {
+        auto const& e = pl.externalize();
+        mValue[i] = values.acquire(e.commit.value);
+        mCounter[i] = e.commit.counter;
+        mPreparedValue[i] = values.acquire(e.commit.value);
+        mPreparedCounter[i] = UINT32_MAX;
+        mLow[i] = e.commit.counter;
+        mHigh[i] = e.nH;
+    }
+    break;
+    default:
+        dbgAbort();
+    }
+
+    for (auto h : old)
+    {
+        values.release(h);
+    }
+}
+
+size_t
+BallotSummaries::getMemoryUsage() const
+{
+    // the columns are resized together
+    return mType.capacity() * (sizeof(uint8_t) +
+                               3 * sizeof(ValueTable::Handle) +
+                               5 * sizeof(uint32));
+}
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the ballot statements of a slot decoded into columns.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <vector>
+
+#include "scp/ValueTable.h"
+#include "util/BitSet.h"
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * The ballot statements of a NodeEnvelopeTable decoded into columns, one
+ * row per node at the node's position in the table, so that the predicates
+ * of the ballot protocol are loops over integers instead of walks through
+ * the XDR unions. Values are handles in the slot's ValueTable: ballots are
+ * compatible when their handles are equal.
+ *
+ * Rows are normalized across statement types:
+ * - mValue / mCounter: ballot of PREPARE and CONFIRM, commit of EXTERNALIZE
+ * - prepared / preparedPrime: p and p' of PREPARE, (nPrepared, ballot.value)
+ *   for CONFIRM, and (UINT32_MAX, commit.value) for EXTERNALIZE, ValueTable
+ *   ::npos when absent
+ * - mLow / mHigh: nC and nH of PREPARE, nCommit and nH of CONFIRM,
+ *   commit.counter and nH of EXTERNALIZE
+ *
+ * Rows of nodes without an envelope are meaningless: scans are restricted
+ * to the nodes of the table.
+ */
+class BallotSummaries
+{
+    std::vector<uint8_t> mType;
+    std::vector<ValueTable::Handle> mValue;
+    std::vector<uint32> mCounter;
+    std::vector<ValueTable::Handle> mPreparedValue;
+    std::vector<uint32> mPreparedCounter;
+    std::vector<ValueTable::Handle> mPreparedPrimeValue;
+    std::vector<uint32> mPreparedPrimeCounter;
+    std::vector<uint32> mLow;
+    std::vector<uint32> mHigh;
+
+    // true if (value, counter) <= the prepared ballot (pv, pc)
+    static bool
+    isPrepared(ValueTable::Handle value, uint32 counter, ValueTable::Handle pv,
+               uint32 pc)
+    {
+        return pv == value && counter <= pc;
+    }
+
+  public:
+    // sets the row of node `i` from its statement, acquiring its values
+    // and releasing the ones of the previous statement
+    void assign(size_t i, SCPStatement const& st, ValueTable& values);
+
+    // nodes of `nodes` for which `pred(i)` holds
+    template <typename Pred>
+    static BitSet
+    filter(BitSet const& nodes, Pred const& pred)
+    {
+        BitSet res(nodes.size());
+        for (size_t i = 0; nodes.nextSet(i); ++i)
+        {
+            if (pred(i))
+            {
+                res.set(i);
+            }
+        }
+        return res;
+    }
+
+    SCPStatementType
+    getType(size_t i) const
+    {
+        return static_cast<SCPStatementType>(mType[i]);
+    }
+
+    // `BallotProtocol::hasPreparedBallot` for the statement of node i
+    bool
+    hasPrepared(size_t i, ValueTable::Handle value, uint32 counter) const
+    {
+        return isPrepared(value, counter, mPreparedValue[i],
+                          mPreparedCounter[i]) ||
+               isPrepared(value, counter, mPreparedPrimeValue[i],
+                          mPreparedPrimeCounter[i]);
+    }
+
+    // node i votes for the ballot to be prepared
+    bool
+    votesPrepared(size_t i, ValueTable::Handle value, uint32 counter) const
+    {
+        return mValue[i] == value &&
+               (mType[i] != SCP_ST_PREPARE || counter <= mCounter[i]);
+    }
+
+    // node i votes to commit the ballot for all counters of [low, high]
+    bool
+    votesCommit(size_t i, ValueTable::Handle value, uint32 low,
+                uint32 high) const
+    {
+        if (mValue[i] != value)
+        {
+            return false;
+        }
+        switch (mType[i])
+        {
+        case SCP_ST_PREPARE:
+            return mLow[i] != 0 && mLow[i] <= low && high <= mHigh[i];
+        default:
+            return mLow[i] <= low;
+        }
+    }
+
+    // `BallotProtocol::commitPredicate` for the statement of node i
+    bool
+    acceptsCommit(size_t i, ValueTable::Handle value, uint32 low,
+                  uint32 high) const
+    {
+        if (mValue[i] != value)
+        {
+            return false;
+        }
+        switch (mType[i])
+        {
+        case SCP_ST_CONFIRM:
+            return mLow[i] <= low && high <= mHigh[i];
+        case SCP_ST_EXTERNALIZE:
+            return mLow[i] <= low;
+        default:
+            return false;
+        }
+    }
+
+    // node i is at least at `counter`, see checkHeardFromQuorum
+    bool
+    isAtCounter(size_t i, uint32 counter) const
+    {
+        return mType[i] != SCP_ST_PREPARE || counter <= mCounter[i];
+    }
+
+    // bytes held by the rows, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
+};
+}
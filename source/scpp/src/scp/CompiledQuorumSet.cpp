@@ -0,0 +1,313 @@
+/*******************************************************************************
+
+    Implementation of quorum sets flattened into bitsets for slice and
+    v-blocking tests, see CompiledQuorumSet.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/CompiledQuorumSet.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace stellar
+{
+CompiledQuorumSet::Level::Level(SCPQuorumSet const& qSet, NodeIndex& index)
+    : mThreshold(qSet.threshold)
+    , mEntries(static_cast<uint32>(qSet.validators.size() +
+                                   qSet.innerSets.size()))
+{
+    for (auto const& v : qSet.validators)
+    {
+        size_t i = index.intern(v);
+        if (mNodes.get(i))
+        {
+            mRepeatedNodes.emplace_back(i);
+        }
+        else
+        {
+            mNodes.set(i);
+        }
+    }
+    mInnerSets.reserve(qSet.innerSets.size());
+    for (auto const& inner : qSet.innerSets)
+    {
+        mInnerSets.emplace_back(inner, index);
+    }
+}
+
+size_t
+CompiledQuorumSet::Level::countNodes(BitSet const& nodes) const
+{
+    size_t res = mNodes.intersectionCount(nodes);
+    for (auto i : mRepeatedNodes)
+    {
+        if (nodes.get(i))
+        {
+            res++;
+        }
+    }
+    return res;
+}
+
+bool
+CompiledQuorumSet::Level::isQuorumSlice(BitSet const& nodes) const
+{
+    // a threshold of 0 can never be reached by decrementing it
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    size_t found = countNodes(nodes);
+    if (found >= mThreshold)
+    {
+        return true;
+    }
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isQuorumSlice(nodes) && ++found >= mThreshold)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+CompiledQuorumSet::Level::isVBlocking(BitSet const& nodes) const
+{
+    // There is no v-blocking set for {\empty}
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    // at least one entry must be blocked, even for unsatisfiable thresholds
+    int leftTillBlock = (int)(1 + mEntries - mThreshold);
+    size_t needed = (size_t)std::max(1, leftTillBlock);
+
+    size_t found = countNodes(nodes);
+    if (found >= needed)
+    {
+        return true;
+    }
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isVBlocking(nodes) && ++found >= needed)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t
+CompiledQuorumSet::Level::findClosestVBlocking(BitSet const& agreeing,
+                                               size_t excluded,
+                                               std::vector<size_t>& res) const
+{
+    size_t start = res.size();
+    size_t leftTillBlock = (1 + static_cast<size_t>(mEntries)) - mThreshold;
+
+    // the validators that don't agree are already blocked, the others are
+    // candidates
+    size_t missing = 0;
+    auto addValidator = [&](size_t i) {
+        if (i == excluded)
+        {
+            return;
+        }
+        if (agreeing.get(i))
+        {
+            res.emplace_back(i);
+        }
+        else
+        {
+            missing++;
+        }
+    };
+    for (size_t i = 0; mNodes.nextSet(i); ++i)
+    {
+        addValidator(i);
+    }
+    for (auto i : mRepeatedNodes)
+    {
+        addValidator(i);
+    }
+    if (missing >= leftTillBlock)
+    {
+        res.resize(start);
+        return 0;
+    }
+    leftTillBlock -= missing;
+    size_t validators = res.size() - start;
+
+    // the inner sets append their own after the validators, an inner set
+    // for which nothing is needed is already blocked
+    std::vector<size_t> costs;
+    costs.reserve(mInnerSets.size());
+    for (auto const& inner : mInnerSets)
+    {
+        size_t cost = inner.findClosestVBlocking(agreeing, excluded, res);
+        if (cost == 0)
+        {
+            if (--leftTillBlock == 0)
+            {
+                res.resize(start);
+                return 0;
+            }
+        }
+        else
+        {
+            costs.emplace_back(cost);
+        }
+    }
+
+    // a validator costs 1, as little as an inner set can
+    size_t taken = std::min(validators, leftTillBlock);
+    leftTillBlock -= taken;
+
+    // then the cheapest inner sets, the first ones among those of the same
+    // cost: all of them under the cost of the last one needed, and as many
+    // as needed of that cost
+    size_t maxCost = SIZE_MAX;
+    size_t atMaxCost = SIZE_MAX;
+    if (leftTillBlock == 0)
+    {
+        maxCost = 0;
+    }
+    else if (leftTillBlock < costs.size())
+    {
+        std::vector<size_t> partitioned(costs);
+        auto nth = partitioned.begin() + (leftTillBlock - 1);
+        std::nth_element(partitioned.begin(), nth, partitioned.end());
+        maxCost = *nth;
+        atMaxCost = leftTillBlock -
+                    std::count_if(partitioned.begin(), nth, [&](size_t c) {
+                        return c < maxCost;
+                    });
+    }
+
+    // compacts `res` to the selection, nothing moves ahead of its position
+    size_t from = start + validators;
+    size_t to = start + taken;
+    for (auto cost : costs)
+    {
+        bool selected = cost < maxCost;
+        if (cost == maxCost && atMaxCost != 0)
+        {
+            atMaxCost--;
+            selected = true;
+        }
+        if (selected)
+        {
+            if (from != to)
+            {
+                std::copy(res.begin() + from, res.begin() + from + cost,
+                          res.begin() + to);
+            }
+            to += cost;
+        }
+        from += cost;
+    }
+    res.resize(to);
+    return to - start;
+}
+
+void
+CompiledQuorumSet::Level::collectNodes(BitSet& nodes) const
+{
+    nodes.inplaceUnion(mNodes);
+    for (auto const& inner : mInnerSets)
+    {
+        inner.collectNodes(nodes);
+    }
+}
+
+size_t
+CompiledQuorumSet::Level::getMemoryUsage() const
+{
+    size_t res = mNodes.size() / 8 +
+                 mRepeatedNodes.capacity() * sizeof(size_t) +
+                 mInnerSets.capacity() * sizeof(Level);
+    for (auto const& inner : mInnerSets)
+    {
+        res += inner.getMemoryUsage();
+    }
+    return res;
+}
+
+CompiledQuorumSet::CompiledQuorumSet(SCPQuorumSet const& qSet)
+    : CompiledQuorumSet(qSet, std::make_shared<NodeIndex>())
+{
+}
+
+CompiledQuorumSet::CompiledQuorumSet(SCPQuorumSet const& qSet,
+                                     std::shared_ptr<NodeIndex> index)
+    : mIndex(std::move(index))
+    , mRoot(qSet, *mIndex)
+    , mFlat(mRoot.mInnerSets.empty() && mRoot.mRepeatedNodes.empty())
+    , mFlatSlice(SIZE_MAX)
+    , mFlatVBlocking(SIZE_MAX)
+{
+    mRoot.collectNodes(mAllNodes);
+    if (mFlat && mRoot.mThreshold != 0)
+    {
+        // same as Level::isQuorumSlice and Level::isVBlocking
+        mFlatSlice = mRoot.mThreshold;
+        int leftTillBlock = (int)(1 + mRoot.mEntries - mRoot.mThreshold);
+        mFlatVBlocking = (size_t)std::max(1, leftTillBlock);
+    }
+}
+
+size_t
+CompiledQuorumSet::getMemoryUsage() const
+{
+    return sizeof(CompiledQuorumSet) + mRoot.getMemoryUsage() +
+           mAllNodes.size() / 8;
+}
+
+BitSet
+CompiledQuorumSet::toBitSet(std::vector<NodeID> const& nodes) const
+{
+    BitSet res(mIndex->size());
+    for (auto const& n : nodes)
+    {
+        size_t i = mIndex->find(n);
+        if (i != NodeIndex::npos)
+        {
+            res.set(i);
+        }
+    }
+    return res;
+}
+
+BitSet
+CompiledQuorumSet::translate(BitSet const& nodes, NodeIndex const& from) const
+{
+    if (&from == mIndex.get())
+    {
+        return nodes;
+    }
+    BitSet res(mIndex->size());
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        size_t j = mIndex->find(from.getNodeID(i));
+        if (j != NodeIndex::npos)
+        {
+            res.set(j);
+        }
+    }
+    return res;
+}
+}
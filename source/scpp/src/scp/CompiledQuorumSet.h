@@ -0,0 +1,173 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains quorum sets flattened into bitsets for slice and v-blocking tests.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "crypto/SecretKey.h"
+#include "scp/NodeIndex.h"
+#include "util/BitSet.h"
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * A SCPQuorumSet flattened into threshold + BitSet levels, so that slice and
+ * v-blocking tests are popcounts over intersections instead of linear scans
+ * of node vectors. Semantics are identical to the LocalNode functions
+ * operating on the XDR form, including for validators listed more than once.
+ *
+ * A flat quorum set (validators listed once, no inner sets), which is what
+ * Agora builds, is tested with a single popcount against a precomputed
+ * threshold.
+ */
+class CompiledQuorumSet
+{
+  public:
+    struct Level
+    {
+        uint32 mThreshold;
+        // number of entries (validators + inner sets) at this level
+        uint32 mEntries;
+        BitSet mNodes;
+        // extra occurrences of validators listed more than once
+        std::vector<size_t> mRepeatedNodes;
+        std::vector<Level> mInnerSets;
+
+        Level(SCPQuorumSet const& qSet, NodeIndex& index);
+
+        bool isQuorumSlice(BitSet const& nodes) const;
+        bool isVBlocking(BitSet const& nodes) const;
+
+        // appends the positions of CompiledQuorumSet::findClosestVBlocking,
+        // returns how many, 0 if `agreeing` already is not a slice
+        size_t findClosestVBlocking(BitSet const& agreeing, size_t excluded,
+                                    std::vector<size_t>& res) const;
+
+        // adds every node referenced by this level and its inner sets
+        void collectNodes(BitSet& nodes) const;
+
+        // bytes held by the level and its inner sets, besides sizeof(Level)
+        size_t getMemoryUsage() const;
+
+      private:
+        size_t countNodes(BitSet const& nodes) const;
+    };
+
+    // compiles qSet against its own node numbering
+    explicit CompiledQuorumSet(SCPQuorumSet const& qSet);
+
+    // compiles qSet against a numbering shared with other quorum sets
+    CompiledQuorumSet(SCPQuorumSet const& qSet,
+                      std::shared_ptr<NodeIndex> index);
+
+    NodeIndex const&
+    getNodeIndex() const
+    {
+        return *mIndex;
+    }
+
+    // every node this quorum set depends on, at any depth
+    BitSet const&
+    getAllNodes() const
+    {
+        return mAllNodes;
+    }
+
+    // converts a set of nodes into a BitSet over this quorum set's numbering,
+    // nodes that are not referenced by the numbering are ignored
+    BitSet toBitSet(std::vector<NodeID> const& nodes) const;
+
+    // converts a BitSet over the numbering `from` into this quorum set's
+    // numbering, which is free if both are the same
+    BitSet translate(BitSet const& nodes, NodeIndex const& from) const;
+
+    // `filter` is any callable taking a SCPStatement const&
+    template <typename Filter>
+    BitSet
+    toBitSet(std::map<NodeID, SCPEnvelope> const& map,
+             Filter const& filter) const
+    {
+        BitSet res(mIndex->size());
+        for (auto const& it : map)
+        {
+            size_t i = mIndex->find(it.first);
+            if (i != NodeIndex::npos && filter(it.second.statement))
+            {
+                res.set(i);
+            }
+        }
+        return res;
+    }
+
+    bool
+    isQuorumSlice(BitSet const& nodes) const
+    {
+        if (mFlat)
+        {
+            return mRoot.mNodes.intersectionCount(nodes) >= mFlatSlice;
+        }
+        return mRoot.isQuorumSlice(nodes);
+    }
+
+    // bytes held by the compiled form, besides the node index
+    size_t getMemoryUsage() const;
+
+    bool
+    isVBlocking(BitSet const& nodes) const
+    {
+        if (mFlat)
+        {
+            return mRoot.mNodes.intersectionCount(nodes) >= mFlatVBlocking;
+        }
+        return mRoot.isVBlocking(nodes);
+    }
+
+    // the fewest nodes of `agreeing` that would have to fail for the nodes
+    // outside of it to be v-blocking, as positions in the numbering, see
+    // LocalNode::findClosestVBlocking; the position `excluded` is skipped
+    // altogether
+    std::vector<size_t>
+    findClosestVBlocking(BitSet const& agreeing,
+                         size_t excluded = NodeIndex::npos) const
+    {
+        std::vector<size_t> res;
+        mRoot.findClosestVBlocking(agreeing, excluded, res);
+        return res;
+    }
+
+    // whether the set has no inner sets nor repeated validators
+    bool
+    isFlat() const
+    {
+        return mFlat;
+    }
+
+  private:
+    std::shared_ptr<NodeIndex> mIndex;
+    Level mRoot;
+    BitSet mAllNodes;
+
+    bool mFlat;
+    // nodes of the root needed for a slice and for a v-blocking set when
+    // flat, SIZE_MAX if there can't be any (threshold of 0)
+    size_t mFlatSlice;
+    size_t mFlatVBlocking;
+};
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+
+    Implementation of the envelopes of the local node along with their
+    encoding, see EncodedEnvelope.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/EncodedEnvelope.h"
+
+#include "crypto/XDRHasher.h"
+#include "util/GlobalChecks.h"
+#include "util/Tracy.h"
+#include "xdrpp/marshal.h"
+
+namespace stellar
+{
+static xdr::opaque_vec<>
+encode(SCPEnvelope const& envelope)
+{
+    ZoneScopedN("xdr_to_opaque");
+    return xdr::xdr_to_opaque(envelope);
+}
+
+EncodedEnvelope::EncodedEnvelope(SCPEnvelope const& envelope)
+    : mEnvelope(envelope), mXDR(encode(envelope))
+{
+    // the statement is encoded first, followed by the fixed size signature
+    size_t sigSize = xdr::xdr_size(envelope.signature);
+    dbgAssert(mXDR.size() > sigSize);
+    XDRHasher hasher;
+    hasher.addEncoded(ByteSlice(mXDR.data(), mXDR.size() - sigSize));
+    mStatementHash = hasher.finish();
+}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the envelopes of the local node along with their encoding.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * An envelope generated by the local node, along with its canonical XDR
+ * encoding and the hash of its statement.
+ *
+ * Both are computed once, when the protocols store the envelope as their
+ * latest one, so that the consumers of the latest envelopes (snapshots,
+ * the duplicate filter) don't encode it again.
+ */
+class EncodedEnvelope
+{
+    SCPEnvelope const mEnvelope;
+    xdr::opaque_vec<> mXDR;
+    uint512 mStatementHash;
+
+  public:
+    explicit EncodedEnvelope(SCPEnvelope const& envelope);
+
+    SCPEnvelope const&
+    getEnvelope() const
+    {
+        return mEnvelope;
+    }
+
+    // XDR encoding of the whole envelope
+    xdr::opaque_vec<> const&
+    getXDR() const
+    {
+        return mXDR;
+    }
+
+    // getXDRHashOf(getEnvelope().statement)
+    uint512 const&
+    getStatementHash() const
+    {
+        return mStatementHash;
+    }
+};
+}
@@ -8,6 +8,7 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/Hash.h"
 #include "lib/json/json.h"
+#include "scp/CompiledQuorumSet.h"
 #include "scp/QuorumSetUtils.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
@@ -15,16 +16,28 @@
 #include "xdrpp/marshal.h"
 #include <algorithm>
 #include <functional>
+#include <tuple>
 #include <unordered_set>
 
 namespace stellar
 {
+// the local quorum set is compiled against the numbering shared with the
+// envelope tables of the slots, so their node sets need no translation
+static std::shared_ptr<CompiledQuorumSet const>
+compileQuorumSet(SCPQuorumSet const& qSet, SCP* scp)
+{
+    return std::make_shared<CompiledQuorumSet const>(
+        qSet, scp ? scp->getNodeIndex() : std::make_shared<NodeIndex>());
+}
+
 LocalNode::LocalNode(NodeID const& nodeID, bool isValidator,
                      SCPQuorumSet const& qSet, SCP* scp)
     : mNodeID(nodeID), mIsValidator(isValidator), mQSet(qSet), mSCP(scp)
 {
     normalizeQSet(mQSet);
     mQSetHash = getHashOf(mQSet);
+    mCompiledQSet = compileQuorumSet(mQSet, mSCP);
+    computeNodeWeights();
 
     CLOG(INFO, "SCP") << "LocalNode::LocalNode"
                       << "@" << KeyUtils::toShortString(mNodeID)
@@ -48,6 +61,43 @@ LocalNode::updateQuorumSet(SCPQuorumSet const& qSet)
 {
     mQSetHash = getHashOf(qSet);
     mQSet = qSet;
+    mCompiledQSet = compileQuorumSet(mQSet, mSCP);
+    computeNodeWeights();
+}
+
+void
+LocalNode::computeNodeWeights()
+{
+    SCPQuorumSet qSet = mQSet;
+    normalizeQSet(qSet, &mNodeID);
+
+    mNodeWeights.clear();
+    // local node is in all quorum sets
+    mNodeWeights.emplace_back(mNodeID, UINT64_MAX);
+
+    std::set<NodeID> seen{mNodeID};
+    if (qSet.innerSets.empty())
+    {
+        // a flat set gives the same weight to all of its validators
+        uint64 w = qSet.validators.empty()
+                       ? 0
+                       : computeWeight(UINT64_MAX, qSet.validators.size(),
+                                       qSet.threshold);
+        for (auto const& cur : qSet.validators)
+        {
+            if (seen.insert(cur).second)
+            {
+                mNodeWeights.emplace_back(cur, w);
+            }
+        }
+        return;
+    }
+    forAllNodes(qSet, [&](NodeID const& cur) {
+        if (seen.insert(cur).second)
+        {
+            mNodeWeights.emplace_back(cur, getNodeWeight(cur, qSet));
+        }
+    });
 }
 
 SCPQuorumSet const&
@@ -56,6 +106,18 @@ LocalNode::getQuorumSet()
     return mQSet;
 }
 
+CompiledQuorumSet const&
+LocalNode::getCompiledQuorumSet()
+{
+    return *mCompiledQSet;
+}
+
+std::vector<std::pair<NodeID, uint64>> const&
+LocalNode::getNodeWeights()
+{
+    return mNodeWeights;
+}
+
 Hash const&
 LocalNode::getQuorumSetHash()
 {
@@ -122,38 +184,6 @@ LocalNode::getNodeWeight(NodeID const& nodeID, SCPQuorumSet const& qset)
     return 0;
 }
 
-bool
-LocalNode::isQuorumSliceInternal(SCPQuorumSet const& qset,
-                                 std::vector<NodeID> const& nodeSet)
-{
-    uint32 thresholdLeft = qset.threshold;
-    for (auto const& validator : qset.validators)
-    {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
-    }
-
-    for (auto const& inner : qset.innerSets)
-    {
-        if (isQuorumSliceInternal(inner, nodeSet))
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
 bool
 LocalNode::isQuorumSlice(SCPQuorumSet const& qSet,
                          std::vector<NodeID> const& nodeSet)
@@ -161,49 +191,8 @@ LocalNode::isQuorumSlice(SCPQuorumSet const& qSet,
     // CLOG(TRACE, "SCP") << "LocalNode::isQuorumSlice"
     //                    << " nodeSet.size: " << nodeSet.size();
 
-    return isQuorumSliceInternal(qSet, nodeSet);
-}
-
-// called recursively
-bool
-LocalNode::isVBlockingInternal(SCPQuorumSet const& qset,
-                               std::vector<NodeID> const& nodeSet)
-{
-    // There is no v-blocking set for {\empty}
-    if (qset.threshold == 0)
-    {
-        return false;
-    }
-
-    int leftTillBlock =
-        (int)((1 + qset.validators.size() + qset.innerSets.size()) -
-              qset.threshold);
-
-    for (auto const& validator : qset.validators)
-    {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
-    }
-    for (auto const& inner : qset.innerSets)
-    {
-        if (isVBlockingInternal(inner, nodeSet))
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    CompiledQuorumSet cqSet(qSet);
+    return cqSet.isQuorumSlice(cqSet.toBitSet(nodeSet));
 }
 
 bool
@@ -213,7 +202,8 @@ LocalNode::isVBlocking(SCPQuorumSet const& qSet,
     // CLOG(TRACE, "SCP") << "LocalNode::isVBlocking"
     //                    << " nodeSet.size: " << nodeSet.size();
 
-    return isVBlockingInternal(qSet, nodeSet);
+    CompiledQuorumSet cqSet(qSet);
+    return cqSet.isVBlocking(cqSet.toBitSet(nodeSet));
 }
 
 bool
@@ -221,16 +211,7 @@ LocalNode::isVBlocking(SCPQuorumSet const& qSet,
                        std::map<NodeID, SCPEnvelope> const& map,
                        std::function<bool(SCPStatement const&)> const& filter)
 {
-    std::vector<NodeID> pNodes;
-    for (auto const& it : map)
-    {
-        if (filter(it.second.statement))
-        {
-            pNodes.push_back(it.first);
-        }
-    }
-
-    return isVBlocking(qSet, pNodes);
+    return isVBlocking(CompiledQuorumSet(qSet), map, filter);
 }
 
 bool
@@ -239,38 +220,106 @@ LocalNode::isQuorum(
     std::function<SCPQuorumSetPtr(SCPStatement const&)> const& qfun,
     std::function<bool(SCPStatement const&)> const& filter)
 {
-    std::vector<NodeID> pNodes;
-    for (auto const& it : map)
+    return isQuorum(CompiledQuorumSet(qSet), map, qfun, filter);
+}
+
+void
+LocalNode::contractToQuorum(
+    BitSet& nodes, std::shared_ptr<NodeIndex> const& index,
+    std::function<SCPQuorumSetPtr(size_t)> const& qfun)
+{
+    // compiling quorum sets may extend the numbering, but only with nodes
+    // that are not candidates
+    size_t const n = index->size();
+
+    // resolve and compile every quorum set once, nodes sharing the same
+    // quorum set also share its compiled form
+    std::vector<SCPQuorumSetPtr> qSets;
+    std::map<SCPQuorumSet const*, CompiledQuorumSet> compiled;
+    std::vector<CompiledQuorumSet const*> nodeQSets(n);
+    for (size_t i = 0; nodes.nextSet(i); ++i)
     {
-        if (filter(it.second.statement))
+        auto qSetPtr = qfun(i);
+        if (!qSetPtr)
+        {
+            nodes.unset(i);
+            continue;
+        }
+        auto it = compiled.find(qSetPtr.get());
+        if (it == compiled.end())
         {
-            pNodes.push_back(it.first);
+            it = compiled
+                     .emplace(std::piecewise_construct,
+                              std::forward_as_tuple(qSetPtr.get()),
+                              std::forward_as_tuple(*qSetPtr, index))
+                     .first;
+            qSets.emplace_back(std::move(qSetPtr));
         }
+        nodeQSets[i] = &it->second;
     }
+    contractToQuorum(nodes, nodeQSets);
+}
 
-    size_t count = 0;
-    do
+void
+LocalNode::contractToQuorum(
+    BitSet& nodes, std::shared_ptr<NodeIndex> const& index,
+    std::function<std::shared_ptr<CompiledQuorumSet const>(size_t)> const&
+        cfun)
+{
+    size_t const n = index->size();
+    std::vector<std::shared_ptr<CompiledQuorumSet const>> qSets(n);
+    std::vector<CompiledQuorumSet const*> nodeQSets(n);
+    for (size_t i = 0; nodes.nextSet(i); ++i)
     {
-        count = pNodes.size();
-        std::vector<NodeID> fNodes(pNodes.size());
-        auto quorumFilter = [&](NodeID nodeID) -> bool {
-            auto qSetPtr = qfun(map.find(nodeID)->second.statement);
-            if (qSetPtr)
-            {
-                return isQuorumSlice(*qSetPtr, pNodes);
-            }
-            else
+        qSets[i] = cfun(i);
+        if (!qSets[i])
+        {
+            nodes.unset(i);
+            continue;
+        }
+        nodeQSets[i] = qSets[i].get();
+    }
+    contractToQuorum(nodes, nodeQSets);
+}
+
+void
+LocalNode::contractToQuorum(
+    BitSet& nodes, std::vector<CompiledQuorumSet const*> const& nodeQSets)
+{
+    size_t const n = nodeQSets.size();
+
+    // dependents[j] lists the candidates whose quorum set refers to j
+    std::vector<std::vector<size_t>> dependents(n);
+    std::vector<size_t> worklist;
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        auto const& deps = nodeQSets[i]->getAllNodes();
+        for (size_t j = 0; deps.nextSet(j) && j < n; ++j)
+        {
+            dependents[j].emplace_back(i);
+        }
+        worklist.emplace_back(i);
+    }
+
+    // remove nodes that don't have a slice within the surviving nodes,
+    // only re-checking the nodes that depend on a node just removed
+    while (!worklist.empty())
+    {
+        size_t i = worklist.back();
+        worklist.pop_back();
+        if (!nodes.get(i) || nodeQSets[i]->isQuorumSlice(nodes))
+        {
+            continue;
+        }
+        nodes.unset(i);
+        for (auto d : dependents[i])
+        {
+            if (nodes.get(d))
             {
-                return false;
+                worklist.emplace_back(d);
             }
-        };
-        auto it = std::copy_if(pNodes.begin(), pNodes.end(), fNodes.begin(),
-                               quorumFilter);
-        fNodes.resize(std::distance(fNodes.begin(), it));
-        pNodes = fNodes;
-    } while (count != pNodes.size());
-
-    return isQuorumSlice(qSet, pNodes);
+        }
+    }
 }
 
 std::vector<NodeID>
@@ -290,6 +339,32 @@ LocalNode::findClosestVBlocking(
     return findClosestVBlocking(qset, s, excluded);
 }
 
+std::vector<NodeID>
+LocalNode::findClosestVBlocking(
+    SCPQuorumSet const& qset, NodeEnvelopeTable const& envs,
+    std::function<bool(SCPStatement const&)> const& filter,
+    NodeID const* excluded)
+{
+    CompiledQuorumSet compiled(qset, envs.getSharedNodeIndex());
+    return findClosestVBlocking(compiled, envs.filter(filter), excluded);
+}
+
+std::vector<NodeID>
+LocalNode::findClosestVBlocking(CompiledQuorumSet const& qset,
+                                BitSet const& nodes, NodeID const* excluded)
+{
+    auto const& index = qset.getNodeIndex();
+    auto positions = qset.findClosestVBlocking(
+        nodes, excluded ? index.find(*excluded) : NodeIndex::npos);
+    std::vector<NodeID> res;
+    res.reserve(positions.size());
+    for (auto i : positions)
+    {
+        res.emplace_back(index.getNodeID(i));
+    }
+    return res;
+}
+
 std::vector<NodeID>
 LocalNode::findClosestVBlocking(SCPQuorumSet const& qset,
                                 std::set<NodeID> const& nodes,
@@ -376,7 +451,7 @@ Json::Value
 LocalNode::toJson(SCPQuorumSet const& qSet, bool fullKeys) const
 {
     return toJson(qSet, [&](PublicKey const& k) {
-        return mSCP->getDriver().toStrKey(k, fullKeys);
+        return mSCP->toStrKey(k, fullKeys);
     });
 }
 
@@ -8,6 +8,8 @@
 #include <set>
 #include <vector>
 
+#include "scp/CompiledQuorumSet.h"
+#include "scp/NodeEnvelopeTable.h"
 #include "scp/SCP.h"
 
 namespace stellar
@@ -29,6 +31,15 @@ class LocalNode
 
     SCP* mSCP;
 
+    // mQSet in its BitSet form, rebuilt whenever mQSet changes
+    std::shared_ptr<CompiledQuorumSet const> mCompiledQSet;
+
+    // weight of every node of mQSet for the nomination protocol, starting
+    // with the local node itself, rebuilt whenever mQSet changes
+    std::vector<std::pair<NodeID, uint64>> mNodeWeights;
+
+    void computeNodeWeights();
+
   public:
     LocalNode(NodeID const& nodeID, bool isValidator, SCPQuorumSet const& qSet,
               SCP* scp);
@@ -38,6 +49,8 @@ class LocalNode
     void updateQuorumSet(SCPQuorumSet const& qSet);
 
     SCPQuorumSet const& getQuorumSet();
+    CompiledQuorumSet const& getCompiledQuorumSet();
+    std::vector<std::pair<NodeID, uint64>> const& getNodeWeights();
     Hash const& getQuorumSetHash();
     bool isValidator();
 
@@ -68,6 +81,15 @@ class LocalNode
                 std::function<bool(SCPStatement const&)> const& filter =
                     [](SCPStatement const&) { return true; });
 
+    // overload for any callable `filter`, so it gets inlined in the scan
+    template <typename Filter>
+    static bool
+    isVBlocking(CompiledQuorumSet const& qSet,
+                std::map<NodeID, SCPEnvelope> const& map, Filter const& filter)
+    {
+        return qSet.isVBlocking(qSet.toBitSet(map, filter));
+    }
+
     // `isQuorum` tests if the filtered nodes V form a quorum
     // (meaning for each v \in V there is q \in Q(v)
     // included in V and we have quorum on V for qSetHash). `qfun` extracts the
@@ -79,6 +101,72 @@ class LocalNode
              std::function<bool(SCPStatement const&)> const& filter =
                  [](SCPStatement const&) { return true; });
 
+    // overload for any callable `qfun` & `filter`
+    template <typename QFun, typename Filter>
+    static bool
+    isQuorum(CompiledQuorumSet const& qSet,
+             std::map<NodeID, SCPEnvelope> const& map, QFun const& qfun,
+             Filter const& filter)
+    {
+        // number the candidates [0, candidates.size())
+        auto index = std::make_shared<NodeIndex>();
+        std::vector<SCPStatement const*> candidates;
+        for (auto const& it : map)
+        {
+            if (filter(it.second.statement))
+            {
+                index->intern(it.first);
+                candidates.emplace_back(&it.second.statement);
+            }
+        }
+        BitSet nodes(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            nodes.set(i);
+        }
+        contractToQuorum(nodes, index,
+                         [&](size_t i) { return qfun(*candidates[i]); });
+        return qSet.isQuorumSlice(qSet.translate(nodes, *index));
+    }
+
+    // overloads working on the latest envelope tables, when their index is
+    // the one `qSet` was compiled against the node sets are used as is
+    template <typename Filter>
+    static bool
+    isVBlocking(CompiledQuorumSet const& qSet, NodeEnvelopeTable const& envs,
+                Filter const& filter)
+    {
+        return qSet.isVBlocking(
+            qSet.translate(envs.filter(filter), envs.getNodeIndex()));
+    }
+
+    template <typename QFun, typename Filter>
+    static bool
+    isQuorum(CompiledQuorumSet const& qSet, NodeEnvelopeTable const& envs,
+             QFun const& qfun, Filter const& filter)
+    {
+        return isQuorum(qSet, envs, qfun, envs.filter(filter));
+    }
+
+    // same, with the filtered nodes of `envs` already computed
+    static bool
+    isVBlocking(CompiledQuorumSet const& qSet, NodeEnvelopeTable const& envs,
+                BitSet const& nodes)
+    {
+        return qSet.isVBlocking(qSet.translate(nodes, envs.getNodeIndex()));
+    }
+
+    template <typename QFun>
+    static bool
+    isQuorum(CompiledQuorumSet const& qSet, NodeEnvelopeTable const& envs,
+             QFun const& qfun, BitSet nodes)
+    {
+        contractToQuorum(nodes, envs.getSharedNodeIndex(), [&](size_t i) {
+            return qfun(envs.at(i).statement);
+        });
+        return qSet.isQuorumSlice(qSet.translate(nodes, envs.getNodeIndex()));
+    }
+
     // computes the distance to the set of v-blocking sets given
     // a set of nodes that agree (but can fail)
     // excluded, if set will be skipped altogether
@@ -91,6 +179,16 @@ class LocalNode
         std::function<bool(SCPStatement const&)> const& filter =
             [](SCPStatement const&) { return true; },
         NodeID const* excluded = nullptr);
+    // compiles `qset` against the numbering of `envs`
+    static std::vector<NodeID> findClosestVBlocking(
+        SCPQuorumSet const& qset, NodeEnvelopeTable const& envs,
+        std::function<bool(SCPStatement const&)> const& filter,
+        NodeID const* excluded = nullptr);
+    // `nodes` over the numbering of `qset`, the nodes are in no particular
+    // order
+    static std::vector<NodeID>
+    findClosestVBlocking(CompiledQuorumSet const& qset, BitSet const& nodes,
+                         NodeID const* excluded);
 
     static Json::Value toJson(SCPQuorumSet const& qSet,
                               std::function<std::string(PublicKey const&)> r);
@@ -104,10 +202,20 @@ class LocalNode
     // returns a quorum set {{ nodeID }}
     static SCPQuorumSet buildSingletonQSet(NodeID const& nodeID);
 
-    // called recursively
-    static bool isQuorumSliceInternal(SCPQuorumSet const& qset,
-                                      std::vector<NodeID> const& nodeSet);
-    static bool isVBlockingInternal(SCPQuorumSet const& qset,
-                                    std::vector<NodeID> const& nodeSet);
+    // transitive part of `isQuorum`: removes from `nodes` (numbered by
+    // `index`) the nodes that don't have a slice within `nodes`, until a
+    // fixpoint is reached. `qfun(i)` returns the quorum set of node i.
+    static void
+    contractToQuorum(BitSet& nodes, std::shared_ptr<NodeIndex> const& index,
+                     std::function<SCPQuorumSetPtr(size_t)> const& qfun);
+    // same, with quorum sets already compiled against `index`
+    static void contractToQuorum(
+        BitSet& nodes, std::shared_ptr<NodeIndex> const& index,
+        std::function<std::shared_ptr<CompiledQuorumSet const>(size_t)> const&
+            cfun);
+    // the fixpoint itself, nodeQSets[i] being the quorum set of node i
+    static void
+    contractToQuorum(BitSet& nodes,
+                     std::vector<CompiledQuorumSet const*> const& nodeQSets);
 };
 }
@@ -0,0 +1,65 @@
+/*******************************************************************************
+
+    Implementation of the latest envelope of every node, by node index, see
+    NodeEnvelopeTable.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/NodeEnvelopeTable.h"
+
+namespace stellar
+{
+NodeEnvelopeTable::NodeEnvelopeTable(std::shared_ptr<NodeIndex> index)
+    : mIndex(std::move(index))
+{
+}
+
+NodeEnvelopeTable::const_iterator
+NodeEnvelopeTable::find(NodeID const& nodeID) const
+{
+    size_t i = mIndex->find(nodeID);
+    if (i == NodeIndex::npos || !mPresent.get(i))
+    {
+        return end();
+    }
+    return const_iterator(this, i);
+}
+
+size_t
+NodeEnvelopeTable::assign(NodeID const& nodeID, SCPEnvelope const& env)
+{
+    size_t i = mIndex->intern(nodeID);
+    if (i >= mEntries.size())
+    {
+        mEntries.resize(i + 1);
+    }
+    if (!mPresent.get(i))
+    {
+        mEntries[i].first = nodeID;
+        mPresent.set(i);
+    }
+    else
+    {
+        mEnvelopeBytes -= xdr::xdr_size(mEntries[i].second);
+    }
+    mEntries[i].second = env;
+    mEnvelopeBytes += xdr::xdr_size(env);
+    return i;
+}
+
+size_t
+NodeEnvelopeTable::getMemoryUsage() const
+{
+    return mEntries.capacity() * sizeof(value_type) + mPresent.size() / 8 +
+           mEnvelopeBytes;
+}
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the latest envelope of every node, by node index.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "scp/CompiledQuorumSet.h"
+#include "util/BitSet.h"
+
+namespace stellar
+{
+/**
+ * The latest envelope of every node, stored in a dense vector addressed by
+ * the node's position in a NodeIndex shared with the rest of SCP.
+ * Lookups are O(1), scans are linear in memory, and the set of nodes that
+ * have (or match a filter on) an envelope is directly a BitSet usable with
+ * CompiledQuorumSets built against the same index.
+ *
+ * The interface mimics the subset of std::map<NodeID, SCPEnvelope> the
+ * protocols use; iteration is in index order, i.e. the order in which the
+ * nodes were first seen by the index.
+ */
+class NodeEnvelopeTable
+{
+  public:
+    using value_type = std::pair<NodeID, SCPEnvelope>;
+
+    class const_iterator
+    {
+        NodeEnvelopeTable const* mTable;
+        size_t mPos;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = NodeEnvelopeTable::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = value_type const*;
+        using reference = value_type const&;
+
+        const_iterator(NodeEnvelopeTable const* table, size_t pos)
+            : mTable(table), mPos(pos)
+        {
+        }
+
+        reference operator*() const
+        {
+            return mTable->mEntries[mPos];
+        }
+        pointer operator->() const
+        {
+            return &mTable->mEntries[mPos];
+        }
+        const_iterator&
+        operator++()
+        {
+            mPos = mTable->nextPresent(mPos + 1);
+            return *this;
+        }
+        bool
+        operator==(const_iterator const& other) const
+        {
+            return mPos == other.mPos;
+        }
+        bool
+        operator!=(const_iterator const& other) const
+        {
+            return mPos != other.mPos;
+        }
+
+        // position of the node in the NodeIndex
+        size_t
+        index() const
+        {
+            return mPos;
+        }
+    };
+
+    explicit NodeEnvelopeTable(std::shared_ptr<NodeIndex> index);
+
+    const_iterator
+    begin() const
+    {
+        return const_iterator(this, nextPresent(0));
+    }
+    const_iterator
+    end() const
+    {
+        return const_iterator(this, NodeIndex::npos);
+    }
+
+    const_iterator find(NodeID const& nodeID) const;
+
+    // inserts or replaces the envelope of `nodeID`, returns its position
+    size_t assign(NodeID const& nodeID, SCPEnvelope const& env);
+
+    size_t
+    size() const
+    {
+        return mPresent.count();
+    }
+    bool
+    empty() const
+    {
+        return mPresent.empty();
+    }
+
+    // the envelope of the node at position `i`, which must be present
+    SCPEnvelope const&
+    at(size_t i) const
+    {
+        return mEntries[i].second;
+    }
+
+    // bytes held by the table, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
+
+    // nodes that have an envelope
+    BitSet const&
+    getNodes() const
+    {
+        return mPresent;
+    }
+
+    // nodes for which `filter(statement)` holds
+    template <typename Filter>
+    BitSet
+    filter(Filter const& filter) const
+    {
+        BitSet res(mEntries.size());
+        for (size_t i = 0; mPresent.nextSet(i); ++i)
+        {
+            if (filter(mEntries[i].second.statement))
+            {
+                res.set(i);
+            }
+        }
+        return res;
+    }
+
+    // calls `visitor(envelope)` on the envelopes for which `filter(entry)`
+    // holds, ordered by node ID, until it returns false
+    // returns false if the visitor stopped
+    template <typename Filter, typename Visitor>
+    bool
+    forEachByNodeID(Filter const& filter, Visitor const& visitor) const
+    {
+        std::vector<value_type const*> entries;
+        entries.reserve(size());
+        for (size_t i = 0; mPresent.nextSet(i); ++i)
+        {
+            if (filter(mEntries[i]))
+            {
+                entries.emplace_back(&mEntries[i]);
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](value_type const* l, value_type const* r) {
+                      return l->first < r->first;
+                  });
+        for (auto e : entries)
+        {
+            if (!visitor(e->second))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    NodeIndex const&
+    getNodeIndex() const
+    {
+        return *mIndex;
+    }
+    std::shared_ptr<NodeIndex> const&
+    getSharedNodeIndex() const
+    {
+        return mIndex;
+    }
+
+  private:
+    size_t
+    nextPresent(size_t i) const
+    {
+        return mPresent.nextSet(i) ? i : NodeIndex::npos;
+    }
+
+    std::shared_ptr<NodeIndex> mIndex;
+    // mEntries[i] is only meaningful if mPresent.get(i)
+    std::vector<value_type> mEntries;
+    BitSet mPresent;
+    // XDR size of the envelopes present
+    size_t mEnvelopeBytes{0};
+};
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+
+    Implementation of the dense numbering of the node IDs known to SCP, see
+    NodeIndex.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/NodeIndex.h"
+#include "crypto/KeyUtils.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace stellar
+{
+constexpr size_t NodeIndex::npos;
+
+size_t
+NodeIndex::intern(NodeID const& nodeID)
+{
+    auto it = mIndices.find(nodeID);
+    if (it != mIndices.end())
+    {
+        return it->second;
+    }
+    if (mNodes.size() >= std::numeric_limits<uint32>::max())
+    {
+        throw std::runtime_error("NodeIndex: too many nodes");
+    }
+    uint32 res = static_cast<uint32>(mNodes.size());
+    mIndices.emplace(nodeID, res);
+    mNodes.emplace_back(nodeID);
+    return res;
+}
+
+size_t
+NodeIndex::find(NodeID const& nodeID) const
+{
+    auto it = mIndices.find(nodeID);
+    return it == mIndices.end() ? npos : it->second;
+}
+
+NodeID const&
+NodeIndex::getNodeID(size_t index) const
+{
+    if (index >= mNodes.size())
+    {
+        throw std::runtime_error("NodeIndex: index out of range");
+    }
+    return mNodes[index];
+}
+
+std::string const&
+NodeIndex::getName(size_t index, bool fullKey) const
+{
+    return getName(index, fullKey, [](NodeID const& nodeID, bool full) {
+        return full ? KeyUtils::toStrKey(nodeID)
+                    : KeyUtils::toShortString(nodeID);
+    });
+}
+
+void
+NodeIndex::clear()
+{
+    mIndices.clear();
+    mNodes.clear();
+    mFullNames.clear();
+    mShortNames.clear();
+}
+}
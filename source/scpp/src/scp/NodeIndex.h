@@ -0,0 +1,99 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the dense numbering of the node IDs known to SCP.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/SecretKey.h"
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+/**
+ * Dense numbering of node IDs, so sets of nodes can be represented as
+ * BitSets and algorithms can work on integers instead of hashing and
+ * comparing keys.
+ *
+ * A node keeps the number it got on first sight for the lifetime of the
+ * index. The instance of SCP (see SCP::getNodeIndex) is shared by the local
+ * quorum set, the envelope tables of the slots and the quorum trackers, so
+ * their node sets can be combined as is.
+ *
+ * Numbers fit in 32 bits, which keeps the map half the size; they are
+ * returned as size_t, the index type of BitSet.
+ */
+class NodeIndex
+{
+    std::unordered_map<NodeID, uint32> mIndices;
+    std::vector<NodeID> mNodes;
+    // names of the nodes, rendered on first use (see getName), empty if not
+    mutable std::vector<std::string> mFullNames;
+    mutable std::vector<std::string> mShortNames;
+
+  public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    // returns the index of nodeID, assigning the next free one if needed
+    size_t intern(NodeID const& nodeID);
+
+    // returns the index of nodeID or npos if it was never interned
+    size_t find(NodeID const& nodeID) const;
+
+    NodeID const& getNodeID(size_t index) const;
+
+    size_t
+    size() const
+    {
+        return mNodes.size();
+    }
+
+    std::vector<NodeID> const&
+    getNodes() const
+    {
+        return mNodes;
+    }
+
+    // the name of the node at `index` (its StrKey if `fullKey`, a short
+    // form otherwise), which is `render(nodeID, fullKey)` the first time it
+    // is asked for: logs and JSON dumps render the same few keys over and
+    // over. Like interning, this isn't thread safe.
+    template <typename Render>
+    std::string const&
+    getName(size_t index, bool fullKey, Render const& render) const
+    {
+        auto& names = fullKey ? mFullNames : mShortNames;
+        if (names.size() <= index)
+        {
+            names.resize(mNodes.size());
+        }
+        auto& res = names[index];
+        if (res.empty())
+        {
+            res = render(getNodeID(index), fullKey);
+        }
+        return res;
+    }
+
+    // same, with `KeyUtils::toStrKey` and `KeyUtils::toShortString`
+    std::string const& getName(size_t index, bool fullKey) const;
+
+    // forgets every node, for indices that aren't shared
+    void clear();
+};
+}
@@ -12,6 +12,7 @@
 #include "scp/QuorumSetUtils.h"
 #include "util/GlobalChecks.h"
 #include "util/Logging.h"
+#include "util/Tracy.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 #include <algorithm>
@@ -22,7 +23,13 @@ namespace stellar
 using namespace std::placeholders;
 
 NominationProtocol::NominationProtocol(Slot& slot)
-    : mSlot(slot), mRoundNumber(0), mNominationStarted(false)
+    : mSlot(slot)
+    , mRoundNumber(0)
+    , mLatestNominations(slot.getSCP().getNodeIndex())
+    , mNominationStarted(false)
+    , mCombining(false)
+    , mCandidatesChanged(false)
+    , mNominationPending(false)
 {
 }
 
@@ -39,7 +46,8 @@ NominationProtocol::isNewerStatement(NodeID const& nodeID,
     }
     else
     {
-        res = isNewerStatement(oldp->second.statement.pledges.nominate(), st);
+        res = mSummaries.isNewerStatement(oldp.index(), st,
+                                          mSlot.getValueTable());
     }
     return res;
 }
@@ -72,12 +80,13 @@ NominationProtocol::isSubsetHelper(xdr::xvector<Value> const& p,
 SCPDriver::ValidationLevel
 NominationProtocol::validateValue(Value const& v)
 {
-    return mSlot.getSCPDriver().validateValue(mSlot.getSlotIndex(), v, true);
+    return mSlot.validateValue(v, true);
 }
 
 Value
 NominationProtocol::extractValidValue(Value const& value)
 {
+    ZoneScopedN("SCPDriver::extractValidValue");
     return mSlot.getSCPDriver().extractValidValue(mSlot.getSlotIndex(), value);
 }
 
@@ -127,21 +136,69 @@ NominationProtocol::isSane(SCPStatement const& st)
 void
 NominationProtocol::recordEnvelope(SCPEnvelope const& env)
 {
-    auto const& st = env.statement;
-    auto oldp = mLatestNominations.find(st.nodeID);
-    if (oldp == mLatestNominations.end())
+    size_t i = mLatestNominations.assign(env.statement.nodeID, env);
+    mSummaries.assign(i, env.statement.pledges.nominate(),
+                      mSlot.getValueTable());
+    mSlot.getSCP().recordLatestMessage(i, mSlot.getSlotIndex());
+    mSlot.recordStatement(env.statement);
+}
+
+void
+NominationProtocol::emitNomination()
+{
+    mNominationPending = true;
+    if (!mSlot.isEmissionDeferred())
     {
-        mLatestNominations.insert(std::make_pair(st.nodeID, env));
+        mSlot.deferEmission();
+        mSlot.emitDeferred();
     }
-    else
+}
+
+void
+NominationProtocol::emitDeferredNomination()
+{
+    if (!mNominationPending)
     {
-        oldp->second = env;
+        return;
+    }
+
+    // the local statement is recorded unsigned while recording it changes
+    // it again, so that only the last one gets signed: the local node
+    // doesn't verify its own statements
+    SCPEnvelope envelope;
+    while (mNominationPending)
+    {
+        mNominationPending = false;
+        envelope = mSlot.createEnvelope(makeStatement(), false);
+        if (mSlot.processEnvelope(envelope, true) !=
+            SCP::EnvelopeState::VALID)
+        {
+            // there is a bug in the application if it queued up
+            // a statement for itself that it considers invalid
+            throw std::runtime_error("moved to a bad state (nomination)");
+        }
+    }
+
+    mSlot.signEnvelope(envelope);
+    auto const& st = envelope.statement;
+    mLatestNominations.assign(st.nodeID, envelope);
+
+    if (!mLastEnvelope ||
+        isNewerStatement(
+            mLastEnvelope->getEnvelope().statement.pledges.nominate(),
+            st.pledges.nominate()))
+    {
+        mLastEnvelope = std::make_unique<EncodedEnvelope>(envelope);
+        if (mSlot.isFullyValidated())
+        {
+            ZoneScopedN("SCPDriver::emitEnvelope");
+            mSlot.getSCPDriver().emitEnvelope(envelope);
+        }
     }
-    mSlot.recordStatement(env.statement);
 }
 
-void
-NominationProtocol::emitNomination()
+SCPStatement
+NominationProtocol::makeStatement() const
 {
     SCPStatement st;
     st.nodeID = mSlot.getLocalNode()->getNodeID();
@@ -158,28 +215,7 @@ NominationProtocol::emitNomination()
     {
         nom.accepted.emplace_back(a);
     }
-
-    SCPEnvelope envelope = mSlot.createEnvelope(st);
-
-    if (mSlot.processEnvelope(envelope, true) == SCP::EnvelopeState::VALID)
-    {
-        if (!mLastEnvelope ||
-            isNewerStatement(mLastEnvelope->statement.pledges.nominate(),
-                             st.pledges.nominate()))
-        {
-            mLastEnvelope = std::make_unique<SCPEnvelope>(envelope);
-            if (mSlot.isFullyValidated())
-            {
-                mSlot.getSCPDriver().emitEnvelope(envelope);
-            }
-        }
-    }
-    else
-    {
-        // there is a bug in the application if it queued up
-        // a statement for itself that it considers invalid
-        throw std::runtime_error("moved to a bad state (nomination)");
-    }
+    return st;
 }
 
 bool
@@ -209,18 +245,45 @@ NominationProtocol::applyAll(SCPNomination const& nom,
 void
 NominationProtocol::updateRoundLeaders()
 {
-    SCPQuorumSet myQSet = mSlot.getLocalNode()->getQuorumSet();
+    ZoneScoped;
+    // weights are computed against the normalized local quorum set,
+    // with the local node first
+    auto const& weights = mSlot.getLocalNode()->getNodeWeights();
+
+    // priority is only computed for the nodes passing the weight check:
+    // weight > 0 && hashNode(N) <= weight
+    std::vector<NodeID> nodes;
+    std::vector<uint64> nodeWeights;
+    for (auto const& w : weights)
+    {
+        if (w.second > 0)
+        {
+            nodes.emplace_back(w.first);
+            nodeWeights.emplace_back(w.second);
+        }
+    }
+    auto hashesN = hashNodes(false, nodes);
 
-    // initialize priority with value derived from self
-    std::set<NodeID> newRoundLeaders;
-    auto localID = mSlot.getLocalNode()->getNodeID();
-    normalizeQSet(myQSet, &localID);
+    std::vector<NodeID> eligible;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        // w is inclusive here as 0 <= hashNode <= UINT64_MAX
+        if (hashesN[i] <= nodeWeights[i])
+        {
+            eligible.emplace_back(nodes[i]);
+        }
+    }
+    auto priorities = hashNodes(true, eligible);
 
-    newRoundLeaders.insert(localID);
-    uint64 topPriority = getNodePriority(localID, myQSet);
+    // initialize priority with value derived from self, which always passes
+    // the weight check and is first
+    std::set<NodeID> newRoundLeaders;
+    newRoundLeaders.insert(eligible.front());
+    uint64 topPriority = priorities.front();
 
-    LocalNode::forAllNodes(myQSet, [&](NodeID const& cur) {
-        uint64 w = getNodePriority(cur, myQSet);
+    for (size_t i = 0; i < eligible.size(); i++)
+    {
+        uint64 w = priorities[i];
         if (w > topPriority)
         {
             topPriority = w;
@@ -228,9 +291,9 @@ NominationProtocol::updateRoundLeaders()
         }
         if (w == topPriority && w > 0)
         {
-            newRoundLeaders.insert(cur);
+            newRoundLeaders.insert(eligible[i]);
         }
-    });
+    }
     // expand mRoundLeaders with the newly computed leaders
     mRoundLeaders.insert(newRoundLeaders.begin(), newRoundLeaders.end());
     if (Logging::logDebug("SCP"))
@@ -240,7 +303,7 @@ NominationProtocol::updateRoundLeaders()
         for (auto const& rl : mRoundLeaders)
         {
             CLOG(DEBUG, "SCP")
-                << "    leader " << mSlot.getSCPDriver().toShortString(rl);
+                << "    leader " << mSlot.getSCP().toStrKey(rl, false);
         }
     }
 }
@@ -249,18 +312,50 @@ uint64
 NominationProtocol::hashNode(bool isPriority, NodeID const& nodeID)
 {
     dbgAssert(!mPreviousValue.empty());
+    ZoneScopedN("SCPDriver::computeHashNode");
     return mSlot.getSCPDriver().computeHashNode(
         mSlot.getSlotIndex(), mPreviousValue, isPriority, mRoundNumber, nodeID);
 }
 
+std::vector<uint64>
+NominationProtocol::hashNodes(bool isPriority,
+                              std::vector<NodeID> const& nodeIDs)
+{
+    dbgAssert(!mPreviousValue.empty());
+    std::vector<uint64> res(nodeIDs.size());
+    if (!nodeIDs.empty())
+    {
+        ZoneScopedN("SCPDriver::computeHashNodes");
+        mSlot.getSCPDriver().computeHashNodes(mSlot.getSlotIndex(),
+                                              mPreviousValue, isPriority,
+                                              mRoundNumber, nodeIDs, res);
+    }
+    return res;
+}
+
 uint64
 NominationProtocol::hashValue(Value const& value)
 {
     dbgAssert(!mPreviousValue.empty());
+    ZoneScopedN("SCPDriver::computeValueHash");
     return mSlot.getSCPDriver().computeValueHash(
         mSlot.getSlotIndex(), mPreviousValue, mRoundNumber, value);
 }
 
+std::vector<uint64>
+NominationProtocol::hashValues(std::vector<Value> const& values)
+{
+    dbgAssert(!mPreviousValue.empty());
+    std::vector<uint64> res(values.size());
+    if (!values.empty())
+    {
+        ZoneScopedN("SCPDriver::computeValueHashes");
+        mSlot.getSCPDriver().computeValueHashes(
+            mSlot.getSlotIndex(), mPreviousValue, mRoundNumber, values, res);
+    }
+    return res;
+}
+
 uint64
 NominationProtocol::getNodePriority(NodeID const& nodeID,
                                     SCPQuorumSet const& qset)
@@ -292,12 +387,12 @@ NominationProtocol::getNodePriority(NodeID const& nodeID,
 }
 
 Value
-NominationProtocol::getNewValueFromNomination(SCPNomination const& nom)
+NominationProtocol::getNewValueFromNomination(SCPNomination const& nom,
+                                              bool& pending)
 {
     // pick the highest value we don't have from the leader
     // sorted using hashValue.
-    Value newVote;
-    uint64 newHash = 0;
+    std::vector<Value> candidates;
 
     applyAll(nom, [&](Value const& value) {
         Value valueToNominate;
@@ -306,6 +401,10 @@ NominationProtocol::getNewValueFromNomination(SCPNomination const& nom)
         {
             valueToNominate = value;
         }
+        else if (vl == SCPDriver::kPendingValue)
+        {
+            pending = true;
+        }
         else
         {
             valueToNominate = extractValidValue(value);
@@ -314,21 +413,33 @@ NominationProtocol::getNewValueFromNomination(SCPNomination const& nom)
         {
             if (mVotes.find(valueToNominate) == mVotes.end())
             {
-                uint64 curHash = hashValue(valueToNominate);
-                if (curHash >= newHash)
-                {
-                    newHash = curHash;
-                    newVote = valueToNominate;
-                }
+                candidates.emplace_back(std::move(valueToNominate));
             }
         }
     });
-    return newVote;
+
+    if (candidates.empty())
+    {
+        return Value();
+    }
+
+    // on ties, the last value wins
+    auto hashes = hashValues(candidates);
+    size_t newVote = 0;
+    for (size_t i = 1; i < candidates.size(); i++)
+    {
+        if (hashes[i] >= hashes[newVote])
+        {
+            newVote = i;
+        }
+    }
+    return std::move(candidates[newVote]);
 }
 
 SCP::EnvelopeState
 NominationProtocol::processEnvelope(SCPEnvelope const& envelope)
 {
+    ZoneScoped;
     auto const& st = envelope.statement;
     auto const& nom = st.pledges.nominate();
 
@@ -341,113 +452,184 @@ NominationProtocol::processEnvelope(SCPEnvelope const& envelope)
             recordEnvelope(envelope);
             res = SCP::EnvelopeState::VALID;
 
-            if (mNominationStarted)
+            if (mNominationStarted && !advanceNomination(st))
             {
-                bool modified =
-                    false; // tracks if we should emit a new nomination message
-                bool newCandidates = false;
+                mSlot.deferEnvelope(envelope);
+            }
+        }
+        else
+        {
+            CLOG(TRACE, "SCP")
+                << "NominationProtocol: message didn't pass sanity check";
+        }
+    }
+    return res;
+}
 
-                // attempts to promote some of the votes to accepted
-                for (auto const& v : nom.votes)
-                {
-                    if (mAccepted.find(v) != mAccepted.end())
-                    { // v is already accepted
-                        continue;
-                    }
-                    if (mSlot.federatedAccept(
-                            [&v](SCPStatement const& st) -> bool {
-                                auto const& nom = st.pledges.nominate();
-                                bool res;
-                                res = (std::find(nom.votes.begin(),
-                                                 nom.votes.end(),
-                                                 v) != nom.votes.end());
-                                return res;
-                            },
-                            std::bind(&NominationProtocol::acceptPredicate, v,
-                                      _1),
-                            mLatestNominations))
-                    {
-                        auto vl = validateValue(v);
-                        if (vl == SCPDriver::kFullyValidatedValue)
-                        {
-                            mAccepted.emplace(v);
-                            mVotes.emplace(v);
-                            modified = true;
-                        }
-                        else
-                        {
-                            // the value made it pretty far:
-                            // see if we can vote for a variation that
-                            // we consider valid
-                            Value toVote;
-                            toVote = extractValidValue(v);
-                            if (!toVote.empty())
-                            {
-                                if (mVotes.emplace(toVote).second)
-                                {
-                                    modified = true;
-                                }
-                            }
-                        }
-                    }
-                }
-                // attempts to promote accepted values to candidates
-                for (auto const& a : mAccepted)
-                {
-                    if (mCandidates.find(a) != mCandidates.end())
-                    {
-                        continue;
-                    }
-                    if (mSlot.federatedRatify(
-                            std::bind(&NominationProtocol::acceptPredicate, a,
-                                      _1),
-                            mLatestNominations))
-                    {
-                        mCandidates.emplace(a);
-                        newCandidates = true;
-                    }
-                }
+void
+NominationProtocol::processDeferredEnvelope(SCPEnvelope const& envelope)
+{
+    // the statement was recorded when it was received
+    if (mNominationStarted && !advanceNomination(envelope.statement))
+    {
+        mSlot.deferEnvelope(envelope);
+    }
+}
+
+bool
+NominationProtocol::advanceNomination(SCPStatement const& st)
+{
+    auto const& nom = st.pledges.nominate();
 
-                // only take round leader votes if we're still looking for
-                // candidates
-                if (mCandidates.empty() &&
-                    mRoundLeaders.find(st.nodeID) != mRoundLeaders.end())
+    bool modified = false; // tracks if we should emit a new nomination message
+    bool newCandidates = false;
+    bool pending = false;
+
+    // attempts to promote some of the votes to accepted
+    for (auto const& v : nom.votes)
+    {
+        if (mAccepted.find(v) != mAccepted.end())
+        { // v is already accepted
+            continue;
+        }
+        auto h = mSlot.getValueTable().intern(v);
+        if (mSlot.federatedAccept(
+                mSummaries.getVotedNodes(mLatestNominations.getNodes(), h),
+                mSummaries.getAcceptedNodes(mLatestNominations.getNodes(), h),
+                mLatestNominations))
+        {
+            auto vl = validateValue(v);
+            if (vl == SCPDriver::kFullyValidatedValue)
+            {
+                mAccepted.emplace(v);
+                mVotes.emplace(v);
+                modified = true;
+            }
+            else if (vl == SCPDriver::kPendingValue)
+            {
+                pending = true;
+            }
+            else
+            {
+                // the value made it pretty far:
+                // see if we can vote for a variation that
+                // we consider valid
+                Value toVote;
+                toVote = extractValidValue(v);
+                if (!toVote.empty())
                 {
-                    Value newVote = getNewValueFromNomination(nom);
-                    if (!newVote.empty())
+                    if (mVotes.emplace(toVote).second)
                     {
-                        mVotes.emplace(newVote);
                         modified = true;
-                        mSlot.getSCPDriver().nominatingValue(
-                            mSlot.getSlotIndex(), newVote);
                     }
                 }
-
-                if (modified)
-                {
-                    emitNomination();
-                }
-
-                if (newCandidates)
-                {
-                    mLatestCompositeCandidate =
-                        mSlot.getSCPDriver().combineCandidates(
-                            mSlot.getSlotIndex(), mCandidates);
-
-                    mSlot.getSCPDriver().updatedCandidateValue(
-                        mSlot.getSlotIndex(), mLatestCompositeCandidate);
-
-                    mSlot.bumpState(mLatestCompositeCandidate, false);
-                }
             }
         }
-        else
+    }
+    // attempts to promote accepted values to candidates
+    for (auto const& a : mAccepted)
+    {
+        if (mCandidates.find(a) != mCandidates.end())
         {
-            CLOG(TRACE, "SCP")
-                << "NominationProtocol: message didn't pass sanity check";
+            continue;
+        }
+        auto h = mSlot.getValueTable().intern(a);
+        if (mSlot.federatedRatify(
+                mSummaries.getAcceptedNodes(mLatestNominations.getNodes(), h),
+                mLatestNominations))
+        {
+            mCandidates.emplace(a);
+            newCandidates = true;
         }
     }
-    return res;
+
+    // only take round leader votes if we're still looking for
+    // candidates
+    if (mCandidates.empty() &&
+        mRoundLeaders.find(st.nodeID) != mRoundLeaders.end())
+    {
+        Value newVote = getNewValueFromNomination(nom, pending);
+        if (!newVote.empty())
+        {
+            mVotes.emplace(newVote);
+            modified = true;
+            ZoneScopedN("SCPDriver::nominatingValue");
+            mSlot.getSCPDriver().nominatingValue(mSlot.getSlotIndex(),
+                                                 newVote);
+        }
+    }
+
+    if (modified)
+    {
+        emitNomination();
+    }
+
+    if (newCandidates)
+    {
+        mSlot.recordLatency(SCPLatency::FIRST_CANDIDATE);
+        combineCandidates();
+    }
+    return !pending;
+}
+
+void
+NominationProtocol::combineCandidates()
+{
+    if (mCombining)
+    {
+        // combined again once the driver completes
+        mCandidatesChanged = true;
+        return;
+    }
+
+    Value composite;
+    {
+        ZoneScopedN("SCPDriver::combineCandidates");
+        composite = mSlot.getSCPDriver().combineCandidates(
+            mSlot.getSlotIndex(), mCandidates);
+    }
+    if (composite.empty())
+    {
+        mCombining = true;
+        return;
+    }
+    updateCompositeCandidate(composite);
+}
+
+void
+NominationProtocol::candidatesCombined(Value const& composite)
+{
+    if (!mCombining)
+    {
+        CLOG(DEBUG, "SCP") << "NominationProtocol::candidatesCombined"
+                           << " i: " << mSlot.getSlotIndex()
+                           << " no combination pending";
+        return;
+    }
+    mCombining = false;
+
+    if (mCandidatesChanged)
+    {
+        // the composite value is already outdated
+        mCandidatesChanged = false;
+        combineCandidates();
+        return;
+    }
+    updateCompositeCandidate(composite);
+}
+
+void
+NominationProtocol::updateCompositeCandidate(Value const& composite)
+{
+    mLatestCompositeCandidate = composite;
+
+    {
+        ZoneScopedN("SCPDriver::updatedCandidateValue");
+        mSlot.getSCPDriver().updatedCandidateValue(mSlot.getSlotIndex(),
+                                                   mLatestCompositeCandidate);
+    }
+
+    mSlot.bumpState(mLatestCompositeCandidate, false);
 }
 
 std::vector<Value>
@@ -464,6 +646,7 @@ bool
 NominationProtocol::nominate(Value const& value, Value const& previousValue,
                              bool timedout)
 {
+    ZoneScoped;
     if (Logging::logDebug("SCP"))
         CLOG(DEBUG, "SCP") << "NominationProtocol::nominate (" << mRoundNumber
                            << ") " << mSlot.getSCP().getValueString(value);
@@ -477,10 +660,12 @@ NominationProtocol::nominate(Value const& value, Value const& previousValue,
     }
 
     mNominationStarted = true;
+    mSlot.recordLatency(SCPLatency::NOMINATION_STARTED);
 
     mPreviousValue = previousValue;
 
     mRoundNumber++;
+    mSlot.trace(SCPTraceEvent::NOMINATION_ROUND, mRoundNumber);
     updateRoundLeaders();
 
     Value nominatingValue;
@@ -502,30 +687,43 @@ NominationProtocol::nominate(Value const& value, Value const& previousValue,
         auto it = mLatestNominations.find(leader);
         if (it != mLatestNominations.end())
         {
+            bool pending = false;
             nominatingValue = getNewValueFromNomination(
-                it->second.statement.pledges.nominate());
+                it->second.statement.pledges.nominate(), pending);
             if (!nominatingValue.empty())
             {
                 mVotes.insert(nominatingValue);
                 updated = true;
             }
+            if (pending)
+            {
+                mSlot.deferEnvelope(it->second);
+            }
         }
     }
 
-    std::chrono::milliseconds timeout =
-        mSlot.getSCPDriver().computeTimeout(mRoundNumber);
+    std::chrono::milliseconds timeout;
+    {
+        ZoneScopedN("SCPDriver::computeTimeout");
+        timeout = mSlot.getSCPDriver().computeTimeout(mRoundNumber);
+    }
 
-    mSlot.getSCPDriver().nominatingValue(mSlot.getSlotIndex(), nominatingValue);
+    {
+        ZoneScopedN("SCPDriver::nominatingValue");
+        mSlot.getSCPDriver().nominatingValue(mSlot.getSlotIndex(),
+                                             nominatingValue);
+    }
 
     std::shared_ptr<Slot> slot = mSlot.shared_from_this();
 
-    std::function<void()>* func = new std::function<void()>;
-    *func = [slot, value, previousValue]() {
+    mSlot.trace(SCPTraceEvent::TIMER_ARMED, Slot::NOMINATION_TIMER,
+                static_cast<uint32>(timeout.count()));
+    mSlot.getSCP().getTimers().arm(
+        mSlot.getSlotIndex(), Slot::NOMINATION_TIMER, timeout,
+        [slot, value, previousValue]() {
+            slot->trace(SCPTraceEvent::TIMER_FIRED, Slot::NOMINATION_TIMER);
             slot->nominate(value, previousValue, true);
-        };
-
-    mSlot.getSCPDriver().setupTimer(
-        mSlot.getSlotIndex(), Slot::NOMINATION_TIMER, timeout, func);
+        });
 
     if (updated)
     {
@@ -543,6 +741,9 @@ void
 NominationProtocol::stopNomination()
 {
     mNominationStarted = false;
+    // the timer would find the nomination stopped
+    mSlot.getSCP().getTimers().cancel(mSlot.getSlotIndex(),
+                                      Slot::NOMINATION_TIMER);
 }
 
 std::set<NodeID> const&
@@ -601,7 +802,21 @@ NominationProtocol::setStateFromEnvelope(SCPEnvelope const& e)
         mVotes.emplace(v);
     }
 
-    mLastEnvelope = std::make_unique<SCPEnvelope>(e);
+    mLastEnvelope = std::make_unique<EncodedEnvelope>(e);
+}
+
+bool
+NominationProtocol::forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const
+{
+    auto const& localID = mSlot.getSCP().getLocalNodeID();
+    // only return messages for self if the slot is fully validated
+    bool self = mSlot.isFullyValidated();
+    // report envelopes by node, independently of the order they were seen in
+    return mLatestNominations.forEachByNodeID(
+        [&](NodeEnvelopeTable::value_type const& n) {
+            return self || !(n.first == localID);
+        },
+        f);
 }
 
 std::vector<SCPEnvelope>
@@ -609,15 +824,10 @@ NominationProtocol::getCurrentState() const
 {
     std::vector<SCPEnvelope> res;
     res.reserve(mLatestNominations.size());
-    for (auto const& n : mLatestNominations)
-    {
-        // only return messages for self if the slot is fully validated
-        if (!(n.first == mSlot.getSCP().getLocalNodeID()) ||
-            mSlot.isFullyValidated())
-        {
-            res.emplace_back(n.second);
-        }
-    }
+    forEachCurrentEnvelope([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
     return res;
 }
 
@@ -631,4 +841,20 @@ NominationProtocol::getLatestMessage(NodeID const& id) const
     }
     return nullptr;
 }
+
+size_t
+NominationProtocol::getMemoryUsage() const
+{
+    size_t res =
+        mLatestNominations.getMemoryUsage() + mSummaries.getMemoryUsage();
+    // X, Y and Z, with the parent, children and color of their nodes
+    for (auto const* values : {&mVotes, &mAccepted, &mCandidates})
+    {
+        for (auto const& v : *values)
+        {
+            res += 4 * sizeof(void*) + sizeof(Value) + v.size();
+        }
+    }
+    return res;
+}
 }
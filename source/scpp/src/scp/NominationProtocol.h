@@ -5,6 +5,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "lib/json/json-forwards.h"
+#include "scp/EncodedEnvelope.h"
+#include "scp/NodeEnvelopeTable.h"
+#include "scp/NominationSummaries.h"
 #include "scp/SCP.h"
 #include <functional>
 #include <memory>
@@ -23,9 +26,11 @@ class NominationProtocol
     std::set<Value> mVotes;                           // X
     std::set<Value> mAccepted;                        // Y
     std::set<Value> mCandidates;                      // Z
-    std::map<NodeID, SCPEnvelope> mLatestNominations; // N
+    NodeEnvelopeTable mLatestNominations;             // N
+    // the statements of N as value handles, same positions
+    NominationSummaries mSummaries;
 
-    std::unique_ptr<SCPEnvelope>
+    std::unique_ptr<EncodedEnvelope const>
         mLastEnvelope; // last envelope emitted by this node
 
     // nodes from quorum set that have the highest priority this round
@@ -34,6 +39,16 @@ class NominationProtocol
     // true if 'nominate' was called
     bool mNominationStarted;
 
+    // true while the driver combines the candidates, see
+    // SCPDriver::combineCandidates; mCandidatesChanged is set when new
+    // candidates come in the meantime
+    bool mCombining;
+    bool mCandidatesChanged;
+
+    // true when the local statement changed since it was last recorded,
+    // see emitDeferredNomination
+    bool mNominationPending;
+
     // the latest (if any) candidate value
     Value mLatestCompositeCandidate;
 
@@ -41,8 +56,6 @@ class NominationProtocol
     Value mPreviousValue;
 
     bool isNewerStatement(NodeID const& nodeID, SCPNomination const& st);
-    static bool isNewerStatement(SCPNomination const& oldst,
-                                 SCPNomination const& st);
 
     // returns true if 'p' is a subset of 'v'
     // also sets 'notEqual' if p and v differ
@@ -57,7 +70,10 @@ class NominationProtocol
 
     void recordEnvelope(SCPEnvelope const& env);
 
+    // the local statement changed, it must be recorded and emitted
     void emitNomination();
+    // the statement of the local node, from its votes and accepted values
+    SCPStatement makeStatement() const;
 
     // returns true if v is in the accepted list from the statement
     static bool acceptPredicate(Value const& v, SCPStatement const& st);
@@ -72,21 +88,50 @@ class NominationProtocol
     // computes Gi(isPriority?P:N, prevValue, mRoundNumber, nodeID)
     // from the paper
     uint64 hashNode(bool isPriority, NodeID const& nodeID);
+    // same, for every node of nodeIDs at once
+    std::vector<uint64> hashNodes(bool isPriority,
+                                  std::vector<NodeID> const& nodeIDs);
 
     // computes Gi(K, prevValue, mRoundNumber, value)
     uint64 hashValue(Value const& value);
+    // same, for every value of values at once
+    std::vector<uint64> hashValues(std::vector<Value> const& values);
 
     uint64 getNodePriority(NodeID const& nodeID, SCPQuorumSet const& qset);
 
     // returns the highest value that we don't have yet, that we should
     // vote for, extracted from a nomination.
     // returns the empty value if no new value was found
-    Value getNewValueFromNomination(SCPNomination const& nom);
+    // sets `pending` if some values are still being validated
+    Value getNewValueFromNomination(SCPNomination const& nom, bool& pending);
+
+    // runs the protocol for a recorded statement; returns false if some of
+    // its values are still being validated
+    bool advanceNomination(SCPStatement const& st);
+
+    // `SCPDriver::combineCandidates` on the current candidates, unless the
+    // driver is still combining
+    void combineCandidates();
+    // the composite value becomes the one the ballot protocol works on
+    void updateCompositeCandidate(Value const& composite);
 
   public:
     NominationProtocol(Slot& slot);
 
+    static bool isNewerStatement(SCPNomination const& oldst,
+                                 SCPNomination const& st);
+
     SCP::EnvelopeState processEnvelope(SCPEnvelope const& envelope);
+    // runs the protocol again for a statement that waited for the
+    // validation of its values, see Slot::deferEnvelope
+    void processDeferredEnvelope(SCPEnvelope const& envelope);
+
+    // see SCP::candidatesCombined
+    void candidatesCombined(Value const& composite);
+
+    // records, signs and emits the local statement if it changed, see
+    // Slot::emitDeferred
+    void emitDeferredNomination();
 
     static std::vector<Value> getStatementValues(SCPStatement const& st);
 
@@ -108,18 +153,37 @@ class NominationProtocol
 
     Json::Value getJsonInfo();
 
-    SCPEnvelope*
+    SCPEnvelope const*
     getLastMessageSend() const
+    {
+        return mLastEnvelope ? &mLastEnvelope->getEnvelope() : nullptr;
+    }
+
+    EncodedEnvelope const*
+    getLastEncodedMessageSend() const
     {
         return mLastEnvelope.get();
     }
 
     void setStateFromEnvelope(SCPEnvelope const& e);
 
+    // true once the local node started nominating, the state cannot be set
+    // from an envelope anymore
+    bool
+    isNominationStarted() const
+    {
+        return mNominationStarted;
+    }
+
     std::vector<SCPEnvelope> getCurrentState() const;
+    // same as `getCurrentState`, without copying the envelopes
+    bool forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const;
 
     // returns the latest message from a node
     // or nullptr if not found
     SCPEnvelope const* getLatestMessage(NodeID const& id) const;
+
+    // bytes held by N and the indexes derived from it, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
 };
 }
@@ -0,0 +1,142 @@
+/*******************************************************************************
+
+    Implementation of the nomination statements of a slot as sorted
+    handles of values, see NominationSummaries.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/NominationSummaries.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+namespace
+{
+void
+assignHandles(std::vector<ValueTable::Handle>& row,
+              xdr::xvector<Value> const& v, ValueTable& values)
+{
+    // released once the new ones are acquired, as they are mostly the same
+    std::vector<ValueTable::Handle> old;
+    old.swap(row);
+    row.reserve(v.size());
+    for (auto const& x : v)
+    {
+        row.emplace_back(values.acquire(x));
+    }
+    std::sort(row.begin(), row.end());
+    for (auto h : old)
+    {
+        values.release(h);
+    }
+}
+
+// the NominationProtocol::isSubsetHelper of p, as handles, and v
+bool
+isSubset(std::vector<ValueTable::Handle> const& p,
+         xdr::xvector<Value> const& v, ValueTable const& values,
+         bool& notEqual)
+{
+    notEqual = true;
+    if (p.size() > v.size())
+    {
+        return false;
+    }
+
+    std::vector<ValueTable::Handle> handles;
+    handles.reserve(v.size());
+    for (auto const& x : v)
+    {
+        auto h = values.find(x);
+        if (h != ValueTable::npos)
+        {
+            handles.emplace_back(h);
+        }
+    }
+    if (handles.size() < p.size())
+    {
+        return false;
+    }
+    std::sort(handles.begin(), handles.end());
+    if (!std::includes(handles.begin(), handles.end(), p.begin(), p.end()))
+    {
+        return false;
+    }
+    notEqual = p.size() != v.size();
+    return true;
+}
+}
+
+BitSet
+NominationSummaries::filter(BitSet const& nodes,
+                            std::vector<Handles> const& rows,
+                            ValueTable::Handle value)
+{
+    BitSet res(nodes.size());
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        auto const& row = rows[i];
+        if (std::binary_search(row.begin(), row.end(), value))
+        {
+            res.set(i);
+        }
+    }
+    return res;
+}
+
+void
+NominationSummaries::assign(size_t i, SCPNomination const& nom,
+                            ValueTable& values)
+{
+    if (i >= mVotes.size())
+    {
+        mVotes.resize(i + 1);
+        mAccepted.resize(i + 1);
+    }
+    assignHandles(mVotes[i], nom.votes, values);
+    assignHandles(mAccepted[i], nom.accepted, values);
+}
+
+bool
+NominationSummaries::isNewerStatement(size_t i, SCPNomination const& nom,
+                                      ValueTable const& values) const
+{
+    bool grows;
+    bool g;
+    if (!isSubset(mVotes[i], nom.votes, values, g))
+    {
+        return false;
+    }
+    grows = g;
+    if (!isSubset(mAccepted[i], nom.accepted, values, g))
+    {
+        return false;
+    }
+    //  true only if one of the sets grew
+    return grows || g;
+}
+
+size_t
+NominationSummaries::getMemoryUsage() const
+{
+    size_t res = (mVotes.capacity() + mAccepted.capacity()) * sizeof(Handles);
+    for (auto const* rows : {&mVotes, &mAccepted})
+    {
+        for (auto const& row : *rows)
+        {
+            res += row.capacity() * sizeof(ValueTable::Handle);
+        }
+    }
+    return res;
+}
+}
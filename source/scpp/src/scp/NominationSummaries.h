@@ -0,0 +1,73 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the nomination statements of a slot as sorted handles of values.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <vector>
+
+#include "scp/ValueTable.h"
+#include "util/BitSet.h"
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * The nomination statements of a NodeEnvelopeTable as sorted arrays of
+ * handles in the slot's ValueTable, one row per node at the node's
+ * position in the table, so that the membership and subset tests of the
+ * nomination protocol are searches and merges over integers instead of
+ * comparisons of the values, which can be large.
+ *
+ * Rows of nodes without an envelope are meaningless: scans are restricted
+ * to the nodes of the table.
+ */
+class NominationSummaries
+{
+    using Handles = std::vector<ValueTable::Handle>;
+
+    std::vector<Handles> mVotes;
+    std::vector<Handles> mAccepted;
+
+    // nodes of `nodes` whose row of `rows` contains value
+    static BitSet filter(BitSet const& nodes, std::vector<Handles> const& rows,
+                         ValueTable::Handle value);
+
+  public:
+    // sets the row of node `i` from its statement, acquiring its values
+    // and releasing the ones of the previous statement
+    void assign(size_t i, SCPNomination const& nom, ValueTable& values);
+
+    // nodes of `nodes` that vote for value, or accepted it
+    BitSet
+    getVotedNodes(BitSet const& nodes, ValueTable::Handle value) const
+    {
+        return filter(nodes, mVotes, value);
+    }
+    BitSet
+    getAcceptedNodes(BitSet const& nodes, ValueTable::Handle value) const
+    {
+        return filter(nodes, mAccepted, value);
+    }
+
+    // `NominationProtocol::isNewerStatement` for the statement of node i
+    // and nom: only the values of nom already in the table are looked up,
+    // the others can't be in the statement of node i
+    bool isNewerStatement(size_t i, SCPNomination const& nom,
+                          ValueTable const& values) const;
+
+    // bytes held by the rows, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
+};
+}
@@ -268,6 +268,17 @@ normalizeQuorumSetReorder(SCPQuorumSet& qset)
 void
 normalizeQSet(SCPQuorumSet& qSet, NodeID const* idToRemove)
 {
+    // a flat set has nothing to simplify, and its validators usually come
+    // sorted already
+    if (qSet.innerSets.empty())
+    {
+        normalizeQSetSimplify(qSet, idToRemove);
+        if (!std::is_sorted(qSet.validators.begin(), qSet.validators.end()))
+        {
+            std::sort(qSet.validators.begin(), qSet.validators.end());
+        }
+        return;
+    }
     normalizeQSetSimplify(qSet, idToRemove);
     normalizeQuorumSetReorder(qSet);
 }
@@ -8,7 +8,9 @@
 #include "scp/LocalNode.h"
 #include "scp/Slot.h"
 #include "util/GlobalChecks.h"
+#include "util/JsonWriter.h"
 #include "util/Logging.h"
+#include "util/Tracy.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 
@@ -18,31 +20,204 @@
 namespace stellar
 {
 
+constexpr uint64 SCP::NO_SLOT;
+
 SCP::SCP(SCPDriver& driver, NodeID const& nodeID, bool isValidator,
          SCPQuorumSet const& qSetLocal)
     : mDriver(driver)
+    , mQSetCacheEnabled(false)
+    , mCatchUpEnabled(false)
+    , mQuorumFilterEnabled(false)
+    , mReadSnapshotEnabled(false)
+    , mInputDepth(0)
+    , mQSetGeneration(0)
+    , mNodeIndex(std::make_shared<NodeIndex>())
+    , mHistoryMode(HISTORY_FULL)
+    , mHistoryLimit(0)
+    , mTrace(std::make_unique<SCPTrace>())
+    , mLatency(std::make_unique<SCPLatency>())
+    , mEnvelopeFilter(std::make_unique<SCPEnvelopeFilter>())
+    , mEnvelopeQueue(std::make_unique<SCPEnvelopeQueue>(*this))
+    , mQuorumFilter(std::make_unique<SCPQuorumFilter>(*this))
+    , mTimers(std::make_unique<SCPTimers>(driver))
 {
     mLocalNode =
         std::make_shared<LocalNode>(nodeID, isValidator, qSetLocal, this);
+    // the driver runs the timers outside of any other input
+    mTimers->setFiredCallback([this]() {
+        if (mReadSnapshotEnabled && mInputDepth == 0)
+        {
+            publishReadSnapshot();
+        }
+    });
+}
+
+// the envelope isn't checked yet: its node is only looked up, as numbering
+// every key received would grow the index for good
+static void
+traceEnvelope(SCPTrace& trace, NodeIndex const& index, SCPStatement const& st)
+{
+    uint32 counter = 0;
+    if (st.pledges.type() != SCP_ST_NOMINATE)
+    {
+        counter = BallotProtocol::getWorkingBallot(st).counter;
+    }
+    size_t node = index.find(st.nodeID);
+    trace.record(SCPTraceEvent::ENVELOPE_RECEIVED, st.slotIndex,
+                 node == NodeIndex::npos ? SCPTraceEvent::NO_NODE
+                                         : static_cast<uint32>(node),
+                 counter, st.pledges.type());
 }
 
 SCP::EnvelopeState
 SCP::receiveEnvelope(SCPEnvelope const& envelope)
 {
-    uint64 slotIndex = envelope.statement.slotIndex;
-    return getSlot(slotIndex, true)->processEnvelope(envelope, false);
+    ZoneScoped;
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::RECEIVE_ENVELOPE,
+                             envelope);
+    auto const& st = envelope.statement;
+    if (mQuorumFilterEnabled && !mQuorumFilter->admits(st))
+    {
+        return EnvelopeState::INVALID;
+    }
+    traceEnvelope(*mTrace, *mNodeIndex, st);
+    auto res = getSlot(st.slotIndex, true)->processEnvelope(envelope, false);
+    if (mQuorumFilterEnabled && res == EnvelopeState::VALID)
+    {
+        mQuorumFilter->learn(st.nodeID);
+    }
+    return res;
+}
+
+size_t
+SCP::receiveEnvelopes(std::vector<SCPEnvelope> const& envelopes)
+{
+    ZoneScoped;
+    ZoneValue(envelopes.size());
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get());
+    if (input)
+    {
+        mRecorder->writeEnvelopesInput(SCPRecorder::RECEIVE_ENVELOPES,
+                                       envelopes.data(), envelopes.size());
+    }
+    std::map<uint64, std::vector<SCPEnvelope const*>> bySlot;
+    for (auto const& e : envelopes)
+    {
+        if (mQuorumFilterEnabled && !mQuorumFilter->admits(e.statement))
+        {
+            continue;
+        }
+        traceEnvelope(*mTrace, *mNodeIndex, e.statement);
+        bySlot[e.statement.slotIndex].emplace_back(&e);
+    }
+
+    size_t res = 0;
+    for (auto const& s : bySlot)
+    {
+        res += getSlot(s.first, true)->processEnvelopes(s.second);
+    }
+    if (mQuorumFilterEnabled)
+    {
+        // the quorum sets of the latest statements, whichever were VALID
+        for (auto const& s : bySlot)
+        {
+            for (auto e : s.second)
+            {
+                mQuorumFilter->learn(e->statement.nodeID);
+            }
+        }
+    }
+    return res;
+}
+
+void
+SCP::valueValidated(uint64 slotIndex, Hash const& valueHash,
+                    SCPDriver::ValidationLevel level)
+{
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::VALUE_VALIDATED,
+                             slotIndex, valueHash, static_cast<uint32>(level));
+    auto slot = getSlot(slotIndex, false);
+    if (slot)
+    {
+        slot->valueValidated(valueHash, level);
+    }
+}
+
+void
+SCP::candidatesCombined(uint64 slotIndex, Value const& composite)
+{
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::CANDIDATES_COMBINED, slotIndex,
+                             composite);
+    auto slot = getSlot(slotIndex, false);
+    if (slot)
+    {
+        slot->candidatesCombined(composite);
+    }
+}
+
+void
+SCP::externalizeCompleted(uint64 slotIndex)
+{
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::EXTERNALIZE_COMPLETED, slotIndex);
+    // the slots may be purged by the driver while the envelopes are
+    // processed
+    std::vector<std::shared_ptr<Slot>> next;
+    mKnownSlots.forEach([&](Slot& slot) {
+        if (slot.getSlotIndex() > slotIndex)
+        {
+            next.emplace_back(slot.shared_from_this());
+        }
+        return true;
+    });
+    for (auto const& slot : next)
+    {
+        if (slot->getSlotIndex() == slotIndex + 1)
+        {
+            slot->releaseBallotProtocol();
+        }
+        else
+        {
+            slot->retryValidations();
+        }
+    }
 }
 
 bool
 SCP::nominate(uint64 slotIndex, Value const& value, Value const& previousValue)
 {
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::NOMINATE, slotIndex,
+                             value, previousValue);
     dbgAssert(isValidator());
     return getSlot(slotIndex, true)->nominate(value, previousValue, false);
 }
 
+bool
+SCP::nominateAhead(uint64 slotIndex, Value const& value,
+                   Value const& previousValue)
+{
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::NOMINATE_AHEAD,
+                             slotIndex, value, previousValue);
+    dbgAssert(isValidator());
+    auto slot = getSlot(slotIndex, true);
+    slot->holdBallotProtocol();
+    return slot->nominate(value, previousValue, false);
+}
+
 void
 SCP::stopNomination(uint64 slotIndex)
 {
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::STOP_NOMINATION,
+                             slotIndex);
     auto s = getSlot(slotIndex, false);
     if (s)
     {
@@ -50,10 +225,61 @@ SCP::stopNomination(uint64 slotIndex)
     }
 }
 
+std::set<NodeID>
+SCP::getNominationLeaders(uint64 slotIndex)
+{
+    auto s = getSlot(slotIndex, false);
+    return s ? s->getNominationLeaders() : std::set<NodeID>();
+}
+
 void
 SCP::updateLocalQuorumSet(SCPQuorumSet const& qSet)
 {
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::UPDATE_LOCAL_QUORUM_SET, qSet);
     mLocalNode->updateQuorumSet(qSet);
+    mKnownSlots.forEach([](Slot& slot) {
+        slot.getBallotProtocol().resetHeardFromQuorum();
+        return true;
+    });
+    if (mQuorumFilterEnabled)
+    {
+        mQuorumFilter->rebuild();
+    }
+}
+
+void
+SCP::setQSetCacheEnabled(bool enabled)
+{
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::SET_QSET_CACHE_ENABLED, enabled);
+    if (mQSetCacheEnabled != enabled)
+    {
+        mQSetCacheEnabled = enabled;
+        invalidateQSets();
+    }
+}
+
+void
+SCP::invalidateQSet(Hash const& qSetHash)
+{
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::INVALIDATE_QSET,
+                             qSetHash);
+    mKnownSlots.forEach([&](Slot& slot) {
+        slot.invalidateQSet(qSetHash);
+        return true;
+    });
+}
+
+void
+SCP::invalidateQSets()
+{
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::INVALIDATE_QSETS);
+    mQSetGeneration++;
+    mKnownSlots.forEach([](Slot& slot) {
+        slot.getBallotProtocol().resetHeardFromQuorum();
+        return true;
+    });
 }
 
 SCPQuorumSet const&
@@ -71,16 +297,19 @@ SCP::getLocalNodeID()
 void
 SCP::purgeSlots(uint64 maxSlotIndex)
 {
-    auto it = mKnownSlots.begin();
-    while (it != mKnownSlots.end())
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::PURGE_SLOTS,
+                             maxSlotIndex);
+    mKnownSlots.purge(maxSlotIndex);
+    mEnvelopeFilter->purge(maxSlotIndex);
+    mEnvelopeQueue->purge(maxSlotIndex);
+    mTimers->purge(maxSlotIndex);
+    // an older slot may be created again, with a newer envelope of the node
+    for (auto& slotIndex : mLatestMessageSlots)
     {
-        if (it->first < maxSlotIndex)
+        if (slotIndex < maxSlotIndex)
         {
-            it = mKnownSlots.erase(it);
-        }
-        else
-        {
-            ++it;
+            slotIndex = NO_SLOT;
         }
     }
 }
@@ -91,22 +320,180 @@ SCP::getLocalNode()
     return mLocalNode;
 }
 
-std::shared_ptr<Slot>
-SCP::getSlot(uint64 slotIndex, bool create)
+SCPTrace&
+SCP::getTrace()
+{
+    return *mTrace;
+}
+
+SCPTrace const&
+SCP::getTrace() const
+{
+    return *mTrace;
+}
+
+SCPLatency&
+SCP::getLatency()
 {
-    std::shared_ptr<Slot> res;
-    auto it = mKnownSlots.find(slotIndex);
-    if (it == mKnownSlots.end())
+    return *mLatency;
+}
+
+SCPLatency const&
+SCP::getLatency() const
+{
+    return *mLatency;
+}
+
+SCPEnvelopeFilter&
+SCP::getEnvelopeFilter()
+{
+    return *mEnvelopeFilter;
+}
+
+SCPEnvelopeFilter const&
+SCP::getEnvelopeFilter() const
+{
+    return *mEnvelopeFilter;
+}
+
+SCPEnvelopeQueue&
+SCP::getEnvelopeQueue()
+{
+    return *mEnvelopeQueue;
+}
+
+SCPEnvelopeQueue const&
+SCP::getEnvelopeQueue() const
+{
+    return *mEnvelopeQueue;
+}
+
+SCPQuorumFilter const&
+SCP::getQuorumFilter() const
+{
+    return *mQuorumFilter;
+}
+
+void
+SCP::setInboxCapacity(size_t capacity)
+{
+    mInbox = capacity != 0 ? std::make_unique<SCPInbox>(*this, capacity)
+                           : nullptr;
+}
+
+SCPInbox&
+SCP::getInbox()
+{
+    dbgAssert(mInbox);
+    return *mInbox;
+}
+
+SCPTimers&
+SCP::getTimers()
+{
+    return *mTimers;
+}
+
+void
+SCP::stopTimers()
+{
+    mTimers->cancelAll();
+}
+
+bool
+SCP::startRecording(char const* path)
+{
+    auto recorder = std::make_unique<SCPRecorder>(mDriver);
+    if (!recorder->open(path, getLocalNodeID(), isValidator(),
+                        getLocalQuorumSet()))
     {
-        if (create)
-        {
-            res = std::make_shared<Slot>(slotIndex, *this);
-            mKnownSlots[slotIndex] = res;
-        }
+        return false;
     }
-    else
+    // the settings the replay starts from
+    recorder->writeInput(SCPRecorder::SET_QSET_CACHE_ENABLED,
+                         mQSetCacheEnabled);
+    recorder->writeInput(SCPRecorder::SET_CATCH_UP_ENABLED, mCatchUpEnabled);
+    recorder->writeInput(SCPRecorder::SET_QUORUM_FILTER_ENABLED,
+                         mQuorumFilterEnabled);
+    recorder->writeInput(SCPRecorder::SET_STATEMENT_HISTORY,
+                         static_cast<uint32>(mHistoryMode),
+                         static_cast<uint64>(mHistoryLimit));
+    mRecorder = std::move(recorder);
+    mTimers->setRecorder(mRecorder.get());
+    return true;
+}
+
+void
+SCP::stopRecording()
+{
+    mTimers->setRecorder(nullptr);
+    mRecorder.reset();
+}
+
+bool
+SCP::isRecording() const
+{
+    return mRecorder != nullptr;
+}
+
+bool
+SCP::isQSetCacheEnabled() const
+{
+    return mQSetCacheEnabled;
+}
+
+void
+SCP::setCatchUpEnabled(bool enabled)
+{
+    SCPRecorder::Input input(mRecorder.get(), SCPRecorder::SET_CATCH_UP_ENABLED,
+                             enabled);
+    mCatchUpEnabled = enabled;
+}
+
+bool
+SCP::isCatchUpEnabled() const
+{
+    return mCatchUpEnabled;
+}
+
+void
+SCP::setQuorumFilterEnabled(bool enabled)
+{
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::SET_QUORUM_FILTER_ENABLED, enabled);
+    if (enabled && !mQuorumFilterEnabled)
+    {
+        mQuorumFilter->rebuild();
+    }
+    mQuorumFilterEnabled = enabled;
+}
+
+bool
+SCP::isQuorumFilterEnabled() const
+{
+    return mQuorumFilterEnabled;
+}
+
+SCP::HistoryMode
+SCP::getHistoryMode() const
+{
+    return mHistoryMode;
+}
+
+size_t
+SCP::getHistoryLimit() const
+{
+    return mHistoryLimit;
+}
+
+std::shared_ptr<Slot>
+SCP::getSlot(uint64 slotIndex, bool create)
+{
+    std::shared_ptr<Slot> res = mKnownSlots.get(slotIndex);
+    if (!res && create)
     {
-        res = it->second;
+        res = std::make_shared<Slot>(slotIndex, *this);
+        mKnownSlots.insert(slotIndex, res);
     }
     return res;
 }
@@ -115,17 +502,41 @@ Json::Value
 SCP::getJsonInfo(size_t limit, bool fullKeys)
 {
     Json::Value ret;
-    auto it = mKnownSlots.rbegin();
-    while (it != mKnownSlots.rend() && limit-- != 0)
-    {
-        auto& slot = *(it->second);
+    mKnownSlots.forEachReverse([&](Slot& slot) {
+        if (limit-- == 0)
+        {
+            return false;
+        }
         ret[std::to_string(slot.getSlotIndex())] = slot.getJsonInfo(fullKeys);
-        it++;
-    }
+        return true;
+    });
 
     return ret;
 }
 
+void
+SCP::writeJsonInfo(std::ostream& out, size_t limit, size_t offset,
+                   bool fullKeys)
+{
+    JsonWriter w(out);
+    w.beginObject();
+    mKnownSlots.forEachReverse([&](Slot& slot) {
+        if (offset > 0)
+        {
+            offset--;
+            return true;
+        }
+        if (limit-- == 0)
+        {
+            return false;
+        }
+        w.key(std::to_string(slot.getSlotIndex()));
+        slot.writeJsonInfo(w, fullKeys);
+        return true;
+    });
+    w.endObject();
+}
+
 Json::Value
 SCP::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys,
                        uint64 index)
@@ -133,12 +544,11 @@ SCP::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys,
     Json::Value ret;
     if (index == 0)
     {
-        for (auto& item : mKnownSlots)
-        {
-            auto& slot = *item.second;
+        mKnownSlots.forEach([&](Slot& slot) {
             ret = slot.getJsonQuorumInfo(id, summary, fullKeys);
             ret["ledger"] = static_cast<Json::UInt64>(slot.getSlotIndex());
-        }
+            return true;
+        });
     }
     else
     {
@@ -172,6 +582,21 @@ SCP::isSlotFullyValidated(uint64 slotIndex)
     }
 }
 
+void
+SCP::setStatementHistory(HistoryMode mode, size_t limit)
+{
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::SET_STATEMENT_HISTORY,
+                             static_cast<uint32>(mode),
+                             static_cast<uint64>(limit));
+    mHistoryMode = mode;
+    mHistoryLimit = limit;
+    mKnownSlots.forEach([](Slot& slot) {
+        slot.clearStatementHistory();
+        return true;
+    });
+}
+
 size_t
 SCP::getKnownSlotsCount() const
 {
@@ -182,11 +607,36 @@ size_t
 SCP::getCumulativeStatemtCount() const
 {
     size_t c = 0;
-    for (auto const& s : mKnownSlots)
+    mKnownSlots.forEach([&](Slot& slot) {
+        c += slot.getStatementCount();
+        return true;
+    });
+    return c;
+}
+
+std::vector<SlotMemoryUsage>
+SCP::getMemoryUsage() const
+{
+    std::vector<SlotMemoryUsage> res;
+    res.reserve(mKnownSlots.size());
+    mKnownSlots.forEach([&](Slot& slot) {
+        res.emplace_back(slot.getMemoryUsage());
+        return true;
+    });
+    return res;
+}
+
+SlotMemoryUsage
+SCP::getMemoryUsage(uint64 slotIndex) const
+{
+    auto slot = mKnownSlots.get(slotIndex);
+    if (!slot)
     {
-        c += s.second->getStatementCount();
+        SlotMemoryUsage res{};
+        res.mSlotIndex = slotIndex;
+        return res;
     }
-    return c;
+    return slot->getMemoryUsage();
 }
 
 std::vector<SCPEnvelope>
@@ -203,13 +653,112 @@ SCP::getLatestMessagesSend(uint64 slotIndex)
     }
 }
 
+bool
+SCP::forEachLatestMessageSend(uint64 slotIndex, EnvelopeVisitor const& f) const
+{
+    auto slot = mKnownSlots.get(slotIndex);
+    return !slot || slot->forEachLatestMessageSend(f);
+}
+
 void
 SCP::setStateFromEnvelope(uint64 slotIndex, SCPEnvelope const& e)
 {
+    ReadSnapshotScope snapshot(*this);
+    SCPRecorder::Input input(mRecorder.get(),
+                             SCPRecorder::SET_STATE_FROM_ENVELOPE, slotIndex, e);
     auto slot = getSlot(slotIndex, true);
     slot->setStateFromEnvelope(e);
 }
 
+bool
+SCP::restoreState(uint64 slotIndex, SCPEnvelope const* envelopes, size_t count)
+{
+    ReadSnapshotScope snapshot(*this);
+    // the snapshots are recorded as the slots they restore
+    SCPRecorder::Input input(mRecorder.get());
+    if (input)
+    {
+        mRecorder->writeEnvelopesInput(SCPRecorder::RESTORE_STATE, envelopes,
+                                       count, slotIndex);
+    }
+    if (count == 0)
+    {
+        return true;
+    }
+    auto slot = getSlot(slotIndex, true);
+    return slot->restoreState(envelopes, count);
+}
+
+bool
+SCP::restoreState(uint8_t const* data, size_t size)
+{
+    xdr::xvector<SCPEnvelope> envelopes;
+    try
+    {
+        if (reinterpret_cast<uintptr_t>(data) & 3)
+        {
+            throw xdr::xdr_runtime_error("snapshot is not 4-byte aligned");
+        }
+        xdr::xdr_get g(data, data + size);
+        g(envelopes);
+        g.done();
+    }
+    catch (xdr::xdr_runtime_error const& e)
+    {
+        CLOG(ERROR, "SCP") << "SCP::restoreState invalid snapshot: "
+                           << e.what();
+        return false;
+    }
+
+    // snapshots are ordered by slot, restore each run at once
+    size_t start = 0;
+    while (start < envelopes.size())
+    {
+        uint64 slotIndex = envelopes[start].statement.slotIndex;
+        size_t end = start + 1;
+        while (end < envelopes.size() &&
+               envelopes[end].statement.slotIndex == slotIndex)
+        {
+            end++;
+        }
+        if (!restoreState(slotIndex, envelopes.data() + start, end - start))
+        {
+            return false;
+        }
+        start = end;
+    }
+    return true;
+}
+
+std::vector<uint8_t>
+SCP::getStateSnapshot()
+{
+    // the encoding of a xvector<SCPEnvelope>: the number of envelopes
+    // followed by the envelopes, which are already encoded
+    std::vector<EncodedEnvelope const*> envelopes;
+    size_t size = 4;
+    mKnownSlots.forEach([&](Slot& slot) {
+        for (auto e : slot.getLatestEncodedMessagesSend())
+        {
+            envelopes.emplace_back(e);
+            size += e->getXDR().size();
+        }
+        return true;
+    });
+    std::vector<uint8_t> res;
+    res.reserve(size);
+    uint32 count = static_cast<uint32>(envelopes.size());
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        res.emplace_back(static_cast<uint8_t>(count >> shift));
+    }
+    for (auto e : envelopes)
+    {
+        res.insert(res.end(), e->getXDR().begin(), e->getXDR().end());
+    }
+    return res;
+}
+
 bool
 SCP::empty() const
 {
@@ -220,16 +769,14 @@ uint64
 SCP::getLowSlotIndex() const
 {
     assert(!empty());
-    return mKnownSlots.begin()->first;
+    return mKnownSlots.getLowIndex();
 }
 
 uint64
 SCP::getHighSlotIndex() const
 {
     assert(!empty());
-    auto it = mKnownSlots.end();
-    it--;
-    return it->first;
+    return mKnownSlots.getHighIndex();
 }
 
 std::vector<SCPEnvelope>
@@ -246,19 +793,99 @@ SCP::getCurrentState(uint64 slotIndex)
     }
 }
 
+bool
+SCP::forEachCurrentEnvelope(uint64 slotIndex, EnvelopeVisitor const& f) const
+{
+    auto slot = mKnownSlots.get(slotIndex);
+    return !slot || slot->forEachCurrentEnvelope(f);
+}
+
 SCPEnvelope const*
 SCP::getLatestMessage(NodeID const& id)
 {
-    for (auto it = mKnownSlots.rbegin(); it != mKnownSlots.rend(); it++)
+    size_t node = mNodeIndex->find(id);
+    if (node >= mLatestMessageSlots.size() ||
+        mLatestMessageSlots[node] == NO_SLOT)
     {
-        auto slot = it->second;
-        auto res = slot->getLatestMessage(id);
-        if (res != nullptr)
+        return nullptr;
+    }
+    auto slot = mKnownSlots.get(mLatestMessageSlots[node]);
+    dbgAssert(slot);
+    return slot->getLatestMessage(id);
+}
+
+void
+SCP::recordLatestMessage(size_t node, uint64 slotIndex)
+{
+    if (node >= mLatestMessageSlots.size())
+    {
+        mLatestMessageSlots.resize(node + 1, NO_SLOT);
+    }
+    auto& latest = mLatestMessageSlots[node];
+    if (latest == NO_SLOT || latest < slotIndex)
+    {
+        latest = slotIndex;
+    }
+}
+
+void
+SCP::publishReadSnapshot()
+{
+    auto previous = getReadSnapshot();
+    std::vector<SCPReadSnapshot::SlotStatePtr> slots;
+    slots.reserve(mKnownSlots.size());
+    mKnownSlots.forEach([&](Slot& slot) {
+        auto old = previous ? previous->getSlot(slot.getSlotIndex())
+                            : nullptr;
+        if (old && old->mVersion == slot.getStateVersion())
+        {
+            slots.emplace_back(std::move(old));
+        }
+        else
         {
-            return res;
+            slots.emplace_back(slot.makeReadState());
         }
+        return true;
+    });
+    std::atomic_store(
+        &mReadSnapshot,
+        std::shared_ptr<SCPReadSnapshot const>(
+            std::make_shared<SCPReadSnapshot>(std::move(slots))));
+}
+
+std::shared_ptr<SCPReadSnapshot const>
+SCP::getReadSnapshot() const
+{
+    return std::atomic_load(&mReadSnapshot);
+}
+
+void
+SCP::setReadSnapshotEnabled(bool enabled)
+{
+    mReadSnapshotEnabled = enabled;
+    if (enabled && mInputDepth == 0)
+    {
+        publishReadSnapshot();
+    }
+}
+
+bool
+SCP::isReadSnapshotEnabled() const
+{
+    return mReadSnapshotEnabled;
+}
+
+SCP::ReadSnapshotScope::ReadSnapshotScope(SCP& scp) : mSCP(scp)
+{
+    mSCP.mInputDepth++;
+}
+
+SCP::ReadSnapshotScope::~ReadSnapshotScope()
+{
+    if (--mSCP.mInputDepth == 0 && mSCP.mReadSnapshotEnabled)
+    {
+        mSCP.publishReadSnapshot();
     }
-    return nullptr;
 }
 
 std::vector<SCPEnvelope>
@@ -275,9 +902,17 @@ SCP::getExternalizingState(uint64 slotIndex)
     }
 }
 
+bool
+SCP::forEachExternalizingEnvelope(uint64 slotIndex, EnvelopeVisitor const& f) const
+{
+    auto slot = mKnownSlots.get(slotIndex);
+    return !slot || slot->forEachExternalizingEnvelope(f);
+}
+
 std::string
 SCP::getValueString(Value const& v) const
 {
+    ZoneScopedN("SCPDriver::getValueString");
     return mDriver.getValueString(v);
 }
 
@@ -305,6 +940,22 @@ SCP::ballotToStr(std::unique_ptr<SCPBallot> const& ballot) const
     return res;
 }
 
+std::string
+SCP::toStrKey(NodeID const& nodeID, bool fullKey) const
+{
+    size_t i = mNodeIndex->find(nodeID);
+    if (i == NodeIndex::npos)
+    {
+        ZoneScopedN("SCPDriver::toStrKey");
+        return mDriver.toStrKey(nodeID, fullKey);
+    }
+    return mNodeIndex->getName(i, fullKey,
+                               [&](NodeID const& n, bool full) {
+                                   ZoneScopedN("SCPDriver::toStrKey");
+                                   return mDriver.toStrKey(n, full);
+                               });
+}
+
 std::string
 SCP::envToStr(SCPEnvelope const& envelope, bool fullKeys) const
 {
@@ -318,7 +969,7 @@ SCP::envToStr(SCPStatement const& st, bool fullKeys) const
 
     Hash const& qSetHash = Slot::getCompanionQuorumSetHashFromStatement(st);
 
-    std::string nodeId = mDriver.toStrKey(st.nodeID, fullKeys);
+    std::string nodeId = toStrKey(st.nodeID, fullKeys);
 
     oss << "{ENV@" << nodeId << " | "
         << " i: " << st.slotIndex;
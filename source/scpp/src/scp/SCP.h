@@ -6,6 +6,7 @@
 
 #include <chrono>
 #include <functional>
+#include <iosfwd>
 #include <map>
 #include <memory>
 #include <set>
@@ -13,12 +14,24 @@
 #include "crypto/SecretKey.h"
 #include "lib/json/json-forwards.h"
 #include "scp/SCPDriver.h"
+#include "scp/SCPEnvelopeFilter.h"
+#include "scp/SCPEnvelopeQueue.h"
+#include "scp/SCPInbox.h"
+#include "scp/SCPLatency.h"
+#include "scp/SCPQuorumFilter.h"
+#include "scp/SCPReadSnapshot.h"
+#include "scp/SCPRecorder.h"
+#include "scp/SCPTimers.h"
+#include "scp/SCPTrace.h"
+#include "scp/SlotMemoryUsage.h"
+#include "scp/SlotStore.h"
 
 namespace stellar
 {
 class Node;
 class Slot;
 class LocalNode;
+class NodeIndex;
 typedef std::shared_ptr<SCPQuorumSet> SCPQuorumSetPtr;
 
 class SCP
@@ -26,18 +39,22 @@ class SCP
     SCPDriver& mDriver;
 
   public:
+    // Instances share no mutable state, so each can run on its own thread,
+    // as long as an instance is only used by one thread at a time (see
+    // setInboxCapacity).
     SCP(SCPDriver& driver, NodeID const& nodeID, bool isValidator,
         SCPQuorumSet const& qSetLocal);
 
+    // the recorder forwarding to the driver while recording
     SCPDriver&
     getDriver()
     {
-        return mDriver;
+        return mRecorder ? *mRecorder : mDriver;
     }
     SCPDriver const&
     getDriver() const
     {
-        return mDriver;
+        return mRecorder ? *mRecorder : mDriver;
     }
 
     enum EnvelopeState
@@ -46,19 +63,62 @@ class SCP
         VALID    // the envelope is valid
     };
 
+    // called on the envelopes of a state without copying them, returns
+    // false to stop the iteration; the envelope is only valid for the
+    // duration of the call
+    typedef std::function<bool(SCPEnvelope const&)> EnvelopeVisitor;
+
     // this is the main entry point of the SCP library
     // it processes the envelope, updates the internal state and
     // invokes the appropriate methods
     EnvelopeState receiveEnvelope(SCPEnvelope const& envelope);
 
+    // processes a batch of envelopes: all envelopes of a slot are recorded
+    // before its state machine runs, so that it reaches its final state in
+    // one pass and only emits the resulting envelope.
+    // returns the number of envelopes that were VALID
+    size_t receiveEnvelopes(std::vector<SCPEnvelope> const& envelopes);
+
+    // gives the verdict of a validation that `SCPDriver::validateValue`
+    // left pending (kPendingValue) for the value of hash `valueHash`, and
+    // processes the statements of the slot that were waiting for it.
+    // The verdict holds for the rest of the slot, for the nomination and
+    // the ballot protocol alike. Not to be called from validateValue,
+    // which can just return the verdict.
+    void valueValidated(uint64 slotIndex, Hash const& valueHash,
+                        SCPDriver::ValidationLevel level);
+
+    // gives the composite value of the candidates of the slot, when
+    // `SCPDriver::combineCandidates` didn't return it
+    void candidatesCombined(uint64 slotIndex, Value const& composite);
+
+    // called once the value of the slot given to
+    // `SCPDriver::valueExternalized` is applied: the validations of the
+    // next slots that were left pending are asked again, and the ballot
+    // protocol of the next slot starts if it was nominated ahead
+    void externalizeCompleted(uint64 slotIndex);
+
     // Submit a value to consider for slotIndex
     // previousValue is the value from slotIndex-1
     bool nominate(uint64 slotIndex, Value const& value,
                   Value const& previousValue);
 
+    // same, while the value externalized for slotIndex-1 (previousValue)
+    // is still being applied: the nomination runs (leaders, votes, the
+    // validation of the values received, left pending if they need the
+    // previous value applied), but the ballot protocol of the slot waits
+    // for `externalizeCompleted(slotIndex - 1)`, deferring the ballot
+    // statements received until then
+    bool nominateAhead(uint64 slotIndex, Value const& value,
+                       Value const& previousValue);
+
     // stops nomination for a slot
     void stopNomination(uint64 slotIndex);
 
+    // the leaders of the current nomination round of the slot, empty if
+    // the local node doesn't nominate for it
+    std::set<NodeID> getNominationLeaders(uint64 slotIndex);
+
     // Local QuorumSet interface (can be dynamically updated)
     void updateLocalQuorumSet(SCPQuorumSet const& qSet);
     SCPQuorumSet const& getLocalQuorumSet();
@@ -69,8 +129,70 @@ class SCP
     // returns the local node descriptor
     std::shared_ptr<LocalNode> getLocalNode();
 
+    // numbering of the nodes known to this instance, shared by the local
+    // quorum set and the envelope tables of every slot
+    std::shared_ptr<NodeIndex> const&
+    getNodeIndex() const
+    {
+        return mNodeIndex;
+    }
+
+    // the last state transitions of this instance, see SCPTrace
+    SCPTrace& getTrace();
+    SCPTrace const& getTrace() const;
+
+    // latencies of the phases of the slots, see SCPLatency
+    SCPLatency& getLatency();
+    SCPLatency const& getLatency() const;
+
+    // statements already received, for drivers to drop duplicate envelopes
+    // before verifying them, see SCPEnvelopeFilter
+    SCPEnvelopeFilter& getEnvelopeFilter();
+    SCPEnvelopeFilter const& getEnvelopeFilter() const;
+
+    // envelopes waiting to be processed by priority rather than in their
+    // arrival order, see SCPEnvelopeQueue
+    SCPEnvelopeQueue& getEnvelopeQueue();
+    SCPEnvelopeQueue const& getEnvelopeQueue() const;
+
+    // Opt-in ownership of SCP by a single consensus thread, fed by the
+    // other threads through a lock-free inbox of verified envelopes and
+    // timer expirations, see SCPInbox. Creates the inbox (or drops it if
+    // 0), to be called before it is shared with other threads.
+    void setInboxCapacity(size_t capacity);
+    // the inbox, which must have been created
+    SCPInbox& getInbox();
+
+    // nodes whose envelopes are admitted, when enabled by
+    // `setQuorumFilterEnabled`, see SCPQuorumFilter
+    SCPQuorumFilter const& getQuorumFilter() const;
+
+    // timers of the slots, coalesced into a single driver timer, see
+    // SCPTimers
+    SCPTimers& getTimers();
+    // cancels the timers of every slot
+    void stopTimers();
+
+    // Records the inputs of this instance and the answers of the driver to
+    // `path` until `stopRecording`, for `SCPReplay` to run them again
+    // offline, see SCPRecorder.
+    // The replay starts from a fresh instance: start recording before the
+    // first input, restoring the state included. Neither is to be called
+    // from a driver callback.
+    // returns false if the file can't be created
+    bool startRecording(char const* path);
+    // completes the file, if recording
+    void stopRecording();
+    bool isRecording() const;
+
     Json::Value getJsonInfo(size_t limit, bool fullKeys = false);
 
+    // writes the same information as getJsonInfo to out as it is produced,
+    // skipping the `offset` most recent slots, so that large states can be
+    // paginated without building them in memory
+    void writeJsonInfo(std::ostream& out, size_t limit, size_t offset = 0,
+                       bool fullKeys = false);
+
     // summary: only return object counts
     // index = 0 for returning information for all slots
     Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
@@ -89,15 +211,45 @@ class SCP
     // Helpers for monitoring and reporting the internal memory-usage of the SCP
     // protocol to system metric reporters.
     size_t getKnownSlotsCount() const;
+    // statements recorded by the known slots, whether or not the statement
+    // history keeps them (see `setStatementHistory`)
     size_t getCumulativeStatemtCount() const;
+    // bytes held by every known slot, by increasing slot index, see
+    // SlotMemoryUsage
+    std::vector<SlotMemoryUsage> getMemoryUsage() const;
+    // same for one slot, zero if it isn't known
+    SlotMemoryUsage getMemoryUsage(uint64 slotIndex) const;
 
     // returns the latest messages sent for the given slot
     std::vector<SCPEnvelope> getLatestMessagesSend(uint64 slotIndex);
+    // same, without copying the envelopes: the `forEach` methods return
+    // false if the visitor stopped
+    bool forEachLatestMessageSend(uint64 slotIndex,
+                                  EnvelopeVisitor const& f) const;
 
     // forces the state to match the one in the envelope
     // this is used when rebuilding the state after a crash for example
     void setStateFromEnvelope(uint64 slotIndex, SCPEnvelope const& e);
 
+    // same for all the envelopes of a slot at once: they must all be from
+    // the local node for `slotIndex`, with at most one nomination and one
+    // statement per ballot phase (the most advanced one is used), and the
+    // protocols they are for must not have started.
+    // Nothing is restored unless all of them are valid.
+    // returns true if the state was restored
+    bool restoreState(uint64 slotIndex, SCPEnvelope const* envelopes,
+                      size_t count);
+
+    // restores every slot of a snapshot produced by `getStateSnapshot`,
+    // which may be a memory mapped file: `data` must be 4-byte aligned
+    // returns false if the snapshot can't be decoded or one of its slots
+    // can't be restored (the slots before it are restored)
+    bool restoreState(uint8_t const* data, size_t size);
+
+    // the latest messages sent for every known slot (see
+    // `getLatestMessagesSend`), XDR encoded
+    std::vector<uint8_t> getStateSnapshot();
+
     // check if we are holding some slots
     bool empty() const;
     // return lowest slot index value
@@ -107,14 +259,102 @@ class SCP
 
     // returns all messages for the slot
     std::vector<SCPEnvelope> getCurrentState(uint64 slotIndex);
+    bool forEachCurrentEnvelope(uint64 slotIndex,
+                                EnvelopeVisitor const& f) const;
 
     // returns the latest message from a node
     // or nullptr if not found
     SCPEnvelope const* getLatestMessage(NodeID const& id);
 
+    // records that the slot `slotIndex` holds an envelope of the node at
+    // position `node` of the node index, see `getLatestMessage`
+    void recordLatestMessage(size_t node, uint64 slotIndex);
+
     // returns messages that contributed to externalizing the slot
     // (or empty if the slot didn't externalize)
     std::vector<SCPEnvelope> getExternalizingState(uint64 slotIndex);
+    bool forEachExternalizingEnvelope(uint64 slotIndex,
+                                      EnvelopeVisitor const& f) const;
+
+    // Publishes the current state of the known slots for other threads:
+    // only the slots that changed since the previous snapshot are copied.
+    void publishReadSnapshot();
+    // the latest published snapshot, empty until the first one; unlike the
+    // rest of SCP, this can be called from any thread
+    std::shared_ptr<SCPReadSnapshot const> getReadSnapshot() const;
+
+    // Opt-in publication of the read snapshot when every input of SCP
+    // returns: envelopes, nominations, answers of the driver, timers and
+    // purges (nested inputs publish once, with the outermost one).
+    // Enabling it publishes the current state. Drivers without readers on
+    // other threads leave it off, as the snapshot isn't free.
+    void setReadSnapshotEnabled(bool enabled);
+    bool isReadSnapshotEnabled() const;
+
+    // Makes the inputs of SCP in its lifetime publish the read snapshot
+    // once, when it ends, for callers feeding SCP several inputs in a row
+    class ReadSnapshotScope
+    {
+        SCP& mSCP;
+
+      public:
+        explicit ReadSnapshotScope(SCP& scp);
+        ~ReadSnapshotScope();
+        ReadSnapshotScope(ReadSnapshotScope const&) = delete;
+        ReadSnapshotScope& operator=(ReadSnapshotScope const&) = delete;
+    };
+
+    // Opt-in cache of `SCPDriver::getQSet`, kept by every slot so that a
+    // protocol step resolves each distinct hash once.
+    // Drivers enabling it must call `invalidateQSet` (or `invalidateQSets`)
+    // whenever `getQSet` stops returning a quorum set it previously returned.
+    // `nullptr` results are never cached.
+    void setQSetCacheEnabled(bool enabled);
+    bool isQSetCacheEnabled() const;
+    // drops the quorum set for qSetHash from the cache of every slot
+    void invalidateQSet(Hash const& qSetHash);
+    // drops every cached quorum set
+    void invalidateQSets();
+    // incremented by every `invalidateQSets`, slots with an older
+    // generation discard their cache
+    uint64
+    getQSetGeneration() const
+    {
+        return mQSetGeneration;
+    }
+
+    // Opt-in catch-up of the slots a node fell behind on: a slot still in
+    // the PREPARE phase externalizes as soon as the CONFIRM and EXTERNALIZE
+    // statements it received show that a v-blocking quorum accepted to
+    // commit a value, instead of going through the accept and confirm
+    // steps of the ballot protocol first, each emitting a statement.
+    void setCatchUpEnabled(bool enabled);
+    bool isCatchUpEnabled() const;
+
+    // Opt-in admission of the envelopes received: the envelopes of the
+    // nodes outside the transitive quorum of the local node are INVALID,
+    // and dropped before creating any slot state (see SCPQuorumFilter).
+    void setQuorumFilterEnabled(bool enabled);
+    bool isQuorumFilterEnabled() const;
+
+    // Statements recorded by slots for debugging purpose (see
+    // `Slot::getJsonInfo`), all of them as is by default.
+    enum HistoryMode
+    {
+        HISTORY_OFF,    // not recorded
+        HISTORY_FULL,   // recorded as is
+        HISTORY_COMPACT // only the time, type and hash are recorded
+    };
+    // limit: maximum number of statements kept by a slot, the oldest ones
+    // being dropped first (0: no limit)
+    // changing the mode discards the history of every slot
+    void setStatementHistory(HistoryMode mode, size_t limit = 0);
+    HistoryMode getHistoryMode() const;
+    size_t getHistoryLimit() const;
+
+    // `SCPDriver::toStrKey` of a node, rendered once per node of the node
+    // index: drivers must render a key the same way for the lifetime of SCP
+    std::string toStrKey(NodeID const& nodeID, bool fullKey) const;
 
     // ** helper methods to stringify ballot for logging
     std::string getValueString(Value const& v) const;
@@ -126,7 +366,39 @@ class SCP
 
   protected:
     std::shared_ptr<LocalNode> mLocalNode;
-    std::map<uint64, std::shared_ptr<Slot>> mKnownSlots;
+    SlotStore mKnownSlots;
+
+    bool mQSetCacheEnabled;
+    bool mCatchUpEnabled;
+    bool mQuorumFilterEnabled;
+    bool mReadSnapshotEnabled;
+    // inputs running, see ReadSnapshotScope
+    uint32 mInputDepth;
+    uint64 mQSetGeneration;
+
+    std::shared_ptr<NodeIndex> mNodeIndex;
+
+    // highest slot holding an envelope of every node of mNodeIndex, or
+    // NO_SLOT: envelopes are only dropped with their slot, so it is the one
+    // `getLatestMessage` returns from
+    static constexpr uint64 NO_SLOT = UINT64_MAX;
+    std::vector<uint64> mLatestMessageSlots;
+
+    HistoryMode mHistoryMode;
+    size_t mHistoryLimit;
+
+    std::unique_ptr<SCPTrace> mTrace;
+    std::unique_ptr<SCPLatency> mLatency;
+    std::unique_ptr<SCPEnvelopeFilter> mEnvelopeFilter;
+    std::unique_ptr<SCPEnvelopeQueue> mEnvelopeQueue;
+    std::unique_ptr<SCPQuorumFilter> mQuorumFilter;
+    std::unique_ptr<SCPInbox> mInbox;
+
+    // only accessed with std::atomic_load / std::atomic_store
+    std::shared_ptr<SCPReadSnapshot const> mReadSnapshot;
+
+    std::unique_ptr<SCPTimers> mTimers;
+    std::unique_ptr<SCPRecorder> mRecorder;
 
     // Slot getter
     std::shared_ptr<Slot> getSlot(uint64 slotIndex, bool create);
@@ -59,6 +59,19 @@ SCPDriver::computeHashNode(uint64 slotIndex, Value const& prev, bool isPriority,
     return hashHelper(hash);
 }
 
+void
+SCPDriver::computeHashNodes(uint64 slotIndex, Value const& prev,
+                            bool isPriority, int32_t roundNumber,
+                            std::vector<NodeID> const& nodeIDs,
+                            std::vector<uint64>& hashes)
+{
+    for (size_t i = 0; i < nodeIDs.size(); i++)
+    {
+        hashes[i] = computeHashNode(slotIndex, prev, isPriority, roundNumber,
+                                    nodeIDs[i]);
+    }
+}
+
 uint64
 SCPDriver::computeValueHash(uint64 slotIndex, Value const& prev,
                             int32_t roundNumber, Value const& value)
@@ -67,6 +80,18 @@ SCPDriver::computeValueHash(uint64 slotIndex, Value const& prev,
     return hashHelper(hash);
 }
 
+void
+SCPDriver::computeValueHashes(uint64 slotIndex, Value const& prev,
+                              int32_t roundNumber,
+                              std::vector<Value> const& values,
+                              std::vector<uint64>& hashes)
+{
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        hashes[i] = computeValueHash(slotIndex, prev, roundNumber, values[i]);
+    }
+}
+
 static const int MAX_TIMEOUT_SECONDS = (30 * 60);
 
 std::chrono::milliseconds
@@ -32,7 +32,8 @@ class SCPDriver
     // a quorum set hash.
     // SCP does not define how quorum sets are exchanged between nodes,
     // hence their retrieval is delegated to the user of SCP.
-    // The return value is not cached by SCP, as quorum sets are transient.
+    // The return value is not cached by SCP, as quorum sets are transient,
+    // unless the cache is enabled with `SCP::setQSetCacheEnabled`.
     //
     // `nullptr` is a valid return value which cause the statement to be
     // considered invalid.
@@ -59,11 +60,18 @@ class SCPDriver
     // the current slot to be marked as a non validating slot: the local node
     // will abstain from emiting its position.
     // validation can be *more* restrictive during nomination as needed
+    // If validating the value takes time (fetching or checking data that
+    // isn't local), kPendingValue can be returned and the verdict given
+    // later with `SCP::valueValidated`: the statements that need the value
+    // wait for it, and it isn't asked again for this slot in the meantime.
+    // The local node's own ballot statements can't wait: for them,
+    // kPendingValue is handled as kMaybeValidValue.
     enum ValidationLevel
     {
         kInvalidValue,        // value is invalid for sure
         kFullyValidatedValue, // value is valid for sure
-        kMaybeValidValue      // value may be valid
+        kMaybeValidValue,     // value may be valid
+        kPendingValue         // value is being validated
     };
     virtual ValidationLevel
     validateValue(uint64 slotIndex, Value const& value, bool nomination)
@@ -103,11 +111,17 @@ class SCPDriver
 
     // `combineCandidates` computes the composite value based off a list
     // of candidate values.
+    // It can also return an empty value and give the composite value later
+    // with `SCP::candidatesCombined`: the slot then waits for it before
+    // bumping its ballot, and calls combineCandidates again if it got new
+    // candidates in the meantime.
     virtual Value combineCandidates(uint64 slotIndex,
                                     std::set<Value> const& candidates) = 0;
 
     // `setupTimer`: requests to trigger 'cb' after timeout
     // if cb is nullptr, the timer is cancelled
+    // SCP coalesces the timers of its slots (see SCPTimers): every call
+    // replaces the previous timer, whatever its slotIndex and timerID
     virtual void setupTimer(uint64 slotIndex, int timerID,
                             std::chrono::milliseconds timeout,
                             std::function<void()>* cb) = 0;
@@ -121,6 +135,10 @@ class SCPDriver
 
     // `valueExternalized` is called at most once per slot when the slot
     // externalize its value.
+    // The value can be applied after returning, while SCP processes the
+    // next slots: validations that need it can be left pending
+    // (kPendingValue), and `SCP::externalizeCompleted` asks them again once
+    // it is applied.
     virtual void
     valueExternalized(uint64 slotIndex, Value const& value)
     {
@@ -162,5 +180,23 @@ class SCPDriver
     // the local node.
     virtual void
     ballotDidHearFromQuorum(uint64 slotIndex, SCPBallot const& ballot);
+
+    // `computeHashNodes` computes `computeHashNode` for every node of
+    // `nodeIDs` into `hashes`, which already has the same size.
+    // Drivers can override it to share the work between nodes, the default
+    // implementation calls `computeHashNode` for each of them.
+    virtual void computeHashNodes(uint64 slotIndex, Value const& prev,
+                                  bool isPriority, int32_t roundNumber,
+                                  std::vector<NodeID> const& nodeIDs,
+                                  std::vector<uint64>& hashes);
+
+    // `computeValueHashes` computes `computeValueHash` for every value of
+    // `values` into `hashes`, which already has the same size.
+    // Drivers can override it to share the work between values, the default
+    // implementation calls `computeValueHash` for each of them.
+    virtual void computeValueHashes(uint64 slotIndex, Value const& prev,
+                                    int32_t roundNumber,
+                                    std::vector<Value> const& values,
+                                    std::vector<uint64>& hashes);
 };
 }
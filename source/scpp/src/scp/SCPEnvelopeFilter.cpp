@@ -0,0 +1,51 @@
+/*******************************************************************************
+
+    Implementation of the filter dropping the copies of the envelopes received,
+    see SCPEnvelopeFilter.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPEnvelopeFilter.h"
+
+namespace stellar
+{
+bool
+SCPEnvelopeFilter::contains(uint64 slotIndex, Hash const& statementHash) const
+{
+    auto it = mStatements.find(slotIndex);
+    return it != mStatements.end() && it->second.count(statementHash) != 0;
+}
+
+bool
+SCPEnvelopeFilter::add(uint64 slotIndex, Hash const& statementHash)
+{
+    return mStatements[slotIndex].insert(statementHash).second;
+}
+
+void
+SCPEnvelopeFilter::purge(uint64 maxSlotIndex)
+{
+    mStatements.erase(mStatements.begin(),
+                      mStatements.lower_bound(maxSlotIndex));
+}
+
+size_t
+SCPEnvelopeFilter::size() const
+{
+    size_t res = 0;
+    for (auto const& s : mStatements)
+    {
+        res += s.second.size();
+    }
+    return res;
+}
+}
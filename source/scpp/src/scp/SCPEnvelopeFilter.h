@@ -0,0 +1,55 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the filter dropping the copies of the envelopes received.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <map>
+#include <unordered_set>
+
+#include "util/HashOfHash.h"
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+/**
+ * Hashes of the statements received for every slot, so that the copies of
+ * an envelope relayed by several peers can be dropped before their
+ * signature is verified and SCP sees them again.
+ *
+ * The hash function is up to the caller, as long as it is always the same.
+ * Only statements from envelopes with a valid signature must be added: the
+ * statement is then known to come from its node, and another envelope
+ * carrying it has nothing new for SCP, whatever its signature.
+ *
+ * Slots are dropped by `SCP::purgeSlots`.
+ */
+class SCPEnvelopeFilter
+{
+    std::map<uint64, std::unordered_set<Hash>> mStatements;
+
+  public:
+    // true if the statement was added for this slot
+    bool contains(uint64 slotIndex, Hash const& statementHash) const;
+
+    // returns false if the statement was already added for this slot
+    bool add(uint64 slotIndex, Hash const& statementHash);
+
+    // drops every slot whose index is smaller than `maxSlotIndex`
+    void purge(uint64 maxSlotIndex);
+
+    // the number of statements known, over all slots
+    size_t size() const;
+};
+}
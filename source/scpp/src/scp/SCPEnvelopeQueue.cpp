@@ -0,0 +1,195 @@
+/*******************************************************************************
+
+    Implementation of the queue handing the envelopes received to SCP by
+    priority, see SCPEnvelopeQueue.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPEnvelopeQueue.h"
+
+#include "scp/BallotProtocol.h"
+#include "scp/NominationProtocol.h"
+#include "scp/SCP.h"
+#include "util/Tracy.h"
+#include "util/XDROperators.h"
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+namespace stellar
+{
+namespace
+{
+// position of a statement within its slot, lower first
+int
+getRank(SCPStatement const& st, bool leader)
+{
+    switch (st.pledges.type())
+    {
+    case SCP_ST_EXTERNALIZE:
+        return 0;
+    case SCP_ST_CONFIRM:
+        return 1;
+    case SCP_ST_PREPARE:
+        return 2;
+    default:
+        return leader ? 3 : 4;
+    }
+}
+
+// ballot counter of the statement, higher first
+uint32
+getCounter(SCPStatement const& st)
+{
+    switch (st.pledges.type())
+    {
+    case SCP_ST_PREPARE:
+        return st.pledges.prepare().ballot.counter;
+    case SCP_ST_CONFIRM:
+        return st.pledges.confirm().ballot.counter;
+    default:
+        return 0;
+    }
+}
+}
+
+bool
+SCPEnvelopeQueue::Key::operator<(Key const& other) const
+{
+    return std::tie(mSlotIndex, mNomination, mNodeID) <
+           std::tie(other.mSlotIndex, other.mNomination, other.mNodeID);
+}
+
+SCPEnvelopeQueue::SCPEnvelopeQueue(SCP& scp) : mSCP(scp)
+{
+}
+
+bool
+SCPEnvelopeQueue::push(SCPEnvelope const& envelope)
+{
+    auto const& st = envelope.statement;
+    bool nomination = st.pledges.type() == SCP_ST_NOMINATE;
+    auto res =
+        mPending.emplace(Key{st.slotIndex, st.nodeID, nomination}, Entry());
+    auto& entry = res.first->second;
+    if (!res.second)
+    {
+        auto const& old = entry.mEnvelope.statement;
+        if (nomination ? !NominationProtocol::isNewerStatement(
+                             old.pledges.nominate(), st.pledges.nominate())
+                       : !BallotProtocol::isNewerStatement(old, st))
+        {
+            return false;
+        }
+    }
+    entry.mEnvelope = envelope;
+    entry.mSeq = mNextSeq++;
+    return true;
+}
+
+size_t
+SCPEnvelopeQueue::process(size_t max)
+{
+    ZoneScoped;
+    struct Item
+    {
+        uint64 mSlotIndex;
+        int mRank;
+        uint32 mCounter;
+        uint64 mSeq;
+        std::map<Key, Entry>::iterator mIt;
+    };
+
+    std::vector<Item> items;
+    items.reserve(mPending.size());
+    std::set<NodeID> leaders;
+    for (auto it = mPending.begin(); it != mPending.end(); ++it)
+    {
+        auto const& st = it->second.mEnvelope.statement;
+        // the queue is ordered by slot: leaders are asked once per slot
+        if (items.empty() || items.back().mSlotIndex != st.slotIndex)
+        {
+            leaders = mSCP.getNominationLeaders(st.slotIndex);
+        }
+        bool leader = it->first.mNomination && leaders.count(st.nodeID) != 0;
+        items.push_back(Item{st.slotIndex, getRank(st, leader),
+                             getCounter(st), it->second.mSeq, it});
+    }
+
+    auto before = [](Item const& a, Item const& b) {
+        if (a.mSlotIndex != b.mSlotIndex)
+        {
+            return a.mSlotIndex > b.mSlotIndex;
+        }
+        if (a.mRank != b.mRank)
+        {
+            return a.mRank < b.mRank;
+        }
+        if (a.mCounter != b.mCounter)
+        {
+            return a.mCounter > b.mCounter;
+        }
+        return a.mSeq < b.mSeq;
+    };
+    if (max != 0 && max < items.size())
+    {
+        std::partial_sort(items.begin(), items.begin() + max, items.end(),
+                          before);
+        items.resize(max);
+    }
+    else
+    {
+        std::sort(items.begin(), items.end(), before);
+    }
+
+    // out of the queue before SCP runs, as the driver may push meanwhile
+    std::vector<std::vector<SCPEnvelope>> bySlot;
+    for (auto& item : items)
+    {
+        if (bySlot.empty() ||
+            bySlot.back().front().statement.slotIndex != item.mSlotIndex)
+        {
+            bySlot.emplace_back();
+        }
+        bySlot.back().emplace_back(std::move(item.mIt->second.mEnvelope));
+        mPending.erase(item.mIt);
+    }
+
+    size_t res = 0;
+    SCP::ReadSnapshotScope snapshot(mSCP);
+    for (auto const& envelopes : bySlot)
+    {
+        res += mSCP.receiveEnvelopes(envelopes);
+    }
+    return res;
+}
+
+void
+SCPEnvelopeQueue::purge(uint64 maxSlotIndex)
+{
+    mPending.erase(mPending.begin(),
+                   mPending.lower_bound(Key{maxSlotIndex, NodeID(), false}));
+}
+
+size_t
+SCPEnvelopeQueue::size() const
+{
+    return mPending.size();
+}
+
+bool
+SCPEnvelopeQueue::empty() const
+{
+    return mPending.empty();
+}
+}
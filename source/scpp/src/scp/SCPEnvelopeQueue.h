@@ -0,0 +1,87 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the queue handing the envelopes received to SCP by priority.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <map>
+
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+class SCP;
+
+/**
+ * Envelopes received but not processed yet, handed to SCP in the order in
+ * which they are the most likely to advance its state rather than in the
+ * order in which they arrived:
+ * - the most recent slots first
+ * - within a slot, EXTERNALIZE, then CONFIRM, then PREPARE by decreasing
+ *   ballot counter, then the nominations of the current round leaders,
+ *   then the other nominations
+ * - in arrival order otherwise
+ *
+ * Only the latest statement of a node is kept for each slot and protocol,
+ * as SCP drops the older ones anyway: under a flood of envelopes, the
+ * superseded ones are dropped before SCP sees them.
+ * Envelopes must be verified before being queued, as an envelope replaces
+ * the one of its node.
+ *
+ * Slots are dropped by `SCP::purgeSlots`.
+ */
+class SCPEnvelopeQueue
+{
+    SCP& mSCP;
+
+    struct Key
+    {
+        uint64 mSlotIndex;
+        NodeID mNodeID;
+        bool mNomination;
+
+        bool operator<(Key const& other) const;
+    };
+
+    struct Entry
+    {
+        SCPEnvelope mEnvelope;
+        uint64 mSeq;
+    };
+
+    // ordered by slot, purge drops a prefix
+    std::map<Key, Entry> mPending;
+    uint64 mNextSeq{0};
+
+  public:
+    explicit SCPEnvelopeQueue(SCP& scp);
+
+    // returns false if the envelope was dropped, as a newer statement of
+    // its node is already queued for the slot and protocol
+    bool push(SCPEnvelope const& envelope);
+
+    // processes the `max` first envelopes (all of them if 0) with
+    // `SCP::receiveEnvelopes`, and returns the number that were VALID.
+    // The envelopes pushed meanwhile, e.g. by the driver, wait for the
+    // next call.
+    size_t process(size_t max = 0);
+
+    // drops every slot whose index is smaller than `maxSlotIndex`
+    void purge(uint64 maxSlotIndex);
+
+    // the number of envelopes queued, over all slots
+    size_t size() const;
+    bool empty() const;
+};
+}
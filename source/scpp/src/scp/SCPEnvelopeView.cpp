@@ -0,0 +1,295 @@
+/*******************************************************************************
+
+    Implementation of a read-only view of XDR encoded envelopes, see
+    SCPEnvelopeView.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPEnvelopeView.h"
+
+#include "crypto/XDRHasher.h"
+#include "util/GlobalChecks.h"
+#include "util/Tracy.h"
+#include "xdrpp/marshal.h"
+
+#include <cstring>
+
+namespace stellar
+{
+constexpr size_t SCPEnvelopeView::NODE_ID_SIZE;
+constexpr size_t SCPEnvelopeView::SIGNATURE_SIZE;
+
+namespace
+{
+constexpr size_t HASH_SIZE = 64;
+constexpr size_t UINT256_SIZE = 32;
+
+// walks a message, checking every read against its end
+class Reader
+{
+    unsigned char const* mData;
+    size_t mSize;
+    size_t mOffset{0};
+
+  public:
+    Reader(unsigned char const* data, size_t size) : mData(data), mSize(size)
+    {
+    }
+
+    size_t
+    offset() const
+    {
+        return mOffset;
+    }
+    bool
+    atEnd() const
+    {
+        return mOffset == mSize;
+    }
+
+    bool
+    skip(size_t n)
+    {
+        if (n > mSize - mOffset)
+        {
+            return false;
+        }
+        mOffset += n;
+        return true;
+    }
+    bool
+    uint32(uint32_t& res)
+    {
+        if (mSize - mOffset < 4)
+        {
+            return false;
+        }
+        unsigned char const* p = mData + mOffset;
+        res = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+              (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        mOffset += 4;
+        return true;
+    }
+    bool
+    uint64(uint64_t& res)
+    {
+        uint32_t hi, lo;
+        if (!uint32(hi) || !uint32(lo))
+        {
+            return false;
+        }
+        res = (uint64_t(hi) << 32) | lo;
+        return true;
+    }
+    // variable length opaque, its padding must be zeroes
+    bool
+    opaque()
+    {
+        uint32_t len;
+        if (!uint32(len) || !skip(len))
+        {
+            return false;
+        }
+        size_t pad = (4 - (len & 3)) & 3;
+        if (mSize - mOffset < pad)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < pad; i++)
+        {
+            if (mData[mOffset + i] != 0)
+            {
+                return false;
+            }
+        }
+        mOffset += pad;
+        return true;
+    }
+    // array of opaques, sets count and start to its size and first element
+    bool
+    opaques(uint32_t& count, size_t& start)
+    {
+        if (!uint32(count))
+        {
+            return false;
+        }
+        start = mOffset;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!opaque())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool
+    ballot(size_t& value)
+    {
+        uint32_t counter;
+        if (!uint32(counter))
+        {
+            return false;
+        }
+        value = mOffset;
+        return opaque();
+    }
+    bool
+    optionalBallot()
+    {
+        uint32_t present;
+        size_t value;
+        if (!uint32(present) || present > 1)
+        {
+            return false;
+        }
+        return present == 0 || ballot(value);
+    }
+};
+}
+
+bool
+SCPEnvelopeView::parse(ByteSlice const& msg)
+{
+    ZoneScoped;
+    *this = SCPEnvelopeView();
+    Reader r(msg.data(), msg.size());
+
+    uint32_t keyType;
+    if (!r.uint32(keyType) || keyType != PUBLIC_KEY_TYPE_ED25519 ||
+        !r.skip(UINT256_SIZE) || !r.uint64(mSlotIndex))
+    {
+        return false;
+    }
+
+    uint32_t type, dummy;
+    if (!r.uint32(type))
+    {
+        return false;
+    }
+    switch (type)
+    {
+    case SCP_ST_PREPARE:
+        if (!r.skip(HASH_SIZE) || !r.ballot(mBallotValue) ||
+            !r.optionalBallot() || !r.optionalBallot() || !r.uint32(dummy) ||
+            !r.uint32(dummy))
+        {
+            return false;
+        }
+        break;
+    case SCP_ST_CONFIRM:
+        if (!r.ballot(mBallotValue) || !r.skip(UINT256_SIZE + 3 * 4) ||
+            !r.skip(HASH_SIZE))
+        {
+            return false;
+        }
+        break;
+    case SCP_ST_EXTERNALIZE:
+        if (!r.ballot(mBallotValue) || !r.uint32(dummy) || !r.skip(HASH_SIZE))
+        {
+            return false;
+        }
+        break;
+    case SCP_ST_NOMINATE:
+        if (!r.skip(HASH_SIZE) || !r.opaques(mNumVotes, mVotes) ||
+            !r.opaques(mNumAccepted, mAccepted))
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    mType = static_cast<SCPStatementType>(type);
+
+    if (!r.skip(SIGNATURE_SIZE) || !r.atEnd())
+    {
+        return false;
+    }
+    mData = msg.data();
+    mSize = msg.size();
+    return true;
+}
+
+uint32
+SCPEnvelopeView::readUint32(size_t offset) const
+{
+    unsigned char const* p = mData + offset;
+    return (uint32(p[0]) << 24) | (uint32(p[1]) << 16) | (uint32(p[2]) << 8) |
+           uint32(p[3]);
+}
+
+ByteSlice
+SCPEnvelopeView::readOpaque(size_t offset) const
+{
+    return ByteSlice(mData + offset + 4, readUint32(offset));
+}
+
+size_t
+SCPEnvelopeView::skipOpaque(size_t offset) const
+{
+    uint32 len = readUint32(offset);
+    return offset + 4 + len + ((4 - (len & 3)) & 3);
+}
+
+NodeID
+SCPEnvelopeView::getNodeID() const
+{
+    dbgAssert(mData != nullptr);
+    NodeID res;
+    res.type(PUBLIC_KEY_TYPE_ED25519);
+    std::memcpy(res.ed25519().data(), mData + 4, UINT256_SIZE);
+    return res;
+}
+
+ByteSlice
+SCPEnvelopeView::getStatement() const
+{
+    dbgAssert(mData != nullptr);
+    return ByteSlice(mData, mSize - SIGNATURE_SIZE);
+}
+
+ByteSlice
+SCPEnvelopeView::getSignature() const
+{
+    dbgAssert(mData != nullptr);
+    return ByteSlice(mData + mSize - SIGNATURE_SIZE, SIGNATURE_SIZE);
+}
+
+uint512
+SCPEnvelopeView::getStatementHash() const
+{
+    XDRHasher hasher;
+    hasher.addEncoded(getStatement());
+    return hasher.finish();
+}
+
+ByteSlice
+SCPEnvelopeView::getBallotValue() const
+{
+    dbgAssert(mData != nullptr);
+    if (mType == SCP_ST_NOMINATE)
+    {
+        return ByteSlice(mData, 0);
+    }
+    return readOpaque(mBallotValue);
+}
+
+void
+SCPEnvelopeView::decode(SCPEnvelope& out) const
+{
+    dbgAssert(mData != nullptr);
+    xdr::xdr_get g(mData, mData + mSize);
+    xdr::xdr_argpack_archive(g, out);
+    g.done();
+}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains a read-only view of XDR encoded envelopes.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "crypto/ByteSlice.h"
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * Read-only view of a XDR encoded SCPEnvelope.
+ *
+ * `parse` checks the message the way xdr::xdr_from_opaque does but doesn't
+ * allocate: values are returned as slices of the message, which must
+ * outlive the view. This lets a receiver look at the slot index, sender and
+ * statement of an envelope (and drop it when it is stale or a duplicate)
+ * before paying for an owned SCPEnvelope.
+ */
+class SCPEnvelopeView
+{
+    unsigned char const* mData{nullptr};
+    size_t mSize{0};
+
+    uint64 mSlotIndex{0};
+    SCPStatementType mType{SCP_ST_PREPARE};
+
+    // offset of the opaque of the ballot (b, c for EXTERNALIZE)
+    size_t mBallotValue{0};
+    // offsets of the first vote / accepted value of a nomination
+    size_t mVotes{0};
+    uint32 mNumVotes{0};
+    size_t mAccepted{0};
+    uint32 mNumAccepted{0};
+
+    uint32 readUint32(size_t offset) const;
+    ByteSlice readOpaque(size_t offset) const;
+    // offset of the element following the (validated) opaque at offset
+    size_t skipOpaque(size_t offset) const;
+
+    template <typename F>
+    void
+    forEachValue(size_t offset, uint32 count, F f) const
+    {
+        for (uint32 i = 0; i < count; i++)
+        {
+            f(readOpaque(offset));
+            offset = skipOpaque(offset);
+        }
+    }
+
+  public:
+    static constexpr size_t NODE_ID_SIZE = 4 + 32;
+    static constexpr size_t SIGNATURE_SIZE = 64;
+
+    // binds the view to msg, false if msg isn't a valid envelope (the view
+    // must not be used then)
+    bool parse(ByteSlice const& msg);
+
+    NodeID getNodeID() const;
+    uint64
+    getSlotIndex() const
+    {
+        return mSlotIndex;
+    }
+    SCPStatementType
+    getType() const
+    {
+        return mType;
+    }
+
+    // encoding of the statement
+    ByteSlice getStatement() const;
+    ByteSlice getSignature() const;
+
+    // getXDRHashOf the statement, as EncodedEnvelope::getStatementHash
+    uint512 getStatementHash() const;
+
+    // value of the ballot b (c for EXTERNALIZE), empty for NOMINATE
+    ByteSlice getBallotValue() const;
+
+    // calls f(ByteSlice const&) with the votes / accepted values of a
+    // NOMINATE statement
+    template <typename F>
+    void
+    forEachVote(F f) const
+    {
+        forEachValue(mVotes, mNumVotes, f);
+    }
+    template <typename F>
+    void
+    forEachAccepted(F f) const
+    {
+        forEachValue(mAccepted, mNumAccepted, f);
+    }
+
+    // decodes the whole envelope into out: xvectors keep their capacity, so
+    // reusing the same envelope for every message avoids most allocations
+    void decode(SCPEnvelope& out) const;
+};
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+
+    Implementation of the inbox of a SCP instance owned by a single thread, see
+    SCPInbox.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPInbox.h"
+
+#include "scp/SCP.h"
+#include "util/Tracy.h"
+
+namespace stellar
+{
+SCPInbox::SCPInbox(SCP& scp, size_t capacity)
+    : mSCP(scp), mEnvelopes(capacity)
+{
+}
+
+void
+SCPInbox::setWakeUp(std::function<void()> wakeUp)
+{
+    mWakeUp = std::move(wakeUp);
+}
+
+void
+SCPInbox::signal()
+{
+    if (mWakeUp && !mSignaled.exchange(true))
+    {
+        mWakeUp();
+    }
+}
+
+bool
+SCPInbox::push(SCPEnvelope const& envelope)
+{
+    if (!mEnvelopes.tryPush(envelope))
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    signal();
+    return true;
+}
+
+void
+SCPInbox::postTimer()
+{
+    mTimerExpired.store(true);
+    signal();
+}
+
+size_t
+SCPInbox::process(size_t max)
+{
+    ZoneScoped;
+    // before popping: the events posted from now on wake the thread again
+    mSignaled.store(false);
+    // a single snapshot for the timers and envelopes processed
+    SCP::ReadSnapshotScope snapshot(mSCP);
+    if (mTimerExpired.exchange(false))
+    {
+        mSCP.getTimers().fire();
+    }
+
+    // at most a lap of the queue, as producers may keep pushing
+    size_t limit = max == 0 ? mEnvelopes.capacity() : max;
+    auto& queue = mSCP.getEnvelopeQueue();
+    SCPEnvelope envelope;
+    for (size_t n = 0; n < limit && mEnvelopes.tryPop(envelope); ++n)
+    {
+        queue.push(envelope);
+    }
+    return queue.process();
+}
+
+uint64
+SCPInbox::getDroppedCount() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+size_t
+SCPInbox::capacity() const
+{
+    return mEnvelopes.capacity();
+}
+}
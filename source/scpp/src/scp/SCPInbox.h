@@ -0,0 +1,84 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the inbox of a SCP instance owned by a single thread.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <functional>
+
+#include "util/BoundedMPSCQueue.h"
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+class SCP;
+
+/**
+ * Inbound events of a SCP instance owned by a single thread, the consensus
+ * thread, posted from any other thread: the network threads push envelopes
+ * once they verified them, and the driver reports the expiration of the
+ * timers set by `SCPDriver::setupTimer` here rather than calling their
+ * callback. Nothing else of SCP is thread safe, so the consensus thread is
+ * the only one calling it, by processing the inbox whenever it is woken up.
+ *
+ * Envelopes go through a BoundedMPSCQueue: a push never blocks, and fails
+ * when the consensus thread falls too far behind, the envelope being
+ * dropped as if it were lost by the network: the capacity must cover the
+ * bursts expected, and drivers rebroadcast as they do for lost messages.
+ * Envelopes processed go through the SCPEnvelopeQueue of SCP.
+ * Emissions happen on the consensus thread, from which drivers hand them
+ * to the network threads, typically with their own BoundedMPSCQueue.
+ *
+ * Created by `SCP::setInboxCapacity`.
+ */
+class SCPInbox
+{
+    SCP& mSCP;
+    BoundedMPSCQueue<SCPEnvelope> mEnvelopes;
+    std::atomic<bool> mTimerExpired{false};
+    // true from the time producers wake the consumer up until it processes
+    // the inbox: a single wake up for the events posted meanwhile
+    std::atomic<bool> mSignaled{false};
+    std::atomic<uint64> mDropped{0};
+    std::function<void()> mWakeUp;
+
+    void signal();
+
+  public:
+    SCPInbox(SCP& scp, size_t capacity);
+
+    // called from the producer thread after posting events, when the
+    // consensus thread has to process the inbox; to be set before the
+    // inbox is shared with other threads
+    void setWakeUp(std::function<void()> wakeUp);
+
+    // from any thread: queues a verified envelope, returns false if the
+    // inbox is full and the envelope was dropped
+    bool push(SCPEnvelope const& envelope);
+
+    // from any thread: the timer set with `SCPDriver::setupTimer` expired
+    void postTimer();
+
+    // from the consensus thread: runs the expired timers and processes the
+    // `max` first envelopes (a capacity worth if 0) with the
+    // SCPEnvelopeQueue, returns the number that were VALID
+    size_t process(size_t max = 0);
+
+    // number of envelopes dropped by `push`
+    uint64 getDroppedCount() const;
+
+    size_t capacity() const;
+};
+}
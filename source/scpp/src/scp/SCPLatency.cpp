@@ -0,0 +1,130 @@
+/*******************************************************************************
+
+    Implementation of the latency histograms of the phases of the slots, see
+    SCPLatency.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPLatency.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace stellar
+{
+constexpr uint32 LatencyHistogram::SUB_BITS;
+constexpr uint32 LatencyHistogram::SUB_BUCKETS;
+constexpr uint32 LatencyHistogram::MAX_BIT;
+constexpr size_t LatencyHistogram::NUM_BUCKETS;
+
+size_t
+LatencyHistogram::getBucket(uint64 micros)
+{
+    if (micros < SUB_BUCKETS)
+    {
+        return static_cast<size_t>(micros);
+    }
+    uint32 bit = 63 - __builtin_clzll(micros);
+    if (bit > MAX_BIT)
+    {
+        return NUM_BUCKETS - 1;
+    }
+    return (bit - SUB_BITS + 1) * SUB_BUCKETS +
+           ((micros >> (bit - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+uint64
+LatencyHistogram::getBucketUpperBound(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    uint32 shift = static_cast<uint32>(bucket / SUB_BUCKETS) - 1;
+    uint64 low = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + (uint64(1) << shift) - 1;
+}
+
+void
+LatencyHistogram::record(uint64 micros)
+{
+    mCounts[getBucket(micros)]++;
+    mCount++;
+    mSum += micros;
+    mMax = std::max(mMax, micros);
+}
+
+uint64
+LatencyHistogram::getPercentile(double q) const
+{
+    if (mCount == 0)
+    {
+        return 0;
+    }
+    q = std::min(std::max(q, 0.0), 1.0);
+    // rank of the value, starting at 1
+    uint64 rank = std::max<uint64>(
+        1, static_cast<uint64>(std::ceil(q * static_cast<double>(mCount))));
+    uint64 seen = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; b++)
+    {
+        seen += mCounts[b];
+        if (seen >= rank)
+        {
+            // the bound of the last bucket is a clamp, not a measurement
+            return std::min(getBucketUpperBound(b), mMax);
+        }
+    }
+    return mMax;
+}
+
+void
+LatencyHistogram::clear()
+{
+    *this = LatencyHistogram();
+}
+
+const char* SCPLatency::phaseNames[SCPLatency::NUM_PHASES] = {
+    "nomination_started", "first_candidate",    "ballot_started",
+    "prepared_accepted",  "prepared_confirmed", "commit_accepted",
+    "externalized"};
+
+void
+SCPLatency::record(Phase phase, int64 nanos)
+{
+    mHistograms[phase].record(static_cast<uint64>(std::max<int64>(nanos, 0)) /
+                              1000);
+}
+
+SCPLatency::Summary
+SCPLatency::getSummary(Phase phase) const
+{
+    auto const& h = mHistograms[phase];
+    Summary res;
+    res.mCount = h.getCount();
+    res.mSum = h.getSum();
+    res.mMax = h.getMax();
+    res.mP50 = h.getPercentile(0.5);
+    res.mP90 = h.getPercentile(0.9);
+    res.mP99 = h.getPercentile(0.99);
+    return res;
+}
+
+void
+SCPLatency::clear()
+{
+    for (auto& h : mHistograms)
+    {
+        h.clear();
+    }
+}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the latency histograms of the phases of the slots.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+/**
+ * Histogram of durations in microseconds with HDR-style buckets: values
+ * below 2^SUB_BITS have a bucket each, every larger power of 2 is split in
+ * 2^SUB_BITS buckets, which bounds the relative error of the percentiles to
+ * 1/2^SUB_BITS (12.5%) while recording is a couple of bit operations.
+ */
+class LatencyHistogram
+{
+  public:
+    static constexpr uint32 SUB_BITS = 3;
+    static constexpr uint32 SUB_BUCKETS = 1u << SUB_BITS;
+    // values from 2^(MAX_BIT + 1) microseconds (~2 days) are clamped
+    static constexpr uint32 MAX_BIT = 37;
+    static constexpr size_t NUM_BUCKETS =
+        (MAX_BIT - SUB_BITS + 2) * SUB_BUCKETS;
+
+  private:
+    std::array<uint64, NUM_BUCKETS> mCounts{};
+    uint64 mCount{0};
+    uint64 mSum{0};
+    uint64 mMax{0};
+
+  public:
+    void record(uint64 micros);
+
+    uint64
+    getCount() const
+    {
+        return mCount;
+    }
+    uint64
+    getSum() const
+    {
+        return mSum;
+    }
+    uint64
+    getMax() const
+    {
+        return mMax;
+    }
+
+    // upper bound of the bucket holding the q-th quantile (0 <= q <= 1),
+    // 0 if nothing was recorded
+    uint64 getPercentile(double q) const;
+
+    static size_t getBucket(uint64 micros);
+    // largest value of the bucket
+    static uint64 getBucketUpperBound(size_t bucket);
+    uint64
+    getBucketCount(size_t bucket) const
+    {
+        return mCounts[bucket];
+    }
+
+    void clear();
+};
+
+/**
+ * Latencies of the phases of the slots of a SCP instance, each measured
+ * from the first phase the slot went through (usually the start of the
+ * nomination): slots started by a remote nomination or ballot are measured
+ * from the time the local node joined.
+ *
+ * Like the rest of SCP, this isn't thread safe.
+ */
+class SCPLatency
+{
+  public:
+    enum Phase : uint32
+    {
+        NOMINATION_STARTED,
+        FIRST_CANDIDATE,
+        BALLOT_STARTED,
+        PREPARED_ACCEPTED,
+        PREPARED_CONFIRMED,
+        COMMIT_ACCEPTED,
+        EXTERNALIZED,
+        NUM_PHASES
+    };
+
+    // human readable names matching Phase
+    static const char* phaseNames[NUM_PHASES];
+
+    // durations of a phase, in microseconds
+    struct Summary
+    {
+        uint64 mCount;
+        uint64 mSum;
+        uint64 mMax;
+        uint64 mP50;
+        uint64 mP90;
+        uint64 mP99;
+    };
+
+    // nanoseconds on the steady clock
+    static int64
+    now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+  private:
+    std::array<LatencyHistogram, NUM_PHASES> mHistograms;
+
+  public:
+    // records that a slot reached `phase`, `nanos` after its first phase
+    void record(Phase phase, int64 nanos);
+
+    LatencyHistogram const&
+    getHistogram(Phase phase) const
+    {
+        return mHistograms[phase];
+    }
+
+    Summary getSummary(Phase phase) const;
+
+    void clear();
+};
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+
+    Implementation of the admission of the envelopes by transitive quorum, see
+    SCPQuorumFilter.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPQuorumFilter.h"
+
+#include "quorum/QuorumTracker.h"
+#include "scp/SCP.h"
+#include "scp/Slot.h"
+#include "util/Tracy.h"
+#include "util/XDROperators.h"
+
+namespace stellar
+{
+SCPQuorumFilter::SCPQuorumFilter(SCP& scp)
+    : mSCP(scp), mTracker(std::make_unique<InternedQuorumTracker>(scp))
+{
+}
+
+SCPQuorumFilter::~SCPQuorumFilter()
+{
+}
+
+SCPQuorumSetPtr
+SCPQuorumFilter::getQuorumSet(NodeID const& nodeID)
+{
+    auto latest = mSCP.getLatestMessage(nodeID);
+    if (latest == nullptr)
+    {
+        return nullptr;
+    }
+    ZoneScopedN("SCPDriver::getQSet");
+    return mSCP.getDriver().getQSet(
+        Slot::getCompanionQuorumSetHashFromStatement(latest->statement));
+}
+
+bool
+SCPQuorumFilter::admits(SCPStatement const& st) const
+{
+    return mTracker->isNodeDefinitelyInQuorum(st.nodeID);
+}
+
+void
+SCPQuorumFilter::learn(NodeID const& nodeID)
+{
+    size_t index = mTracker->getNodeIndex().find(nodeID);
+    if (index == NodeIndex::npos ||
+        !mTracker->isNodeDefinitelyInQuorum(index) ||
+        nodeID == mSCP.getLocalNodeID())
+    {
+        return;
+    }
+    auto qSet = getQuorumSet(nodeID);
+    if (qSet == nullptr)
+    {
+        return;
+    }
+    // drivers may return a new copy of the same quorum set every time
+    auto const& current = mTracker->getQuorumSet(index);
+    if (current != nullptr && *current == *qSet)
+    {
+        return;
+    }
+    if (!mTracker->expand(index, qSet))
+    {
+        rebuild();
+    }
+}
+
+void
+SCPQuorumFilter::rebuild()
+{
+    ZoneScoped;
+    auto const& localID = mSCP.getLocalNodeID();
+    auto local = std::make_shared<SCPQuorumSet>(mSCP.getLocalQuorumSet());
+    mTracker->rebuild([&](NodeID const& id) {
+        return id == localID ? local : getQuorumSet(id);
+    });
+}
+
+size_t
+SCPQuorumFilter::size() const
+{
+    return mTracker->size();
+}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the admission of the envelopes by transitive quorum.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <memory>
+
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+class SCP;
+class InternedQuorumTracker;
+typedef std::shared_ptr<SCPQuorumSet> SCPQuorumSetPtr;
+
+/**
+ * Admission of the envelopes received by SCP: only the nodes of the
+ * transitive quorum of the local node can take part in the federated
+ * voting of a slot, so the envelopes of the other nodes are dropped before
+ * they allocate slot state, as they never change its outcome.
+ *
+ * The quorum is tracked by an `InternedQuorumTracker` on the node index of
+ * SCP, from the local quorum set and the quorum sets of the latest
+ * statements of the nodes of the quorum found so far (`learn`): a node is
+ * only admitted once a node of the quorum with a known quorum set depends
+ * on it.
+ * Quorum sets are resolved with `SCPDriver::getQSet`, the nodes whose
+ * quorum set is unknown are part of the quorum without dependencies.
+ */
+class SCPQuorumFilter
+{
+    SCP& mSCP;
+    // by pointer, as QuorumTracker.h includes SCP.h
+    std::unique_ptr<InternedQuorumTracker> mTracker;
+
+    // quorum set of the latest statement of a node, nullptr if unknown
+    SCPQuorumSetPtr getQuorumSet(NodeID const& nodeID);
+
+  public:
+    explicit SCPQuorumFilter(SCP& scp);
+    ~SCPQuorumFilter();
+
+    // true if the node of the statement is part of the quorum
+    bool admits(SCPStatement const& st) const;
+
+    // updates the quorum with the quorum set of the latest statement of a
+    // node, to be called once an envelope of the node was processed
+    void learn(NodeID const& nodeID);
+
+    // recomputes the quorum from the local quorum set, to be called when
+    // it changes
+    void rebuild();
+
+    // the number of nodes in the quorum
+    size_t size() const;
+};
+}
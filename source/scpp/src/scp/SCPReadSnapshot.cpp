@@ -0,0 +1,105 @@
+/*******************************************************************************
+
+    Implementation of the snapshots of the state of SCP read by other threads,
+    see SCPReadSnapshot.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPReadSnapshot.h"
+
+#include "util/XDROperators.h"
+#include <algorithm>
+
+namespace stellar
+{
+SCPReadSnapshot::SCPReadSnapshot(std::vector<SlotStatePtr> slots)
+    : mSlots(std::move(slots))
+{
+}
+
+SCPReadSnapshot::SlotStatePtr
+SCPReadSnapshot::getSlot(uint64 slotIndex) const
+{
+    auto it = std::lower_bound(mSlots.begin(), mSlots.end(), slotIndex,
+                               [](SlotStatePtr const& s, uint64 i) {
+                                   return s->mSlotIndex < i;
+                               });
+    if (it == mSlots.end() || (*it)->mSlotIndex != slotIndex)
+    {
+        return nullptr;
+    }
+    return *it;
+}
+
+std::vector<SCPEnvelope>
+SCPReadSnapshot::getCurrentState(uint64 slotIndex) const
+{
+    std::vector<SCPEnvelope> res;
+    auto slot = getSlot(slotIndex);
+    if (slot)
+    {
+        res = slot->mNominationState;
+        res.insert(res.end(), slot->mBallotState.begin(),
+                   slot->mBallotState.end());
+    }
+    return res;
+}
+
+std::vector<SCPEnvelope>
+SCPReadSnapshot::getExternalizingState(uint64 slotIndex) const
+{
+    auto slot = getSlot(slotIndex);
+    return slot ? slot->mExternalizingState : std::vector<SCPEnvelope>();
+}
+
+// envelope of id in a state sorted by node
+static SCPEnvelope const*
+findEnvelope(std::vector<SCPEnvelope> const& state, NodeID const& id)
+{
+    auto it = std::lower_bound(state.begin(), state.end(), id,
+                               [](SCPEnvelope const& e, NodeID const& n) {
+                                   return e.statement.nodeID < n;
+                               });
+    if (it == state.end() || !(it->statement.nodeID == id))
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+
+SCPEnvelope const*
+SCPReadSnapshot::getLatestMessage(NodeID const& id) const
+{
+    // same order as SCP::getLatestMessage: newest slot first, and ballot
+    // messages before nominations
+    for (auto it = mSlots.rbegin(); it != mSlots.rend(); ++it)
+    {
+        auto res = findEnvelope((*it)->mBallotState, id);
+        if (res == nullptr)
+        {
+            res = findEnvelope((*it)->mNominationState, id);
+        }
+        if (res != nullptr)
+        {
+            return res;
+        }
+    }
+    return nullptr;
+}
+
+bool
+SCPReadSnapshot::isSlotFullyValidated(uint64 slotIndex) const
+{
+    auto slot = getSlot(slotIndex);
+    return slot && slot->mFullyValidated;
+}
+}
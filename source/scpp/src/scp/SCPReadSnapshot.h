@@ -0,0 +1,76 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the snapshots of the state of SCP read by other threads.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <memory>
+#include <vector>
+
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * Immutable copy of the state of the slots of a SCP instance, published by
+ * SCP::publishReadSnapshot so that other threads can answer monitoring
+ * queries without touching the live slots. With
+ * SCP::setReadSnapshotEnabled, every input of SCP publishes one when it
+ * returns, so the snapshot never lags behind the slots.
+ *
+ * The state of a slot is shared by the successive snapshots until the
+ * slot changes, so publishing only copies the slots that changed.
+ */
+class SCPReadSnapshot
+{
+  public:
+    struct SlotState
+    {
+        uint64 mSlotIndex;
+        // version of the slot at the time it was copied
+        uint32 mVersion;
+        bool mFullyValidated;
+        // as Slot::getCurrentState, split by protocol, sorted by node
+        std::vector<SCPEnvelope> mNominationState;
+        std::vector<SCPEnvelope> mBallotState;
+        // as Slot::getExternalizingState
+        std::vector<SCPEnvelope> mExternalizingState;
+    };
+    using SlotStatePtr = std::shared_ptr<SlotState const>;
+
+  private:
+    // ordered by slot index
+    std::vector<SlotStatePtr> mSlots;
+
+  public:
+    explicit SCPReadSnapshot(std::vector<SlotStatePtr> slots);
+
+    std::vector<SlotStatePtr> const&
+    getSlots() const
+    {
+        return mSlots;
+    }
+
+    // state of a slot, nullptr if it wasn't known
+    SlotStatePtr getSlot(uint64 slotIndex) const;
+
+    // same queries as SCP, see there
+    std::vector<SCPEnvelope> getCurrentState(uint64 slotIndex) const;
+    std::vector<SCPEnvelope> getExternalizingState(uint64 slotIndex) const;
+    // messages of the local node are only found in fully validated slots,
+    // as they are left out of the current state otherwise
+    SCPEnvelope const* getLatestMessage(NodeID const& id) const;
+    bool isSlotFullyValidated(uint64 slotIndex) const;
+};
+}
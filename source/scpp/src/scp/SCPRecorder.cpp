@@ -0,0 +1,351 @@
+/*******************************************************************************
+
+    Implementation of the recording of the inputs of a SCP instance, see
+    SCPRecorder.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPRecorder.h"
+
+#include "util/Logging.h"
+
+namespace stellar
+{
+constexpr uint32 SCPRecorder::MAGIC;
+constexpr uint32 SCPRecorder::VERSION;
+
+// the buffer is written to the file once it holds that many bytes
+static constexpr size_t FLUSH_SIZE = 1 << 16;
+
+SCPRecorder::Callback::Callback(SCPRecorder& recorder, RecordType type)
+    : mRecorder(recorder)
+    , mType(type)
+    , mRecorded(recorder.mInputDepth > recorder.mCallbackDepth)
+    , mOuter(recorder.mCallback)
+{
+    if (mRecorded)
+    {
+        mRecorder.mCallbackDepth++;
+        mRecorder.mCallback = this;
+    }
+}
+
+SCPRecorder::Callback::~Callback()
+{
+    if (mRecorded)
+    {
+        mRecorder.mCallbackDepth--;
+        mRecorder.mCallback = mOuter;
+    }
+}
+
+SCPRecorder::SCPRecorder(SCPDriver& driver) : mDriver(driver)
+{
+}
+
+SCPRecorder::~SCPRecorder()
+{
+    flush();
+}
+
+bool
+SCPRecorder::open(char const* path, NodeID const& nodeID, bool isValidator,
+                  SCPQuorumSet const& qSetLocal)
+{
+    mOut.open(path, std::ios::binary | std::ios::trunc);
+    if (!mOut)
+    {
+        CLOG(ERROR, "SCP") << "SCPRecorder: can't create " << path;
+        return false;
+    }
+    mStart = std::chrono::steady_clock::now();
+    auto header = xdr::xdr_to_opaque(MAGIC, VERSION, nodeID, isValidator,
+                                     qSetLocal);
+    mBuffer.assign(header.begin(), header.end());
+    flush();
+    return !mFailed;
+}
+
+xdr::xdr_put
+SCPRecorder::beginRecord(uint32 type, size_t size)
+{
+    // payloads are XDR, a multiple of 4 bytes: records stay aligned
+    size_t start = mBuffer.size();
+    mBuffer.resize(start + 8 + size);
+    xdr::xdr_put p(mBuffer.data() + start, mBuffer.data() + mBuffer.size());
+    p(type);
+    p(static_cast<uint32>(size));
+    return p;
+}
+
+uint64
+SCPRecorder::getElapsed() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - mStart)
+        .count();
+}
+
+void
+SCPRecorder::beginNested()
+{
+    // the outer calls already have theirs, as this one is made while
+    // processing an input they gave
+    if (mCallback && !mCallback->mNested)
+    {
+        mCallback->mNested = true;
+        write(NESTED, static_cast<uint32>(mCallback->mType));
+    }
+}
+
+void
+SCPRecorder::flushIfFull()
+{
+    if (mBuffer.size() >= FLUSH_SIZE)
+    {
+        flush();
+    }
+}
+
+void
+SCPRecorder::flush()
+{
+    if (mBuffer.empty() || !mOut.is_open())
+    {
+        return;
+    }
+    if (!mFailed)
+    {
+        mOut.write(reinterpret_cast<char const*>(mBuffer.data()),
+                   mBuffer.size());
+        mOut.flush();
+        if (!mOut)
+        {
+            // the records that follow would be out of context
+            CLOG(ERROR, "SCP") << "SCPRecorder: write failed, "
+                                  "the recording is truncated";
+            mFailed = true;
+        }
+    }
+    mBuffer.clear();
+}
+
+void
+SCPRecorder::signEnvelope(SCPEnvelope& envelope)
+{
+    Callback cb(*this, SIGN_ENVELOPE);
+    mDriver.signEnvelope(envelope);
+    cb.done(envelope.signature);
+}
+
+SCPQuorumSetPtr
+SCPRecorder::getQSet(Hash const& qSetHash)
+{
+    Callback cb(*this, GET_QSET);
+    auto res = mDriver.getQSet(qSetHash);
+    if (res)
+    {
+        cb.done(true, *res);
+    }
+    else
+    {
+        cb.done(false);
+    }
+    return res;
+}
+
+void
+SCPRecorder::emitEnvelope(SCPEnvelope const& envelope)
+{
+    Callback cb(*this, EMIT_ENVELOPE);
+    mDriver.emitEnvelope(envelope);
+    cb.done();
+}
+
+SCPDriver::ValidationLevel
+SCPRecorder::validateValue(uint64 slotIndex, Value const& value,
+                           bool nomination)
+{
+    Callback cb(*this, VALIDATE_VALUE);
+    auto res = mDriver.validateValue(slotIndex, value, nomination);
+    cb.done(static_cast<uint32>(res));
+    return res;
+}
+
+Value
+SCPRecorder::extractValidValue(uint64 slotIndex, Value const& value)
+{
+    Callback cb(*this, EXTRACT_VALID_VALUE);
+    auto res = mDriver.extractValidValue(slotIndex, value);
+    cb.done(res);
+    return res;
+}
+
+// only used for logging, not recorded
+
+std::string
+SCPRecorder::getValueString(Value const& v) const
+{
+    return mDriver.getValueString(v);
+}
+
+std::string
+SCPRecorder::toStrKey(PublicKey const& pk, bool fullKey) const
+{
+    return mDriver.toStrKey(pk, fullKey);
+}
+
+std::string
+SCPRecorder::toShortString(PublicKey const& pk) const
+{
+    return mDriver.toShortString(pk);
+}
+
+uint64
+SCPRecorder::computeHashNode(uint64 slotIndex, Value const& prev,
+                             bool isPriority, int32_t roundNumber,
+                             NodeID const& nodeID)
+{
+    Callback cb(*this, COMPUTE_HASH_NODE);
+    auto res = mDriver.computeHashNode(slotIndex, prev, isPriority,
+                                       roundNumber, nodeID);
+    cb.done(res);
+    return res;
+}
+
+uint64
+SCPRecorder::computeValueHash(uint64 slotIndex, Value const& prev,
+                              int32_t roundNumber, Value const& value)
+{
+    Callback cb(*this, COMPUTE_VALUE_HASH);
+    auto res = mDriver.computeValueHash(slotIndex, prev, roundNumber, value);
+    cb.done(res);
+    return res;
+}
+
+Value
+SCPRecorder::combineCandidates(uint64 slotIndex,
+                               std::set<Value> const& candidates)
+{
+    Callback cb(*this, COMBINE_CANDIDATES);
+    auto res = mDriver.combineCandidates(slotIndex, candidates);
+    cb.done(res);
+    return res;
+}
+
+// timers expire through SCPTimers, which records the callbacks it runs
+
+void
+SCPRecorder::setupTimer(uint64 slotIndex, int timerID,
+                        std::chrono::milliseconds timeout,
+                        std::function<void()>* cb)
+{
+    mDriver.setupTimer(slotIndex, timerID, timeout, cb);
+}
+
+std::chrono::milliseconds
+SCPRecorder::computeTimeout(uint32 roundNumber)
+{
+    Callback cb(*this, COMPUTE_TIMEOUT);
+    auto res = mDriver.computeTimeout(roundNumber);
+    cb.done(static_cast<uint64>(res.count()));
+    return res;
+}
+
+void
+SCPRecorder::valueExternalized(uint64 slotIndex, Value const& value)
+{
+    // the value lets the replay check that it externalized the same one
+    Callback cb(*this, VALUE_EXTERNALIZED);
+    mDriver.valueExternalized(slotIndex, value);
+    cb.done(value);
+}
+
+void
+SCPRecorder::nominatingValue(uint64 slotIndex, Value const& value)
+{
+    Callback cb(*this, NOMINATING_VALUE);
+    mDriver.nominatingValue(slotIndex, value);
+    cb.done();
+}
+
+void
+SCPRecorder::updatedCandidateValue(uint64 slotIndex, Value const& value)
+{
+    Callback cb(*this, UPDATED_CANDIDATE_VALUE);
+    mDriver.updatedCandidateValue(slotIndex, value);
+    cb.done();
+}
+
+void
+SCPRecorder::startedBallotProtocol(uint64 slotIndex, SCPBallot const& ballot)
+{
+    Callback cb(*this, STARTED_BALLOT_PROTOCOL);
+    mDriver.startedBallotProtocol(slotIndex, ballot);
+    cb.done();
+}
+
+void
+SCPRecorder::acceptedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
+{
+    Callback cb(*this, ACCEPTED_BALLOT_PREPARED);
+    mDriver.acceptedBallotPrepared(slotIndex, ballot);
+    cb.done();
+}
+
+void
+SCPRecorder::confirmedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
+{
+    Callback cb(*this, CONFIRMED_BALLOT_PREPARED);
+    mDriver.confirmedBallotPrepared(slotIndex, ballot);
+    cb.done();
+}
+
+void
+SCPRecorder::acceptedCommit(uint64 slotIndex, SCPBallot const& ballot)
+{
+    Callback cb(*this, ACCEPTED_COMMIT);
+    mDriver.acceptedCommit(slotIndex, ballot);
+    cb.done();
+}
+
+void
+SCPRecorder::ballotDidHearFromQuorum(uint64 slotIndex, SCPBallot const& ballot)
+{
+    Callback cb(*this, BALLOT_DID_HEAR_FROM_QUORUM);
+    mDriver.ballotDidHearFromQuorum(slotIndex, ballot);
+    cb.done();
+}
+
+void
+SCPRecorder::computeHashNodes(uint64 slotIndex, Value const& prev,
+                              bool isPriority, int32_t roundNumber,
+                              std::vector<NodeID> const& nodeIDs,
+                              std::vector<uint64>& hashes)
+{
+    Callback cb(*this, COMPUTE_HASH_NODES);
+    mDriver.computeHashNodes(slotIndex, prev, isPriority, roundNumber,
+                             nodeIDs, hashes);
+    cb.done(xdr::xvector<uint64>(hashes.begin(), hashes.end()));
+}
+
+void
+SCPRecorder::computeValueHashes(uint64 slotIndex, Value const& prev,
+                                int32_t roundNumber,
+                                std::vector<Value> const& values,
+                                std::vector<uint64>& hashes)
+{
+    Callback cb(*this, COMPUTE_VALUE_HASHES);
+    mDriver.computeValueHashes(slotIndex, prev, roundNumber, values, hashes);
+    cb.done(xdr::xvector<uint64>(hashes.begin(), hashes.end()));
+}
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the recording of the inputs of a SCP instance.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include "scp/SCPDriver.h"
+#include "xdrpp/marshal.h"
+
+namespace stellar
+{
+/**
+ * Records a SCP instance to a file, to be replayed offline by SCPReplay:
+ * the inputs of the driver (envelopes, nominations, timer expirations and
+ * the other calls changing the state of SCP) and the answers of the driver
+ * to SCP (quorum sets, validations, composite values, hashes, timeouts),
+ * so that the replay goes through the same states without the driver.
+ *
+ * Set with `SCP::startRecording`, it sits between SCP and its driver,
+ * forwarding every call. Only the calls of the driver to SCP are inputs,
+ * not the ones SCP makes to itself while processing them. A driver call
+ * made while an input is processed writes a record when it returns, with
+ * its result if any. The inputs the driver gives from within the call come
+ * before it, after a NESTED record, so that the replay gives them at the
+ * same point.
+ *
+ * The file starts with MAGIC, VERSION and the XDR of the arguments of the
+ * SCP constructor, followed by the records: type and size of the payload
+ * (uint32 each), then the payload, in XDR. The payload of an input starts
+ * with the time since the recording started (uint64, in nanoseconds).
+ *
+ * Records are buffered, the file is complete once the recording stopped.
+ */
+class SCPRecorder : public SCPDriver
+{
+  public:
+    static constexpr uint32 MAGIC = 0x53435052; // "SCPR"
+    static constexpr uint32 VERSION = 1;
+
+    enum RecordType : uint32
+    {
+        // inputs
+        RECEIVE_ENVELOPE = 1,
+        RECEIVE_ENVELOPES,
+        VALUE_VALIDATED,
+        CANDIDATES_COMBINED,
+        EXTERNALIZE_COMPLETED,
+        NOMINATE,
+        NOMINATE_AHEAD,
+        STOP_NOMINATION,
+        UPDATE_LOCAL_QUORUM_SET,
+        INVALIDATE_QSET,
+        INVALIDATE_QSETS,
+        PURGE_SLOTS,
+        SET_STATE_FROM_ENVELOPE,
+        RESTORE_STATE,
+        SET_QSET_CACHE_ENABLED,
+        SET_CATCH_UP_ENABLED,
+        SET_QUORUM_FILTER_ENABLED,
+        SET_STATEMENT_HISTORY,
+        TIMER,
+        // the inputs that follow, up to the answer of the driver call of
+        // the payload, are given from within that call
+        NESTED = 32,
+        // answers of the driver
+        SIGN_ENVELOPE = 64,
+        GET_QSET,
+        EMIT_ENVELOPE,
+        VALIDATE_VALUE,
+        EXTRACT_VALID_VALUE,
+        COMPUTE_HASH_NODE,
+        COMPUTE_VALUE_HASH,
+        COMBINE_CANDIDATES,
+        COMPUTE_TIMEOUT,
+        VALUE_EXTERNALIZED,
+        NOMINATING_VALUE,
+        UPDATED_CANDIDATE_VALUE,
+        STARTED_BALLOT_PROTOCOL,
+        ACCEPTED_BALLOT_PREPARED,
+        CONFIRMED_BALLOT_PREPARED,
+        ACCEPTED_COMMIT,
+        BALLOT_DID_HEAR_FROM_QUORUM,
+        COMPUTE_HASH_NODES,
+        COMPUTE_VALUE_HASHES
+    };
+
+    static bool
+    isInput(uint32 type)
+    {
+        return type >= RECEIVE_ENVELOPE && type <= TIMER;
+    }
+
+    // scope of an input: recorded with its arguments if it comes from the
+    // driver, a nullptr recorder doing nothing
+    class Input
+    {
+        SCPRecorder* mRecorder;
+        bool mRecorded;
+
+      public:
+        explicit Input(SCPRecorder* recorder)
+            : mRecorder(recorder)
+            , mRecorded(recorder && recorder->mInputDepth ==
+                                      recorder->mCallbackDepth)
+        {
+            if (mRecorder)
+            {
+                mRecorder->mInputDepth++;
+            }
+        }
+        template <typename... Args>
+        Input(SCPRecorder* recorder, RecordType type, Args const&... args)
+            : Input(recorder)
+        {
+            if (mRecorded)
+            {
+                mRecorder->writeInput(type, args...);
+            }
+        }
+        ~Input()
+        {
+            if (mRecorder)
+            {
+                mRecorder->mInputDepth--;
+            }
+        }
+        Input(Input const&) = delete;
+        Input& operator=(Input const&) = delete;
+
+        // false if the input isn't recorded, for inputs written by hand
+        explicit operator bool() const
+        {
+            return mRecorded;
+        }
+    };
+
+  private:
+    SCPDriver& mDriver;
+    std::ofstream mOut;
+    std::vector<uint8_t> mBuffer;
+    std::chrono::steady_clock::time_point mStart;
+    bool mFailed{false};
+
+    class Callback;
+
+    // inputs being processed, and driver calls made while processing them
+    uint32 mInputDepth{0};
+    uint32 mCallbackDepth{0};
+    // the innermost of these calls
+    Callback* mCallback{nullptr};
+
+    // scope of a driver call, recorded if SCP makes it while processing an
+    // input
+    class Callback
+    {
+        SCPRecorder& mRecorder;
+        RecordType mType;
+        bool mRecorded;
+        // the NESTED record is written
+        bool mNested{false};
+        Callback* mOuter;
+
+        friend class SCPRecorder;
+
+      public:
+        Callback(SCPRecorder& recorder, RecordType type);
+        ~Callback();
+        Callback(Callback const&) = delete;
+        Callback& operator=(Callback const&) = delete;
+
+        template <typename... Args>
+        void
+        done(Args const&... args)
+        {
+            if (mRecorded)
+            {
+                mRecorder.write(mType, args...);
+            }
+        }
+    };
+
+    // writes the NESTED record of the innermost driver call, if any
+    void beginNested();
+
+    // appends the type and size of a record, returns the archive of its
+    // payload, which must be written before the next record
+    xdr::xdr_put beginRecord(uint32 type, size_t size);
+    uint64 getElapsed() const;
+    void flushIfFull();
+    void flush();
+
+    template <typename... Args>
+    void
+    write(uint32 type, Args const&... args)
+    {
+        auto p = beginRecord(type, xdr::xdr_argpack_size(args...));
+        xdr::xdr_argpack_archive(p, args...);
+        flushIfFull();
+    }
+
+  public:
+    explicit SCPRecorder(SCPDriver& driver);
+    ~SCPRecorder();
+
+    // creates the file and writes its header, false if it can't be written
+    bool open(char const* path, NodeID const& nodeID, bool isValidator,
+              SCPQuorumSet const& qSetLocal);
+
+    // an input: the time since the recording started, then `args`
+    template <typename... Args>
+    void
+    writeInput(RecordType type, Args const&... args)
+    {
+        beginNested();
+        write(type, getElapsed(), args...);
+    }
+
+    // same, followed by `count` envelopes, in the encoding of a
+    // xvector<SCPEnvelope>
+    template <typename... Args>
+    void
+    writeEnvelopesInput(RecordType type, SCPEnvelope const* envelopes,
+                        size_t count, Args const&... args)
+    {
+        beginNested();
+        uint64 elapsed = getElapsed();
+        size_t size = xdr::xdr_argpack_size(elapsed, args...) + 4;
+        for (size_t i = 0; i < count; i++)
+        {
+            size += xdr::xdr_size(envelopes[i]);
+        }
+        auto p = beginRecord(type, size);
+        xdr::xdr_argpack_archive(p, elapsed, args...,
+                                 static_cast<uint32>(count));
+        for (size_t i = 0; i < count; i++)
+        {
+            p(envelopes[i]);
+        }
+        flushIfFull();
+    }
+
+    void signEnvelope(SCPEnvelope& envelope) override;
+    SCPQuorumSetPtr getQSet(Hash const& qSetHash) override;
+    void emitEnvelope(SCPEnvelope const& envelope) override;
+    ValidationLevel validateValue(uint64 slotIndex, Value const& value,
+                                  bool nomination) override;
+    Value extractValidValue(uint64 slotIndex, Value const& value) override;
+    std::string getValueString(Value const& v) const override;
+    std::string toStrKey(PublicKey const& pk,
+                         bool fullKey = true) const override;
+    std::string toShortString(PublicKey const& pk) const override;
+    uint64 computeHashNode(uint64 slotIndex, Value const& prev,
+                           bool isPriority, int32_t roundNumber,
+                           NodeID const& nodeID) override;
+    uint64 computeValueHash(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber, Value const& value) override;
+    Value combineCandidates(uint64 slotIndex,
+                            std::set<Value> const& candidates) override;
+    void setupTimer(uint64 slotIndex, int timerID,
+                    std::chrono::milliseconds timeout,
+                    std::function<void()>* cb) override;
+    std::chrono::milliseconds computeTimeout(uint32 roundNumber) override;
+    void valueExternalized(uint64 slotIndex, Value const& value) override;
+    void nominatingValue(uint64 slotIndex, Value const& value) override;
+    void updatedCandidateValue(uint64 slotIndex, Value const& value) override;
+    void startedBallotProtocol(uint64 slotIndex,
+                               SCPBallot const& ballot) override;
+    void acceptedBallotPrepared(uint64 slotIndex,
+                                SCPBallot const& ballot) override;
+    void confirmedBallotPrepared(uint64 slotIndex,
+                                 SCPBallot const& ballot) override;
+    void acceptedCommit(uint64 slotIndex, SCPBallot const& ballot) override;
+    void ballotDidHearFromQuorum(uint64 slotIndex,
+                                 SCPBallot const& ballot) override;
+    void computeHashNodes(uint64 slotIndex, Value const& prev,
+                          bool isPriority, int32_t roundNumber,
+                          std::vector<NodeID> const& nodeIDs,
+                          std::vector<uint64>& hashes) override;
+    void computeValueHashes(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber,
+                            std::vector<Value> const& values,
+                            std::vector<uint64>& hashes) override;
+};
+}
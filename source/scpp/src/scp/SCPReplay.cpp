@@ -0,0 +1,631 @@
+/*******************************************************************************
+
+    Implementation of the offline replay of the recordings of SCPRecorder, see
+    SCPReplay.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPReplay.h"
+
+#include "scp/SCP.h"
+#include "scp/SCPRecorder.h"
+#include "util/Logging.h"
+#include "xdrpp/marshal.h"
+
+#include <fstream>
+#include <iterator>
+
+namespace stellar
+{
+typedef std::chrono::steady_clock ReplayClock;
+
+// size of the type and size of a record
+static constexpr size_t RECORD_HEADER_SIZE = 8;
+
+static uint32
+readUint32(uint8_t const* p)
+{
+    return (uint32(p[0]) << 24) | (uint32(p[1]) << 16) | (uint32(p[2]) << 8) |
+           uint32(p[3]);
+}
+
+SCPReplay::SCPReplay()
+{
+}
+
+SCPReplay::~SCPReplay()
+{
+}
+
+bool
+SCPReplay::load(char const* path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        CLOG(ERROR, "SCP") << "SCPReplay: can't open " << path;
+        return false;
+    }
+    mData.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+
+    uint32 magic, version;
+    NodeID nodeID;
+    bool isValidator;
+    SCPQuorumSet qSetLocal;
+    try
+    {
+        xdr::xdr_get g(mData.data(), mData.data() + (mData.size() & ~3));
+        g(magic);
+        g(version);
+        if (magic != SCPRecorder::MAGIC || version != SCPRecorder::VERSION)
+        {
+            throw xdr::xdr_runtime_error("not a recording of this version");
+        }
+        g(nodeID);
+        g(isValidator);
+        g(qSetLocal);
+        mPos = reinterpret_cast<uint8_t const*>(g.p_) - mData.data();
+    }
+    catch (xdr::xdr_runtime_error const& e)
+    {
+        CLOG(ERROR, "SCP") << "SCPReplay: invalid recording " << path << ": "
+                           << e.what();
+        return false;
+    }
+
+    // a recording interrupted by a crash ends with a partial record
+    size_t end = mPos;
+    while (end + RECORD_HEADER_SIZE <= mData.size())
+    {
+        size_t size = readUint32(mData.data() + end + 4);
+        if ((size & 3) != 0 ||
+            size > mData.size() - end - RECORD_HEADER_SIZE)
+        {
+            break;
+        }
+        end += RECORD_HEADER_SIZE + size;
+    }
+    if (end != mData.size())
+    {
+        CLOG(WARN, "SCP") << "SCPReplay: " << path << " is truncated, "
+                          << (mData.size() - end) << " bytes ignored";
+        mData.resize(end);
+    }
+
+    mSCP = std::make_unique<SCP>(*this, nodeID, isValidator, qSetLocal);
+    return true;
+}
+
+uint32
+SCPReplay::peekType() const
+{
+    return readUint32(mData.data() + mPos);
+}
+
+std::pair<uint8_t const*, uint8_t const*>
+SCPReplay::next()
+{
+    auto begin = mData.data() + mPos + RECORD_HEADER_SIZE;
+    auto end = begin + readUint32(mData.data() + mPos + 4);
+    mPos = end - mData.data();
+    return std::make_pair(begin, end);
+}
+
+void
+SCPReplay::applyInput()
+{
+    uint32 type = peekType();
+    auto payload = next();
+    xdr::xdr_get g(payload.first, payload.second);
+    uint64 elapsed;
+    g(elapsed);
+    mRecordedTime = std::chrono::nanoseconds(elapsed);
+
+    auto start = ReplayClock::now();
+    switch (type)
+    {
+    case SCPRecorder::RECEIVE_ENVELOPE:
+    {
+        SCPEnvelope envelope;
+        g(envelope);
+        g.done();
+        mSCP->receiveEnvelope(envelope);
+        break;
+    }
+    case SCPRecorder::RECEIVE_ENVELOPES:
+    {
+        xdr::xvector<SCPEnvelope> envelopes;
+        g(envelopes);
+        g.done();
+        mSCP->receiveEnvelopes(envelopes);
+        break;
+    }
+    case SCPRecorder::VALUE_VALIDATED:
+    {
+        uint64 slotIndex;
+        Hash valueHash;
+        uint32 level;
+        g(slotIndex);
+        g(valueHash);
+        g(level);
+        g.done();
+        mSCP->valueValidated(slotIndex, valueHash,
+                             static_cast<ValidationLevel>(level));
+        break;
+    }
+    case SCPRecorder::CANDIDATES_COMBINED:
+    {
+        uint64 slotIndex;
+        Value composite;
+        g(slotIndex);
+        g(composite);
+        g.done();
+        mSCP->candidatesCombined(slotIndex, composite);
+        break;
+    }
+    case SCPRecorder::EXTERNALIZE_COMPLETED:
+    {
+        uint64 slotIndex;
+        g(slotIndex);
+        g.done();
+        mSCP->externalizeCompleted(slotIndex);
+        break;
+    }
+    case SCPRecorder::NOMINATE:
+    case SCPRecorder::NOMINATE_AHEAD:
+    {
+        uint64 slotIndex;
+        Value value, previousValue;
+        g(slotIndex);
+        g(value);
+        g(previousValue);
+        g.done();
+        if (type == SCPRecorder::NOMINATE)
+        {
+            mSCP->nominate(slotIndex, value, previousValue);
+        }
+        else
+        {
+            mSCP->nominateAhead(slotIndex, value, previousValue);
+        }
+        break;
+    }
+    case SCPRecorder::STOP_NOMINATION:
+    {
+        uint64 slotIndex;
+        g(slotIndex);
+        g.done();
+        mSCP->stopNomination(slotIndex);
+        break;
+    }
+    case SCPRecorder::UPDATE_LOCAL_QUORUM_SET:
+    {
+        SCPQuorumSet qSet;
+        g(qSet);
+        g.done();
+        mSCP->updateLocalQuorumSet(qSet);
+        break;
+    }
+    case SCPRecorder::INVALIDATE_QSET:
+    {
+        Hash qSetHash;
+        g(qSetHash);
+        g.done();
+        mSCP->invalidateQSet(qSetHash);
+        break;
+    }
+    case SCPRecorder::INVALIDATE_QSETS:
+        g.done();
+        mSCP->invalidateQSets();
+        break;
+    case SCPRecorder::PURGE_SLOTS:
+    {
+        uint64 maxSlotIndex;
+        g(maxSlotIndex);
+        g.done();
+        mSCP->purgeSlots(maxSlotIndex);
+        break;
+    }
+    case SCPRecorder::SET_STATE_FROM_ENVELOPE:
+    {
+        uint64 slotIndex;
+        SCPEnvelope envelope;
+        g(slotIndex);
+        g(envelope);
+        g.done();
+        mSCP->setStateFromEnvelope(slotIndex, envelope);
+        break;
+    }
+    case SCPRecorder::RESTORE_STATE:
+    {
+        uint64 slotIndex;
+        xdr::xvector<SCPEnvelope> envelopes;
+        g(slotIndex);
+        g(envelopes);
+        g.done();
+        mSCP->restoreState(slotIndex, envelopes.data(), envelopes.size());
+        break;
+    }
+    case SCPRecorder::SET_QSET_CACHE_ENABLED:
+    case SCPRecorder::SET_CATCH_UP_ENABLED:
+    case SCPRecorder::SET_QUORUM_FILTER_ENABLED:
+    {
+        bool enabled;
+        g(enabled);
+        g.done();
+        if (type == SCPRecorder::SET_QSET_CACHE_ENABLED)
+        {
+            mSCP->setQSetCacheEnabled(enabled);
+        }
+        else if (type == SCPRecorder::SET_CATCH_UP_ENABLED)
+        {
+            mSCP->setCatchUpEnabled(enabled);
+        }
+        else
+        {
+            mSCP->setQuorumFilterEnabled(enabled);
+        }
+        break;
+    }
+    case SCPRecorder::SET_STATEMENT_HISTORY:
+    {
+        uint32 mode;
+        uint64 limit;
+        g(mode);
+        g(limit);
+        g.done();
+        mSCP->setStatementHistory(static_cast<SCP::HistoryMode>(mode),
+                                  static_cast<size_t>(limit));
+        break;
+    }
+    case SCPRecorder::TIMER:
+    {
+        uint64 slotIndex;
+        int32_t timerID;
+        g(slotIndex);
+        g(timerID);
+        g.done();
+        if (!mSCP->getTimers().fire(slotIndex, timerID))
+        {
+            mDivergences++;
+        }
+        break;
+    }
+    default:
+        throw xdr::xdr_runtime_error("unknown input");
+    }
+
+    auto elapsedReplay = ReplayClock::now() - start;
+    auto& stats = mStats[type];
+    stats.mCount++;
+    stats.mTotal += elapsedReplay;
+    stats.mMax = std::max<std::chrono::nanoseconds>(stats.mMax, elapsedReplay);
+}
+
+bool
+SCPReplay::findAnswer(uint32 type)
+{
+    if (mPos < mData.size() && peekType() == SCPRecorder::NESTED)
+    {
+        auto payload = next();
+        xdr::xdr_get g(payload.first, payload.second);
+        uint32 nested;
+        g(nested);
+        g.done();
+        if (nested != type)
+        {
+            mDivergences++;
+            return false;
+        }
+        while (mPos < mData.size() && SCPRecorder::isInput(peekType()))
+        {
+            applyInput();
+        }
+    }
+    if (mPos < mData.size() && peekType() == type)
+    {
+        return true;
+    }
+    mDivergences++;
+    return false;
+}
+
+template <typename... Args>
+bool
+SCPReplay::readAnswer(uint32 type, Args&... args)
+{
+    if (!findAnswer(type))
+    {
+        return false;
+    }
+    auto payload = next();
+    xdr::xdr_get g(payload.first, payload.second);
+    xdr::xdr_argpack_archive(g, args...);
+    g.done();
+    return true;
+}
+
+bool
+SCPReplay::run()
+{
+    try
+    {
+        while (mPos < mData.size())
+        {
+            if (SCPRecorder::isInput(peekType()))
+            {
+                applyInput();
+            }
+            else
+            {
+                // an answer SCP didn't ask for
+                mDivergences++;
+                next();
+            }
+        }
+    }
+    catch (xdr::xdr_runtime_error const& e)
+    {
+        CLOG(ERROR, "SCP") << "SCPReplay: invalid record: " << e.what();
+        return false;
+    }
+    return true;
+}
+
+SCP&
+SCPReplay::getSCP()
+{
+    return *mSCP;
+}
+
+std::map<uint32, SCPReplay::InputStats> const&
+SCPReplay::getStats() const
+{
+    return mStats;
+}
+
+uint64
+SCPReplay::getDivergences() const
+{
+    return mDivergences;
+}
+
+uint64
+SCPReplay::getExternalizedCount() const
+{
+    return mExternalized;
+}
+
+std::chrono::nanoseconds
+SCPReplay::getRecordedTime() const
+{
+    return mRecordedTime;
+}
+
+void
+SCPReplay::signEnvelope(SCPEnvelope& envelope)
+{
+    readAnswer(SCPRecorder::SIGN_ENVELOPE, envelope.signature);
+}
+
+SCPQuorumSetPtr
+SCPReplay::getQSet(Hash const& qSetHash)
+{
+    bool found;
+    if (!findAnswer(SCPRecorder::GET_QSET))
+    {
+        return nullptr;
+    }
+    auto payload = next();
+    xdr::xdr_get g(payload.first, payload.second);
+    g(found);
+    if (!found)
+    {
+        g.done();
+        return nullptr;
+    }
+    auto res = std::make_shared<SCPQuorumSet>();
+    g(*res);
+    g.done();
+    return res;
+}
+
+void
+SCPReplay::emitEnvelope(SCPEnvelope const& envelope)
+{
+    readAnswer(SCPRecorder::EMIT_ENVELOPE);
+}
+
+SCPDriver::ValidationLevel
+SCPReplay::validateValue(uint64 slotIndex, Value const& value,
+                         bool nomination)
+{
+    uint32 res;
+    if (!readAnswer(SCPRecorder::VALIDATE_VALUE, res))
+    {
+        return SCPDriver::validateValue(slotIndex, value, nomination);
+    }
+    return static_cast<ValidationLevel>(res);
+}
+
+Value
+SCPReplay::extractValidValue(uint64 slotIndex, Value const& value)
+{
+    Value res;
+    readAnswer(SCPRecorder::EXTRACT_VALID_VALUE, res);
+    return res;
+}
+
+uint64
+SCPReplay::computeHashNode(uint64 slotIndex, Value const& prev,
+                           bool isPriority, int32_t roundNumber,
+                           NodeID const& nodeID)
+{
+    uint64 res;
+    if (!readAnswer(SCPRecorder::COMPUTE_HASH_NODE, res))
+    {
+        return SCPDriver::computeHashNode(slotIndex, prev, isPriority,
+                                          roundNumber, nodeID);
+    }
+    return res;
+}
+
+uint64
+SCPReplay::computeValueHash(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber, Value const& value)
+{
+    uint64 res;
+    if (!readAnswer(SCPRecorder::COMPUTE_VALUE_HASH, res))
+    {
+        return SCPDriver::computeValueHash(slotIndex, prev, roundNumber,
+                                           value);
+    }
+    return res;
+}
+
+Value
+SCPReplay::combineCandidates(uint64 slotIndex,
+                             std::set<Value> const& candidates)
+{
+    Value res;
+    if (!readAnswer(SCPRecorder::COMBINE_CANDIDATES, res))
+    {
+        // any of them, for the slot to go on
+        return *candidates.begin();
+    }
+    return res;
+}
+
+void
+SCPReplay::setupTimer(uint64 slotIndex, int timerID,
+                      std::chrono::milliseconds timeout,
+                      std::function<void()>* cb)
+{
+    // the expirations are inputs of the recording
+    delete cb;
+}
+
+std::chrono::milliseconds
+SCPReplay::computeTimeout(uint32 roundNumber)
+{
+    uint64 res;
+    if (!readAnswer(SCPRecorder::COMPUTE_TIMEOUT, res))
+    {
+        return SCPDriver::computeTimeout(roundNumber);
+    }
+    return std::chrono::milliseconds(res);
+}
+
+void
+SCPReplay::valueExternalized(uint64 slotIndex, Value const& value)
+{
+    mExternalized++;
+    Value recorded;
+    if (readAnswer(SCPRecorder::VALUE_EXTERNALIZED, recorded) &&
+        !(recorded == value))
+    {
+        CLOG(ERROR, "SCP") << "SCPReplay: slot " << slotIndex
+                           << " externalized another value";
+        mDivergences++;
+    }
+}
+
+void
+SCPReplay::nominatingValue(uint64 slotIndex, Value const& value)
+{
+    readAnswer(SCPRecorder::NOMINATING_VALUE);
+}
+
+void
+SCPReplay::updatedCandidateValue(uint64 slotIndex, Value const& value)
+{
+    readAnswer(SCPRecorder::UPDATED_CANDIDATE_VALUE);
+}
+
+void
+SCPReplay::startedBallotProtocol(uint64 slotIndex, SCPBallot const& ballot)
+{
+    readAnswer(SCPRecorder::STARTED_BALLOT_PROTOCOL);
+}
+
+void
+SCPReplay::acceptedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
+{
+    readAnswer(SCPRecorder::ACCEPTED_BALLOT_PREPARED);
+}
+
+void
+SCPReplay::confirmedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
+{
+    readAnswer(SCPRecorder::CONFIRMED_BALLOT_PREPARED);
+}
+
+void
+SCPReplay::acceptedCommit(uint64 slotIndex, SCPBallot const& ballot)
+{
+    readAnswer(SCPRecorder::ACCEPTED_COMMIT);
+}
+
+void
+SCPReplay::ballotDidHearFromQuorum(uint64 slotIndex, SCPBallot const& ballot)
+{
+    readAnswer(SCPRecorder::BALLOT_DID_HEAR_FROM_QUORUM);
+}
+
+void
+SCPReplay::computeHashNodes(uint64 slotIndex, Value const& prev,
+                            bool isPriority, int32_t roundNumber,
+                            std::vector<NodeID> const& nodeIDs,
+                            std::vector<uint64>& hashes)
+{
+    xdr::xvector<uint64> res;
+    if (readAnswer(SCPRecorder::COMPUTE_HASH_NODES, res))
+    {
+        if (res.size() == hashes.size())
+        {
+            std::copy(res.begin(), res.end(), hashes.begin());
+            return;
+        }
+        mDivergences++;
+    }
+    // not through computeHashNode, which would look for its answers
+    for (size_t i = 0; i < nodeIDs.size(); i++)
+    {
+        hashes[i] = SCPDriver::computeHashNode(slotIndex, prev, isPriority,
+                                               roundNumber, nodeIDs[i]);
+    }
+}
+
+void
+SCPReplay::computeValueHashes(uint64 slotIndex, Value const& prev,
+                              int32_t roundNumber,
+                              std::vector<Value> const& values,
+                              std::vector<uint64>& hashes)
+{
+    xdr::xvector<uint64> res;
+    if (readAnswer(SCPRecorder::COMPUTE_VALUE_HASHES, res))
+    {
+        if (res.size() == hashes.size())
+        {
+            std::copy(res.begin(), res.end(), hashes.begin());
+            return;
+        }
+        mDivergences++;
+    }
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        hashes[i] = SCPDriver::computeValueHash(slotIndex, prev, roundNumber,
+                                                values[i]);
+    }
+}
+}
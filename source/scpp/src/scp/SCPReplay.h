@@ -0,0 +1,131 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the offline replay of the recordings of SCPRecorder.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "scp/SCPDriver.h"
+
+namespace stellar
+{
+class SCP;
+
+/**
+ * Runs a recording of SCPRecorder again, in a fresh SCP instance driven by
+ * the recording itself: the inputs are given in the recorded order, timer
+ * expirations included, and the driver calls are answered with the
+ * recorded results, so that the replay goes through the same states
+ * without the network, the clock or the ledger, and can be profiled or
+ * timed (see `getStats`).
+ *
+ * A driver call that doesn't match the next record is a divergence: SCP no
+ * longer behaves as it did when recording, e.g. because it was changed
+ * since. The default of SCPDriver (or an empty value) is used instead,
+ * and the records the replay doesn't ask for are skipped.
+ *
+ * Envelopes are neither signed nor emitted.
+ */
+class SCPReplay : public SCPDriver
+{
+  public:
+    // time spent in the inputs of a type, nested ones included
+    struct InputStats
+    {
+        uint64 mCount{0};
+        std::chrono::nanoseconds mTotal{0};
+        std::chrono::nanoseconds mMax{0};
+    };
+
+  private:
+    std::vector<uint8_t> mData;
+    size_t mPos{0};
+    std::unique_ptr<SCP> mSCP;
+
+    std::map<uint32, InputStats> mStats;
+    uint64 mDivergences{0};
+    uint64 mExternalized{0};
+    // time of the last input since the recording started
+    std::chrono::nanoseconds mRecordedTime{0};
+
+    uint32 peekType() const;
+    // returns the payload of the next record and skips it
+    std::pair<uint8_t const*, uint8_t const*> next();
+    void applyInput();
+    // applies the inputs preceding the answer of `type`, true if it is next
+    bool findAnswer(uint32 type);
+    // `findAnswer` and decodes its payload into `args`
+    template <typename... Args> bool readAnswer(uint32 type, Args&... args);
+
+  public:
+    SCPReplay();
+    ~SCPReplay();
+
+    // reads a recording and creates the SCP instance from its header,
+    // returns false if it can't be read or isn't a recording
+    bool load(char const* path);
+
+    // gives every input of the recording to SCP, returns false if the
+    // recording is truncated
+    bool run();
+
+    SCP& getSCP();
+    std::map<uint32, InputStats> const& getStats() const;
+    uint64 getDivergences() const;
+    uint64 getExternalizedCount() const;
+    std::chrono::nanoseconds getRecordedTime() const;
+
+    void signEnvelope(SCPEnvelope& envelope) override;
+    SCPQuorumSetPtr getQSet(Hash const& qSetHash) override;
+    void emitEnvelope(SCPEnvelope const& envelope) override;
+    ValidationLevel validateValue(uint64 slotIndex, Value const& value,
+                                  bool nomination) override;
+    Value extractValidValue(uint64 slotIndex, Value const& value) override;
+    uint64 computeHashNode(uint64 slotIndex, Value const& prev,
+                           bool isPriority, int32_t roundNumber,
+                           NodeID const& nodeID) override;
+    uint64 computeValueHash(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber, Value const& value) override;
+    Value combineCandidates(uint64 slotIndex,
+                            std::set<Value> const& candidates) override;
+    void setupTimer(uint64 slotIndex, int timerID,
+                    std::chrono::milliseconds timeout,
+                    std::function<void()>* cb) override;
+    std::chrono::milliseconds computeTimeout(uint32 roundNumber) override;
+    void valueExternalized(uint64 slotIndex, Value const& value) override;
+    void nominatingValue(uint64 slotIndex, Value const& value) override;
+    void updatedCandidateValue(uint64 slotIndex, Value const& value) override;
+    void startedBallotProtocol(uint64 slotIndex,
+                               SCPBallot const& ballot) override;
+    void acceptedBallotPrepared(uint64 slotIndex,
+                                SCPBallot const& ballot) override;
+    void confirmedBallotPrepared(uint64 slotIndex,
+                                 SCPBallot const& ballot) override;
+    void acceptedCommit(uint64 slotIndex, SCPBallot const& ballot) override;
+    void ballotDidHearFromQuorum(uint64 slotIndex,
+                                 SCPBallot const& ballot) override;
+    void computeHashNodes(uint64 slotIndex, Value const& prev,
+                          bool isPriority, int32_t roundNumber,
+                          std::vector<NodeID> const& nodeIDs,
+                          std::vector<uint64>& hashes) override;
+    void computeValueHashes(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber,
+                            std::vector<Value> const& values,
+                            std::vector<uint64>& hashes) override;
+};
+}
@@ -0,0 +1,207 @@
+/*******************************************************************************
+
+    Implementation of the timers of the slots, coalesced into a single driver
+    timer, see SCPTimers.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPTimers.h"
+#include "scp/SCPDriver.h"
+#include "scp/SCPRecorder.h"
+#include "util/Tracy.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+
+SCPTimers::SCPTimers(SCPDriver& driver) : mDriver(driver)
+{
+}
+
+void
+SCPTimers::setRecorder(SCPRecorder* recorder)
+{
+    mRecorder = recorder;
+}
+
+void
+SCPTimers::setFiredCallback(std::function<void()> cb)
+{
+    mFired = std::move(cb);
+}
+
+std::vector<SCPTimers::Timer>::iterator
+SCPTimers::find(uint64 slotIndex, int timerID)
+{
+    return std::find_if(mTimers.begin(), mTimers.end(),
+                        [&](Timer const& t) {
+                            return t.mSlotIndex == slotIndex &&
+                                   t.mTimerID == timerID;
+                        });
+}
+
+void
+SCPTimers::arm(uint64 slotIndex, int timerID,
+               std::chrono::milliseconds timeout, std::function<void()> cb)
+{
+    auto deadline = clock::now() + timeout;
+    auto it = find(slotIndex, timerID);
+    if (it == mTimers.end())
+    {
+        mTimers.emplace_back();
+        it = mTimers.end() - 1;
+        it->mSlotIndex = slotIndex;
+        it->mTimerID = timerID;
+    }
+    it->mDeadline = deadline;
+    it->mCallback = std::move(cb);
+    it->mSeq = mNextSeq++;
+    rearm();
+}
+
+void
+SCPTimers::cancel(uint64 slotIndex, int timerID)
+{
+    // the driver timer is left as is: when it expires, it is set again for
+    // the next deadline
+    auto it = find(slotIndex, timerID);
+    if (it != mTimers.end())
+    {
+        mTimers.erase(it);
+    }
+}
+
+void
+SCPTimers::purge(uint64 maxSlotIndex)
+{
+    mTimers.erase(std::remove_if(mTimers.begin(), mTimers.end(),
+                                 [&](Timer const& t) {
+                                     return t.mSlotIndex < maxSlotIndex;
+                                 }),
+                  mTimers.end());
+}
+
+void
+SCPTimers::cancelAll()
+{
+    mTimers.clear();
+    if (mArmed)
+    {
+        mArmed = false;
+        ZoneScopedN("SCPDriver::setupTimer");
+        mDriver.setupTimer(mArmedSlotIndex, mArmedTimerID,
+                           std::chrono::milliseconds::zero(), nullptr);
+    }
+}
+
+bool
+SCPTimers::isArmed(uint64 slotIndex, int timerID) const
+{
+    return std::any_of(mTimers.begin(), mTimers.end(), [&](Timer const& t) {
+        return t.mSlotIndex == slotIndex && t.mTimerID == timerID;
+    });
+}
+
+size_t
+SCPTimers::size() const
+{
+    return mTimers.size();
+}
+
+void
+SCPTimers::rearm()
+{
+    if (mFiring || mTimers.empty())
+    {
+        return;
+    }
+    auto next = std::min_element(mTimers.begin(), mTimers.end(),
+                                 [](Timer const& a, Timer const& b) {
+                                     return a.mDeadline < b.mDeadline;
+                                 });
+    if (mArmed && mArmedDeadline <= next->mDeadline)
+    {
+        return;
+    }
+
+    // round up, so that the driver timer doesn't expire before the deadline
+    auto left = next->mDeadline - clock::now();
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        left + std::chrono::milliseconds(1) - clock::duration(1));
+    timeout = std::max(timeout, std::chrono::milliseconds(1));
+
+    mArmed = true;
+    mArmedDeadline = next->mDeadline;
+    mArmedSlotIndex = next->mSlotIndex;
+    mArmedTimerID = next->mTimerID;
+    std::function<void()>* func = new std::function<void()>;
+    *func = [this]() { fire(); };
+    ZoneScopedN("SCPDriver::setupTimer");
+    mDriver.setupTimer(mArmedSlotIndex, mArmedTimerID, timeout, func);
+}
+
+void
+SCPTimers::fire()
+{
+    mArmed = false;
+    mFiring = true;
+    auto now = clock::now();
+    uint64 lastSeq = mNextSeq;
+    for (;;)
+    {
+        auto it = std::find_if(mTimers.begin(), mTimers.end(),
+                               [&](Timer const& t) {
+                                   return t.mDeadline <= now &&
+                                          t.mSeq < lastSeq;
+                               });
+        if (it == mTimers.end())
+        {
+            break;
+        }
+        // the callback may set or cancel timers, including its own
+        auto cb = std::move(it->mCallback);
+        SCPRecorder::Input input(mRecorder, SCPRecorder::TIMER,
+                                 it->mSlotIndex, it->mTimerID);
+        mTimers.erase(it);
+        cb();
+    }
+    mFiring = false;
+    rearm();
+    if (mFired)
+    {
+        mFired();
+    }
+}
+
+bool
+SCPTimers::fire(uint64 slotIndex, int timerID)
+{
+    auto it = find(slotIndex, timerID);
+    if (it == mTimers.end())
+    {
+        return false;
+    }
+    auto cb = std::move(it->mCallback);
+    mTimers.erase(it);
+    bool firing = mFiring;
+    mFiring = true;
+    cb();
+    mFiring = firing;
+    rearm();
+    if (mFired)
+    {
+        mFired();
+    }
+    return true;
+}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the timers of the slots, coalesced into a single driver timer.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+class SCPDriver;
+class SCPRecorder;
+
+/**
+ * Timers of the slots of a SCP instance, keyed by (slot, timer ID).
+ *
+ * Only the earliest deadline is handed to `SCPDriver::setupTimer`, and the
+ * driver timer is only re-armed when a timer is due before it: a timer
+ * that is pushed back or cancelled leaves it alone, and its expiration
+ * simply re-arms it for the next deadline. The callbacks are kept here, so
+ * that protocols restarting their timer on every envelope don't cost the
+ * driver anything.
+ *
+ * There are a couple of timers per active slot, so they are kept in a
+ * vector. Like the rest of SCP, this isn't thread safe.
+ */
+class SCPTimers
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+
+  private:
+    struct Timer
+    {
+        uint64 mSlotIndex;
+        int mTimerID;
+        clock::time_point mDeadline;
+        std::function<void()> mCallback;
+        // order in which the timers were set, so that a timer re-armed by
+        // a callback doesn't run in the same `fire`
+        uint64 mSeq;
+    };
+
+    SCPDriver& mDriver;
+    SCPRecorder* mRecorder{nullptr};
+    std::vector<Timer> mTimers;
+    uint64 mNextSeq{0};
+
+    // deadline of the timer set with the driver, if any
+    bool mArmed{false};
+    clock::time_point mArmedDeadline;
+    uint64 mArmedSlotIndex{0};
+    int mArmedTimerID{0};
+    // set while callbacks run, which re-arm their timers
+    bool mFiring{false};
+    std::function<void()> mFired;
+
+    std::vector<Timer>::iterator find(uint64 slotIndex, int timerID);
+    void rearm();
+
+  public:
+    SCPTimers(SCPDriver& driver);
+
+    // the callbacks run by `fire` are recorded as inputs of SCP, see
+    // SCP::startRecording
+    void setRecorder(SCPRecorder* recorder);
+    // `cb` is called once the callbacks run by `fire` returned
+    void setFiredCallback(std::function<void()> cb);
+
+    // `cb` is called after `timeout`, replacing the timer (slotIndex,
+    // timerID) if it was set
+    void arm(uint64 slotIndex, int timerID, std::chrono::milliseconds timeout,
+             std::function<void()> cb);
+
+    void cancel(uint64 slotIndex, int timerID);
+    // cancels the timers of every slot whose index is smaller than
+    // `maxSlotIndex`
+    void purge(uint64 maxSlotIndex);
+    // cancels every timer, including the one of the driver
+    void cancelAll();
+
+    bool isArmed(uint64 slotIndex, int timerID) const;
+    size_t size() const;
+
+    // runs the callbacks of the expired timers, then sets the driver timer
+    // for the next deadline; called when the driver timer expires
+    void fire();
+
+    // runs the callback of the timer (slotIndex, timerID) whatever its
+    // deadline, to replay a recording; false if the timer isn't set
+    bool fire(uint64 slotIndex, int timerID);
+};
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************
+
+    Implementation of the ring buffer of the state transitions of SCP, see
+    SCPTrace.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SCPTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace stellar
+{
+namespace
+{
+size_t constexpr EVENT_WORDS = sizeof(SCPTraceEvent) / sizeof(uint64);
+static_assert(sizeof(SCPTraceEvent) % sizeof(uint64) == 0,
+              "SCPTraceEvent must be made of whole words");
+}
+
+constexpr uint32 SCPTraceEvent::NO_NODE;
+constexpr size_t SCPTrace::DEFAULT_CAPACITY;
+
+// The event is stored as words so that it can be read while it's written
+// without a data race: a torn read is detected through mSequence, which is
+// 2 * (position + 1) once the event at position is written.
+struct SCPTrace::Entry
+{
+    std::atomic<uint64> mSequence{0};
+    std::atomic<uint64> mWords[EVENT_WORDS];
+};
+
+SCPTrace::SCPTrace(size_t capacity) : mNext(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    mEntries.reset(new Entry[size]);
+    mMask = size - 1;
+}
+
+SCPTrace::~SCPTrace()
+{
+}
+
+void
+SCPTrace::record(SCPTraceEvent::Type type, uint64 slotIndex, uint32 node,
+                 uint32 counter, uint32 value)
+{
+    uint64 pos = mNext.fetch_add(1, std::memory_order_relaxed);
+
+    SCPTraceEvent event;
+    event.mSequence = pos;
+    event.mTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    event.mSlotIndex = slotIndex;
+    event.mType = type;
+    event.mNode = node;
+    event.mCounter = counter;
+    event.mValue = value;
+    uint64 words[EVENT_WORDS];
+    std::memcpy(words, &event, sizeof(event));
+
+    auto& entry = mEntries[pos & mMask];
+    entry.mSequence.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < EVENT_WORDS; ++i)
+    {
+        entry.mWords[i].store(words[i], std::memory_order_relaxed);
+    }
+    entry.mSequence.store(2 * pos + 2, std::memory_order_release);
+}
+
+size_t
+SCPTrace::copyEvents(SCPTraceEvent* out, size_t max) const
+{
+    uint64 end = getRecordedCount();
+    uint64 begin = end - std::min<uint64>({end, getCapacity(), max});
+    size_t res = 0;
+    for (uint64 pos = begin; pos < end; ++pos)
+    {
+        auto const& entry = mEntries[pos & mMask];
+        if (entry.mSequence.load(std::memory_order_acquire) != 2 * pos + 2)
+        {
+            // being written, or already overwritten
+            continue;
+        }
+        uint64 words[EVENT_WORDS];
+        for (size_t i = 0; i < EVENT_WORDS; ++i)
+        {
+            words[i] = entry.mWords[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.mSequence.load(std::memory_order_relaxed) != 2 * pos + 2)
+        {
+            continue;
+        }
+        std::memcpy(&out[res++], words, sizeof(SCPTraceEvent));
+    }
+    return res;
+}
+}
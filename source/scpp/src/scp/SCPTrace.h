@@ -0,0 +1,113 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the ring buffer of the state transitions of SCP.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+// A state transition of the SCP core, as recorded by SCPTrace
+struct SCPTraceEvent
+{
+    enum Type : uint32
+    {
+        // statement received, mCounter: counter of the working ballot (0 for
+        // nominations), mValue: SCPStatementType
+        ENVELOPE_RECEIVED,
+        // mCounter: counter of p
+        PREPARED_ACCEPTED,
+        // mCounter: counter of h, mValue: counter of c
+        PREPARED_CONFIRMED,
+        // mCounter: counter of h, mValue: counter of c
+        COMMIT_ACCEPTED,
+        // mCounter: counter of h, mValue: counter of c
+        COMMIT_CONFIRMED,
+        // mCounter: the new round number
+        NOMINATION_ROUND,
+        // mCounter: Slot::timerIDs, mValue: timeout in milliseconds
+        TIMER_ARMED,
+        // mCounter: Slot::timerIDs
+        TIMER_STOPPED,
+        // mCounter: Slot::timerIDs
+        TIMER_FIRED
+    };
+
+    // position of the event in the trace, starting at 0
+    uint64 mSequence;
+    // nanoseconds since the epoch (system clock)
+    int64 mTime;
+    uint64 mSlotIndex;
+    uint32 mType;
+    // index of the node in the numbering of the SCP instance (see
+    // SCP::getNodeIndex), NO_NODE for events of the local state machine and
+    // envelopes of nodes that aren't numbered yet
+    uint32 mNode;
+    uint32 mCounter;
+    uint32 mValue;
+
+    static constexpr uint32 NO_NODE = UINT32_MAX;
+};
+
+/**
+ * Fixed-size ring buffer of the last SCPTraceEvents of a SCP instance, cheap
+ * enough to be always on, so that there is something to look at when
+ * consensus stalls.
+ *
+ * Recording is lock-free. Every entry is guarded by a sequence number
+ * (odd while it's being written), so that the events can be copied from
+ * another thread while the SCP instance keeps running: entries overwritten
+ * during the copy are skipped.
+ */
+class SCPTrace
+{
+    struct Entry;
+
+    std::unique_ptr<Entry[]> mEntries;
+    size_t mMask;
+    std::atomic<uint64> mNext;
+
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    // capacity is rounded up to a power of 2
+    explicit SCPTrace(size_t capacity = DEFAULT_CAPACITY);
+    ~SCPTrace();
+
+    void record(SCPTraceEvent::Type type, uint64 slotIndex, uint32 node,
+                uint32 counter = 0, uint32 value = 0);
+
+    size_t
+    getCapacity() const
+    {
+        return mMask + 1;
+    }
+
+    // number of events recorded so far, including the ones overwritten
+    uint64
+    getRecordedCount() const
+    {
+        return mNext.load(std::memory_order_acquire);
+    }
+
+    // copies up to `max` of the latest events to `out`, oldest first
+    // returns the number of events copied
+    size_t copyEvents(SCPTraceEvent* out, size_t max) const;
+};
+}
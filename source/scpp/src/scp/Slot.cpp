@@ -4,15 +4,21 @@
 
 #include "Slot.h"
 
-#include "crypto/Hex.h"
 #include "crypto/Hash.h"
+#include "crypto/Hex.h"
+#include "crypto/XDRHasher.h"
 #include "lib/json/json.h"
 #include "main/ErrorMessages.h"
+#include "scp/CompiledQuorumSet.h"
 #include "scp/LocalNode.h"
+#include "scp/QuorumSetUtils.h"
 #include "util/GlobalChecks.h"
+#include "util/JsonWriter.h"
 #include "util/Logging.h"
+#include "util/Tracy.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
 #include <ctime>
 #include <functional>
 
@@ -23,12 +29,42 @@ using namespace std::placeholders;
 Slot::Slot(uint64 slotIndex, SCP& scp)
     : mSlotIndex(slotIndex)
     , mSCP(scp)
+    , mArena()
     , mBallotProtocol(*this)
     , mNominationProtocol(*this)
+    , mHistoryStart(0)
+    , mHistoryBytes(0)
+    , mStatementCount(0)
     , mFullyValidated(scp.getLocalNode()->isValidator())
+    , mBallotProtocolHeld(false)
+    , mEmissionDepth(0)
+    , mQSetCacheGeneration(scp.getQSetGeneration())
+    , mLatencyStart(0)
+    , mLatencyPhases(0)
+    , mStateVersion(0)
 {
 }
 
+void
+Slot::recordLatency(SCPLatency::Phase phase)
+{
+    uint32 bit = 1u << phase;
+    if (mLatencyPhases & bit)
+    {
+        return;
+    }
+    int64 now = SCPLatency::now();
+    if (mLatencyPhases == 0)
+    {
+        mLatencyStart = now;
+    }
+    else
+    {
+        mSCP.getLatency().record(phase, now - mLatencyStart);
+    }
+    mLatencyPhases |= bit;
+}
+
 Value const&
 Slot::getLatestCompositeCandidate()
 {
@@ -39,18 +75,42 @@ std::vector<SCPEnvelope>
 Slot::getLatestMessagesSend() const
 {
     std::vector<SCPEnvelope> res;
+    forEachLatestMessageSend([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
+    return res;
+}
+
+bool
+Slot::forEachLatestMessageSend(SCP::EnvelopeVisitor const& f) const
+{
+    for (auto e : getLatestEncodedMessagesSend())
+    {
+        if (!f(e->getEnvelope()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<EncodedEnvelope const*>
+Slot::getLatestEncodedMessagesSend() const
+{
+    std::vector<EncodedEnvelope const*> res;
     if (mFullyValidated)
     {
-        SCPEnvelope* e;
-        e = mNominationProtocol.getLastMessageSend();
+        EncodedEnvelope const* e;
+        e = mNominationProtocol.getLastEncodedMessageSend();
         if (e)
         {
-            res.emplace_back(*e);
+            res.emplace_back(e);
         }
-        e = mBallotProtocol.getLastMessageSend();
+        e = mBallotProtocol.getLastEncodedMessageSend();
         if (e)
         {
-            res.emplace_back(*e);
+            res.emplace_back(e);
         }
     }
     return res;
@@ -80,16 +140,78 @@ Slot::setStateFromEnvelope(SCPEnvelope const& e)
     }
 }
 
+bool
+Slot::restoreState(SCPEnvelope const* envelopes, size_t count)
+{
+    SCPEnvelope const* nomination = nullptr;
+    SCPEnvelope const* ballot = nullptr;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto const& e = envelopes[i];
+        auto type = e.statement.pledges.type();
+        bool valid = e.statement.nodeID == getSCP().getLocalNodeID() &&
+                     e.statement.slotIndex == mSlotIndex;
+        if (valid && type == SCPStatementType::SCP_ST_NOMINATE)
+        {
+            valid = nomination == nullptr;
+            nomination = &e;
+        }
+        else if (valid)
+        {
+            // the ballot statement types are ordered by phase, keep the
+            // most advanced one
+            valid = ballot == nullptr || ballot->statement.pledges.type() != type;
+            if (ballot == nullptr || ballot->statement.pledges.type() < type)
+            {
+                ballot = &e;
+            }
+        }
+        if (!valid)
+        {
+            CLOG(WARN, "SCP")
+                << "Slot::restoreState invalid envelope"
+                << " i: " << getSlotIndex() << " " << mSCP.envToStr(e);
+            return false;
+        }
+    }
+
+    if ((nomination && mNominationProtocol.isNominationStarted()) ||
+        (ballot && mBallotProtocol.hasCurrentBallot()))
+    {
+        CLOG(WARN, "SCP") << "Slot::restoreState slot " << getSlotIndex()
+                             << " already started";
+        return false;
+    }
+
+    if (nomination)
+    {
+        mNominationProtocol.setStateFromEnvelope(*nomination);
+    }
+    if (ballot)
+    {
+        mBallotProtocol.setStateFromEnvelope(*ballot);
+    }
+    return true;
+}
+
 std::vector<SCPEnvelope>
 Slot::getCurrentState() const
 {
     std::vector<SCPEnvelope> res;
-    res = mNominationProtocol.getCurrentState();
-    auto r2 = mBallotProtocol.getCurrentState();
-    res.insert(res.end(), r2.begin(), r2.end());
+    forEachCurrentEnvelope([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
     return res;
 }
 
+bool
+Slot::forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const
+{
+    return mNominationProtocol.forEachCurrentEnvelope(f) &&
+           mBallotProtocol.forEachCurrentEnvelope(f);
+}
+
 SCPEnvelope const*
 Slot::getLatestMessage(NodeID const& id) const
 {
@@ -107,20 +229,92 @@ Slot::getExternalizingState() const
     return mBallotProtocol.getExternalizingState();
 }
 
+bool
+Slot::forEachExternalizingEnvelope(SCP::EnvelopeVisitor const& f) const
+{
+    return mBallotProtocol.forEachExternalizingEnvelope(f);
+}
+
 void
 Slot::recordStatement(SCPStatement const& st)
 {
-    mStatementsHistory.emplace_back(
-        HistoricalStatement{std::time(nullptr), st, mFullyValidated});
+    mStateVersion++;
+    mStatementCount++;
+    switch (mSCP.getHistoryMode())
+    {
+    case SCP::HISTORY_FULL:
+    {
+        HistoricalStatement item{std::time(nullptr),
+                                 InternedStatement(st, mValueTable),
+                                 mFullyValidated};
+        mHistoryBytes += item.mStatement.getMemoryUsage();
+        if (appendHistory(mStatementsHistory, item))
+        {
+            mHistoryBytes -= item.mStatement.getMemoryUsage();
+            item.mStatement.release(mValueTable);
+        }
+    }
+    break;
+    case SCP::HISTORY_COMPACT:
+    {
+        CompactStatement item{std::time(nullptr), getXDRHashOf(st),
+                              st.pledges.type(), mFullyValidated};
+        appendHistory(mCompactHistory, item);
+    }
+    break;
+    case SCP::HISTORY_OFF:
+        break;
+    }
     CLOG(DEBUG, "SCP") << "new statement: "
                        << " i: " << getSlotIndex()
                        << " st: " << mSCP.envToStr(st, false) << " validated: "
                        << (mFullyValidated ? "true" : "false");
 }
 
+void
+Slot::clearStatementHistory()
+{
+    for (auto const& item : mStatementsHistory)
+    {
+        item.mStatement.release(mValueTable);
+    }
+    mStatementsHistory.clear();
+    mCompactHistory.clear();
+    mHistoryStart = 0;
+    mHistoryBytes = 0;
+}
+
+SlotMemoryUsage
+Slot::getMemoryUsage() const
+{
+    SlotMemoryUsage res;
+    res.mSlotIndex = mSlotIndex;
+    // the arena only holds the counters of the ballot protocol
+    res.mBallotEnvelopes =
+        mBallotProtocol.getMemoryUsage() + mArena.getReservedBytes();
+    res.mNominationEnvelopes = mNominationProtocol.getMemoryUsage();
+    res.mStatementHistory =
+        mStatementsHistory.capacity() * sizeof(HistoricalStatement) +
+        mCompactHistory.capacity() * sizeof(CompactStatement) + mHistoryBytes;
+    res.mValues = mValueTable.getMemoryUsage();
+    // the quorum sets are the driver's
+    using CacheNode = std::pair<Hash const, QSetCacheEntry>;
+    res.mQSetCache = 0;
+    for (auto const& it : mQSetCache)
+    {
+        res.mQSetCache += 4 * sizeof(void*) + sizeof(CacheNode);
+        if (it.second.mCompiled)
+        {
+            res.mQSetCache += it.second.mCompiled->getMemoryUsage();
+        }
+    }
+    return res;
+}
+
 SCP::EnvelopeState
 Slot::processEnvelope(SCPEnvelope const& envelope, bool self)
 {
+    ZoneScoped;
     dbgAssert(envelope.statement.slotIndex == mSlotIndex);
 
     if (Logging::logTrace("SCP"))
@@ -132,6 +326,11 @@ Slot::processEnvelope(SCPEnvelope const& envelope, bool self)
 
     try
     {
+        // the local statements are processed while emitting them
+        if (!self)
+        {
+            deferEmission();
+        }
 
         if (envelope.statement.pledges.type() ==
             SCPStatementType::SCP_ST_NOMINATE)
@@ -142,9 +341,15 @@ Slot::processEnvelope(SCPEnvelope const& envelope, bool self)
         {
             res = mBallotProtocol.processEnvelope(envelope, self);
         }
+
+        if (!self)
+        {
+            emitDeferred();
+        }
     }
     catch (...)
     {
+        mEmissionDepth = 0;
         CLOG(FATAL, "SCP") << "SCP context:";
         CLOG(FATAL, "SCP") << getJsonInfo().toStyledString();
         CLOG(FATAL, "SCP") << "Exception processing SCP messages at "
@@ -157,23 +362,96 @@ Slot::processEnvelope(SCPEnvelope const& envelope, bool self)
     return res;
 }
 
+size_t
+Slot::processEnvelopes(std::vector<SCPEnvelope const*> const& envelopes)
+{
+    ZoneScoped;
+    ZoneValue(envelopes.size());
+    size_t res = 0;
+    std::vector<SCPEnvelope const*> ballotEnvelopes;
+
+    try
+    {
+        deferEmission();
+        for (auto e : envelopes)
+        {
+            dbgAssert(e->statement.slotIndex == mSlotIndex);
+
+            if (Logging::logTrace("SCP"))
+                CLOG(TRACE, "SCP") << "Slot::processEnvelopes"
+                                   << " i: " << getSlotIndex() << " "
+                                   << mSCP.envToStr(*e);
+
+            if (e->statement.pledges.type() ==
+                SCPStatementType::SCP_ST_NOMINATE)
+            {
+                if (mNominationProtocol.processEnvelope(*e) ==
+                    SCP::EnvelopeState::VALID)
+                {
+                    res++;
+                }
+            }
+            else
+            {
+                ballotEnvelopes.emplace_back(e);
+            }
+        }
+
+        if (!ballotEnvelopes.empty())
+        {
+            res += mBallotProtocol.processEnvelopes(ballotEnvelopes);
+        }
+        emitDeferred();
+    }
+    catch (...)
+    {
+        mEmissionDepth = 0;
+        CLOG(FATAL, "SCP") << "SCP context:";
+        CLOG(FATAL, "SCP") << getJsonInfo().toStyledString();
+        CLOG(FATAL, "SCP") << "Exception processing SCP messages at "
+                           << mSlotIndex << ", batch of " << envelopes.size()
+                           << " envelopes";
+        CLOG(FATAL, "SCP") << REPORT_INTERNAL_BUG;
+
+        throw;
+    }
+    return res;
+}
+
+void
+Slot::candidatesCombined(Value const& composite)
+{
+    mNominationProtocol.candidatesCombined(composite);
+}
+
 bool
 Slot::abandonBallot()
 {
+    if (mBallotProtocolHeld)
+    {
+        return false;
+    }
     return mBallotProtocol.abandonBallot(0);
 }
 
 bool
 Slot::bumpState(Value const& value, bool force)
 {
-
+    // the nomination protocol keeps the composite value until released
+    if (mBallotProtocolHeld)
+    {
+        return false;
+    }
     return mBallotProtocol.bumpState(value, force);
 }
 
 bool
 Slot::nominate(Value const& value, Value const& previousValue, bool timedout)
 {
-    return mNominationProtocol.nominate(value, previousValue, timedout);
+    deferEmission();
+    bool res = mNominationProtocol.nominate(value, previousValue, timedout);
+    emitDeferred();
+    return res;
 }
 
 void
@@ -197,11 +475,200 @@ Slot::isFullyValidated() const
 void
 Slot::setFullyValidated(bool fullyValidated)
 {
+    if (mFullyValidated != fullyValidated)
+    {
+        mStateVersion++;
+    }
     mFullyValidated = fullyValidated;
 }
 
+SCPDriver::ValidationLevel
+Slot::validateValue(Value const& value, bool nomination)
+{
+    // values are only hashed once the driver deferred a validation
+    Hash valueHash;
+    if (!mValidations.empty())
+    {
+        valueHash = getHashOf(value);
+        auto it = mValidations.find(valueHash);
+        if (it != mValidations.end())
+        {
+            return it->second;
+        }
+    }
+
+    SCPDriver::ValidationLevel res;
+    {
+        ZoneScopedN("SCPDriver::validateValue");
+        res = getSCPDriver().validateValue(mSlotIndex, value, nomination);
+    }
+    if (res == SCPDriver::kPendingValue)
+    {
+        if (mValidations.empty())
+        {
+            valueHash = getHashOf(value);
+        }
+        // the driver may already have given its verdict
+        res = mValidations.emplace(valueHash, res).first->second;
+    }
+    return res;
+}
+
+void
+Slot::deferEnvelope(SCPEnvelope const& envelope)
+{
+    auto const& st = envelope.statement;
+    bool nomination = st.pledges.type() == SCP_ST_NOMINATE;
+    auto it = std::find_if(
+        mDeferredEnvelopes.begin(), mDeferredEnvelopes.end(),
+        [&](SCPEnvelope const& e) {
+            return e.statement.nodeID == st.nodeID &&
+                   (e.statement.pledges.type() == SCP_ST_NOMINATE) ==
+                       nomination;
+        });
+    if (it == mDeferredEnvelopes.end())
+    {
+        mDeferredEnvelopes.emplace_back(envelope);
+    }
+    else if (nomination ? NominationProtocol::isNewerStatement(
+                              it->statement.pledges.nominate(),
+                              st.pledges.nominate())
+                        : BallotProtocol::isNewerStatement(it->statement, st))
+    {
+        *it = envelope;
+    }
+}
+
+void
+Slot::valueValidated(Hash const& valueHash, SCPDriver::ValidationLevel level)
+{
+    dbgAssert(level != SCPDriver::kPendingValue);
+    auto& known = mValidations[valueHash];
+    bool wasPending = known == SCPDriver::kPendingValue;
+    known = level;
+    if (wasPending)
+    {
+        processDeferredEnvelopes();
+    }
+}
+
+bool
+Slot::dropPendingValidations()
+{
+    bool pending = false;
+    for (auto it = mValidations.begin(); it != mValidations.end();)
+    {
+        if (it->second == SCPDriver::kPendingValue)
+        {
+            it = mValidations.erase(it);
+            pending = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return pending;
+}
+
+void
+Slot::retryValidations()
+{
+    if (dropPendingValidations())
+    {
+        processDeferredEnvelopes();
+    }
+}
+
+void
+Slot::holdBallotProtocol()
+{
+    mBallotProtocolHeld = true;
+}
+
+void
+Slot::releaseBallotProtocol()
+{
+    if (!mBallotProtocolHeld)
+    {
+        retryValidations();
+        return;
+    }
+    mBallotProtocolHeld = false;
+    dropPendingValidations();
+
+    // the local candidate first, as if it had been bumped when combined
+    auto const& composite = mNominationProtocol.getLatestCompositeCandidate();
+    if (!composite.empty())
+    {
+        mBallotProtocol.bumpState(composite, false);
+    }
+    processDeferredEnvelopes();
+}
+
+void
+Slot::processDeferredEnvelopes()
+{
+    // the envelopes still waiting for other values are deferred again
+    std::vector<SCPEnvelope> deferred;
+    deferred.swap(mDeferredEnvelopes);
+    std::vector<SCPEnvelope const*> ballotEnvelopes;
+    deferEmission();
+    for (auto const& e : deferred)
+    {
+        if (e.statement.pledges.type() == SCP_ST_NOMINATE)
+        {
+            mNominationProtocol.processDeferredEnvelope(e);
+        }
+        else
+        {
+            ballotEnvelopes.emplace_back(&e);
+        }
+    }
+    if (!ballotEnvelopes.empty())
+    {
+        processEnvelopes(ballotEnvelopes);
+    }
+    emitDeferred();
+}
+
+void
+Slot::deferEmission()
+{
+    mEmissionDepth++;
+}
+
+void
+Slot::emitDeferred()
+{
+    dbgAssert(mEmissionDepth != 0);
+    if (mEmissionDepth == 1)
+    {
+        // recording the nomination may bump the ballot protocol, which is
+        // still deferred meanwhile
+        mNominationProtocol.emitDeferredNomination();
+    }
+    if (--mEmissionDepth == 0)
+    {
+        mBallotProtocol.emitDeferredEnvelope();
+    }
+}
+
+std::shared_ptr<SCPReadSnapshot::SlotState const>
+Slot::makeReadState() const
+{
+    auto res = std::make_shared<SCPReadSnapshot::SlotState>();
+    res->mSlotIndex = mSlotIndex;
+    res->mVersion = mStateVersion;
+    res->mFullyValidated = mFullyValidated;
+    res->mNominationState = mNominationProtocol.getCurrentState();
+    res->mBallotState = mBallotProtocol.getCurrentState();
+    res->mExternalizingState = mBallotProtocol.getExternalizingState();
+    return res;
+}
+
 SCPEnvelope
-Slot::createEnvelope(SCPStatement const& statement)
+Slot::createEnvelope(SCPStatement const& statement, bool sign)
 {
     SCPEnvelope envelope;
 
@@ -210,11 +677,20 @@ Slot::createEnvelope(SCPStatement const& statement)
     mySt.nodeID = getSCP().getLocalNodeID();
     mySt.slotIndex = getSlotIndex();
 
-    mSCP.getDriver().signEnvelope(envelope);
-
+    if (sign)
+    {
+        signEnvelope(envelope);
+    }
     return envelope;
 }
 
+void
+Slot::signEnvelope(SCPEnvelope& envelope)
+{
+    ZoneScopedN("SCPDriver::signEnvelope");
+    mSCP.getDriver().signEnvelope(envelope);
+}
+
 Hash
 Slot::getCompanionQuorumSetHashFromStatement(SCPStatement const& st)
 {
@@ -283,28 +759,137 @@ Slot::getQuorumSetFromStatement(SCPStatement const& st)
         {
             dbgAbort();
         }
-        res = getSCPDriver().getQSet(h);
+        res = getQSet(h);
     }
     return res;
 }
 
+Slot::QSetCacheEntry const*
+Slot::getQSetCacheEntry(Hash const& qSetHash)
+{
+    if (!mSCP.isQSetCacheEnabled())
+    {
+        return nullptr;
+    }
+
+    if (mQSetCacheGeneration != mSCP.getQSetGeneration())
+    {
+        mQSetCache.clear();
+        mQSetCacheGeneration = mSCP.getQSetGeneration();
+    }
+
+    auto it = mQSetCache.find(qSetHash);
+    if (it != mQSetCache.end())
+    {
+        return &it->second;
+    }
+
+    SCPQuorumSetPtr qSet;
+    {
+        ZoneScopedN("SCPDriver::getQSet");
+        qSet = getSCPDriver().getQSet(qSetHash);
+    }
+    if (!qSet)
+    {
+        return nullptr;
+    }
+    QSetCacheEntry entry;
+    entry.mReason = nullptr;
+    entry.mSane = isQuorumSetSane(*qSet, false, &entry.mReason);
+    entry.mCompiled =
+        std::make_shared<CompiledQuorumSet>(*qSet, mSCP.getNodeIndex());
+    entry.mQSet = std::move(qSet);
+    return &mQSetCache.emplace(qSetHash, std::move(entry)).first->second;
+}
+
+SCPQuorumSetPtr
+Slot::getQSet(Hash const& qSetHash)
+{
+    if (!mSCP.isQSetCacheEnabled())
+    {
+        ZoneScopedN("SCPDriver::getQSet");
+        return getSCPDriver().getQSet(qSetHash);
+    }
+    auto entry = getQSetCacheEntry(qSetHash);
+    return entry ? entry->mQSet : nullptr;
+}
+
+bool
+Slot::isQuorumSetFromStatementSane(SCPStatement const& st,
+                                   char const** reason)
+{
+    if (st.pledges.type() != SCP_ST_EXTERNALIZE && mSCP.isQSetCacheEnabled())
+    {
+        auto entry =
+            getQSetCacheEntry(getCompanionQuorumSetHashFromStatement(st));
+        if (entry && reason != nullptr)
+        {
+            *reason = entry->mReason;
+        }
+        return entry && entry->mSane;
+    }
+    auto qSet = getQuorumSetFromStatement(st);
+    return qSet != nullptr && isQuorumSetSane(*qSet, false, reason);
+}
+
+std::shared_ptr<CompiledQuorumSet const>
+Slot::getCompiledQuorumSetFromStatement(SCPStatement const& st)
+{
+    if (st.pledges.type() != SCP_ST_EXTERNALIZE && mSCP.isQSetCacheEnabled())
+    {
+        auto entry =
+            getQSetCacheEntry(getCompanionQuorumSetHashFromStatement(st));
+        return entry ? entry->mCompiled : nullptr;
+    }
+    auto qSet = getQuorumSetFromStatement(st);
+    if (!qSet)
+    {
+        return nullptr;
+    }
+    return std::make_shared<CompiledQuorumSet>(*qSet, mSCP.getNodeIndex());
+}
+
+void
+Slot::invalidateQSet(Hash const& qSetHash)
+{
+    mQSetCache.erase(qSetHash);
+    mBallotProtocol.resetHeardFromQuorum();
+}
+
 Json::Value
 Slot::getJsonInfo(bool fullKeys)
 {
     Json::Value ret;
     std::map<Hash, SCPQuorumSetPtr> qSetsUsed;
 
+    // histories are ring buffers starting at mHistoryStart once full
+    auto historyAt = [&](auto const& history, size_t i)
+        -> decltype(history[0]) {
+        return history[(mHistoryStart + i) % history.size()];
+    };
+
     int count = 0;
-    for (auto const& item : mStatementsHistory)
+    for (size_t i = 0; i < mCompactHistory.size(); i++)
+    {
+        auto const& item = historyAt(mCompactHistory, i);
+        Json::Value& v = ret["statements"][count++];
+        v.append((Json::UInt64)item.mWhen);
+        v.append(std::string(xdr::xdr_traits<SCPStatementType>::enum_name(
+                     item.mType)) +
+                 " " + hexAbbrev(item.mStatementHash));
+        v.append(item.mValidated);
+    }
+    for (size_t i = 0; i < mStatementsHistory.size(); i++)
     {
+        auto const& item = historyAt(mStatementsHistory, i);
         Json::Value& v = ret["statements"][count++];
         v.append((Json::UInt64)item.mWhen);
-        v.append(mSCP.envToStr(item.mStatement, fullKeys));
+        v.append(mSCP.envToStr(item.mStatement.get(mValueTable), fullKeys));
         v.append(item.mValidated);
 
-        Hash const& qSetHash =
-            getCompanionQuorumSetHashFromStatement(item.mStatement);
-        auto qSet = getSCPDriver().getQSet(qSetHash);
+        Hash const& qSetHash = getCompanionQuorumSetHashFromStatement(
+            item.mStatement.getStripped());
+        auto qSet = getQSet(qSetHash);
         if (qSet)
         {
             qSetsUsed.insert(std::make_pair(qSetHash, qSet));
@@ -324,6 +909,84 @@ Slot::getJsonInfo(bool fullKeys)
     return ret;
 }
 
+void
+Slot::writeJsonInfo(JsonWriter& out, bool fullKeys)
+{
+    auto historyAt = [&](auto const& history, size_t i)
+        -> decltype(history[0]) {
+        return history[(mHistoryStart + i) % history.size()];
+    };
+
+    // keys are written in the order of getJsonInfo (Json::Value sorts
+    // them), so the quorum sets are collected before the statements
+    std::map<Hash, SCPQuorumSetPtr> qSetsUsed;
+    for (size_t i = 0; i < mStatementsHistory.size(); i++)
+    {
+        auto const& st = historyAt(mStatementsHistory, i).mStatement;
+        Hash const& qSetHash =
+            getCompanionQuorumSetHashFromStatement(st.getStripped());
+        auto qSet = getQSet(qSetHash);
+        if (qSet)
+        {
+            qSetsUsed.insert(std::make_pair(qSetHash, qSet));
+        }
+    }
+
+    out.beginObject();
+    out.key("ballotProtocol");
+    out.value(mBallotProtocol.getJsonInfo());
+    out.key("nomination");
+    out.value(mNominationProtocol.getJsonInfo());
+
+    out.key("quorum_sets");
+    if (qSetsUsed.empty())
+    {
+        out.value(Json::Value());
+    }
+    else
+    {
+        out.beginObject();
+        for (auto const& q : qSetsUsed)
+        {
+            out.key(hexAbbrev(q.first));
+            out.value(getLocalNode()->toJson(*q.second, fullKeys));
+        }
+        out.endObject();
+    }
+
+    if (!mCompactHistory.empty() || !mStatementsHistory.empty())
+    {
+        out.key("statements");
+        out.beginArray();
+        for (size_t i = 0; i < mCompactHistory.size(); i++)
+        {
+            auto const& item = historyAt(mCompactHistory, i);
+            out.beginArray();
+            out.value(static_cast<uint64_t>(item.mWhen));
+            out.value(std::string(xdr::xdr_traits<SCPStatementType>::enum_name(
+                          item.mType)) +
+                      " " + hexAbbrev(item.mStatementHash));
+            out.value(item.mValidated);
+            out.endArray();
+        }
+        for (size_t i = 0; i < mStatementsHistory.size(); i++)
+        {
+            auto const& item = historyAt(mStatementsHistory, i);
+            out.beginArray();
+            out.value(static_cast<uint64_t>(item.mWhen));
+            out.value(
+                mSCP.envToStr(item.mStatement.get(mValueTable), fullKeys));
+            out.value(item.mValidated);
+            out.endArray();
+        }
+        out.endArray();
+    }
+
+    out.key("validated");
+    out.value(mFullyValidated);
+    out.endObject();
+}
+
 Json::Value
 Slot::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
 {
@@ -339,39 +1002,37 @@ bool
 Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
                       std::map<NodeID, SCPEnvelope> const& envs)
 {
-    // Checks if the nodes that claimed to accept the statement form a
-    // v-blocking set
-    if (LocalNode::isVBlocking(getLocalNode()->getQuorumSet(), envs, accepted))
-    {
-        return true;
-    }
-
-    // Checks if the set of nodes that accepted or voted for it form a quorum
+    return federatedAccept<StatementPredicate, StatementPredicate,
+                           std::map<NodeID, SCPEnvelope>>(voted, accepted,
+                                                          envs);
+}
 
-    auto ratifyFilter = [&](SCPStatement const& st) {
-        bool res;
-        res = accepted(st) || voted(st);
-        return res;
-    };
+bool
+Slot::federatedRatify(StatementPredicate voted,
+                      std::map<NodeID, SCPEnvelope> const& envs)
+{
+    return federatedRatify<StatementPredicate, std::map<NodeID, SCPEnvelope>>(
+        voted, envs);
+}
 
-    if (LocalNode::isQuorum(
-            getLocalNode()->getQuorumSet(), envs,
-            std::bind(&Slot::getQuorumSetFromStatement, this, _1),
-            ratifyFilter))
+bool
+Slot::federatedAccept(BitSet const& voted, BitSet const& accepted,
+                      NodeEnvelopeTable const& envs)
+{
+    ZoneScoped;
+    auto const& qSet = getLocalNode()->getCompiledQuorumSet();
+    if (LocalNode::isVBlocking(qSet, envs, accepted))
     {
         return true;
     }
-
-    return false;
+    return isQuorum(qSet, envs, voted | accepted);
 }
 
 bool
-Slot::federatedRatify(StatementPredicate voted,
-                      std::map<NodeID, SCPEnvelope> const& envs)
+Slot::federatedRatify(BitSet const& voted, NodeEnvelopeTable const& envs)
 {
-    return LocalNode::isQuorum(
-        getLocalNode()->getQuorumSet(), envs,
-        std::bind(&Slot::getQuorumSetFromStatement, this, _1), voted);
+    ZoneScoped;
+    return isQuorum(getLocalNode()->getCompiledQuorumSet(), envs, voted);
 }
 
 std::shared_ptr<LocalNode>
@@ -382,12 +1043,32 @@ Slot::getLocalNode()
 
 std::vector<SCPEnvelope>
 Slot::getEntireCurrentState()
+{
+    std::vector<SCPEnvelope> res;
+    forEachEnvelopeOfEntireState([&](SCPEnvelope const& e) {
+        res.emplace_back(e);
+        return true;
+    });
+    return res;
+}
+
+bool
+Slot::forEachEnvelopeOfEntireState(SCP::EnvelopeVisitor const& f)
 {
     bool old = mFullyValidated;
     // fake fully validated to force returning all envelopes
     mFullyValidated = true;
-    auto r = getCurrentState();
+    bool res;
+    try
+    {
+        res = forEachCurrentEnvelope(f);
+    }
+    catch (...)
+    {
+        mFullyValidated = old;
+        throw;
+    }
     mFullyValidated = old;
-    return r;
+    return res;
 }
 }
@@ -9,6 +9,10 @@
 #include "NominationProtocol.h"
 #include "lib/json/json-forwards.h"
 #include "scp/SCP.h"
+#include "scp/SCPReadSnapshot.h"
+#include "scp/SlotMemoryUsage.h"
+#include "scp/ValueTable.h"
+#include "util/Tracy.h"
 #include <functional>
 #include <memory>
 #include <set>
@@ -17,6 +21,7 @@
 
 namespace stellar
 {
+class JsonWriter;
 class Node;
 
 /**
@@ -31,22 +36,92 @@ class Slot : public std::enable_shared_from_this<Slot>
     const uint64 mSlotIndex; // the index this slot is tracking
     SCP& mSCP;
 
+    // memory of the protocol state of the slot, released with the slot:
+    // declared before the protocols so that it outlives them
+    Arena mArena;
+
     BallotProtocol mBallotProtocol;
     NominationProtocol mNominationProtocol;
 
     // keeps track of all statements seen so far for this slot.
     // it is used for debugging purpose
+    // the values are interned in mValueTable
     struct HistoricalStatement
     {
         time_t mWhen;
-        SCPStatement mStatement;
+        InternedStatement mStatement;
+        bool mValidated;
+    };
+
+    // same, for SCP::HISTORY_COMPACT
+    struct CompactStatement
+    {
+        time_t mWhen;
+        Hash mStatementHash;
+        SCPStatementType mType;
         bool mValidated;
     };
 
     std::vector<HistoricalStatement> mStatementsHistory;
+    std::vector<CompactStatement> mCompactHistory;
+    // position of the oldest statement once the history in use is full and
+    // acts as a ring buffer (see SCP::getHistoryLimit)
+    size_t mHistoryStart;
+    // bytes held by the statements of mStatementsHistory
+    size_t mHistoryBytes;
+    // statements recorded, including those the history doesn't keep
+    size_t mStatementCount;
 
     // true if the Slot was fully validated
     bool mFullyValidated;
+    // true while the previous slot is not applied yet, see
+    // SCP::nominateAhead: the ballot protocol waits for it
+    bool mBallotProtocolHeld;
+    // number of calls deferring the emission of the local statements, see
+    // deferEmission
+    uint32 mEmissionDepth;
+
+    // a result of `SCPDriver::getQSet`, with the verdict of
+    // `isQuorumSetSane` and its form compiled against SCP's node index
+    struct QSetCacheEntry
+    {
+        SCPQuorumSetPtr mQSet;
+        bool mSane;
+        char const* mReason;
+        std::shared_ptr<CompiledQuorumSet const> mCompiled;
+    };
+
+    // results of `SCPDriver::getQSet`, only used if enabled on SCP;
+    // discarded when mQSetCacheGeneration falls behind SCP's generation
+    uint64 mQSetCacheGeneration;
+    std::map<Hash, QSetCacheEntry> mQSetCache;
+
+    // the entry for qSetHash, resolving it if needed; nullptr if the cache
+    // is disabled or the driver doesn't know qSetHash
+    QSetCacheEntry const* getQSetCacheEntry(Hash const& qSetHash);
+
+    // values seen by the protocols for this slot
+    ValueTable mValueTable;
+
+    // time of the first phase of the slot (see SCPLatency::now) and bitmask
+    // of the SCPLatency::Phase already recorded
+    int64 mLatencyStart;
+    uint32 mLatencyPhases;
+
+    // incremented whenever a statement is recorded or the validation state
+    // changes, see SCP::publishReadSnapshot
+    uint32 mStateVersion;
+
+    // verdicts given with SCP::valueValidated, and values whose validation
+    // is still pending (kPendingValue), keyed by getHashOf(value)
+    std::map<Hash, SCPDriver::ValidationLevel> mValidations;
+    // statements that wait for the validation of some of their values, at
+    // most one per node and protocol
+    std::vector<SCPEnvelope> mDeferredEnvelopes;
+    // processes them again, once some validations completed
+    void processDeferredEnvelopes();
+    // forgets the validations left pending, returns true if there were some
+    bool dropPendingValidations();
 
   public:
     Slot(uint64 slotIndex, SCP& SCP);
@@ -63,12 +138,30 @@ class Slot : public std::enable_shared_from_this<Slot>
         return mSCP;
     }
 
+    Arena&
+    getArena()
+    {
+        return mArena;
+    }
+
     SCPDriver&
     getSCPDriver()
     {
         return mSCP.getDriver();
     }
 
+    // records the time it took this slot to reach `phase`, only the first
+    // time it does
+    void recordLatency(SCPLatency::Phase phase);
+
+    // records an event of the local state machine for this slot
+    void
+    trace(SCPTraceEvent::Type type, uint32 counter = 0, uint32 value = 0)
+    {
+        mSCP.getTrace().record(type, mSlotIndex, SCPTraceEvent::NO_NODE,
+                               counter, value);
+    }
+
     SCPDriver const&
     getSCPDriver() const
     {
@@ -81,17 +174,37 @@ class Slot : public std::enable_shared_from_this<Slot>
         return mBallotProtocol;
     }
 
+    ValueTable&
+    getValueTable()
+    {
+        return mValueTable;
+    }
+    ValueTable const&
+    getValueTable() const
+    {
+        return mValueTable;
+    }
+
     Value const& getLatestCompositeCandidate();
 
     // returns the latest messages the slot emitted
     std::vector<SCPEnvelope> getLatestMessagesSend() const;
+    // same as `getLatestMessagesSend`, without copying the envelopes
+    std::vector<EncodedEnvelope const*> getLatestEncodedMessagesSend() const;
+    bool forEachLatestMessageSend(SCP::EnvelopeVisitor const& f) const;
 
     // forces the state to match the one in the envelope
     // this is used when rebuilding the state after a crash for example
     void setStateFromEnvelope(SCPEnvelope const& e);
 
+    // same for all the envelopes of the slot at once, see SCP::restoreState
+    bool restoreState(SCPEnvelope const* envelopes, size_t count);
+
     // returns the latest messages known for this slot
     std::vector<SCPEnvelope> getCurrentState() const;
+    // same as `getCurrentState`, without copying the envelopes
+    // returns false if the visitor stopped
+    bool forEachCurrentEnvelope(SCP::EnvelopeVisitor const& f) const;
 
     // returns the latest message from a node
     // or nullptr if not found
@@ -99,16 +212,25 @@ class Slot : public std::enable_shared_from_this<Slot>
 
     // returns messages that helped this slot externalize
     std::vector<SCPEnvelope> getExternalizingState() const;
+    bool forEachExternalizingEnvelope(SCP::EnvelopeVisitor const& f) const;
 
     // records the statement in the historical record for this slot
     void recordStatement(SCPStatement const& st);
 
+    // discards the historical record for this slot
+    void clearStatementHistory();
+
     // Process a newly received envelope for this slot and update the state of
     // the slot accordingly.
     // self: set to true when node wants to record its own messages (potentially
     // triggering more transitions)
     SCP::EnvelopeState processEnvelope(SCPEnvelope const& envelope, bool self);
 
+    // Process a batch of envelopes received for this slot, running the ballot
+    // protocol once all of them are recorded.
+    // returns the number of envelopes that were VALID
+    size_t processEnvelopes(std::vector<SCPEnvelope const*> const& envelopes);
+
     bool abandonBallot();
 
     // bumps the ballot based on the local state and the value passed in:
@@ -124,23 +246,80 @@ class Slot : public std::enable_shared_from_this<Slot>
 
     void stopNomination();
 
+    // see SCP::candidatesCombined
+    void candidatesCombined(Value const& composite);
+
     // returns the current nomination leaders
     std::set<NodeID> getNominationLeaders() const;
 
     bool isFullyValidated() const;
     void setFullyValidated(bool fullyValidated);
 
+    // `SCPDriver::validateValue`, unless the driver already gave its
+    // verdict with SCP::valueValidated or is still validating the value
+    SCPDriver::ValidationLevel validateValue(Value const& value,
+                                             bool nomination);
+    // keeps the envelope until the values it waits for are validated,
+    // replacing an older statement of the node for the same protocol
+    void deferEnvelope(SCPEnvelope const& envelope);
+    // see SCP::valueValidated
+    void valueValidated(Hash const& valueHash,
+                        SCPDriver::ValidationLevel level);
+    // asks the driver again for the validations left pending, see
+    // SCP::externalizeCompleted
+    void retryValidations();
+
+    // see SCP::nominateAhead: the composite value isn't bumped into the
+    // ballot protocol, and the ballot statements are deferred, until
+    // releaseBallotProtocol, which also retries the pending validations
+    void holdBallotProtocol();
+    void releaseBallotProtocol();
+    bool
+    isBallotProtocolHeld() const
+    {
+        return mBallotProtocolHeld;
+    }
+
+    // the local statements are recorded but not emitted until the matching
+    // emitDeferred, so that the envelopes processed in between produce at
+    // most one nomination and one ballot envelope; calls can be nested
+    void deferEmission();
+    void emitDeferred();
+    bool
+    isEmissionDeferred() const
+    {
+        return mEmissionDepth != 0;
+    }
+    size_t
+    getDeferredEnvelopeCount() const
+    {
+        return mDeferredEnvelopes.size();
+    }
+
+    uint32
+    getStateVersion() const
+    {
+        return mStateVersion;
+    }
+    // copy of the state of the slot for SCPReadSnapshot
+    std::shared_ptr<SCPReadSnapshot::SlotState const> makeReadState() const;
+
     // ** status methods
 
     size_t
     getStatementCount() const
     {
-        return mStatementsHistory.size();
+        return mStatementCount;
     }
 
+    // bytes held by the state of the slot, see SCP::getMemoryUsage
+    SlotMemoryUsage getMemoryUsage() const;
+
     // returns information about the local state in JSON format
     // including historical statements if available
     Json::Value getJsonInfo(bool fullKeys = false);
+    // ditto, streamed to out
+    void writeJsonInfo(JsonWriter& out, bool fullKeys = false);
 
     // returns information about the quorum for a given node
     Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
@@ -159,8 +338,26 @@ class Slot : public std::enable_shared_from_this<Slot>
     // statement (singleton for externalize)
     SCPQuorumSetPtr getQuorumSetFromStatement(SCPStatement const& st);
 
+    // retrieves a quorum set from the driver, going through the cache
+    SCPQuorumSetPtr getQSet(Hash const& qSetHash);
+
+    // `isQuorumSetSane` on the quorum set of the statement, memoized by
+    // the cache; false if the quorum set can't be resolved
+    bool isQuorumSetFromStatementSane(SCPStatement const& st,
+                                      char const** reason);
+
+    // `getQuorumSetFromStatement` compiled against SCP's node index, kept
+    // by the cache; nullptr if the quorum set can't be resolved
+    std::shared_ptr<CompiledQuorumSet const>
+    getCompiledQuorumSetFromStatement(SCPStatement const& st);
+
+    // drops qSetHash from the cache
+    void invalidateQSet(Hash const& qSetHash);
+
     // wraps a statement in an envelope (sign it, etc)
-    SCPEnvelope createEnvelope(SCPStatement const& statement);
+    SCPEnvelope createEnvelope(SCPStatement const& statement,
+                               bool sign = true);
+    void signEnvelope(SCPEnvelope& envelope);
 
     // ** federated agreement helper functions
 
@@ -173,6 +370,84 @@ class Slot : public std::enable_shared_from_this<Slot>
     bool federatedRatify(StatementPredicate voted,
                          std::map<NodeID, SCPEnvelope> const& envs);
 
+    // same, with the nodes of envs that voted for or accepted the
+    // statement already computed
+    bool federatedAccept(BitSet const& voted, BitSet const& accepted,
+                         NodeEnvelopeTable const& envs);
+    bool federatedRatify(BitSet const& voted, NodeEnvelopeTable const& envs);
+
+    // overloads for any callable predicate, avoiding the type erasure,
+    // and any envelope container LocalNode supports
+    template <typename Voted, typename Accepted, typename Envelopes>
+    bool
+    federatedAccept(Voted const& voted, Accepted const& accepted,
+                    Envelopes const& envs)
+    {
+        ZoneScoped;
+        auto const& qSet = getLocalNode()->getCompiledQuorumSet();
+
+        // Checks if the nodes that claimed to accept the statement form a
+        // v-blocking set
+        if (LocalNode::isVBlocking(qSet, envs, accepted))
+        {
+            return true;
+        }
+
+        // Checks if the set of nodes that accepted or voted for it form a
+        // quorum
+        return isQuorum(qSet, envs, [&](SCPStatement const& st) {
+            return accepted(st) || voted(st);
+        });
+    }
+
+    template <typename Voted, typename Envelopes>
+    bool
+    federatedRatify(Voted const& voted, Envelopes const& envs)
+    {
+        ZoneScoped;
+        return isQuorum(getLocalNode()->getCompiledQuorumSet(), envs, voted);
+    }
+
+    // `LocalNode::isQuorum` with the quorum sets of the statements
+    template <typename Filter, typename Envelopes>
+    bool
+    isQuorum(CompiledQuorumSet const& qSet, Envelopes const& envs,
+             Filter const& filter)
+    {
+        return LocalNode::isQuorum(qSet, envs, quorumSetFromStatement(),
+                                   filter);
+    }
+
+    // the envelope tables share SCP's node index, so the quorum sets
+    // compiled by the cache are used as is
+    template <typename Filter>
+    bool
+    isQuorum(CompiledQuorumSet const& qSet, NodeEnvelopeTable const& envs,
+             Filter const& filter)
+    {
+        if (!mSCP.isQSetCacheEnabled() ||
+            envs.getSharedNodeIndex() != mSCP.getNodeIndex())
+        {
+            return LocalNode::isQuorum(qSet, envs, quorumSetFromStatement(),
+                                       filter);
+        }
+        return LocalNode::isQuorum(
+            qSet, envs,
+            [this](SCPStatement const& st) {
+                return getCompiledQuorumSetFromStatement(st);
+            },
+            filter);
+    }
+
+    // `getQuorumSetFromStatement` as a callable for `LocalNode::isQuorum`
+    std::function<SCPQuorumSetPtr(SCPStatement const&)>
+    quorumSetFromStatement()
+    {
+        return [this](SCPStatement const& st) {
+            return getQuorumSetFromStatement(st);
+        };
+    }
+
     std::shared_ptr<LocalNode> getLocalNode();
 
     enum timerIDs
@@ -183,6 +458,26 @@ class Slot : public std::enable_shared_from_this<Slot>
 
   protected:
     std::vector<SCPEnvelope> getEntireCurrentState();
+    bool forEachEnvelopeOfEntireState(SCP::EnvelopeVisitor const& f);
+
+    // appends to one of the histories, overwriting the oldest entry
+    // if the limit set on SCP is reached
+    // once the history is full, item replaces the oldest statement and
+    // receives it: returns true in that case
+    template <typename T>
+    bool
+    appendHistory(std::vector<T>& history, T& item)
+    {
+        size_t limit = mSCP.getHistoryLimit();
+        if (limit == 0 || history.size() < limit)
+        {
+            history.emplace_back(std::move(item));
+            return false;
+        }
+        mHistoryStart %= history.size();
+        std::swap(history[mHistoryStart++], item);
+        return true;
+    }
     friend class TestSCP;
 };
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the memory usage report of the slots.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <cstddef>
+
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+/**
+ * Bytes held by the state of a slot, see `SCP::getMemoryUsage`.
+ *
+ * The footprint of the XDR objects (envelopes, statements, values) is
+ * approximated by their XDR size, which is kept up to date as they are
+ * added or replaced, the containers count their capacity. Memory shared
+ * with the driver or other slots, such as the quorum sets returned by
+ * `SCPDriver::getQSet`, isn't counted.
+ */
+struct SlotMemoryUsage
+{
+    uint64 mSlotIndex;
+    // latest envelopes of the ballot protocol, and the indexes derived from
+    // them
+    size_t mBallotEnvelopes;
+    // same for the nomination protocol
+    size_t mNominationEnvelopes;
+    // statements recorded for debugging, see `SCP::setStatementHistory`
+    size_t mStatementHistory;
+    // values interned by the slot
+    size_t mValues;
+    // quorum sets compiled by the slot, see `SCP::setQSetCacheEnabled`
+    size_t mQSetCache;
+
+    size_t
+    getTotal() const
+    {
+        return mBallotEnvelopes + mNominationEnvelopes + mStatementHistory +
+               mValues + mQSetCache;
+    }
+};
+}
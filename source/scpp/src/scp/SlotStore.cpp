@@ -0,0 +1,152 @@
+/*******************************************************************************
+
+    Implementation of the store of the slots of a SCP instance, see
+    SlotStore.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/SlotStore.h"
+
+#include "util/GlobalChecks.h"
+#include <algorithm>
+
+namespace stellar
+{
+constexpr uint64 SlotStore::MAX_SPAN;
+constexpr uint64 SlotStore::MIN_SPAN;
+
+bool
+SlotStore::insertRing(uint64 slotIndex, std::shared_ptr<Slot>& slot)
+{
+    uint64 low = mRingCount != 0 ? std::min(mLow, slotIndex) : slotIndex;
+    uint64 high = mRingCount != 0 ? std::max(mHigh, slotIndex) : slotIndex;
+    if (high - low >= MAX_SPAN)
+    {
+        return false;
+    }
+    if (high - low >= mRing.size())
+    {
+        uint64 capacity = std::max<uint64>(mRing.size(), MIN_SPAN);
+        while (capacity <= high - low)
+        {
+            capacity *= 2;
+        }
+        std::vector<std::shared_ptr<Slot>> ring(capacity);
+        for (uint64 i = mLow; mRingCount != 0 && i <= mHigh; i++)
+        {
+            ring[i & (capacity - 1)] = std::move(at(i));
+        }
+        mRing = std::move(ring);
+    }
+    dbgAssert(!at(slotIndex));
+    at(slotIndex) = std::move(slot);
+    mLow = low;
+    mHigh = high;
+    mRingCount++;
+    return true;
+}
+
+void
+SlotStore::migrateFar()
+{
+    for (auto it = mFar.begin(); it != mFar.end();)
+    {
+        if (insertRing(it->first, it->second))
+        {
+            it = mFar.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<Slot>
+SlotStore::get(uint64 slotIndex) const
+{
+    if (mRingCount != 0 && slotIndex >= mLow && slotIndex <= mHigh)
+    {
+        return at(slotIndex);
+    }
+    if (!mFar.empty())
+    {
+        auto it = mFar.find(slotIndex);
+        if (it != mFar.end())
+        {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void
+SlotStore::insert(uint64 slotIndex, std::shared_ptr<Slot> slot)
+{
+    if (!insertRing(slotIndex, slot))
+    {
+        mFar.emplace(slotIndex, std::move(slot));
+    }
+}
+
+void
+SlotStore::purge(uint64 maxSlotIndex)
+{
+    if (mRingCount != 0 && maxSlotIndex > mLow)
+    {
+        uint64 end = std::min(maxSlotIndex, mHigh + 1);
+        for (uint64 i = mLow; i < end; i++)
+        {
+            if (at(i))
+            {
+                at(i).reset();
+                mRingCount--;
+            }
+        }
+        if (mRingCount != 0)
+        {
+            mLow = end;
+            while (!at(mLow))
+            {
+                mLow++;
+            }
+        }
+    }
+    if (!mFar.empty())
+    {
+        mFar.erase(mFar.begin(), mFar.lower_bound(maxSlotIndex));
+        migrateFar();
+    }
+}
+
+uint64
+SlotStore::getLowIndex() const
+{
+    dbgAssert(!empty());
+    if (mRingCount == 0 || (!mFar.empty() && mFar.begin()->first < mLow))
+    {
+        return mFar.begin()->first;
+    }
+    return mLow;
+}
+
+uint64
+SlotStore::getHighIndex() const
+{
+    dbgAssert(!empty());
+    if (mRingCount == 0 || (!mFar.empty() && mFar.rbegin()->first > mHigh))
+    {
+        return mFar.rbegin()->first;
+    }
+    return mHigh;
+}
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the store of the slots of a SCP instance.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "xdr/Stellar-types.h"
+
+namespace stellar
+{
+class Slot;
+
+/**
+ * The slots of a SCP instance, by slot index.
+ *
+ * Slot indexes are ledger heights, so the slots known at a given time are
+ * nearly contiguous: they are kept in a ring buffer indexed by the slot
+ * index modulo its capacity, which grows to cover every slot from the
+ * lowest one to the highest one. Lookups and insertions are O(1), purging
+ * costs a step per slot index purged, and the ring buffer is reused as the
+ * window moves instead of allocating a node per slot.
+ *
+ * Slots too far from the others to share the ring buffer (for example
+ * those of a node far ahead) are kept in a std::map until they fit.
+ */
+class SlotStore
+{
+  public:
+    // maximum capacity of the ring buffer, a power of 2
+    static constexpr uint64 MAX_SPAN = 1024;
+
+  private:
+    static constexpr uint64 MIN_SPAN = 16;
+
+    // capacity: 0 or a power of 2
+    std::vector<std::shared_ptr<Slot>> mRing;
+    std::map<uint64, std::shared_ptr<Slot>> mFar;
+    // lowest and highest slot index of mRing, if mRingCount != 0
+    uint64 mLow{0};
+    uint64 mHigh{0};
+    size_t mRingCount{0};
+
+    std::shared_ptr<Slot>&
+    at(uint64 slotIndex)
+    {
+        return mRing[slotIndex & (mRing.size() - 1)];
+    }
+    std::shared_ptr<Slot> const&
+    at(uint64 slotIndex) const
+    {
+        return mRing[slotIndex & (mRing.size() - 1)];
+    }
+
+    // returns false if the slot is too far from the ones in mRing
+    bool insertRing(uint64 slotIndex, std::shared_ptr<Slot>& slot);
+    // moves the slots of mFar that fit to mRing
+    void migrateFar();
+
+  public:
+    // nullptr if the slot isn't known
+    std::shared_ptr<Slot> get(uint64 slotIndex) const;
+
+    // the slot must not be known already
+    void insert(uint64 slotIndex, std::shared_ptr<Slot> slot);
+
+    // drops every slot whose index is smaller than `maxSlotIndex`
+    void purge(uint64 maxSlotIndex);
+
+    size_t
+    size() const
+    {
+        return mRingCount + mFar.size();
+    }
+    bool
+    empty() const
+    {
+        return size() == 0;
+    }
+
+    // the store must not be empty
+    uint64 getLowIndex() const;
+    uint64 getHighIndex() const;
+
+    // calls f(Slot&) for every slot by increasing slot index, until it
+    // returns false
+    template <typename F> void forEach(F f) const;
+    // same by decreasing slot index
+    template <typename F> void forEachReverse(F f) const;
+};
+
+template <typename F>
+void
+SlotStore::forEach(F f) const
+{
+    auto far = mFar.begin();
+    if (mRingCount != 0)
+    {
+        for (uint64 i = mLow;; i++)
+        {
+            auto const& slot = at(i);
+            if (slot)
+            {
+                for (; far != mFar.end() && far->first < i; ++far)
+                {
+                    if (!f(*far->second))
+                    {
+                        return;
+                    }
+                }
+                if (!f(*slot))
+                {
+                    return;
+                }
+            }
+            if (i == mHigh)
+            {
+                break;
+            }
+        }
+    }
+    for (; far != mFar.end(); ++far)
+    {
+        if (!f(*far->second))
+        {
+            return;
+        }
+    }
+}
+
+template <typename F>
+void
+SlotStore::forEachReverse(F f) const
+{
+    auto far = mFar.rbegin();
+    if (mRingCount != 0)
+    {
+        for (uint64 i = mHigh;; i--)
+        {
+            auto const& slot = at(i);
+            if (slot)
+            {
+                for (; far != mFar.rend() && far->first > i; ++far)
+                {
+                    if (!f(*far->second))
+                    {
+                        return;
+                    }
+                }
+                if (!f(*slot))
+                {
+                    return;
+                }
+            }
+            if (i == mLow)
+            {
+                break;
+            }
+        }
+    }
+    for (; far != mFar.rend(); ++far)
+    {
+        if (!f(*far->second))
+        {
+            return;
+        }
+    }
+}
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+
+    Implementation of the intern table of the values of a slot, see
+    ValueTable.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "scp/ValueTable.h"
+#include "crypto/ByteSliceHasher.h"
+#include "util/GlobalChecks.h"
+#include "xdrpp/marshal.h"
+
+namespace stellar
+{
+constexpr ValueTable::Handle ValueTable::npos;
+
+uint64
+ValueTable::hashValue(Value const& value)
+{
+    return shortHash::computeHash(ByteSlice(value.data(), value.size()));
+}
+
+ValueTable::Handle
+ValueTable::intern(Value const& value)
+{
+    uint64 hash = hashValue(value);
+    auto range = mByHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (*mEntries[it->second].mValue == value)
+        {
+            return it->second;
+        }
+    }
+
+    Handle h;
+    Entry entry{std::make_shared<Value const>(value), hash, 0};
+    if (mFreeHandles.empty())
+    {
+        h = static_cast<Handle>(mEntries.size());
+        mEntries.emplace_back(std::move(entry));
+    }
+    else
+    {
+        h = mFreeHandles.back();
+        mFreeHandles.pop_back();
+        mEntries[h] = std::move(entry);
+    }
+    mByHash.emplace(hash, h);
+    mValueBytes += value.size();
+    return h;
+}
+
+ValueTable::Handle
+ValueTable::acquire(Value const& value)
+{
+    Handle h = intern(value);
+    mEntries[h].mRefs++;
+    return h;
+}
+
+void
+ValueTable::release(Handle h)
+{
+    if (h == npos)
+    {
+        return;
+    }
+    auto& entry = mEntries[h];
+    dbgAssert(entry.mRefs != 0);
+    if (--entry.mRefs != 0)
+    {
+        return;
+    }
+    auto range = mByHash.equal_range(entry.mHash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == h)
+        {
+            mByHash.erase(it);
+            break;
+        }
+    }
+    mValueBytes -= entry.mValue->size();
+    // the driver may still hold the value, see getShared
+    entry.mValue.reset();
+    mFreeHandles.emplace_back(h);
+}
+
+ValueTable::Handle
+ValueTable::find(Value const& value) const
+{
+    auto range = mByHash.equal_range(hashValue(value));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (*mEntries[it->second].mValue == value)
+        {
+            return it->second;
+        }
+    }
+    return npos;
+}
+
+InternedStatement::InternedStatement(SCPStatement const& st,
+                                     ValueTable& values)
+    : mStatement(st)
+{
+    forEachValue(mStatement, [&](Value& v) {
+        mValues.emplace_back(values.acquire(v));
+        // releases the storage, clear() would keep it
+        v = Value();
+    });
+    mValues.shrink_to_fit();
+}
+
+void
+InternedStatement::release(ValueTable& values) const
+{
+    for (auto h : mValues)
+    {
+        values.release(h);
+    }
+}
+
+SCPStatement
+InternedStatement::get(ValueTable const& values) const
+{
+    SCPStatement res(mStatement);
+    size_t i = 0;
+    forEachValue(res, [&](Value& v) { v = values.get(mValues[i++]); });
+    return res;
+}
+
+size_t
+InternedStatement::getMemoryUsage() const
+{
+    return xdr::xdr_size(mStatement) +
+           mValues.capacity() * sizeof(ValueTable::Handle);
+}
+
+size_t
+ValueTable::getMemoryUsage() const
+{
+    // every value is allocated along with the control block of its
+    // shared_ptr, every node of mByHash holds a next pointer
+    using HashNode = std::pair<void*, decltype(mByHash)::value_type>;
+    return mEntries.capacity() * sizeof(Entry) +
+           mFreeHandles.capacity() * sizeof(Handle) +
+           mByHash.size() * (sizeof(Value) + 2 * sizeof(long)) +
+           mValueBytes + mByHash.bucket_count() * sizeof(void*) +
+           mByHash.size() * sizeof(HashNode);
+}
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the intern table of the values of a slot.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "xdr/Stellar-SCP.h"
+
+namespace stellar
+{
+/**
+ * Slot-scoped intern table of values: every distinct value is stored once,
+ * immutable, and referred to by a dense handle that compares in O(1).
+ * Values are hashed once when first interned, so looking up a value is a
+ * short hash plus (on a hash match) one bytewise comparison.
+ *
+ * The statements the slot holds (M, N and the history) acquire their
+ * values and release them once replaced: a value is dropped with its last
+ * reference, and its handle is reused, so that a node sending new values
+ * over and over doesn't grow the table. Values interned without being
+ * acquired are the ones the protocols look up in their own state, and stay
+ * until a statement acquires and releases them.
+ */
+class ValueTable
+{
+  public:
+    using Handle = uint32;
+    static constexpr Handle npos = UINT32_MAX;
+
+    // returns the handle of value, storing a copy of it if needed
+    Handle intern(Value const& value);
+
+    // `intern`, taking a reference to the value
+    Handle acquire(Value const& value);
+
+    // gives back a reference taken by `acquire`, npos is ignored
+    void release(Handle h);
+
+    // returns the handle of value or npos if it isn't in the table
+    Handle find(Value const& value) const;
+
+    Value const&
+    get(Handle h) const
+    {
+        return *mEntries[h].mValue;
+    }
+
+    // the storage of the value, which may outlive the table
+    std::shared_ptr<Value const> const&
+    getShared(Handle h) const
+    {
+        return mEntries[h].mValue;
+    }
+
+    uint64
+    getHash(Handle h) const
+    {
+        return mEntries[h].mHash;
+    }
+
+    // an upper bound of the handles in use
+    size_t
+    size() const
+    {
+        return mEntries.size();
+    }
+
+    // bytes held by the table, see SlotMemoryUsage
+    size_t getMemoryUsage() const;
+
+  private:
+    static uint64 hashValue(Value const& value);
+
+    struct Entry
+    {
+        std::shared_ptr<Value const> mValue;
+        uint64 mHash;
+        uint32 mRefs;
+    };
+    std::vector<Entry> mEntries;
+    std::unordered_multimap<uint64, Handle> mByHash;
+    // handles of the entries dropped, reused first
+    std::vector<Handle> mFreeHandles;
+    // total size of the values
+    size_t mValueBytes{0};
+};
+
+/**
+ * A statement stored with its values interned in a ValueTable: the copy
+ * holds everything but the values, which are replaced by their handles.
+ * The statements of a slot mostly carry the same few values, which are
+ * then kept once by the table instead of once per copy.
+ */
+class InternedStatement
+{
+    // values are empty
+    SCPStatement mStatement;
+    // handles of the values, in the order of forEachValue
+    std::vector<ValueTable::Handle> mValues;
+
+  public:
+    // acquires the values of st
+    InternedStatement(SCPStatement const& st, ValueTable& values);
+
+    // gives back the values, before the statement is dropped
+    void release(ValueTable& values) const;
+
+    // the statement without its values, enough for anything else
+    SCPStatement const&
+    getStripped() const
+    {
+        return mStatement;
+    }
+
+    // a copy of the statement with its values
+    SCPStatement get(ValueTable const& values) const;
+
+    // bytes held by the statement, besides sizeof(InternedStatement) and
+    // the values
+    size_t getMemoryUsage() const;
+
+    // calls `f(value)` on every value of `st`, Statement being SCPStatement
+    // or SCPStatement const
+    template <typename Statement, typename F>
+    static void
+    forEachValue(Statement& st, F const& f)
+    {
+        auto& pledges = st.pledges;
+        switch (pledges.type())
+        {
+        case SCP_ST_PREPARE:
+        {
+            auto& prep = pledges.prepare();
+            f(prep.ballot.value);
+            if (prep.prepared)
+            {
+                f(prep.prepared->value);
+            }
+            if (prep.preparedPrime)
+            {
+                f(prep.preparedPrime->value);
+            }
+        }
+        break;
+        case SCP_ST_CONFIRM:
+            f(pledges.confirm().ballot.value);
+            break;
+        case SCP_ST_EXTERNALIZE:
+            f(pledges.externalize().commit.value);
+            break;
+        case SCP_ST_NOMINATE:
+            for (auto& v : pledges.nominate().votes)
+            {
+                f(v);
+            }
+            for (auto& v : pledges.nominate().accepted)
+            {
+                f(v);
+            }
+            break;
+        }
+    }
+};
+}
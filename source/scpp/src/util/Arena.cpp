@@ -0,0 +1,92 @@
+/*******************************************************************************
+
+    Implementation of the arena allocator of the state of the slots, see
+    Arena.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "util/Arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace stellar
+{
+constexpr size_t Arena::MAX_BLOCK_SIZE;
+constexpr size_t Arena::FREE_ALIGN;
+constexpr size_t Arena::MAX_FREE_SIZE;
+
+Arena::Arena(size_t initialSize) : mNextSize(initialSize)
+{
+}
+
+Arena::~Arena()
+{
+    while (mBlocks)
+    {
+        Block* next = mBlocks->mNext;
+        std::free(mBlocks);
+        mBlocks = next;
+    }
+}
+
+Arena::Block*
+Arena::newBlock(size_t size)
+{
+    void* mem = std::malloc(sizeof(Block) + size);
+    if (mem == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    Block* block = static_cast<Block*>(mem);
+    block->mSize = size;
+    return block;
+}
+
+void*
+Arena::allocateSlow(size_t bytes, size_t alignment)
+{
+    size_t needed = bytes + alignment;
+    // large allocations get a block of their own, behind the current one,
+    // so that the space left in the current block isn't wasted
+    if (mCur != nullptr && needed > mNextSize / 4)
+    {
+        Block* block = newBlock(needed);
+        block->mNext = mBlocks->mNext;
+        mBlocks->mNext = block;
+        auto start = reinterpret_cast<uintptr_t>(block + 1);
+        auto aligned = (start + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        mAllocated += bytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    size_t size = std::max(mNextSize, needed);
+    mNextSize = std::min(mNextSize * 2, MAX_BLOCK_SIZE);
+    Block* block = newBlock(size);
+    block->mNext = mBlocks;
+    mBlocks = block;
+    mCur = reinterpret_cast<char*>(block + 1);
+    mEnd = mCur + size;
+    return allocate(bytes, alignment);
+}
+
+size_t
+Arena::getReservedBytes() const
+{
+    size_t res = 0;
+    for (Block* b = mBlocks; b != nullptr; b = b->mNext)
+    {
+        res += sizeof(Block) + b->mSize;
+    }
+    return res;
+}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the arena allocator of the state of the slots.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "util/NonCopyable.h"
+
+namespace stellar
+{
+/**
+ * Memory is carved out of blocks that are only released all at once, when
+ * the arena is destroyed, which suits containers that live and die
+ * together, such as the state of a slot: besides saving a call to the
+ * global allocator per node, their memory doesn't end up scattered across
+ * the heap.
+ *
+ * Small chunks (up to MAX_FREE_SIZE bytes, such as the nodes of a map) are
+ * rounded up to a multiple of FREE_ALIGN and kept on a free list by size
+ * when deallocated, to be reused by the next allocation of that size: a
+ * container whose nodes are replaced over and over only holds as much
+ * memory as it held at most at once. Larger chunks aren't reused.
+ */
+class Arena : public NonMovableOrCopyable
+{
+    struct Block
+    {
+        Block* mNext;
+        size_t mSize; // bytes following the header
+    };
+
+    Block* mBlocks{nullptr}; // most recent first
+    char* mCur{nullptr};
+    char* mEnd{nullptr};
+    size_t mNextSize;
+    size_t mAllocated{0};
+
+    static constexpr size_t MAX_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t FREE_ALIGN = 16;
+    static constexpr size_t MAX_FREE_SIZE = 128;
+
+    // heads of the lists of freed small chunks, by size, linked through
+    // their first word
+    void* mFree[MAX_FREE_SIZE / FREE_ALIGN] = {};
+
+    static bool
+    isSmall(size_t bytes, size_t alignment)
+    {
+        return bytes <= MAX_FREE_SIZE && alignment <= FREE_ALIGN;
+    }
+    static size_t
+    getSizeClass(size_t bytes)
+    {
+        return bytes == 0 ? 0 : (bytes - 1) / FREE_ALIGN;
+    }
+
+    Block* newBlock(size_t size);
+
+  public:
+    explicit Arena(size_t initialSize = 1024);
+    ~Arena();
+
+    void*
+    allocate(size_t bytes, size_t alignment)
+    {
+        if (isSmall(bytes, alignment))
+        {
+            size_t cls = getSizeClass(bytes);
+            bytes = (cls + 1) * FREE_ALIGN;
+            if (void* chunk = mFree[cls])
+            {
+                mFree[cls] = *static_cast<void**>(chunk);
+                mAllocated += bytes;
+                return chunk;
+            }
+            // any chunk of the class can be reused for any small alignment
+            alignment = FREE_ALIGN;
+        }
+        auto cur = reinterpret_cast<uintptr_t>(mCur);
+        auto aligned = (cur + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (mCur == nullptr ||
+            aligned + bytes > reinterpret_cast<uintptr_t>(mEnd))
+        {
+            return allocateSlow(bytes, alignment);
+        }
+        mCur = reinterpret_cast<char*>(aligned + bytes);
+        mAllocated += bytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void* allocateSlow(size_t bytes, size_t alignment);
+
+    // gives back what `allocate(bytes, alignment)` returned
+    void
+    deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        if (isSmall(bytes, alignment))
+        {
+            size_t cls = getSizeClass(bytes);
+            *static_cast<void**>(p) = mFree[cls];
+            mFree[cls] = p;
+            mAllocated -= (cls + 1) * FREE_ALIGN;
+        }
+    }
+
+    // bytes handed out by `allocate` and not given back, large chunks
+    // included
+    size_t
+    getAllocatedBytes() const
+    {
+        return mAllocated;
+    }
+    // bytes obtained from the global allocator
+    size_t getReservedBytes() const;
+};
+
+// Allocator drawing from an Arena, for standard containers
+template <typename T> class ArenaAllocator
+{
+    Arena* mArena;
+
+    template <typename U> friend class ArenaAllocator;
+
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : mArena(&arena)
+    {
+    }
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const& other) : mArena(other.mArena)
+    {
+    }
+
+    T*
+    allocate(size_t n)
+    {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void
+    deallocate(T* p, size_t n)
+    {
+        mArena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool
+    operator==(ArenaAllocator<U> const& other) const
+    {
+        return mArena == other.mArena;
+    }
+    template <typename U>
+    bool
+    operator!=(ArenaAllocator<U> const& other) const
+    {
+        return mArena != other.mArena;
+    }
+};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains a bounded lock-free multi-producer single-consumer queue.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "util/NonCopyable.h"
+
+namespace stellar
+{
+/**
+ * Fixed capacity queue that any number of threads push to and a single
+ * thread pops from, without locks (the bounded queue of D. Vyukov): every
+ * cell carries a sequence number telling whether it is free for the push
+ * of a given position or holds the value to pop at a given position.
+ * Producers claim a position with a CAS on the tail, the consumer owns the
+ * head. A push fails rather than waits when the queue is full.
+ */
+template <typename T> class BoundedMPSCQueue : public NonMovableOrCopyable
+{
+    struct Cell
+    {
+        std::atomic<size_t> mSeq;
+        T mValue;
+    };
+
+    // keeps the tail (producers) and the head (consumer) on different
+    // cache lines
+    template <typename V> struct CacheLine
+    {
+        V mValue;
+        char mPad[64 - sizeof(V)];
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t const mMask;
+    CacheLine<std::atomic<size_t>> mTail;
+    CacheLine<size_t> mHead;
+
+    static size_t
+    roundCapacity(size_t capacity)
+    {
+        size_t res = 2;
+        while (res < capacity)
+        {
+            res <<= 1;
+        }
+        return res;
+    }
+
+  public:
+    // the capacity is rounded up to a power of 2
+    explicit BoundedMPSCQueue(size_t capacity)
+        : mCells(new Cell[roundCapacity(capacity)])
+        , mMask(roundCapacity(capacity) - 1)
+    {
+        for (size_t i = 0; i <= mMask; ++i)
+        {
+            mCells[i].mSeq.store(i, std::memory_order_relaxed);
+        }
+        mTail.mValue.store(0, std::memory_order_relaxed);
+        mHead.mValue = 0;
+    }
+
+    // from any thread, returns false if the queue is full
+    template <typename U>
+    bool
+    tryPush(U&& value)
+    {
+        Cell* cell;
+        size_t pos = mTail.mValue.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->mSeq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (mTail.mValue.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // the consumer didn't pop the value of a lap ago yet
+                return false;
+            }
+            else
+            {
+                pos = mTail.mValue.load(std::memory_order_relaxed);
+            }
+        }
+        cell->mValue = std::forward<U>(value);
+        cell->mSeq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // from the consumer thread only, returns false if the queue is empty
+    // (or the next value is still being pushed)
+    bool
+    tryPop(T& value)
+    {
+        size_t& head = mHead.mValue;
+        Cell& cell = mCells[head & mMask];
+        if (cell.mSeq.load(std::memory_order_acquire) != head + 1)
+        {
+            return false;
+        }
+        value = std::move(cell.mValue);
+        cell.mSeq.store(head + mMask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    size_t
+    capacity() const
+    {
+        return mMask + 1;
+    }
+};
+}
@@ -1,5 +1,6 @@
 #include "HashOfHash.h"
 #include "crypto/ByteSliceHasher.h"
+#include <cstring>
 
 namespace std
 {
@@ -22,3 +23,42 @@ hash<stellar::uint512>::operator()(stellar::uint512 const& x) const noexcept
     return res;
 }
 }
+
+namespace stellar
+{
+namespace
+{
+template <size_t N>
+size_t
+foldWords(unsigned char const* data)
+{
+    static_assert(N % sizeof(uint64_t) == 0, "unexpected size");
+    uint64_t res = 0;
+    for (size_t i = 0; i < N; i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        std::memcpy(&w, data + i, sizeof(w));
+        res ^= w;
+    }
+    return static_cast<size_t>(res);
+}
+}
+
+size_t
+UniformHash<uint256>::operator()(uint256 const& x) const noexcept
+{
+    return foldWords<32>(x.data());
+}
+
+size_t
+UniformHash<uint512>::operator()(uint512 const& x) const noexcept
+{
+    return foldWords<64>(x.data());
+}
+
+size_t
+UniformHash<PublicKey>::operator()(PublicKey const& x) const noexcept
+{
+    return UniformHash<uint256>()(x.ed25519());
+}
+}
@@ -13,3 +13,29 @@ template <> struct hash<stellar::uint512>
     size_t operator()(stellar::uint512 const& x) const noexcept;
 };
 }
+
+namespace stellar
+{
+// Hashers for keys that are already uniformly distributed and that an
+// attacker can't choose, such as the public keys of the validators of a
+// known quorum: the 64-bit words of the key are folded together instead of
+// going through the keyed SipHash of std::hash (see ByteSliceHasher).
+// Containers whose keys come from the network must keep using std::hash,
+// the key of SipHash is what makes them resistant to flooding.
+template <typename T> struct UniformHash;
+
+template <> struct UniformHash<uint256>
+{
+    size_t operator()(uint256 const& x) const noexcept;
+};
+
+template <> struct UniformHash<uint512>
+{
+    size_t operator()(uint512 const& x) const noexcept;
+};
+
+template <> struct UniformHash<PublicKey>
+{
+    size_t operator()(PublicKey const& x) const noexcept;
+};
+}
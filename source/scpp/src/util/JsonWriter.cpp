@@ -0,0 +1,178 @@
+/*******************************************************************************
+
+    Implementation of a streaming JSON writer, see JsonWriter.h.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "util/JsonWriter.h"
+
+#include "lib/json/json.h"
+#include "util/GlobalChecks.h"
+
+namespace stellar
+{
+JsonWriter::JsonWriter(std::ostream& out) : mOut(out)
+{
+}
+
+void
+JsonWriter::separate()
+{
+    if (mAfterKey)
+    {
+        mAfterKey = false;
+        return;
+    }
+    if (!mEmpty.empty())
+    {
+        if (!mEmpty.back())
+        {
+            mOut << ',';
+        }
+        mEmpty.back() = false;
+    }
+}
+
+void
+JsonWriter::writeString(std::string const& s)
+{
+    static char const hex[] = "0123456789ABCDEF";
+    mOut << '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            mOut << "\\\"";
+            break;
+        case '\\':
+            mOut << "\\\\";
+            break;
+        case '\b':
+            mOut << "\\b";
+            break;
+        case '\f':
+            mOut << "\\f";
+            break;
+        case '\n':
+            mOut << "\\n";
+            break;
+        case '\r':
+            mOut << "\\r";
+            break;
+        case '\t':
+            mOut << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                mOut << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+            }
+            else
+            {
+                mOut << c;
+            }
+        }
+    }
+    mOut << '"';
+}
+
+void
+JsonWriter::beginObject()
+{
+    separate();
+    mOut << '{';
+    mEmpty.push_back(true);
+}
+
+void
+JsonWriter::endObject()
+{
+    dbgAssert(!mEmpty.empty() && !mAfterKey);
+    mEmpty.pop_back();
+    mOut << '}';
+}
+
+void
+JsonWriter::beginArray()
+{
+    separate();
+    mOut << '[';
+    mEmpty.push_back(true);
+}
+
+void
+JsonWriter::endArray()
+{
+    dbgAssert(!mEmpty.empty() && !mAfterKey);
+    mEmpty.pop_back();
+    mOut << ']';
+}
+
+void
+JsonWriter::key(std::string const& k)
+{
+    dbgAssert(!mEmpty.empty() && !mAfterKey);
+    separate();
+    writeString(k);
+    mOut << ':';
+    mAfterKey = true;
+}
+
+void
+JsonWriter::value(std::string const& v)
+{
+    separate();
+    writeString(v);
+}
+
+void
+JsonWriter::value(char const* v)
+{
+    value(std::string(v));
+}
+
+void
+JsonWriter::value(uint64_t v)
+{
+    separate();
+    mOut << v;
+}
+
+void
+JsonWriter::value(int64_t v)
+{
+    separate();
+    mOut << v;
+}
+
+void
+JsonWriter::value(bool v)
+{
+    separate();
+    mOut << (v ? "true" : "false");
+}
+
+void
+JsonWriter::value(Json::Value const& v)
+{
+    separate();
+    Json::FastWriter fw;
+    std::string s = fw.write(v);
+    // FastWriter terminates documents with a new line
+    if (!s.empty() && s.back() == '\n')
+    {
+        s.pop_back();
+    }
+    mOut << s;
+}
+}
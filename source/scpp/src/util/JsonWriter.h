@@ -0,0 +1,63 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains a streaming JSON writer.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+#include "lib/json/json-forwards.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+/**
+ * Writes JSON to a stream as it is produced, in the format of
+ * Json::FastWriter, so that large documents don't have to be built as a
+ * Json::Value tree before being serialized.
+ *
+ * The caller is responsible for the structure: keys are only valid in
+ * objects, and every begin must be matched by an end.
+ */
+class JsonWriter
+{
+    std::ostream& mOut;
+    // for every open container, whether nothing was written to it yet
+    std::vector<bool> mEmpty;
+    bool mAfterKey{false};
+
+    // writes the separator preceding a new element
+    void separate();
+    void writeString(std::string const& s);
+
+  public:
+    explicit JsonWriter(std::ostream& out);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(std::string const& k);
+
+    void value(std::string const& v);
+    void value(char const* v);
+    void value(uint64_t v);
+    void value(int64_t v);
+    void value(bool v);
+    // a tree built by the caller
+    void value(Json::Value const& v);
+};
+}
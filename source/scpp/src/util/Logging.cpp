@@ -3,25 +3,141 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include <cstdarg>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include "Logging.h"
 
 using namespace std;
 
+namespace
+{
+// Levels of the D logger (`ocean.util.log.ILogger.Level`)
+enum DLogLevel
+{
+    D_TRACE = 0,
+    D_INFO,
+    D_WARN,
+    D_ERROR,
+    D_FATAL,
+    D_NONE
+};
+
+int
+toDLogLevel(int level)
+{
+    switch (level)
+    {
+    case TRACE:
+    case DEBUG:
+        return D_TRACE;
+    case INFO:
+        return D_INFO;
+    case WARN:
+        return D_WARN;
+    case ERROR:
+        return D_ERROR;
+    default:
+        return D_FATAL;
+    }
+}
+}
+
+void
+setDLogLevel(int level)
+{
+    switch (level)
+    {
+    case D_TRACE:
+        stellar::Logging::setLogLevel(TRACE);
+        break;
+    case D_INFO:
+        stellar::Logging::setLogLevel(INFO);
+        break;
+    case D_WARN:
+        stellar::Logging::setLogLevel(WARN);
+        break;
+    case D_ERROR:
+        stellar::Logging::setLogLevel(ERROR);
+        break;
+    case D_FATAL:
+        stellar::Logging::setLogLevel(FATAL);
+        break;
+    default:
+        stellar::Logging::setLogLevel(FATAL + 1);
+        break;
+    }
+}
+
 namespace stellar
 {
-DLogger::DLogger(int level, std::string const& loggerName)
+std::atomic<int> Logging::mLogLevel{INFO};
+
+void
+Logging::setLogLevel(int level)
 {
-    mLevel = level;
-    mLoggerName = std::string(loggerName);
+    mLogLevel.store(level, std::memory_order_relaxed);
 }
 
-DLogger::~DLogger()
+LogBuffer::LogBuffer()
+{
+    // keep room for the terminating NUL
+    setp(mInline, mInline + sizeof(mInline) - 1);
+}
+
+void
+LogBuffer::spill()
 {
-    if (mLevel == TRACE && !Logging::logTrace("SCP"))
-        return;
+    if (pbase() == mInline)
+    {
+        mOverflow.assign(pbase(), pptr());
+        setp(nullptr, nullptr);
+    }
+}
+
+LogBuffer::int_type
+LogBuffer::overflow(int_type c)
+{
+    spill();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        mOverflow.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
 
-    writeDLog(mLoggerName.c_str(), mLevel, mOutStream.str().c_str());
+std::streamsize
+LogBuffer::xsputn(char const* s, std::streamsize n)
+{
+    if (n <= epptr() - pptr())
+    {
+        std::memcpy(pptr(), s, n);
+        pbump(static_cast<int>(n));
+        return n;
+    }
+    spill();
+    mOverflow.append(s, n);
+    return n;
+}
+
+char const*
+LogBuffer::c_str()
+{
+    if (pbase() == mInline)
+    {
+        *pptr() = '\0';
+        return mInline;
+    }
+    return mOverflow.c_str();
+}
+
+DLogger::DLogger(int level, char const* loggerName)
+    : mLoggerName(loggerName), mLevel(level), mOutStream(&mBuffer)
+{
+}
+
+DLogger::~DLogger()
+{
+    writeDLog(mLoggerName, toDLogLevel(mLevel), mBuffer.c_str());
 }
 }
@@ -4,43 +4,94 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <atomic>
 #include <string>
 #include <sstream>
 #include <iostream>
 
 #define TRACE 0
-#define DEBUG 0
-#define INFO  1
-#define WARN  2
-#define ERROR 3
-#define FATAL 4
-#define CLOG(LEVEL, MOD) stellar::DLogger(LEVEL, MOD)
-
-// Logging function to D code
+#define DEBUG 1
+#define INFO  2
+#define WARN  3
+#define ERROR 4
+#define FATAL 5
+
+// The stream expression is only evaluated if LEVEL is enabled, see
+// Logging::setLogLevel
+#define CLOG(LEVEL, MOD)                                                       \
+    !stellar::Logging::isLogLevelEnabled(LEVEL)                                \
+        ? (void)0                                                              \
+        : stellar::DLogVoidify() & stellar::DLogger(LEVEL, MOD)
+
+// Logging function to D code, `level` being a level of the D logger
 void writeDLog(const char* logger, int level, const char* msg);
 
+// Sets the level of the D logger the messages are written to, so that
+// messages it would drop are not formatted
+void setDLogLevel(int level);
+
 namespace stellar
 {
 class Logging
 {
+    static std::atomic<int> mLogLevel;
+
   public:
     static void init();
     static void setFmt(std::string const& peerID, bool timestamps = true);
     static void setLoggingToFile(std::string const& filename);
-    static bool logDebug(std::string const& partition) { return false; }
-    static bool logTrace(std::string const& partition) { return false; }
+
+    // messages below `level` are dropped, INFO by default: TRACE and DEBUG
+    // messages are only written once the D logger asks for them
+    static void setLogLevel(int level);
+    static bool
+    isLogLevelEnabled(int level)
+    {
+        return level >= mLogLevel.load(std::memory_order_relaxed);
+    }
+    static bool
+    logDebug(std::string const& partition)
+    {
+        return isLogLevelEnabled(DEBUG);
+    }
+    static bool
+    logTrace(std::string const& partition)
+    {
+        return isLogLevelEnabled(TRACE);
+    }
     static void rotate();
 };
 
+// Buffer of a log line, stored inline unless the line is too long
+class LogBuffer : public std::streambuf
+{
+    char mInline[256];
+    std::string mOverflow;
+
+    // moves the line to mOverflow, where any further output goes
+    void spill();
+
+  protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(char const* s, std::streamsize n) override;
+
+  public:
+    LogBuffer();
+
+    // the NUL-terminated line
+    char const* c_str();
+};
+
 struct DLogger
 {
   private:
-    std::string mLoggerName;
+    char const* mLoggerName;
     int mLevel;
-    std::ostringstream mOutStream;
+    LogBuffer mBuffer;
+    std::ostream mOutStream;
 
   public:
-    DLogger(int level, std::string const& loggerName);
+    DLogger(int level, char const* loggerName);
     ~DLogger();
 
     template <class T>
@@ -50,4 +101,14 @@ struct DLogger
         return *this;
     }
 };
+
+// Turns a CLOG statement into a void expression, as `&` binds less tightly
+// than the `<<` of the message
+struct DLogVoidify
+{
+    void
+    operator&(DLogger const&)
+    {
+    }
+};
 }
@@ -8,8 +8,9 @@
 namespace stellar
 {
 
-std::default_random_engine gRandomEngine;
-std::uniform_real_distribution<double> uniformFractionDistribution(0.0, 1.0);
+thread_local std::default_random_engine gRandomEngine;
+thread_local std::uniform_real_distribution<double>
+    uniformFractionDistribution(0.0, 1.0);
 
 double
 rand_fraction()
@@ -16,7 +16,9 @@ size_t rand_pareto(float alpha, size_t max);
 
 bool rand_flip();
 
-extern std::default_random_engine gRandomEngine;
+// one engine per thread, so that SCP instances running on separate threads
+// don't race on it
+extern thread_local std::default_random_engine gRandomEngine;
 
 template <typename T>
 T
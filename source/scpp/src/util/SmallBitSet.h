@@ -0,0 +1,388 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains a bitset with inline storage.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+// Variant of BitSet (see util/BitSet.h) storing its first InlineWords 64-bit
+// words inline: sets of up to 64 * InlineWords elements never allocate, and
+// operations only loop over the words in use. Larger sets move to the heap.
+//
+// The interface is the one of BitSet, so the two can be swapped.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#include "util/cbitset.h"
+
+template <size_t InlineWords> class SmallBitSet
+{
+    static_assert(InlineWords > 0, "SmallBitSet needs inline storage");
+
+    // Words of the set: mInline until a bit past the inline words is set,
+    // then mHeap (which always has more than InlineWords words). Only the
+    // first mUsed words may be non-zero, so that operations on small sets
+    // only look at the words they use.
+    uint64_t mInline[InlineWords] = {};
+    std::vector<uint64_t> mHeap;
+    size_t mUsed = {0};
+    mutable bool mCountDirty = {false};
+    mutable size_t mCount = {0};
+
+    bool
+    isInline() const
+    {
+        return mHeap.empty();
+    }
+
+    uint64_t*
+    words()
+    {
+        return isInline() ? mInline : mHeap.data();
+    }
+    uint64_t const*
+    words() const
+    {
+        return isInline() ? mInline : mHeap.data();
+    }
+    size_t
+    numWords() const
+    {
+        return isInline() ? InlineWords : mHeap.size();
+    }
+
+    // make room for n words
+    void
+    reserveWords(size_t n)
+    {
+        if (n <= numWords())
+        {
+            return;
+        }
+        if (isInline())
+        {
+            mHeap.reserve(n);
+            mHeap.assign(mInline, mInline + InlineWords);
+        }
+        mHeap.resize(n, 0);
+    }
+
+    // word k of the set, 0 if out of range
+    uint64_t
+    word(size_t k) const
+    {
+        return k < mUsed ? words()[k] : 0;
+    }
+
+  public:
+    SmallBitSet()
+    {
+    }
+    SmallBitSet(size_t n)
+    {
+        reserveWords((n + 63) / 64);
+    }
+    SmallBitSet(std::set<size_t> const& s)
+    {
+        if (!s.empty())
+        {
+            reserveWords(*s.rbegin() / 64 + 1);
+        }
+        for (auto i : s)
+            set(i);
+    }
+
+    bool
+    operator==(SmallBitSet const& other) const
+    {
+        size_t n = std::max(mUsed, other.mUsed);
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (word(k) != other.word(k))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool
+    isSubsetEq(SmallBitSet const& other) const
+    {
+        uint64_t const* w = words();
+        for (size_t k = 0; k < mUsed; ++k)
+        {
+            if ((w[k] & other.word(k)) != w[k])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool
+    operator<=(SmallBitSet const& other) const
+    {
+        return isSubsetEq(other);
+    }
+
+    size_t
+    size() const
+    {
+        return numWords() * 64;
+    }
+    void
+    set(size_t i)
+    {
+        size_t k = i / 64;
+        reserveWords(k + 1);
+        words()[k] |= (uint64_t(1) << (i % 64));
+        mUsed = std::max(mUsed, k + 1);
+        mCountDirty = true;
+    }
+    void
+    unset(size_t i)
+    {
+        if (i / 64 < mUsed)
+        {
+            words()[i / 64] &= ~(uint64_t(1) << (i % 64));
+            mCountDirty = true;
+        }
+    }
+    bool
+    get(size_t i) const
+    {
+        return (word(i / 64) >> (i % 64)) & 1;
+    }
+    void
+    clear()
+    {
+        std::fill(words(), words() + mUsed, 0);
+        mUsed = 0;
+        mCount = 0;
+        mCountDirty = false;
+    }
+
+    size_t
+    count() const
+    {
+        if (mCountDirty)
+        {
+            mCount = bitset_popcount_words(words(), mUsed);
+            mCountDirty = false;
+        }
+        return mCount;
+    }
+    bool
+    empty() const
+    {
+        size_t tmp = 0;
+        return !nextSet(tmp);
+    }
+    operator bool() const
+    {
+        return !empty();
+    }
+    size_t
+    min() const
+    {
+        size_t i = 0;
+        return nextSet(i) ? i : SIZE_MAX;
+    }
+    size_t
+    max() const
+    {
+        uint64_t const* w = words();
+        for (size_t k = mUsed; k > 0; --k)
+        {
+            if (w[k - 1] != 0)
+            {
+                return (k - 1) * 64 + 63 - __builtin_clzll(w[k - 1]);
+            }
+        }
+        return 0;
+    }
+
+    void
+    inplaceUnion(SmallBitSet const& other)
+    {
+        reserveWords(other.mUsed);
+        uint64_t* w = words();
+        uint64_t const* o = other.words();
+        for (size_t k = 0; k < other.mUsed; ++k)
+            w[k] |= o[k];
+        mUsed = std::max(mUsed, other.mUsed);
+        mCountDirty = true;
+    }
+    SmallBitSet
+    operator|(SmallBitSet const& other) const
+    {
+        SmallBitSet tmp(*this);
+        tmp.inplaceUnion(other);
+        return tmp;
+    }
+    void
+    operator|=(SmallBitSet const& other)
+    {
+        inplaceUnion(other);
+    }
+
+    void
+    inplaceIntersection(SmallBitSet const& other)
+    {
+        uint64_t* w = words();
+        for (size_t k = 0; k < mUsed; ++k)
+            w[k] &= other.word(k);
+        mUsed = std::min(mUsed, other.mUsed);
+        mCountDirty = true;
+    }
+    SmallBitSet operator&(SmallBitSet const& other) const
+    {
+        SmallBitSet tmp(*this);
+        tmp.inplaceIntersection(other);
+        return tmp;
+    }
+    void
+    operator&=(SmallBitSet const& other)
+    {
+        inplaceIntersection(other);
+    }
+
+    void
+    inplaceDifference(SmallBitSet const& other)
+    {
+        uint64_t* w = words();
+        uint64_t const* o = other.words();
+        size_t n = std::min(mUsed, other.mUsed);
+        for (size_t k = 0; k < n; ++k)
+            w[k] &= ~o[k];
+        mCountDirty = true;
+    }
+    SmallBitSet
+    operator-(SmallBitSet const& other) const
+    {
+        SmallBitSet tmp(*this);
+        tmp.inplaceDifference(other);
+        return tmp;
+    }
+    void
+    operator-=(SmallBitSet const& other)
+    {
+        inplaceDifference(other);
+    }
+
+    void
+    inplaceSymmetricDifference(SmallBitSet const& other)
+    {
+        reserveWords(other.mUsed);
+        uint64_t* w = words();
+        uint64_t const* o = other.words();
+        for (size_t k = 0; k < other.mUsed; ++k)
+            w[k] ^= o[k];
+        mUsed = std::max(mUsed, other.mUsed);
+        mCountDirty = true;
+    }
+    SmallBitSet
+    symmetricDifference(SmallBitSet const& other) const
+    {
+        SmallBitSet tmp(*this);
+        tmp.inplaceSymmetricDifference(other);
+        return tmp;
+    }
+
+    size_t
+    unionCount(SmallBitSet const& other) const
+    {
+        return count() + other.count() - intersectionCount(other);
+    }
+    size_t
+    intersectionCount(SmallBitSet const& other) const
+    {
+        return bitset_popcount_and_words(words(), other.words(),
+                                         std::min(mUsed, other.mUsed));
+    }
+    size_t
+    differenceCount(SmallBitSet const& other) const
+    {
+        return count() - intersectionCount(other);
+    }
+    size_t
+    symmetricDifferenceCount(SmallBitSet const& other) const
+    {
+        return count() + other.count() - 2 * intersectionCount(other);
+    }
+    bool
+    nextSet(size_t& i) const
+    {
+        size_t k = i / 64;
+        if (k >= mUsed)
+        {
+            return false;
+        }
+        uint64_t const* w = words();
+        uint64_t cur = w[k] >> (i % 64);
+        if (cur != 0)
+        {
+            i += __builtin_ctzll(cur);
+            return true;
+        }
+        for (++k; k < mUsed; ++k)
+        {
+            if (w[k] != 0)
+            {
+                i = k * 64 + __builtin_ctzll(w[k]);
+                return true;
+            }
+        }
+        return false;
+    }
+    void
+    streamWith(std::ostream& out,
+               std::function<void(std::ostream&, size_t)> item) const
+    {
+        out << '{';
+        bool first = true;
+        for (size_t i = 0; nextSet(i); ++i)
+        {
+            if (first)
+            {
+                first = false;
+            }
+            else
+            {
+                out << ", ";
+            }
+            item(out, i);
+        }
+        out << '}';
+    }
+    void
+    stream(std::ostream& out) const
+    {
+        streamWith(out, [](std::ostream& out, size_t i) { out << i; });
+    }
+};
+
+template <size_t InlineWords>
+inline std::ostream&
+operator<<(std::ostream& out, SmallBitSet<InlineWords> const& b)
+{
+    b.stream(out);
+    return out;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+/*******************************************************************************
+
+    Contains the optional Tracy zones of the SCP library.
+
+    Note: This is not part of Stellar SCP code.
+
+    Copyright:
+        Copyright (c) 2019-2021 BOSAGORA Foundation
+        All rights reserved.
+
+    License:
+        MIT License. See LICENSE for details.
+
+*******************************************************************************/
+
+/**
+ * Tracy zones for the SCP library, with the names of the Tracy client
+ * macros: `ZoneScoped` times the rest of the enclosing scope, named after
+ * the function, `ZoneScopedN("name")` the same with an explicit name, and
+ * `ZoneValue(v)` attaches a number to the innermost zone of the scope.
+ *
+ * The zones only exist when TRACY_ENABLE is defined (see build.d), the
+ * macros expand to nothing otherwise. They go through the C API of the
+ * Tracy client, which the D side binds as well (agora.utils.TracyAPI), so
+ * the library doesn't need the Tracy sources to build, only to link with
+ * TracyClient.o when enabled.
+ */
+
+#ifdef TRACY_ENABLE
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+    struct ___tracy_source_location_data
+    {
+        char const* name;
+        char const* function;
+        char const* file;
+        uint32_t line;
+        uint32_t color;
+    };
+
+    struct ___tracy_c_zone_context
+    {
+        uint32_t id;
+        int active;
+    };
+
+    ___tracy_c_zone_context
+    ___tracy_emit_zone_begin(___tracy_source_location_data const* srcloc,
+                             int active);
+    void ___tracy_emit_zone_end(___tracy_c_zone_context ctx);
+    void ___tracy_emit_zone_value(___tracy_c_zone_context ctx,
+                                  uint64_t value);
+}
+
+namespace stellar
+{
+// ends the zone when it goes out of scope
+class TracyZone
+{
+    ___tracy_c_zone_context mCtx;
+
+  public:
+    explicit TracyZone(___tracy_source_location_data const* srcloc)
+        : mCtx(___tracy_emit_zone_begin(srcloc, 1))
+    {
+    }
+    ~TracyZone()
+    {
+        ___tracy_emit_zone_end(mCtx);
+    }
+    TracyZone(TracyZone const&) = delete;
+    TracyZone& operator=(TracyZone const&) = delete;
+
+    void
+    value(uint64_t v)
+    {
+        ___tracy_emit_zone_value(mCtx, v);
+    }
+};
+}
+
+#define SCP_TRACY_CONCAT2(a, b) a##b
+#define SCP_TRACY_CONCAT(a, b) SCP_TRACY_CONCAT2(a, b)
+
+// the source location must outlive the zone, hence the static
+#define ZoneScopedN(name)                                                      \
+    static ___tracy_source_location_data const SCP_TRACY_CONCAT(               \
+        __scp_tracy_srcloc, __LINE__){name, __func__, __FILE__,                \
+                                      (uint32_t)__LINE__, 0};                  \
+    stellar::TracyZone ___scp_tracy_zone(                                      \
+        &SCP_TRACY_CONCAT(__scp_tracy_srcloc, __LINE__))
+#define ZoneScoped ZoneScopedN(nullptr)
+#define ZoneValue(v) ___scp_tracy_zone.value(v)
+
+#else
+
+#define ZoneScopedN(name)
+#define ZoneScoped
+#define ZoneValue(v)
+
+#endif
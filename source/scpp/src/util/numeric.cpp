@@ -6,8 +6,35 @@
 #include <cassert>
 #include <stdexcept>
 
+// The compiler's 128 bits integers are used where available: their division
+// runs on the hardware 128/64 division (or libgcc's __udivti3), while
+// uint128_t divides bit by bit. uint128_t stays the type of the interface,
+// and the implementation where they are not available.
+#if defined(__SIZEOF_INT128__) && !defined(STELLAR_NO_NATIVE_INT128)
+#define STELLAR_NATIVE_INT128 1
+#endif
+
 namespace stellar
 {
+#ifdef STELLAR_NATIVE_INT128
+namespace
+{
+__extension__ typedef unsigned __int128 native_uint128;
+
+native_uint128
+toNative(uint128_t const& a)
+{
+    return (native_uint128(a.upper()) << 64) | a.lower();
+}
+
+uint128_t
+fromNative(native_uint128 a)
+{
+    return uint128_t(uint64_t(a >> 64), uint64_t(a));
+}
+}
+#endif
+
 // calculates A*B/C when A*B overflows 64bits
 bool
 bigDivide(int64_t& result, int64_t A, int64_t B, int64_t C, Rounding rounding)
@@ -28,6 +55,15 @@ bool
 bigDivide(uint64_t& result, uint64_t A, uint64_t B, uint64_t C,
           Rounding rounding)
 {
+#ifdef STELLAR_NATIVE_INT128
+    // A * B + C - 1 <= UINT64_MAX * UINT64_MAX + UINT64_MAX - 1 can't overflow
+    native_uint128 ab = native_uint128(A) * B;
+    native_uint128 x = rounding == ROUND_DOWN ? ab / C : (ab + C - 1) / C;
+
+    result = (uint64_t)x;
+
+    return (x <= UINT64_MAX);
+#else
     // update when moving to (signed) int128
     uint128_t a(A);
     uint128_t b(B);
@@ -37,6 +73,7 @@ bigDivide(uint64_t& result, uint64_t A, uint64_t B, uint64_t C,
     result = (uint64_t)x;
 
     return (x <= UINT64_MAX);
+#endif
 }
 
 int64_t
@@ -70,6 +107,20 @@ bigDivide(uint64_t& result, uint128_t a, uint64_t B, Rounding rounding)
 {
     assert(B != 0);
 
+#ifdef STELLAR_NATIVE_INT128
+    native_uint128 const na = toNative(a);
+    // see below for the overflow of a + B - 1
+    if ((rounding == ROUND_UP) && (na > ~native_uint128(0) - (B - 1)))
+    {
+        return false;
+    }
+
+    native_uint128 nx = rounding == ROUND_DOWN ? na / B : (na + B - 1) / B;
+
+    result = (uint64_t)nx;
+
+    return (nx <= UINT64_MAX);
+#else
     // update when moving to (signed) int128
     uint128_t b(B);
 
@@ -96,6 +147,7 @@ bigDivide(uint64_t& result, uint128_t a, uint64_t B, Rounding rounding)
     result = (uint64_t)x;
 
     return (x <= UINT64_MAX);
+#endif
 }
 
 int64_t
@@ -112,9 +164,13 @@ bigDivide(uint128_t a, int64_t B, Rounding rounding)
 uint128_t
 bigMultiply(uint64_t a, uint64_t b)
 {
+#ifdef STELLAR_NATIVE_INT128
+    return fromNative(native_uint128(a) * b);
+#else
     uint128_t A(a);
     uint128_t B(b);
     return A * B;
+#endif
 }
 
 uint128_t